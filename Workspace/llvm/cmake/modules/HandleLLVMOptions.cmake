@@ -70,6 +70,10 @@ if( LLVM_ENABLE_ASSERTIONS )
   endif()
 endif()
 
+if( LLVM_ENABLE_STATS )
+  add_definitions( -DLLVM_ENABLE_STATS )
+endif()
+
 if(WIN32)
   set(LLVM_HAVE_LINK_VERSION_SCRIPT 0)
   if(CYGWIN)
@@ -19,6 +19,10 @@
 //
 // Later, in the code: ++NumInstsKilled;
 //
+// Updates are spread over per-thread shards of counters that are summed when
+// the statistic is read, so bumping a statistic from several threads neither
+// races nor contends on a single cache line.
+//
 // NOTE: Statistics *must* be declared as global variables.
 //
 //===----------------------------------------------------------------------===//
@@ -28,6 +32,7 @@
 
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/Valgrind.h"
+#include <vector>
 
 namespace llvm {
 class raw_ostream;
@@ -36,76 +41,69 @@ class Statistic {
 public:
   const char *Name;
   const char *Desc;
+  /// Value - The part of the value that is not held in the shards: all of it
+  /// if the statistic could not be given shards, otherwise whatever was last
+  /// assigned to it.
   volatile llvm::sys::cas_flag Value;
   bool Initialized;
-
-  llvm::sys::cas_flag getValue() const { return Value; }
+  /// ID - The index of this statistic's counter in each shard, assigned when
+  /// the statistic is registered.
+  unsigned ID;
+  const char *VarName;
+
+  /// getValue - Return the sum of all shards.  This does not stop concurrent
+  /// updates, so the result is only a snapshot.
+  unsigned getValue() const;
   const char *getName() const { return Name; }
   const char *getDesc() const { return Desc; }
+  const char *getVarName() const { return VarName ? VarName : ""; }
 
   /// construct - This should only be called for non-global statistics.
   void construct(const char *name, const char *desc) {
     Name = name; Desc = desc;
     Value = 0; Initialized = false;
+    ID = 0; VarName = nullptr;
   }
 
   // Allow use of this class as the value itself.
-  operator unsigned() const { return Value; }
+  operator unsigned() const { return getValue(); }
 
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
-   const Statistic &operator=(unsigned Val) {
-    Value = Val;
-    return init();
-  }
-
-  const Statistic &operator++() {
-    // FIXME: This function and all those that follow carefully use an
-    // atomic operation to update the value safely in the presence of
-    // concurrent accesses, but not to read the return value, so the
-    // return value is not thread safe.
-    sys::AtomicIncrement(&Value);
-    return init();
-  }
-
-  unsigned operator++(int) {
+  // Assigning, multiplying and dividing fold the shards back into one value
+  // and are not atomic with respect to concurrent updates of the statistic.
+  const Statistic &operator=(unsigned Val) {
     init();
-    unsigned OldValue = Value;
-    sys::AtomicIncrement(&Value);
-    return OldValue;
+    setValue(Val);
+    return *this;
   }
 
-  const Statistic &operator--() {
-    sys::AtomicDecrement(&Value);
-    return init();
-  }
-
-  unsigned operator--(int) {
-    init();
-    unsigned OldValue = Value;
-    sys::AtomicDecrement(&Value);
-    return OldValue;
-  }
+  // The postfix forms return nothing: their old value would mean summing
+  // every shard on each update.
+  const Statistic &operator++() { return add(1); }
+  void operator++(int) { add(1); }
+  const Statistic &operator--() { return add(-1); }
+  void operator--(int) { add(-1); }
 
   const Statistic &operator+=(const unsigned &V) {
     if (!V) return *this;
-    sys::AtomicAdd(&Value, V);
-    return init();
+    return add(V);
   }
 
   const Statistic &operator-=(const unsigned &V) {
     if (!V) return *this;
-    sys::AtomicAdd(&Value, -V);
-    return init();
+    return add(-V);
   }
 
   const Statistic &operator*=(const unsigned &V) {
-    sys::AtomicMul(&Value, V);
-    return init();
+    init();
+    setValue(getValue() * V);
+    return *this;
   }
 
   const Statistic &operator/=(const unsigned &V) {
-    sys::AtomicDiv(&Value, V);
-    return init();
+    init();
+    setValue(getValue() / V);
+    return *this;
   }
 
 #else  // Statistics are disabled in release builds.
@@ -118,16 +116,14 @@ public:
     return *this;
   }
 
-  unsigned operator++(int) {
-    return 0;
+  void operator++(int) {
   }
 
   const Statistic &operator--() {
     return *this;
   }
 
-  unsigned operator--(int) {
-    return 0;
+  void operator--(int) {
   }
 
   const Statistic &operator+=(const unsigned &V) {
@@ -157,12 +153,23 @@ protected:
     return *this;
   }
   void RegisterStatistic();
+
+  const Statistic &add(sys::cas_flag Delta) {
+    init();
+    sys::AtomicAdd(getShardCounter(), Delta);
+    return *this;
+  }
+
+  /// getShardCounter - Return this statistic's counter in the calling
+  /// thread's shard.
+  volatile sys::cas_flag *getShardCounter();
+  void setValue(unsigned Val);
 };
 
 // STATISTIC - A macro to make definition of statistics really simple.  This
 // automatically passes the DEBUG_TYPE of the file into the statistic.
 #define STATISTIC(VARNAME, DESC) \
-  static llvm::Statistic VARNAME = { DEBUG_TYPE, DESC, 0, 0 }
+  static llvm::Statistic VARNAME = { DEBUG_TYPE, DESC, 0, 0, 0, #VARNAME }
 
 /// \brief Enable the collection and printing of statistics.
 void EnableStatistics();
@@ -176,6 +183,23 @@ void PrintStatistics();
 /// \brief Print statistics to the given output stream.
 void PrintStatistics(raw_ostream &OS);
 
+/// \brief Print statistics to the given output stream as a JSON object that
+/// maps "<debug type>.<variable name>" to the value of each statistic.
+void PrintStatisticsJSON(raw_ostream &OS);
+
+/// \brief A point-in-time value of one statistic.
+struct StatisticSnapshot {
+  const char *Name;
+  const char *VarName;
+  const char *Desc;
+  unsigned Value;
+};
+
+/// \brief Return the current value of every statistic collected so far.  This
+/// takes the registration lock but does not stop updates, so it is cheap
+/// enough to call during compilation.
+std::vector<StatisticSnapshot> GetStatistics();
+
 } // End llvm namespace
 
 #endif
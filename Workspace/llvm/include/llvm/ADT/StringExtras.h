@@ -141,8 +141,16 @@ void SplitString(StringRef Source,
 // better: http://eternallyconfuzzled.com/tuts/algorithms/jsw_tut_hashing.aspx
 //   X*33+c -> X*33^c
 static inline unsigned HashString(StringRef Str, unsigned Result = 0) {
-  for (StringRef::size_type i = 0, e = Str.size(); i != e; ++i)
-    Result = Result * 33 + (unsigned char)Str[i];
+  const unsigned char *P = reinterpret_cast<const unsigned char *>(Str.data());
+  StringRef::size_type i = 0, e = Str.size();
+  // Do four steps of Result * 33 + C at a time.  This computes the same value
+  // with a much shorter chain of dependent multiplies, which matters for the
+  // long mangled names in symbol tables.
+  for (; e - i >= 4; i += 4)
+    Result = Result * (33u * 33 * 33 * 33) + P[i] * (33u * 33 * 33) +
+             P[i + 1] * (33u * 33) + P[i + 2] * 33u + P[i + 3];
+  for (; i != e; ++i)
+    Result = Result * 33 + P[i];
   return Result;
 }
 
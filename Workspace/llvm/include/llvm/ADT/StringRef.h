@@ -58,6 +58,8 @@ namespace llvm {
       return ::memcmp(Lhs,Rhs,Length);
     }
 
+    size_t findNaive(StringRef Str, size_t From) const;
+
   public:
     /// @name Constructors
     /// @{
@@ -238,9 +240,12 @@ namespace llvm {
     /// \returns The index of the first occurrence of \p C, or npos if not
     /// found.
     size_t find(char C, size_t From = 0) const {
-      for (size_t i = std::min(From, Length), e = Length; i != e; ++i)
-        if (Data[i] == C)
-          return i;
+      // memchr is vectorized by the C library, so prefer it to a byte loop.
+      // Don't call it with an empty range: Data may be null.
+      size_t FindBegin = std::min(From, Length);
+      if (FindBegin < Length)
+        if (const void *P = ::memchr(Data + FindBegin, C, Length - FindBegin))
+          return static_cast<const char *>(P) - Data;
       return npos;
     }
 
@@ -0,0 +1,522 @@
+//===- llvm/ADT/SwissDenseMap.h - Group-probed hash table -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the SwissDenseMap class, an open addressing hash table
+// with the same interface as DenseMap but a different layout.
+//
+// Besides the buckets, the table keeps one control byte per bucket saying
+// whether it is empty, erased, or full, and for full buckets 7 bits of the
+// key's hash.  Buckets are probed in aligned groups of 16: a lookup compares
+// the control bytes of a whole group against the hash bits at once (with SSE2
+// where available) and only touches the buckets whose bits match.  Most
+// lookups, hits and misses alike, therefore read one cache line of control
+// bytes and at most one bucket, where DenseMap compares the keys of every
+// bucket on the probe sequence.
+//
+// Keys are hashed and compared with KeyInfoT like DenseMap does, but the empty
+// and tombstone keys are never stored, so they can be used as regular keys.
+// Iterators and references are invalidated by insertion, as with DenseMap.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ADT_SWISSDENSEMAP_H
+#define LLVM_ADT_SWISSDENSEMAP_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/MathExtras.h"
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LLVM_SWISSDENSEMAP_SSE2 1
+#endif
+
+namespace llvm {
+
+namespace detail {
+/// Control bytes of a SwissDenseMap.  Full buckets hold 7 bits of the hash,
+/// which are never negative.
+enum : int8_t { SwissEmpty = -128, SwissDeleted = -2 };
+
+/// SwissGroup - The 16 control bytes of one probing group.
+class SwissGroup {
+  const int8_t *Ctrl;
+
+public:
+  enum { Width = 16 };
+
+  explicit SwissGroup(const int8_t *Ctrl) : Ctrl(Ctrl) {}
+
+  /// Return a bitmask of the bytes equal to \p Byte.
+  unsigned match(int8_t Byte) const {
+#ifdef LLVM_SWISSDENSEMAP_SSE2
+    __m128i Bytes = _mm_load_si128(reinterpret_cast<const __m128i *>(Ctrl));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(Byte), Bytes));
+#else
+    unsigned Mask = 0;
+    for (unsigned i = 0; i != Width; ++i)
+      Mask |= unsigned(Ctrl[i] == Byte) << i;
+    return Mask;
+#endif
+  }
+
+  /// Return a bitmask of the empty or erased bytes, i.e. those with the sign
+  /// bit set.
+  unsigned matchFree() const {
+#ifdef LLVM_SWISSDENSEMAP_SSE2
+    __m128i Bytes = _mm_load_si128(reinterpret_cast<const __m128i *>(Ctrl));
+    return _mm_movemask_epi8(Bytes);
+#else
+    unsigned Mask = 0;
+    for (unsigned i = 0; i != Width; ++i)
+      Mask |= unsigned(Ctrl[i] < 0) << i;
+    return Mask;
+#endif
+  }
+
+  unsigned matchEmpty() const { return match(SwissEmpty); }
+};
+} // end namespace detail
+
+template <typename KeyT, typename ValueT, typename KeyInfoT, bool IsConst>
+class SwissDenseMapIterator;
+
+template <typename KeyT, typename ValueT,
+          typename KeyInfoT = DenseMapInfo<KeyT> >
+class SwissDenseMap {
+  typedef detail::DenseMapPair<KeyT, ValueT> BucketT;
+  typedef detail::SwissGroup Group;
+
+  int8_t *Ctrl;
+  BucketT *Buckets;
+  unsigned NumBuckets;
+  unsigned NumEntries;
+  unsigned NumDeleted;
+
+public:
+  typedef unsigned size_type;
+  typedef KeyT key_type;
+  typedef ValueT mapped_type;
+  typedef BucketT value_type;
+
+  typedef SwissDenseMapIterator<KeyT, ValueT, KeyInfoT, false> iterator;
+  typedef SwissDenseMapIterator<KeyT, ValueT, KeyInfoT, true> const_iterator;
+
+  explicit SwissDenseMap(unsigned NumInitBuckets = 0)
+      : Ctrl(nullptr), Buckets(nullptr), NumBuckets(0), NumEntries(0),
+        NumDeleted(0) {
+    if (unsigned N = getMinBucketsFor(NumInitBuckets * 7 / 8))
+      allocate(N);
+  }
+
+  SwissDenseMap(const SwissDenseMap &Other)
+      : Ctrl(nullptr), Buckets(nullptr), NumBuckets(0), NumEntries(0),
+        NumDeleted(0) {
+    if (Other.empty())
+      return;
+    allocate(getMinBucketsFor(Other.size()));
+    for (const value_type &V : Other)
+      insertNew(V.first, V.second);
+  }
+
+  SwissDenseMap(SwissDenseMap &&Other)
+      : Ctrl(nullptr), Buckets(nullptr), NumBuckets(0), NumEntries(0),
+        NumDeleted(0) {
+    swap(Other);
+  }
+
+  template <typename InputIt>
+  SwissDenseMap(const InputIt &I, const InputIt &E)
+      : Ctrl(nullptr), Buckets(nullptr), NumBuckets(0), NumEntries(0),
+        NumDeleted(0) {
+    insert(I, E);
+  }
+
+  ~SwissDenseMap() {
+    destroyAll();
+    deallocate();
+  }
+
+  SwissDenseMap &operator=(const SwissDenseMap &Other) {
+    if (&Other != this) {
+      SwissDenseMap Copy(Other);
+      swap(Copy);
+    }
+    return *this;
+  }
+
+  SwissDenseMap &operator=(SwissDenseMap &&Other) {
+    destroyAll();
+    deallocate();
+    swap(Other);
+    return *this;
+  }
+
+  void swap(SwissDenseMap &RHS) {
+    std::swap(Ctrl, RHS.Ctrl);
+    std::swap(Buckets, RHS.Buckets);
+    std::swap(NumBuckets, RHS.NumBuckets);
+    std::swap(NumEntries, RHS.NumEntries);
+    std::swap(NumDeleted, RHS.NumDeleted);
+  }
+
+  iterator begin() {
+    return empty() ? end() : iterator(Ctrl, Buckets, Ctrl + NumBuckets);
+  }
+  iterator end() {
+    return iterator(Ctrl + NumBuckets, Buckets + NumBuckets,
+                    Ctrl + NumBuckets, true);
+  }
+  const_iterator begin() const {
+    return empty() ? end() : const_iterator(Ctrl, Buckets, Ctrl + NumBuckets);
+  }
+  const_iterator end() const {
+    return const_iterator(Ctrl + NumBuckets, Buckets + NumBuckets,
+                          Ctrl + NumBuckets, true);
+  }
+
+  bool LLVM_ATTRIBUTE_UNUSED_RESULT empty() const { return NumEntries == 0; }
+  unsigned size() const { return NumEntries; }
+
+  /// Grow the map so that it can hold \p Size entries without rehashing.
+  void resize(size_type Size) {
+    unsigned NeededBuckets = getMinBucketsFor(Size);
+    if (NeededBuckets > NumBuckets)
+      rehash(NeededBuckets);
+  }
+
+  void clear() {
+    if (NumEntries == 0 && NumDeleted == 0)
+      return;
+    destroyAll();
+    std::memset(Ctrl, detail::SwissEmpty, NumBuckets);
+    NumEntries = 0;
+    NumDeleted = 0;
+  }
+
+  /// Return 1 if the specified key is in the map, 0 otherwise.
+  size_type count(const KeyT &Val) const {
+    return findBucket(Val) != nullptr;
+  }
+
+  iterator find(const KeyT &Val) { return find_as(Val); }
+  const_iterator find(const KeyT &Val) const { return find_as(Val); }
+
+  /// Alternate version of find() which allows a different, and possibly less
+  /// expensive, key type.  KeyInfoT must provide getHashValue(LookupKeyT) and
+  /// isEqual(LookupKeyT, KeyT) for it.
+  template <class LookupKeyT> iterator find_as(const LookupKeyT &Val) {
+    if (BucketT *B = const_cast<BucketT *>(findBucket(Val)))
+      return makeIterator(B);
+    return end();
+  }
+  template <class LookupKeyT>
+  const_iterator find_as(const LookupKeyT &Val) const {
+    if (const BucketT *B = findBucket(Val))
+      return const_iterator(Ctrl + (B - Buckets), B, Ctrl + NumBuckets, true);
+    return end();
+  }
+
+  /// Return the entry for the specified key, or a default constructed value
+  /// if no such entry exists.
+  ValueT lookup(const KeyT &Val) const {
+    if (const BucketT *B = findBucket(Val))
+      return B->second;
+    return ValueT();
+  }
+
+  // Inserts key,value pair into the map if the key isn't already in the map.
+  // If the key is already in the map, it returns false and doesn't update the
+  // value.
+  std::pair<iterator, bool> insert(const std::pair<KeyT, ValueT> &KV) {
+    if (BucketT *B = const_cast<BucketT *>(findBucket(KV.first)))
+      return std::make_pair(makeIterator(B), false);
+    return std::make_pair(makeIterator(insertNew(KV.first, KV.second)), true);
+  }
+
+  std::pair<iterator, bool> insert(std::pair<KeyT, ValueT> &&KV) {
+    if (BucketT *B = const_cast<BucketT *>(findBucket(KV.first)))
+      return std::make_pair(makeIterator(B), false);
+    return std::make_pair(
+        makeIterator(insertNew(std::move(KV.first), std::move(KV.second))),
+        true);
+  }
+
+  /// Insert a range of elements into the map.
+  template <typename InputIt> void insert(InputIt I, InputIt E) {
+    for (; I != E; ++I)
+      insert(*I);
+  }
+
+  bool erase(const KeyT &Val) {
+    BucketT *B = const_cast<BucketT *>(findBucket(Val));
+    if (!B)
+      return false;
+    eraseBucket(B - Buckets);
+    return true;
+  }
+  void erase(iterator I) { eraseBucket(&*I - Buckets); }
+
+  value_type &FindAndConstruct(const KeyT &Key) {
+    if (BucketT *B = const_cast<BucketT *>(findBucket(Key)))
+      return *B;
+    return *insertNew(Key, ValueT());
+  }
+
+  ValueT &operator[](const KeyT &Key) { return FindAndConstruct(Key).second; }
+
+  value_type &FindAndConstruct(KeyT &&Key) {
+    if (BucketT *B = const_cast<BucketT *>(findBucket(Key)))
+      return *B;
+    return *insertNew(std::move(Key), ValueT());
+  }
+
+  ValueT &operator[](KeyT &&Key) {
+    return FindAndConstruct(std::move(Key)).second;
+  }
+
+  /// Return the approximate size (in bytes) of the actual map.
+  size_t getMemorySize() const {
+    return NumBuckets * (sizeof(BucketT) + 1);
+  }
+
+private:
+  /// Return the number of buckets needed to hold \p NumEntries entries at
+  /// the maximum load factor of 7/8.
+  static unsigned getMinBucketsFor(unsigned NumEntries) {
+    if (NumEntries == 0)
+      return 0;
+    return std::max<unsigned>(Group::Width,
+                              NextPowerOf2(NumEntries * 8 / 7 + 1));
+  }
+
+  /// Spread the bits of the user's hash, which is weak for pointers, over
+  /// 64 bits.  The top 7 bits go into the control byte and the rest pick the
+  /// first group to probe.
+  template <class LookupKeyT> static uint64_t getHash(const LookupKeyT &Val) {
+    return uint64_t(KeyInfoT::getHashValue(Val)) * 0x9E3779B97F4A7C15ULL;
+  }
+  static int8_t getH2(uint64_t Hash) { return int8_t(Hash >> 57); }
+  unsigned getFirstGroup(uint64_t Hash) const {
+    return unsigned(Hash >> 20) & (NumBuckets / Group::Width - 1);
+  }
+
+  template <class LookupKeyT>
+  const BucketT *findBucket(const LookupKeyT &Val) const {
+    if (NumBuckets == 0)
+      return nullptr;
+    uint64_t Hash = getHash(Val);
+    int8_t H2 = getH2(Hash);
+    unsigned GroupMask = NumBuckets / Group::Width - 1;
+    // Probe groups in triangular order, which visits every group once.
+    unsigned G = getFirstGroup(Hash);
+    for (unsigned Probe = 0; Probe <= GroupMask; ++Probe) {
+      Group Grp(Ctrl + G * Group::Width);
+      for (unsigned Mask = Grp.match(H2); Mask; Mask &= Mask - 1) {
+        const BucketT *B = Buckets + G * Group::Width + countTrailingZeros(Mask);
+        if (KeyInfoT::isEqual(Val, B->first))
+          return B;
+      }
+      // A group with an empty bucket was never full, so no probe sequence
+      // continues past it.
+      if (Grp.matchEmpty())
+        return nullptr;
+      G = (G + Probe + 1) & GroupMask;
+    }
+    return nullptr;
+  }
+
+  /// Return the index of the first empty or erased bucket on the probe
+  /// sequence of \p Hash.  The table must have a free bucket.
+  unsigned findFreeBucket(uint64_t Hash) const {
+    unsigned GroupMask = NumBuckets / Group::Width - 1;
+    unsigned G = getFirstGroup(Hash);
+    for (unsigned Probe = 0;; ++Probe) {
+      assert(Probe <= GroupMask && "No free bucket in the table!");
+      if (unsigned Mask = Group(Ctrl + G * Group::Width).matchFree())
+        return G * Group::Width + countTrailingZeros(Mask);
+      G = (G + Probe + 1) & GroupMask;
+    }
+  }
+
+  template <typename KeyArg, typename ValueArg>
+  BucketT *insertNew(KeyArg &&Key, ValueArg &&Value) {
+    // Keep the table at most 7/8 full, counting erased buckets, so that
+    // probe sequences stay short and every lookup finds an empty bucket.
+    if ((NumEntries + NumDeleted + 1) * uint64_t(8) > NumBuckets * uint64_t(7))
+      rehash(NumEntries + 1 > NumBuckets * uint64_t(7) / 16
+                 ? getMinBucketsFor(std::max(NumEntries + 1, NumBuckets))
+                 : NumBuckets);
+    uint64_t Hash = getHash(Key);
+    unsigned Idx = findFreeBucket(Hash);
+    if (Ctrl[Idx] == detail::SwissDeleted)
+      --NumDeleted;
+    Ctrl[Idx] = getH2(Hash);
+    ++NumEntries;
+    BucketT *B = Buckets + Idx;
+    ::new (&B->first) KeyT(std::forward<KeyArg>(Key));
+    ::new (&B->second) ValueT(std::forward<ValueArg>(Value));
+    return B;
+  }
+
+  void eraseBucket(unsigned Idx) {
+    BucketT *B = Buckets + Idx;
+    B->second.~ValueT();
+    B->first.~KeyT();
+    // Buckets in a group that still has an empty one can become empty again;
+    // see findBucket().
+    int8_t *GroupCtrl = Ctrl + (Idx & ~(Group::Width - 1));
+    if (Group(GroupCtrl).matchEmpty()) {
+      Ctrl[Idx] = detail::SwissEmpty;
+    } else {
+      Ctrl[Idx] = detail::SwissDeleted;
+      ++NumDeleted;
+    }
+    --NumEntries;
+  }
+
+  void allocate(unsigned Num) {
+    NumBuckets = Num;
+    // Groups are loaded with aligned 16-byte loads.
+    Ctrl = static_cast<int8_t *>(operator new(Num + Group::Width));
+    size_t Misalign = reinterpret_cast<uintptr_t>(Ctrl) % Group::Width;
+    int8_t *Aligned = Ctrl + (Group::Width - Misalign);
+    // Remember how far we moved, so that deallocate() can find the pointer.
+    Aligned[-1] = int8_t(Group::Width - Misalign);
+    Ctrl = Aligned;
+    std::memset(Ctrl, detail::SwissEmpty, Num);
+    Buckets = static_cast<BucketT *>(operator new(sizeof(BucketT) * Num));
+  }
+
+  void deallocate() {
+    if (!Ctrl)
+      return;
+    operator delete(Ctrl - Ctrl[-1]);
+    operator delete(Buckets);
+    Ctrl = nullptr;
+    Buckets = nullptr;
+    NumBuckets = 0;
+  }
+
+  void destroyAll() {
+    for (unsigned i = 0; NumEntries && i != NumBuckets; ++i)
+      if (Ctrl[i] >= 0) {
+        Buckets[i].second.~ValueT();
+        Buckets[i].first.~KeyT();
+      }
+  }
+
+  void rehash(unsigned NewNumBuckets) {
+    int8_t *OldCtrl = Ctrl;
+    BucketT *OldBuckets = Buckets;
+    unsigned OldNumBuckets = NumBuckets;
+    allocate(NewNumBuckets);
+    NumEntries = 0;
+    NumDeleted = 0;
+    for (unsigned i = 0; i != OldNumBuckets; ++i) {
+      if (OldCtrl[i] < 0)
+        continue;
+      BucketT &B = OldBuckets[i];
+      uint64_t Hash = getHash(B.first);
+      unsigned Idx = findFreeBucket(Hash);
+      Ctrl[Idx] = getH2(Hash);
+      ::new (&Buckets[Idx].first) KeyT(std::move(B.first));
+      ::new (&Buckets[Idx].second) ValueT(std::move(B.second));
+      ++NumEntries;
+      B.second.~ValueT();
+      B.first.~KeyT();
+    }
+    if (OldCtrl) {
+      operator delete(OldCtrl - OldCtrl[-1]);
+      operator delete(OldBuckets);
+    }
+  }
+
+  iterator makeIterator(BucketT *B) {
+    return iterator(Ctrl + (B - Buckets), B, Ctrl + NumBuckets, true);
+  }
+};
+
+template <typename KeyT, typename ValueT, typename KeyInfoT, bool IsConst>
+class SwissDenseMapIterator {
+  typedef detail::DenseMapPair<KeyT, ValueT> Bucket;
+  typedef SwissDenseMapIterator<KeyT, ValueT, KeyInfoT, true> ConstIterator;
+  friend class SwissDenseMapIterator<KeyT, ValueT, KeyInfoT, true>;
+
+public:
+  typedef ptrdiff_t difference_type;
+  typedef typename std::conditional<IsConst, const Bucket, Bucket>::type
+  value_type;
+  typedef value_type *pointer;
+  typedef value_type &reference;
+  typedef std::forward_iterator_tag iterator_category;
+
+private:
+  const int8_t *Ctrl, *End;
+  pointer Ptr;
+
+public:
+  SwissDenseMapIterator() : Ctrl(nullptr), End(nullptr), Ptr(nullptr) {}
+
+  SwissDenseMapIterator(const int8_t *Ctrl, pointer Pos, const int8_t *End,
+                        bool NoAdvance = false)
+      : Ctrl(Ctrl), End(End), Ptr(Pos) {
+    if (!NoAdvance)
+      advancePastFreeBuckets();
+  }
+
+  // If IsConst is true this is a converting constructor from iterator to
+  // const_iterator and the default copy constructor is used.
+  // Otherwise this is a copy constructor for iterator.
+  SwissDenseMapIterator(
+      const SwissDenseMapIterator<KeyT, ValueT, KeyInfoT, false> &I)
+      : Ctrl(I.Ctrl), End(I.End), Ptr(I.Ptr) {}
+
+  reference operator*() const { return *Ptr; }
+  pointer operator->() const { return Ptr; }
+
+  bool operator==(const ConstIterator &RHS) const {
+    return Ptr == RHS.operator->();
+  }
+  bool operator!=(const ConstIterator &RHS) const {
+    return Ptr != RHS.operator->();
+  }
+
+  SwissDenseMapIterator &operator++() {
+    ++Ctrl;
+    ++Ptr;
+    advancePastFreeBuckets();
+    return *this;
+  }
+  SwissDenseMapIterator operator++(int) {
+    SwissDenseMapIterator Tmp = *this;
+    ++*this;
+    return Tmp;
+  }
+
+private:
+  void advancePastFreeBuckets() {
+    while (Ctrl != End && *Ctrl < 0) {
+      ++Ctrl;
+      ++Ptr;
+    }
+  }
+
+  friend class SwissDenseMap<KeyT, ValueT, KeyInfoT>;
+};
+
+} // end namespace llvm
+
+#endif
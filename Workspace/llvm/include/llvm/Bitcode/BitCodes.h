@@ -162,11 +162,15 @@ template <> struct isPodLike<BitCodeAbbrevOp> { static const bool value=true; };
 /// BitCodeAbbrev - This class represents an abbreviation record.  An
 /// abbreviation allows a complex record that has redundancy to be stored in a
 /// specialized format instead of the fully-general, fully-vbr, format.
-class BitCodeAbbrev : public RefCountedBase<BitCodeAbbrev> {
+///
+/// The reference count is atomic because the abbreviations of a
+/// BitstreamReader's BLOCKINFO block are shared by all of its cursors, which
+/// may be reading on different threads.
+class BitCodeAbbrev : public ThreadSafeRefCountedBase<BitCodeAbbrev> {
   SmallVector<BitCodeAbbrevOp, 32> OperandList;
   ~BitCodeAbbrev() {}
-  // Only RefCountedBase is allowed to delete.
-  friend class RefCountedBase<BitCodeAbbrev>;
+  // Only ThreadSafeRefCountedBase is allowed to delete.
+  friend class ThreadSafeRefCountedBase<BitCodeAbbrev>;
 
 public:
   unsigned getNumOperandInfos() const {
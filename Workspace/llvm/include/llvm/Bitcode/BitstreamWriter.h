@@ -15,16 +15,53 @@
 #ifndef LLVM_BITCODE_BITSTREAMWRITER_H
 #define LLVM_BITCODE_BITSTREAMWRITER_H
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Bitcode/BitCodes.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <vector>
 
 namespace llvm {
 
+/// BitstreamRecordObserver - Is shown the records that a BitstreamWriter
+/// emits without an abbreviation, for instance to find out which
+/// abbreviations would pay off.
+class BitstreamRecordObserver {
+  virtual void anchor();
+public:
+  virtual ~BitstreamRecordObserver() {}
+
+  /// observeRecord - Called for each record emitted without an abbreviation
+  /// in a block with ID \p BlockID.
+  virtual void observeRecord(unsigned BlockID, unsigned Code,
+                             ArrayRef<uint64_t> Vals) = 0;
+
+  /// observeBlock - Called when leaving a block, with the width of its
+  /// abbreviation IDs and the number of abbreviations it ended up with.
+  virtual void observeBlock(unsigned BlockID, unsigned CodeLen,
+                            unsigned NumAbbrevs) = 0;
+};
+
 class BitstreamWriter {
   SmallVectorImpl<char> &Out;
 
+  /// FS - If non-null, the stream the output is moved to whenever Out holds
+  /// at least FlushThreshold bytes, which bounds the size of Out.  Block
+  /// sizes of flushed blocks are backpatched with pwrite().
+  raw_ostream *FS;
+
+  /// FlushThreshold - See FS.
+  uint64_t FlushThreshold;
+
+  /// FlushedBytes - The number of bytes moved from Out to FS so far.
+  uint64_t FlushedBytes;
+
+  /// FSStartPos - The position in FS of the start of the stream.
+  uint64_t FSStartPos;
+
   /// CurBit - Always between 0 and 31 inclusive, specifies the next bit to use.
   unsigned CurBit;
 
@@ -35,6 +72,9 @@ class BitstreamWriter {
   /// current block, in bits.
   unsigned CurCodeSize;
 
+  /// CurBlockID - The ID of the current block, or ~0U at the top level.
+  unsigned CurBlockID;
+
   /// BlockInfoCurBID - When emitting a BLOCKINFO_BLOCK, this is the currently
   /// selected BLOCK ID.
   unsigned BlockInfoCurBID;
@@ -44,9 +84,11 @@ class BitstreamWriter {
 
   struct Block {
     unsigned PrevCodeSize;
+    unsigned PrevBlockID;
     unsigned StartSizeWord;
     std::vector<IntrusiveRefCntPtr<BitCodeAbbrev>> PrevAbbrevs;
-    Block(unsigned PCS, unsigned SSW) : PrevCodeSize(PCS), StartSizeWord(SSW) {}
+    Block(unsigned PCS, unsigned PBID, unsigned SSW)
+      : PrevCodeSize(PCS), PrevBlockID(PBID), StartSizeWord(SSW) {}
   };
 
   /// BlockScope - This tracks the current blocks that we have entered.
@@ -60,13 +102,40 @@ class BitstreamWriter {
   };
   std::vector<BlockInfo> BlockInfoRecords;
 
+  /// DefaultAbbrevs - For a record code in a block ID, combined as
+  /// (BlockID << 32 | Code), the BLOCKINFO abbreviation to use for records
+  /// that are emitted without one.  See SetDefaultAbbrev.
+  DenseMap<uint64_t, unsigned> DefaultAbbrevs;
+
+  /// Observer - If non-null, shown the records emitted without abbreviation.
+  BitstreamRecordObserver *Observer;
+
   // BackpatchWord - Backpatch a 32-bit word in the output with the specified
   // value.
-  void BackpatchWord(unsigned ByteNo, unsigned NewWord) {
-    Out[ByteNo++] = (unsigned char)(NewWord >>  0);
-    Out[ByteNo++] = (unsigned char)(NewWord >>  8);
-    Out[ByteNo++] = (unsigned char)(NewWord >> 16);
-    Out[ByteNo  ] = (unsigned char)(NewWord >> 24);
+  void BackpatchWord(uint64_t ByteNo, unsigned NewWord) {
+    char Bytes[4] = {
+      (char)(NewWord >>  0),
+      (char)(NewWord >>  8),
+      (char)(NewWord >> 16),
+      (char)(NewWord >> 24) };
+    unsigned NumFlushed = 0;
+    if (ByteNo < FlushedBytes) {
+      NumFlushed = (unsigned)std::min<uint64_t>(4, FlushedBytes - ByteNo);
+      FS->pwrite(Bytes, NumFlushed, FSStartPos + ByteNo);
+    }
+    for (unsigned I = NumFlushed; I != 4; ++I)
+      Out[ByteNo + I - FlushedBytes] = Bytes[I];
+  }
+
+  /// FlushToFile - Move the output to FS if enough of it has accumulated.
+  /// Only called between records, when Out holds whole words.
+  void FlushToFile() {
+    if (!FS || Out.size() < FlushThreshold)
+      return;
+    assert((Out.size() & 3) == 0 && "Not 32-bit aligned");
+    FS->write(Out.data(), Out.size());
+    FlushedBytes += Out.size();
+    Out.clear();
   }
 
   void WriteByte(unsigned char Value) {
@@ -82,19 +151,27 @@ class BitstreamWriter {
     Out.append(&Bytes[0], &Bytes[4]);
   }
 
-  unsigned GetBufferOffset() const {
-    return Out.size();
+  uint64_t GetBufferOffset() const {
+    return FlushedBytes + Out.size();
   }
 
   unsigned GetWordIndex() const {
-    unsigned Offset = GetBufferOffset();
+    uint64_t Offset = GetBufferOffset();
     assert((Offset & 3) == 0 && "Not 32-bit aligned");
     return Offset / 4;
   }
 
 public:
-  explicit BitstreamWriter(SmallVectorImpl<char> &O)
-    : Out(O), CurBit(0), CurValue(0), CurCodeSize(2) {}
+  /// Write the stream to \p O.  If \p FS is given, all but the last
+  /// \p FlushThreshold or so bytes are moved on from \p O to \p FS, which
+  /// must support pwrite(); the caller writes out the rest.
+  explicit BitstreamWriter(SmallVectorImpl<char> &O, raw_ostream *FS = nullptr,
+                           uint64_t FlushThreshold = 0)
+    : Out(O), FS(FS), FlushThreshold(FlushThreshold), FlushedBytes(0),
+      FSStartPos(FS ? FS->tell() : 0), CurBit(0), CurValue(0),
+      CurCodeSize(2), CurBlockID(~0U), Observer(nullptr) {
+    assert((!FS || FS->supportsPwrite()) && "Can't backpatch the stream!");
+  }
 
   ~BitstreamWriter() {
     assert(CurBit == 0 && "Unflushed data remaining");
@@ -104,6 +181,38 @@ public:
   /// \brief Retrieve the current position in the stream, in bits.
   uint64_t GetCurrentBitNo() const { return GetBufferOffset() * 8 + CurBit; }
 
+  /// \brief Retrieve the number of bits used for abbreviation IDs in the
+  /// current block.
+  unsigned GetAbbrevIDWidth() const { return CurCodeSize; }
+
+  /// \brief Show the records emitted without an abbreviation to \p O.
+  void SetObserver(BitstreamRecordObserver *O) { Observer = O; }
+
+  /// \brief Overwrite the 32 bits starting at bit \p BitNo, which need not
+  /// be aligned, with \p NewWord.  The bits must already have been flushed
+  /// to the output, e.g. by entering or leaving a block.  Unaligned bits
+  /// must not have been moved on to the stream yet.
+  void BackpatchWordAtBit(uint64_t BitNo, unsigned NewWord) {
+    uint64_t ByteNo = BitNo / 8;
+    unsigned StartBit = BitNo & 7;
+    assert(ByteNo + (StartBit ? 5 : 4) <= GetBufferOffset() &&
+           "Backpatching unflushed bits");
+    if (!StartBit) {
+      BackpatchWord(ByteNo, NewWord);
+      return;
+    }
+    assert(ByteNo >= FlushedBytes && "Unaligned backpatch of flushed bits");
+    ByteNo -= FlushedBytes;
+    // The word straddles five bytes; keep the bits around it.
+    uint64_t Bits = 0;
+    for (unsigned I = 0; I != 5; ++I)
+      Bits |= uint64_t((unsigned char)Out[ByteNo + I]) << (I * 8);
+    Bits &= ~(uint64_t(~0U) << StartBit);
+    Bits |= uint64_t(NewWord) << StartBit;
+    for (unsigned I = 0; I != 5; ++I)
+      Out[ByteNo + I] = (unsigned char)(Bits >> (I * 8));
+  }
+
   //===--------------------------------------------------------------------===//
   // Basic Primitives for emitting bits to the stream.
   //===--------------------------------------------------------------------===//
@@ -215,8 +324,9 @@ public:
 
     // Push the outer block's abbrev set onto the stack, start out with an
     // empty abbrev set.
-    BlockScope.push_back(Block(OldCodeSize, BlockSizeWordIndex));
+    BlockScope.push_back(Block(OldCodeSize, CurBlockID, BlockSizeWordIndex));
     BlockScope.back().PrevAbbrevs.swap(CurAbbrevs);
+    CurBlockID = BlockID;
 
     // If there is a blockinfo for this BlockID, add all the predefined abbrevs
     // to the abbrev list.
@@ -224,6 +334,8 @@ public:
       CurAbbrevs.insert(CurAbbrevs.end(), Info->Abbrevs.begin(),
                         Info->Abbrevs.end());
     }
+
+    FlushToFile();
   }
 
   void ExitBlock() {
@@ -237,15 +349,21 @@ public:
 
     // Compute the size of the block, in words, not counting the size field.
     unsigned SizeInWords = GetWordIndex() - B.StartSizeWord - 1;
-    unsigned ByteNo = B.StartSizeWord*4;
+    uint64_t ByteNo = uint64_t(B.StartSizeWord)*4;
 
     // Update the block size field in the header of this sub-block.
     BackpatchWord(ByteNo, SizeInWords);
 
+    if (Observer)
+      Observer->observeBlock(CurBlockID, CurCodeSize, CurAbbrevs.size());
+
     // Restore the inner block's code size and abbrev table.
     CurCodeSize = B.PrevCodeSize;
+    CurBlockID = B.PrevBlockID;
     CurAbbrevs = std::move(B.PrevAbbrevs);
     BlockScope.pop_back();
+
+    FlushToFile();
   }
 
   //===--------------------------------------------------------------------===//
@@ -380,6 +498,81 @@ private:
     assert(RecordIdx == Vals.size() && "Not all record operands emitted!");
     assert(BlobData == nullptr &&
            "Blob data specified for record that doesn't use it!");
+    FlushToFile();
+  }
+
+  /// FitsAbbreviatedField - Return true if \p V can be emitted as \p Op.
+  template<typename uintty>
+  static bool FitsAbbreviatedField(const BitCodeAbbrevOp &Op, uintty V) {
+    if (Op.isLiteral())
+      return V == Op.getLiteralValue();
+    switch (Op.getEncoding()) {
+    default: return false;
+    case BitCodeAbbrevOp::Fixed:
+      return Op.getEncodingData() >= 64 ||
+             (uint64_t(V) >> Op.getEncodingData()) == 0;
+    case BitCodeAbbrevOp::VBR:
+      return true;
+    case BitCodeAbbrevOp::Char6:
+      return V < 128 && BitCodeAbbrevOp::isChar6((char)V);
+    }
+  }
+
+  /// EmitRecordWithDefaultAbbrev - If there is a default abbreviation for
+  /// records with code \p Code in the current block and the record fits it,
+  /// emit the record with it and return true.  Default abbreviations consist
+  /// of the literal code, scalar fields and possibly a final array.
+  template<typename uintty>
+  bool EmitRecordWithDefaultAbbrev(unsigned Code,
+                                   const SmallVectorImpl<uintty> &Vals) {
+    DenseMap<uint64_t, unsigned>::const_iterator I =
+        DefaultAbbrevs.find(uint64_t(CurBlockID) << 32 | Code);
+    if (I == DefaultAbbrevs.end())
+      return false;
+
+    // The abbreviation is only known in blocks entered after the BLOCKINFO
+    // that defines it.
+    unsigned AbbrevNo = I->second - bitc::FIRST_APPLICATION_ABBREV;
+    BlockInfo *Info = getBlockInfo(CurBlockID);
+    if (!Info || AbbrevNo >= Info->Abbrevs.size() ||
+        AbbrevNo >= CurAbbrevs.size() ||
+        CurAbbrevs[AbbrevNo] != Info->Abbrevs[AbbrevNo])
+      return false;
+    const BitCodeAbbrev *Abbv = CurAbbrevs[AbbrevNo].get();
+
+    // Check that every value fits.
+    unsigned NumOps = Abbv->getNumOperandInfos();
+    bool HasArray = NumOps >= 2 &&
+        !Abbv->getOperandInfo(NumOps - 2).isLiteral() &&
+        Abbv->getOperandInfo(NumOps - 2).getEncoding() ==
+            BitCodeAbbrevOp::Array;
+    unsigned NumScalars = HasArray ? NumOps - 3 : NumOps - 1;
+    if (HasArray ? Vals.size() < NumScalars : Vals.size() != NumScalars)
+      return false;
+    for (unsigned i = 0; i != NumScalars; ++i)
+      if (!FitsAbbreviatedField(Abbv->getOperandInfo(i + 1), Vals[i]))
+        return false;
+    if (HasArray) {
+      const BitCodeAbbrevOp &EltEnc = Abbv->getOperandInfo(NumOps - 1);
+      for (unsigned i = NumScalars, e = Vals.size(); i != e; ++i)
+        if (!FitsAbbreviatedField(EltEnc, Vals[i]))
+          return false;
+    }
+
+    EmitCode(I->second);
+    for (unsigned i = 0; i != NumScalars; ++i) {
+      const BitCodeAbbrevOp &Op = Abbv->getOperandInfo(i + 1);
+      if (!Op.isLiteral())
+        EmitAbbreviatedField(Op, Vals[i]);
+    }
+    if (HasArray) {
+      const BitCodeAbbrevOp &EltEnc = Abbv->getOperandInfo(NumOps - 1);
+      EmitVBR(static_cast<uint32_t>(Vals.size() - NumScalars), 6);
+      for (unsigned i = NumScalars, e = Vals.size(); i != e; ++i)
+        EmitAbbreviatedField(EltEnc, Vals[i]);
+    }
+    FlushToFile();
+    return true;
   }
 
 public:
@@ -390,6 +583,14 @@ public:
   void EmitRecord(unsigned Code, SmallVectorImpl<uintty> &Vals,
                   unsigned Abbrev = 0) {
     if (!Abbrev) {
+      if (!DefaultAbbrevs.empty() && EmitRecordWithDefaultAbbrev(Code, Vals))
+        return;
+
+      if (Observer) {
+        SmallVector<uint64_t, 64> Vals64(Vals.begin(), Vals.end());
+        Observer->observeRecord(CurBlockID, Code, Vals64);
+      }
+
       // If we don't have an abbrev to use, emit this in its fully unabbreviated
       // form.
       EmitCode(bitc::UNABBREV_RECORD);
@@ -397,6 +598,7 @@ public:
       EmitVBR(static_cast<uint32_t>(Vals.size()), 6);
       for (unsigned i = 0, e = static_cast<unsigned>(Vals.size()); i != e; ++i)
         EmitVBR64(Vals[i], 6);
+      FlushToFile();
       return;
     }
 
@@ -522,6 +724,15 @@ public:
 
     return Info.Abbrevs.size()-1+bitc::FIRST_APPLICATION_ABBREV;
   }
+
+  /// SetDefaultAbbrev - Emit the records with code \p Code in blocks with ID
+  /// \p BlockID that are emitted without an abbreviation with \p Abbrev
+  /// instead, as far as they fit it.  \p Abbrev must have been returned by
+  /// EmitBlockInfoAbbrev for \p BlockID and consist of a literal for the
+  /// code followed by scalar fields, the last two of which may be an array.
+  void SetDefaultAbbrev(unsigned BlockID, unsigned Code, unsigned Abbrev) {
+    DefaultAbbrevs[uint64_t(BlockID) << 32 | Code] = Abbrev;
+  }
 };
 
 
@@ -42,7 +42,11 @@ namespace bitc {
 
     TYPE_BLOCK_ID_NEW,
 
-    USELIST_BLOCK_ID
+    USELIST_BLOCK_ID,
+
+    FUNCTION_INDEX_BLOCK_ID,
+
+    SYMTAB_BLOCK_ID
   };
 
 
@@ -73,6 +77,37 @@ namespace bitc {
 
     MODULE_CODE_GCNAME      = 11,  // GCNAME: [strchr x N]
     MODULE_CODE_COMDAT      = 12,  // COMDAT: [selection_kind, name]
+
+    // FNINDEXOFFSET: [8 x byte], the little-endian offset as a blob
+    MODULE_CODE_FNINDEXOFFSET = 13,
+  };
+
+  /// FUNCTION_INDEX blocks map each function with a body to the position of
+  /// that body in the stream.
+  enum FunctionIndexCodes {
+    FNINDEX_CODE_ENTRY = 1  // ENTRY: [valueid, bitoffset]
+  };
+
+  /// SYMTAB blocks describe the symbols of the module, for linkers and tools
+  /// that only need those, without having to read the rest of the module.
+  enum SymtabCodes {
+    SYMTAB_CODE_TRIPLE        = 1, // TRIPLE:        [strchr x N]
+    SYMTAB_CODE_DATALAYOUT    = 2, // DATALAYOUT:    [strchr x N]
+    SYMTAB_CODE_LINKER_OPTION = 3, // LINKER_OPTION: [strchr x N]
+
+    // ENTRY: [kind, linkage, visibility, flags, alignment, commonsize,
+    //         namelen, comdatlen, strchr x N]
+    // The name, the comdat name and the section name, one after the other.
+    SYMTAB_CODE_ENTRY         = 4
+  };
+
+  /// Flags of SYMTAB_CODE_ENTRY records.
+  enum SymtabFlags {
+    SYMTAB_FLAG_UNDEFINED     = 1 << 0, // A declaration for the linker.
+    SYMTAB_FLAG_CONSTANT      = 1 << 1,
+    SYMTAB_FLAG_UNNAMED_ADDR  = 1 << 2,
+    SYMTAB_FLAG_FUNCTION_TYPE = 1 << 3, // The value has a function type.
+    SYMTAB_FLAG_LLVM_NAME     = 1 << 4  // The IR name starts with "llvm.".
   };
 
   /// PARAMATTR blocks have code for defining a parameter attribute set.
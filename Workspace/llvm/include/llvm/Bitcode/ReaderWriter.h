@@ -15,10 +15,12 @@
 #define LLVM_BITCODE_READERWRITER_H
 
 #include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/GlobalValue.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace llvm {
   class BitstreamWriter;
@@ -27,14 +29,18 @@ namespace llvm {
   class Module;
   class ModulePass;
   class raw_ostream;
+  template <typename T> class SmallVectorImpl;
 
   /// Read the header of the specified bitcode buffer and prepare for lazy
   /// deserialization of function bodies.  If successful, this moves Buffer. On
-  /// error, this *does not* move Buffer.
+  /// error, this *does not* move Buffer.  If ShouldLazyLoadMetadata is true,
+  /// the module-level metadata is only read by Module::materializeMetadata()
+  /// or when the whole module is materialized.
   ErrorOr<Module *>
   getLazyBitcodeModule(std::unique_ptr<MemoryBuffer> &&Buffer,
                        LLVMContext &Context,
-                       DiagnosticHandlerFunction DiagnosticHandler = nullptr);
+                       DiagnosticHandlerFunction DiagnosticHandler = nullptr,
+                       bool ShouldLazyLoadMetadata = false);
 
   /// Read the header of the specified stream and prepare for lazy
   /// deserialization and streaming of function bodies.
@@ -49,6 +55,44 @@ namespace llvm {
   getBitcodeTargetTriple(MemoryBufferRef Buffer, LLVMContext &Context,
                          DiagnosticHandlerFunction DiagnosticHandler = nullptr);
 
+  /// BitcodeSymbol - What the symbol table of a bitcode file says about one
+  /// of the global values of its module.  The symbols are in the order of the
+  /// functions, global variables and aliases of the module.
+  struct BitcodeSymbol {
+    enum SymbolKind { Function, Variable, Alias };
+
+    std::string Name;     ///< Mangled for the module's DataLayout, if any.
+    std::string Comdat;   ///< The comdat of the object, or of the aliasee.
+    std::string Section;
+    SymbolKind Kind;
+    GlobalValue::LinkageTypes Linkage;
+    GlobalValue::VisibilityTypes Visibility;
+    unsigned Alignment;
+    uint64_t CommonSize;  ///< The allocation size of common symbols.
+    bool IsUndefined;     ///< The value is a declaration for the linker.
+    bool IsConstant;
+    bool HasUnnamedAddr;
+    bool HasFunctionType;
+    bool HasLLVMName;     ///< The IR name starts with "llvm.".
+  };
+
+  /// BitcodeSymbolTable - The symbol table of a bitcode file, along with the
+  /// target information of its module.
+  struct BitcodeSymbolTable {
+    std::string Triple;
+    std::string DataLayout;
+    std::vector<std::string> LinkerOptions;
+    std::vector<BitcodeSymbol> Symbols;
+  };
+
+  /// Read the symbol table of the specified bitcode buffer without reading
+  /// its module.  Files without a symbol table, which older writers and
+  /// modules with module-level inline asm don't have, return
+  /// BitcodeError::MissingSymbolTable.  Errors aren't diagnosed: callers
+  /// are expected to fall back to reading the module.
+  ErrorOr<BitcodeSymbolTable> readBitcodeSymbolTable(MemoryBufferRef Buffer,
+                                                     LLVMContext &Context);
+
   /// Read the specified bitcode file, returning the module.
   ErrorOr<Module *>
   parseBitcodeFile(MemoryBufferRef Buffer, LLVMContext &Context,
@@ -59,6 +103,22 @@ namespace llvm {
   /// should be in "binary" mode.
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out);
 
+  /// The codecs that compressed bitcode can use.
+  enum class BitcodeCompression { None = 0, Zlib = 1, LZ77 = 2 };
+
+  /// compressBitcode - Append to Out the compressed form of the bitcode file
+  /// in Bitcode, with each ChunkSize bytes compressed independently with
+  /// Codec.  Chunks that don't get smaller, or that can't be compressed
+  /// because the codec isn't available, are stored as they are.
+  void compressBitcode(StringRef Bitcode, SmallVectorImpl<char> &Out,
+                       BitcodeCompression Codec, unsigned ChunkSize);
+
+  /// uncompressBitcode - Append to Out the bitcode file that the compressed
+  /// bitcode in Buffer holds.  The reader uncompresses compressed bitcode by
+  /// itself, a chunk at a time as it is read.
+  std::error_code uncompressBitcode(MemoryBufferRef Buffer,
+                                    SmallVectorImpl<char> &Out);
+
 
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
@@ -88,13 +148,41 @@ namespace llvm {
            BufPtr[3] == 0xde;
   }
 
+  /// isCompressedBitcode - Return true if the given bytes are the magic bytes
+  /// for compressed LLVM IR bitcode, as written by compressBitcode().  The
+  /// bitcode file is cut into chunks that are compressed independently, so
+  /// that each can be uncompressed when it is first read.  The format of the
+  /// header is:
+  ///
+  /// struct bcz_header {
+  ///   uint32_t Magic;        // 'B', 'C', 'Z', '1'
+  ///   uint32_t Codec;        // BitcodeCompression of the chunks.
+  ///   uint32_t ChunkSize;    // Uncompressed size of all chunks but the last.
+  ///   uint32_t BitcodeSize;  // Uncompressed size of the bitcode file.
+  ///   uint32_t ChunkOffset[NumChunks + 1]; // Offsets in bytes of the chunks,
+  ///                                        // and of the end of the last one.
+  /// };
+  ///
+  /// The fields are little endian.  A chunk is stored uncompressed if its
+  /// size is its uncompressed size.  The chunks are followed by padding to a
+  /// multiple of four bytes.
+  inline bool isCompressedBitcode(const unsigned char *BufPtr,
+                                  const unsigned char *BufEnd) {
+    return BufEnd - BufPtr >= 4 &&
+           BufPtr[0] == 'B' &&
+           BufPtr[1] == 'C' &&
+           BufPtr[2] == 'Z' &&
+           BufPtr[3] == '1';
+  }
+
   /// isBitcode - Return true if the given bytes are the magic bytes for
-  /// LLVM IR bitcode, either with or without a wrapper.
+  /// LLVM IR bitcode, either with or without a wrapper, or compressed.
   ///
   inline bool isBitcode(const unsigned char *BufPtr,
                         const unsigned char *BufEnd) {
     return isBitcodeWrapper(BufPtr, BufEnd) ||
-           isRawBitcode(BufPtr, BufEnd);
+           isRawBitcode(BufPtr, BufEnd) ||
+           isCompressedBitcode(BufPtr, BufEnd);
   }
 
   /// SkipBitcodeWrapperHeader - Some systems wrap bc files with a special
@@ -143,7 +231,11 @@ namespace llvm {
   }
 
   const std::error_category &BitcodeErrorCategory();
-  enum class BitcodeError { InvalidBitcodeSignature, CorruptedBitcode };
+  enum class BitcodeError {
+    InvalidBitcodeSignature,
+    CorruptedBitcode,
+    MissingSymbolTable
+  };
   inline std::error_code make_error_code(BitcodeError E) {
     return std::error_code(static_cast<int>(E), BitcodeErrorCategory());
   }
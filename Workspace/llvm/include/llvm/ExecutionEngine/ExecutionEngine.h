@@ -265,6 +265,26 @@ public:
   /// \param isDtors - Run the destructors instead of constructors.
   void runStaticConstructorsDestructors(Module &module, bool isDtors);
 
+  /// saveGlobalsSnapshot - Write the current contents of all writable global
+  /// variables to the file \p Path, so that a later run of the same program
+  /// can restore them with restoreGlobalsSnapshot instead of running the
+  /// static constructors again.  Pointers to globals and functions are
+  /// recorded symbolically and re-resolved on restore.
+  ///
+  /// Saving fails if a global holds a pointer to anything else (e.g. heap
+  /// memory), since that memory would not exist in the restoring process.
+  ///
+  /// \returns true if an error occurred, with \p ErrMsg describing it.
+  virtual bool saveGlobalsSnapshot(StringRef Path, std::string &ErrMsg);
+
+  /// restoreGlobalsSnapshot - Overwrite the writable global variables with
+  /// the contents saved by saveGlobalsSnapshot.  The snapshot is rejected,
+  /// leaving all globals untouched, unless it was taken from modules with the
+  /// same globals and functions as the ones currently loaded.
+  ///
+  /// \returns true if an error occurred, with \p ErrMsg describing it.
+  bool restoreGlobalsSnapshot(StringRef Path, std::string &ErrMsg);
+
 
   /// runFunctionAsMain - This is a helper function which wraps runFunction to
   /// handle the common task of starting up main with the specified argc, argv,
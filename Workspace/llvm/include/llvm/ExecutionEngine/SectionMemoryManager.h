@@ -34,12 +34,29 @@ namespace llvm {
 /// in the JITed object.  Permissions can be applied either by calling
 /// MCJIT::finalizeObject or by calling SectionMemoryManager::finalizeMemory
 /// directly.  Clients of MCJIT should call MCJIT::finalizeObject.
+///
+/// Sections are carved out of slabs of at least \p SlabSize bytes, so that
+/// objects loaded one after another share mappings instead of each getting
+/// their own.  Only the pages touched since the last call to finalizeMemory
+/// have their permissions changed, and the untouched tail of each slab stays
+/// writable and is used for the sections of later objects.
 class SectionMemoryManager : public RTDyldMemoryManager {
   SectionMemoryManager(const SectionMemoryManager&) LLVM_DELETED_FUNCTION;
   void operator=(const SectionMemoryManager&) LLVM_DELETED_FUNCTION;
 
 public:
-  SectionMemoryManager() { }
+  /// The default minimum size of each mapping requested from the system.
+  static const uintptr_t DefaultSlabSize = 64 * 1024;
+
+  /// The size of a huge page on the hosts we ask for them on.
+  static const uintptr_t HugePageSize = 2 * 1024 * 1024;
+
+  /// Create a memory manager that maps memory in slabs of at least
+  /// \p SlabSize bytes.  If \p UseHugePages is set, slabs are rounded up to
+  /// a whole number of huge pages and the system is asked to back them with
+  /// huge pages where it supports it.
+  explicit SectionMemoryManager(uintptr_t SlabSize = DefaultSlabSize,
+                                bool UseHugePages = false);
   virtual ~SectionMemoryManager();
 
   /// \brief Allocates a memory block of (at least) the given size suitable for
@@ -84,7 +101,11 @@ public:
 
 private:
   struct MemoryGroup {
+      // Slabs obtained from the system, released on destruction.
       SmallVector<sys::MemoryBlock, 16> AllocatedMem;
+      // Sections handed out since the last call to finalizeMemory.
+      SmallVector<sys::MemoryBlock, 16> PendingMem;
+      // Still unused parts of the slabs.
       SmallVector<sys::MemoryBlock, 16> FreeMem;
       sys::MemoryBlock Near;
   };
@@ -95,6 +116,9 @@ private:
   std::error_code applyMemoryGroupPermissions(MemoryGroup &MemGroup,
                                               unsigned Permissions);
 
+  uintptr_t SlabSize;
+  bool UseHugePages;
+
   MemoryGroup CodeMem;
   MemoryGroup RWDataMem;
   MemoryGroup RODataMem;
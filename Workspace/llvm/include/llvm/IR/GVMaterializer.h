@@ -53,6 +53,10 @@ public:
   ///
   virtual std::error_code MaterializeModule(Module *M) = 0;
 
+  /// Make sure the module-level metadata has been read. Materializing the
+  /// module reads it too.
+  virtual std::error_code materializeMetadata() = 0;
+
   virtual std::vector<StructType *> getIdentifiedStructTypes() const = 0;
 };
 
@@ -482,6 +482,11 @@ protected:
     return getSubclassDataFromValue() & ~HasMetadataBit;
   }
 
+  /// Instructions are allocated from the current InstructionArena, if any.
+  void *operator new(size_t s, unsigned Us) {
+    return User::allocateFixedOperandUser(s, Us, true);
+  }
+
   Instruction(Type *Ty, unsigned iType, Use *Ops, unsigned NumOps,
               Instruction *InsertBefore = nullptr);
   Instruction(Type *Ty, unsigned iType, Use *Ops, unsigned NumOps,
@@ -0,0 +1,91 @@
+//===-- llvm/IR/InstructionArena.h - Bump allocation of IR ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares InstructionArena, an optional bump allocator that backs
+// the storage of instructions and their co-allocated operand lists.
+//
+// Creating instructions one at a time with global operator new dominates the
+// allocation profile of the bitcode reader and of function cloning, and the
+// per-allocation malloc overhead adds up to a large fraction of the peak
+// memory of whole-program compilations.  While an InstructionArenaScope is
+// active on a thread, every instruction created on that thread is carved out
+// of the scope's arena instead.
+//
+// Each instruction holds a reference on the arena it was allocated from, so
+// the arena's slabs are released in bulk once the last of those instructions
+// has been deleted (typically when the function body is deleted) and no
+// IntrusiveRefCntPtr to the arena is left.  Instructions that are moved to
+// another function or module simply keep their arena alive.  Memory of
+// individual instructions deleted before that point is not reused.
+//
+// Arena allocation needs a small header in front of every User, so it is
+// disabled unless -instruction-arenas is given; the choice is latched by the
+// first User allocation in the process and cannot change afterwards.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_INSTRUCTIONARENA_H
+#define LLVM_IR_INSTRUCTIONARENA_H
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/Support/Allocator.h"
+
+namespace llvm {
+
+class InstructionArena : public RefCountedBase<InstructionArena> {
+  InstructionArena(const InstructionArena &) LLVM_DELETED_FUNCTION;
+  void operator=(const InstructionArena &) LLVM_DELETED_FUNCTION;
+
+  BumpPtrAllocator Allocator;
+
+public:
+  InstructionArena() {}
+
+  /// \brief Return true if instructions may be allocated from arenas in this
+  /// process, i.e. if -instruction-arenas was given before the first User
+  /// was created.
+  static bool isEnabled();
+
+  /// \brief Return the arena that instructions created on the calling thread
+  /// are currently allocated from, or null if there is none.
+  static InstructionArena *getCurrent();
+
+  /// \brief Allocate \p Size bytes for an instruction.  The arena stays
+  /// alive until a matching call to deallocate().
+  void *allocate(size_t Size) {
+    Retain();
+    return Allocator.Allocate(Size, AlignOf<double>::Alignment);
+  }
+
+  /// \brief Give back storage obtained from allocate().  The bytes are only
+  /// reclaimed together with the rest of the arena.
+  void deallocate(void *) { Release(); }
+
+  /// \brief Return the number of bytes obtained from the system so far.
+  size_t getTotalMemory() const { return Allocator.getTotalMemory(); }
+};
+
+/// InstructionArenaScope - Make an arena the source of instruction storage
+/// on the current thread for the lifetime of this object.  Scopes nest; the
+/// previously active arena is restored on destruction.  Passing a null arena
+/// suspends arena allocation within the scope.
+class InstructionArenaScope {
+  InstructionArenaScope(const InstructionArenaScope &) LLVM_DELETED_FUNCTION;
+  void operator=(const InstructionArenaScope &) LLVM_DELETED_FUNCTION;
+
+  InstructionArena *Previous;
+
+public:
+  explicit InstructionArenaScope(InstructionArena *Arena);
+  ~InstructionArenaScope();
+};
+
+} // End llvm namespace
+
+#endif
@@ -158,6 +158,18 @@ public:
   /// any global mutex or cannot block the execution in another LLVM context.
   void yield();
 
+  /// \brief Make the tables that unique constants and types safe to use from
+  /// several threads at once.
+  ///
+  /// This must be called before a second thread starts using the context, and
+  /// cannot be undone.  Only creating and destroying constants and types is
+  /// made thread-safe: the use lists of shared values, such as constants and
+  /// globals, are still unsynchronized.
+  void enableConcurrentUniquing();
+
+  /// \brief Whether enableConcurrentUniquing() has been called.
+  bool isConcurrentUniquingEnabled() const;
+
   /// emitError - Emit an error message to the currently installed error handler
   /// with optional location information.  This function returns, so code should
   /// be prepared to drop the erroneous construct on the floor and "not crash".
@@ -18,6 +18,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
 #include <map>
 #include <vector>
@@ -474,6 +475,37 @@ public:
 
 Timer *getPassTimer(Pass *);
 
+/// PassProfileRegion - If -pass-profile is enabled, record the wall time and
+/// the change in instruction count and malloc'd memory of running pass P on
+/// a unit of IR, from construction to destruction of this object.
+class PassProfileRegion {
+  Pass *P;
+  const Module *M;
+  /// Passes on several functions may delete some of them.
+  SmallVector<WeakVH, 1> Fs;
+  const BasicBlock *BB;
+  std::string IRName;
+  double StartTime;
+  size_t StartMalloc;
+  int64_t StartInsts;
+
+  int64_t countInstructions() const;
+  void start();
+
+public:
+  PassProfileRegion(Pass *P, Module &M);
+  PassProfileRegion(Pass *P, Function &F);
+  /// Profile a pass that runs on several functions at once, such as an SCC of
+  /// the call graph.  Null entries are ignored.
+  PassProfileRegion(Pass *P, ArrayRef<Function *> Functions);
+  PassProfileRegion(Pass *P, BasicBlock &BB);
+  ~PassProfileRegion();
+
+  /// Count the instructions of \p Functions at the end of the region instead,
+  /// for passes that replace the functions they run on.
+  void setFunctions(ArrayRef<Function *> Functions);
+};
+
 }
 
 #endif
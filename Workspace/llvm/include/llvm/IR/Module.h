@@ -506,6 +506,11 @@ public:
   /// Materializer.
   std::error_code materializeAllPermanently();
 
+  /// Make sure the module-level metadata is fully read. Functions that were
+  /// materialized before it refer to placeholders until then, so it has to be
+  /// read before any metadata of the module is looked at.
+  std::error_code materializeMetadata();
+
 /// @}
 /// @name Direct access to the globals list, functions list, and symbol table
 /// @{
@@ -48,6 +48,10 @@ protected:
   Use *OperandList;
 
   void *operator new(size_t s, unsigned Us);
+  /// \brief Allocate a User of size \p s with \p Us operands prefixed to it,
+  /// taking the storage from the thread's InstructionArena if \p UseArena is
+  /// set and an arena is active.
+  static void *allocateFixedOperandUser(size_t s, unsigned Us, bool UseArena);
   User(Type *ty, unsigned vty, Use *OpList, unsigned NumOps)
       : Value(ty, vty), OperandList(OpList) {
     NumOperands = NumOps;
@@ -20,6 +20,7 @@
 #include "llvm/Support/CBindingWrapping.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Compiler.h"
+#include <utility>
 
 namespace llvm {
 
@@ -45,6 +46,7 @@ class ValueHandleBase;
 class ValueSymbolTable;
 class raw_ostream;
 
+template<typename T> class ArrayRef;
 template<typename ValueTy> class StringMapEntry;
 typedef StringMapEntry<Value*> ValueName;
 
@@ -261,6 +263,15 @@ public:
   /// guaranteed to be empty.
   void replaceAllUsesWith(Value *V);
 
+  /// batchReplaceAllUsesWith - Replace all uses of each Replacements[i].first
+  /// with Replacements[i].second.  Replacement values that are replaced
+  /// themselves are followed, so given (A, B) and (B, C) the uses of both A
+  /// and B end up pointing to C; if a value is listed twice, the first pair
+  /// wins.  Constant users of several of the replaced values are rebuilt once
+  /// rather than once per replaced operand.
+  static void
+  batchReplaceAllUsesWith(ArrayRef<std::pair<Value *, Value *>> Replacements);
+
   /// replaceUsesOutsideBlock - Go through the uses list for this definition and
   /// make each use point to "V" instead of "this" when the use is outside the
   /// block. 'This's use list is expected to have at least one element.
@@ -0,0 +1,52 @@
+//===-LTOCache.h - Cache of LTO partition object files ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the LTOCache class.
+//
+//   In an edit-compile-link loop most partitions of a partitioned LTO link
+// (see LTOPartitioner) see the same inputs as in the previous link. The cache
+// keeps the object file of each partition in a directory, under a key that
+// hashes everything that went into it: the bitcode of the partition's inputs
+// and of the inputs it imports from, the decisions made for its symbols, and
+// the code generation options. A partition whose key is found in the cache is
+// not optimized or compiled again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_LTOCACHE_H
+#define LLVM_LTO_LTOCACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include <string>
+
+namespace llvm {
+
+class LTOCache {
+public:
+  /// Use the directory \p Dir, which is created on the first insert().
+  explicit LTOCache(StringRef Dir) : Dir(Dir) {}
+
+  /// If the cache holds an object file for \p Key, copy it to \p Path and
+  /// return true.
+  bool lookup(StringRef Key, const Twine &Path) const;
+
+  /// Store a copy of the object file \p Path under \p Key. Entries appear
+  /// atomically, so concurrent links may share a cache directory. Errors are
+  /// ignored; they only make a later lookup() fail.
+  void insert(StringRef Key, const Twine &Path) const;
+
+private:
+  std::string getEntryPath(StringRef Key) const;
+
+  std::string Dir;
+};
+
+}
+#endif
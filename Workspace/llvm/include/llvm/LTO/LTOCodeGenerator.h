@@ -39,6 +39,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/LTO/LTOPartitioner.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Target/TargetOptions.h"
 #include <string>
@@ -50,6 +51,7 @@ namespace llvm {
   class GlobalValue;
   class Mangler;
   class MemoryBuffer;
+  class Module;
   class TargetLibraryInfo;
   class TargetMachine;
   class raw_ostream;
@@ -76,6 +78,18 @@ struct LTOCodeGenerator {
 
   void addMustPreserveSymbol(const char *sym) { MustPreserveSymbols[sym] = 1; }
 
+  // Split the program into at most the given number of partitions, which are
+  // optimized and compiled into separate object files on the threads of the
+  // global ThreadPool (see LTOPartitioner). Must be called before the first
+  // addModule(); the result can only be retrieved with compile_to_files().
+  void setPartitions(unsigned N) { NumPartitions = N; }
+
+  // Keep the object file of each partition in the directory "dir" and reuse
+  // it in later links whose inputs and options for that partition are the
+  // same (see LTOCache). Implies partitioned mode, even for one partition, so
+  // it is subject to the same restrictions as setPartitions().
+  void setCacheDir(StringRef dir) { CacheDir = dir; }
+
   // To pass options to the driver and optimization passes. These options are
   // not necessarily for debugging purpose (The function name is misleading).
   // This function should be called before LTOCodeGenerator::compilexxx(),
@@ -117,6 +131,19 @@ struct LTOCodeGenerator {
                       bool disableVectorization,
                       std::string &errMsg);
 
+  // Like compile_to_file(), but in partitioned mode: compile each partition
+  // into an object file of its own and return their paths in "names". If
+  // "prefix" is empty, the object files are temporary files that the caller
+  // must remove; otherwise they are named "prefix.0", "prefix.1", etc.
+  // Return true on success.
+  bool compile_to_files(std::vector<std::string> &names,
+                        StringRef prefix,
+                        bool disableOpt,
+                        bool disableInline,
+                        bool disableGVNLoadPRE,
+                        bool disableVectorization,
+                        std::string &errMsg);
+
   void setDiagnosticHandler(lto_diagnostic_handler_t, void *);
 
   LLVMContext &getContext() { return Context; }
@@ -124,15 +151,25 @@ struct LTOCodeGenerator {
 private:
   void initializeLTOPasses();
 
-  bool generateObjectFile(raw_ostream &out, bool disableOpt, bool disableInline,
+  bool generateObjectFile(raw_ostream &out, Module &M, TargetMachine &TM,
+                          bool disableOpt, bool disableInline,
                           bool disableGVNLoadPRE, bool disableVectorization,
                           std::string &errMsg);
+  bool compilePartition(unsigned I, StringRef Path, bool disableOpt,
+                        bool disableInline, bool disableGVNLoadPRE,
+                        bool disableVectorization, std::string &errMsg);
+  std::string getCacheKey(unsigned I, bool disableOpt, bool disableInline,
+                          bool disableGVNLoadPRE, bool disableVectorization);
+  bool isPartitioned() const { return NumPartitions > 1 || !CacheDir.empty(); }
   void applyScopeRestrictions();
-  void applyRestriction(GlobalValue &GV, ArrayRef<StringRef> Libcalls,
+  void applyScopeRestrictions(Module &M, TargetMachine &TM);
+  void applyRestriction(GlobalValue &GV, TargetMachine &TM,
+                        ArrayRef<StringRef> Libcalls,
                         std::vector<const char *> &MustPreserveList,
                         SmallPtrSetImpl<GlobalValue *> &AsmUsed,
                         Mangler &Mangler);
   bool determineTarget(std::string &errMsg);
+  TargetMachine *createTargetMachine(std::string &errMsg);
 
   static void DiagnosticHandler(const DiagnosticInfo &DI, void *Context);
 
@@ -158,6 +195,9 @@ private:
   TargetOptions Options;
   lto_diagnostic_handler_t DiagHandler;
   void *DiagContext;
+  unsigned NumPartitions;
+  LTOPartitioner Partitioner;
+  std::string CacheDir;
 };
 }
 #endif
@@ -17,6 +17,7 @@
 #include "llvm-c/lto.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/Module.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/MCObjectFileInfo.h"
@@ -46,6 +47,13 @@ private:
   };
 
   std::unique_ptr<LLVMContext> OwnedContext;
+  LLVMContext &Context;
+
+  // The symbols of modules whose bitcode has a symbol table come from that
+  // table.  A module in a context of its own is only used for its symbols,
+  // so it is only read, from a copy of the bitcode, when it is asked for.
+  std::unique_ptr<MemoryBuffer> Bitcode;
+  std::string BitcodeTriple;
 
   std::unique_ptr<object::IRObjectFile> IRFile;
   std::unique_ptr<TargetMachine> _target;
@@ -59,9 +67,11 @@ private:
   StringMap<NameAndAttributes> _undefines;
   std::vector<const char*>                _asm_undefines;
 
-  LTOModule(std::unique_ptr<object::IRObjectFile> Obj, TargetMachine *TM);
   LTOModule(std::unique_ptr<object::IRObjectFile> Obj, TargetMachine *TM,
-            std::unique_ptr<LLVMContext> Context);
+            LLVMContext &Context, std::unique_ptr<LLVMContext> OwnedContext);
+  LTOModule(std::unique_ptr<MemoryBuffer> Bitcode, StringRef Triple,
+            TargetMachine *TM, LLVMContext &Context,
+            std::unique_ptr<LLVMContext> OwnedContext);
 
 public:
   ~LTOModule();
@@ -110,17 +120,21 @@ public:
   const Module &getModule() const {
     return const_cast<LTOModule*>(this)->getModule();
   }
-  Module &getModule() {
-    return IRFile->getModule();
-  }
+  Module &getModule();
 
   /// Return the Module's target triple.
   const std::string &getTargetTriple() {
+    if (!IRFile)
+      return BitcodeTriple;
     return getModule().getTargetTriple();
   }
 
   /// Set the Module's target triple.
   void setTargetTriple(StringRef Triple) {
+    if (!IRFile) {
+      BitcodeTriple = Triple;
+      return;
+    }
     getModule().setTargetTriple(Triple);
   }
 
@@ -172,21 +186,37 @@ public:
   }
 
 private:
+  /// Read the module of a symbol table's bitcode.  Returns true on error.
+  bool parseModule(std::string &errMsg);
+
   /// Parse metadata from the module
   // FIXME: it only parses "Linker Options" metadata at the moment
   void parseMetadata();
 
+  /// Add a linker option, or the library it depends on.
+  void addLinkerOpt(StringRef Opt);
+
+  /// Add the symbols and linker options of the bitcode's symbol table.
+  void parseSymbolTable(const BitcodeSymbolTable &Table);
+
   /// Parse the symbols from the module and model-level ASM and add them to
   /// either the defined or undefined lists.
   bool parseSymbols(std::string &errMsg);
 
+  /// Add the undefined symbols that have no definition to the list.
+  void addUndefinedSymbols();
+
   /// Add a symbol which isn't defined just yet to a list to be resolved later.
   void addPotentialUndefinedSymbol(const object::BasicSymbolRef &Sym,
                                    bool isFunc);
+  void addPotentialUndefinedSymbol(StringRef Name, bool isExternalWeak,
+                                   bool isFunc, const GlobalValue *decl);
 
   /// Add a defined symbol to the list.
   void addDefinedSymbol(const char *Name, const GlobalValue *def,
                         bool isFunction);
+  void addDefinedSymbol(StringRef Name, uint32_t attr, bool isFunction,
+                        const GlobalValue *def);
 
   /// Add a data symbol as defined to the list.
   void addDefinedDataSymbol(const object::BasicSymbolRef &Sym);
@@ -0,0 +1,151 @@
+//===-LTOPartitioner.h - Summary-based partitioned LTO ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the LTOPartitioner class.
+//
+//   Regular LTO links every input into a single module and runs one
+// optimization and code generation pipeline over it, so it needs memory for
+// the whole program and keeps one core busy. Partitioned LTO instead keeps
+// each input as bitcode and only a small summary of it in memory: the global
+// values it defines, their linkage and size, and the globals that each of
+// them references.
+//
+//   The global decisions are made on the summaries alone: which definition of
+// a symbol prevails, which module goes to which partition, which symbols are
+// used from outside their partition and so must not be internalized, and
+// which small functions each partition imports from the others as
+// available_externally copies so that they can still be inlined. Each
+// partition is then loaded into an LLVMContext of its own and optimized and
+// compiled independently of the others, possibly on another thread.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_LTOPARTITIONER_H
+#define LLVM_LTO_LTOPARTITIONER_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/Support/MD5.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class LLVMContext;
+  class MemoryBuffer;
+  class Module;
+
+class LTOPartitioner {
+public:
+  /// Summary of a global value with non-local linkage defined by an input.
+  struct GlobalSummary {
+    unsigned NameID;
+    GlobalValue::LinkageTypes Linkage;
+    /// The number of instructions of a function; zero for other globals.
+    unsigned Size;
+    bool IsFunction;
+    /// Marked cold, for instance from profile data, so never worth importing.
+    bool IsCold;
+    /// Member of a comdat. The native linker picks one copy of the group, so
+    /// such definitions are neither dropped nor internalized.
+    bool InComdat;
+    /// References a global with local linkage, so the body can't be copied
+    /// into another module.
+    bool RefsLocals;
+    /// The non-local globals the body, initializer or aliasee references.
+    std::vector<unsigned> Refs;
+  };
+
+  /// Summary of an input module.
+  struct ModuleSummary {
+    std::unique_ptr<MemoryBuffer> Bitcode;
+    /// The MD5 hash of Bitcode.
+    MD5::MD5Result Hash;
+    std::vector<GlobalSummary> Globals;
+    /// Every non-local global referenced anywhere in the module.
+    std::vector<unsigned> Refs;
+    /// The number of instructions in the module.
+    unsigned Size;
+  };
+
+  LTOPartitioner();
+  ~LTOPartitioner();
+
+  /// Summarize \p M and keep a bitcode copy of it. \p M is left unchanged,
+  /// apart from having all of it materialized.
+  void addModule(Module &M);
+
+  /// Make the global decisions for splitting the inputs added so far into at
+  /// most \p MaxPartitions partitions.
+  void plan(unsigned MaxPartitions);
+
+  /// Return the number of partitions chosen by plan().
+  unsigned getNumPartitions() const { return Partitions.size(); }
+
+  /// Load partition \p I into \p Context: its inputs linked together, with
+  /// the definitions that don't prevail turned into declarations, plus the
+  /// functions it imports. Return null and set \p ErrMsg on failure. May be
+  /// called for different partitions on different threads.
+  std::unique_ptr<Module> buildPartition(unsigned I, LLVMContext &Context,
+                                         std::string &ErrMsg) const;
+
+  /// Add to \p Hasher everything that buildPartition() depends on for
+  /// partition \p I: its inputs, the functions it imports and the inputs
+  /// they come from, and the decisions made for the globals it defines.
+  /// \p Resolution maps the name of each of those globals to a value that
+  /// encodes how the caller will treat it, for instance whether it will be
+  /// internalized. Together with the code generation options this makes a
+  /// key for caching the object file of the partition (see LTOCache).
+  void hashPartition(unsigned I, MD5 &Hasher,
+                     function_ref<unsigned(StringRef)> Resolution) const;
+
+  /// Return true if the global named \p Name is used outside the partition
+  /// that defines it, and so must keep its linkage.
+  bool isExported(StringRef Name) const;
+
+  /// Return the summaries of the inputs, in the order they were added.
+  const std::vector<ModuleSummary> &getModules() const { return Modules; }
+
+private:
+  LTOPartitioner(const LTOPartitioner &) LLVM_DELETED_FUNCTION;
+  void operator=(const LTOPartitioner &) LLVM_DELETED_FUNCTION;
+
+  unsigned getNameID(StringRef Name);
+  bool isImportable(const GlobalSummary &GS) const;
+  bool isPrevailing(unsigned Module, StringRef Name) const;
+
+  /// The names of all non-local globals the inputs define or reference.
+  StringMap<unsigned> NameIDs;
+  std::vector<StringRef> Names;
+
+  std::vector<ModuleSummary> Modules;
+
+  /// For each name, the input whose definition prevails, or -1 if there is
+  /// none or if every definition is kept.
+  std::vector<int> Prevailing;
+
+  /// For each name, the index of the prevailing definition in the Globals of
+  /// its input.
+  std::vector<unsigned> PrevailingGlobal;
+
+  BitVector Exported;
+
+  /// The inputs in each partition, in the order they were added.
+  std::vector<std::vector<unsigned> > Partitions;
+
+  /// The names of the functions each partition imports.
+  std::vector<std::vector<unsigned> > Imports;
+
+  std::vector<unsigned> PartitionOf;
+};
+
+}
+#endif
@@ -13,9 +13,15 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/ValueHandle.h"
+#include <functional>
+#include <memory>
 
 namespace llvm {
+class Constant;
+class LLVMContext;
 class Module;
 class StructType;
 class Type;
@@ -53,12 +59,28 @@ public:
     // The set of identified but non opaque structures in the composite module.
     NonOpaqueStructTypeSet NonOpaqueStructTypes;
 
+    // The same structures by getShapeHash(), which isomorphic structures
+    // share.
+    DenseMap<unsigned, TinyPtrVector<StructType *>> NonOpaqueStructTypesByShape;
+
     void addNonOpaque(StructType *Ty);
     void addOpaque(StructType *Ty);
     StructType *findNonOpaque(ArrayRef<Type *> ETypes, bool IsPacked);
+    ArrayRef<StructType *> findNonOpaqueByShape(unsigned ShapeHash) const;
     bool hasType(StructType *Ty);
+
+    /// Return a hash of the shape of \p Ty that is the same for isomorphic
+    /// types.  Identified structures inside it are hashed as opaque, so
+    /// recursive types are hashed without walking their cycles.
+    static unsigned getShapeHash(StructType *Ty);
   };
 
+  /// The private unnamed_addr constants of the composite module that refer to
+  /// no globals, by initializer and alignment.  Identical constants from the
+  /// modules linked in later are merged into them.
+  typedef DenseMap<std::pair<Constant *, unsigned>, WeakVH>
+      MergeableConstantMap;
+
   Linker(Module *M, DiagnosticHandlerFunction DiagnosticHandler);
   Linker(Module *M);
   ~Linker();
@@ -70,6 +92,28 @@ public:
   /// Returns true on error.
   bool linkInModule(Module *Src);
 
+  /// \brief A function that creates input \p I of linkInModules() in
+  /// \p Context, or reports an error and returns null.
+  typedef std::function<std::unique_ptr<Module>(unsigned I,
+                                                LLVMContext &Context)>
+      ModuleLoaderTy;
+
+  /// \brief Link the modules returned by \p Load(0) to \p Load(NumInputs-1)
+  /// into the composite, like calling linkInModule() on each in turn.
+  ///
+  /// If the global ThreadPool has several threads, runs of consecutive inputs
+  /// are loaded and linked concurrently, each in a private LLVMContext.  The
+  /// partial modules are then merged pairwise in a tree, and the last one
+  /// into the composite.  Modules move between contexts as bitcode in memory
+  /// and are materialized lazily.  Unlike with serial linking, linkonce and
+  /// available_externally definitions are kept even if unreferenced, globals
+  /// may come out in a different order, and local symbols that have to be
+  /// renamed may be given different suffixes.
+  ///
+  /// \p Load may be called from several threads at once.  Diagnostics are
+  /// passed to the diagnostic handler one at a time.  Returns true on error.
+  bool linkInModules(unsigned NumInputs, ModuleLoaderTy Load);
+
   static bool LinkModules(Module *Dest, Module *Src,
                           DiagnosticHandlerFunction DiagnosticHandler);
 
@@ -80,6 +124,7 @@ private:
   Module *Composite;
 
   IdentifiedStructTypeSet IdentifiedStructTypes;
+  MergeableConstantMap MergeableConstants;
 
   DiagnosticHandlerFunction DiagnosticHandler;
 };
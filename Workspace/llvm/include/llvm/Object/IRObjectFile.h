@@ -17,6 +17,7 @@
 #include "llvm/Object/SymbolicFile.h"
 
 namespace llvm {
+struct BitcodeSymbol;
 class Mangler;
 class Module;
 class GlobalValue;
@@ -67,6 +68,10 @@ public:
 
   static ErrorOr<std::unique_ptr<IRObjectFile>> create(MemoryBufferRef Object,
                                                        LLVMContext &Context);
+
+  /// \brief Returns the flags that the symbol of the global value that \p Sym
+  /// describes would have, for users of readBitcodeSymbolTable().
+  static uint32_t getBitcodeSymbolFlags(const BitcodeSymbol &Sym);
 };
 }
 }
@@ -364,6 +364,24 @@
 #define LLVM_HAS_INITIALIZER_LISTS 0
 #endif
 
+/// \macro LLVM_THREAD_LOCAL
+/// \brief A thread-local storage specifier which can be used with globals,
+/// extern globals, and static globals.
+///
+/// This uses the vendor extensions rather than C++11 thread_local, so only use
+/// it for PODs that are statically initialized to a constant, such as pointers
+/// and integers.  If threading is disabled entirely, this expands to nothing
+/// and you get a normal global variable.
+#if LLVM_ENABLE_THREADS
+#if defined(_MSC_VER)
+#define LLVM_THREAD_LOCAL __declspec(thread)
+#else
+#define LLVM_THREAD_LOCAL __thread
+#endif
+#else
+#define LLVM_THREAD_LOCAL
+#endif
+
 /// \brief Mark debug helper function definitions like dump() that should not be
 /// stripped from debug builds.
 // FIXME: Move this to a private config.h as it's not usable in public headers.
@@ -53,6 +53,20 @@ uint32_t crc32(StringRef Buffer);
 
 }  // End of namespace zlib
 
+/// A byte-oriented LZ77 codec that is always available.  It compresses less
+/// than zlib, but decompresses several times faster.
+namespace lz77 {
+
+void compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer);
+
+/// Returns false if InputBuffer doesn't uncompress to exactly
+/// UncompressedSize bytes.
+bool uncompress(StringRef InputBuffer,
+                SmallVectorImpl<char> &UncompressedBuffer,
+                size_t UncompressedSize);
+
+}  // End of namespace lz77
+
 } // End of namespace llvm
 
 #endif
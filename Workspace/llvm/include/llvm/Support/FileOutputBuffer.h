@@ -61,12 +61,19 @@ public:
     return FinalPath;
   }
 
+  /// Changes the size of the buffer, preserving its contents up to the
+  /// smaller of the old and new sizes.  The buffer may move, so pointers
+  /// previously returned by getBufferStart() and getBufferEnd() are
+  /// invalidated.  On failure the buffer is left unmapped and the only valid
+  /// operation is destroying this object.
+  std::error_code resize(size_t NewSize);
+
   /// Flushes the content of the buffer to its file and deallocates the
   /// buffer.  If commit() is not called before this object's destructor
   /// is called, the file is deleted in the destructor. The optional parameter
   /// is used if it turns out you want the file size to be smaller than
   /// initially requested.
-  std::error_code commit();
+  std::error_code commit(int64_t NewSmallerSize = -1);
 
   /// If this object was previously committed, the destructor just deletes
   /// this object.  If this object was not committed, the destructor
@@ -47,7 +47,12 @@ namespace sys {
     enum ProtectionFlags {
       MF_READ  = 0x1000000,
       MF_WRITE = 0x2000000,
-      MF_EXEC  = 0x4000000
+      MF_EXEC  = 0x4000000,
+      MF_RWE_MASK = 0x7000000,
+      /// Hint that the memory should be backed by huge pages where the
+      /// operating system supports it.  Only honoured by allocateMappedMemory
+      /// and ignored everywhere else.
+      MF_HUGE_HINT = 0x0000001
     };
 
     /// This method allocates a block of memory that is suitable for loading
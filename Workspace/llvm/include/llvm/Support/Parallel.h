@@ -0,0 +1,162 @@
+//===-- llvm/Support/Parallel.h - Parallel algorithms -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file defines TaskGroup and the parallel_for_each, parallel_for_each_n
+// and parallel_sort algorithms, which run on a ThreadPool (by default the
+// process-wide one sized by -threads).
+//
+// The algorithms fall back to running serially on the calling thread if the
+// pool has a single thread, so -threads=1 gives deterministic, sequential
+// execution.  Functions passed to them must be safe to call concurrently.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_PARALLEL_H
+#define LLVM_SUPPORT_PARALLEL_H
+
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+
+namespace llvm {
+
+/// TaskGroup - A set of tasks that can be waited for together.  Unlike
+/// ThreadPool::wait(), waiting for a group is allowed from within a task,
+/// which makes nested and recursive parallelism possible.  The destructor
+/// waits for the tasks that are still outstanding.
+class TaskGroup {
+  TaskGroup(const TaskGroup &) LLVM_DELETED_FUNCTION;
+  void operator=(const TaskGroup &) LLVM_DELETED_FUNCTION;
+
+  ThreadPool &Pool;
+  std::atomic<unsigned> Pending;
+
+public:
+  explicit TaskGroup(ThreadPool &Pool = ThreadPool::getGlobal())
+      : Pool(Pool), Pending(0) {}
+  ~TaskGroup() { wait(); }
+
+  /// Run \p F asynchronously as part of this group.
+  void spawn(std::function<void()> F) {
+    ++Pending;
+    Pool.async([this, F] {
+      F();
+      --Pending;
+    });
+  }
+
+  /// Wait for all tasks spawned so far, running queued tasks meanwhile.
+  void wait() {
+    Pool.waitUntil([this] { return Pending == 0; });
+  }
+
+  ThreadPool &getPool() const { return Pool; }
+};
+
+namespace detail {
+/// The number of chunks the parallel algorithms split their input into, per
+/// thread.  More chunks balance uneven work better; fewer cost less
+/// scheduling.
+const unsigned ChunksPerThread = 8;
+
+/// Inputs smaller than this are sorted serially by parallel_sort.
+const size_t MinParallelSortSize = 1024;
+
+template <class RandomAccessIterator, class Comparator>
+RandomAccessIterator medianOf3(RandomAccessIterator Start,
+                               RandomAccessIterator End,
+                               const Comparator &Comp) {
+  RandomAccessIterator Mid = Start + (std::distance(Start, End) / 2);
+  return Comp(*Start, *(End - 1))
+             ? (Comp(*Mid, *(End - 1)) ? (Comp(*Start, *Mid) ? Mid : Start)
+                                       : End - 1)
+             : (Comp(*Mid, *Start) ? (Comp(*(End - 1), *Mid) ? Mid : End - 1)
+                                   : Start);
+}
+
+template <class RandomAccessIterator, class Comparator>
+void parallelQuickSort(RandomAccessIterator Start, RandomAccessIterator End,
+                       const Comparator &Comp, TaskGroup &TG, unsigned Depth) {
+  if (std::distance(Start, End) < (ptrdiff_t)MinParallelSortSize ||
+      Depth == 0) {
+    std::sort(Start, End, Comp);
+    return;
+  }
+
+  // Partition around the median of three.
+  RandomAccessIterator Pivot = medianOf3(Start, End, Comp);
+  std::swap(*(End - 1), *Pivot);
+  Pivot = std::partition(Start, End - 1, [&Comp, End](decltype(*Start) V) {
+    return Comp(V, *(End - 1));
+  });
+  std::swap(*Pivot, *(End - 1));
+
+  // Sort the halves in parallel.
+  TG.spawn([=, &Comp, &TG] {
+    parallelQuickSort(Start, Pivot, Comp, TG, Depth - 1);
+  });
+  parallelQuickSort(Pivot + 1, End, Comp, TG, Depth - 1);
+}
+} // end namespace detail
+
+/// parallel_for_each_n - Call \p Fn(I) for every index I in [Begin, End).
+template <class IndexTy, class FuncTy>
+void parallel_for_each_n(IndexTy Begin, IndexTy End, FuncTy Fn,
+                         ThreadPool &Pool = ThreadPool::getGlobal()) {
+  if (Pool.getThreadCount() <= 1 || End - Begin <= 1) {
+    for (; Begin != End; ++Begin)
+      Fn(Begin);
+    return;
+  }
+
+  IndexTy NumChunks = Pool.getThreadCount() * detail::ChunksPerThread;
+  IndexTy ChunkSize = std::max<IndexTy>(1, (End - Begin) / NumChunks);
+  TaskGroup TG(Pool);
+  for (; End - Begin > ChunkSize; Begin += ChunkSize) {
+    TG.spawn([=, &Fn] {
+      for (IndexTy I = Begin, E = Begin + ChunkSize; I != E; ++I)
+        Fn(I);
+    });
+  }
+  // Do the last chunk ourselves.
+  for (; Begin != End; ++Begin)
+    Fn(Begin);
+}
+
+/// parallel_for_each - Call \p Fn on every element of [Begin, End).
+template <class RandomAccessIterator, class FuncTy>
+void parallel_for_each(RandomAccessIterator Begin, RandomAccessIterator End,
+                       FuncTy Fn, ThreadPool &Pool = ThreadPool::getGlobal()) {
+  parallel_for_each_n(ptrdiff_t(0), std::distance(Begin, End),
+                      [&](ptrdiff_t I) { Fn(Begin[I]); }, Pool);
+}
+
+/// parallel_sort - Sort [Start, End) with \p Comp, like std::sort.  The sort
+/// is not stable.
+template <class RandomAccessIterator, class Comparator>
+void parallel_sort(RandomAccessIterator Start, RandomAccessIterator End,
+                   const Comparator &Comp,
+                   ThreadPool &Pool = ThreadPool::getGlobal()) {
+  if (Pool.getThreadCount() <= 1) {
+    std::sort(Start, End, Comp);
+    return;
+  }
+  TaskGroup TG(Pool);
+  // Bound the recursion like introsort: bad pivots make std::sort take over.
+  detail::parallelQuickSort(Start, End, Comp, TG,
+                            Log2_64(std::distance(Start, End)) + 1);
+}
+
+template <class RandomAccessIterator>
+void parallel_sort(RandomAccessIterator Start, RandomAccessIterator End) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type T;
+  parallel_sort(Start, End, std::less<T>());
+}
+
+} // End llvm namespace
+
+#endif
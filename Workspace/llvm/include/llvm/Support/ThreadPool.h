@@ -0,0 +1,129 @@
+//===-- llvm/Support/ThreadPool.h - A work-stealing thread pool -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares ThreadPool, a pool of worker threads that run
+// asynchronous tasks.  Each worker owns a double-ended queue of tasks: tasks
+// spawned from a worker go to the back of its own queue and are run last-in
+// first-out, and a worker that runs out of work steals from the front of the
+// other queues.  Threads that wait for tasks run queued tasks themselves
+// instead of blocking, so tasks may spawn and wait for further tasks.
+//
+// The size of the process-wide pool returned by getGlobal() is set by the
+// -threads option.  If the process was started by a GNU make that runs a
+// jobserver, workers only run tasks while they hold a jobserver token, so
+// that the total load of the build stays within make's -j limit.
+//
+// See llvm/Support/Parallel.h for parallel algorithms built on top of the
+// pool.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_THREADPOOL_H
+#define LLVM_SUPPORT_THREADPOOL_H
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+#if LLVM_ENABLE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace llvm {
+
+class ThreadPool {
+public:
+  typedef std::function<void()> TaskTy;
+
+  /// Create a pool of \p ThreadCount worker threads.  Zero means
+  /// getDefaultThreadCount().
+  explicit ThreadPool(unsigned ThreadCount = 0);
+
+  /// Wait for all queued tasks to finish and join the worker threads.
+  ~ThreadPool();
+
+  /// Queue \p Task to be run by one of the workers.  If LLVM was built
+  /// without thread support, \p Task is run immediately.
+  void async(TaskTy Task);
+
+  /// Block until every task queued so far, and every task those tasks
+  /// queue, has finished.  The calling thread runs queued tasks meanwhile.
+  void wait();
+
+  /// Run tasks on the calling thread until \p Done returns true.  When there
+  /// is no task to run, block until another task finishes or is queued.
+  /// \p Done must become true as the result of a task finishing.
+  void waitUntil(const std::function<bool()> &Done);
+
+  /// If a task is queued, take it and run it on the calling thread.  Return
+  /// true if a task was run.
+  bool runPendingTask();
+
+  /// Return the number of worker threads.
+  unsigned getThreadCount() const { return ThreadCount; }
+
+  /// Return the process-wide pool, sized by -threads.  It is created on first
+  /// use and destroyed by llvm_shutdown().
+  static ThreadPool &getGlobal();
+
+  /// Return the value of -threads, or the number of hardware threads if it
+  /// was not given.
+  static unsigned getDefaultThreadCount();
+
+private:
+  ThreadPool(const ThreadPool &) LLVM_DELETED_FUNCTION;
+  void operator=(const ThreadPool &) LLVM_DELETED_FUNCTION;
+
+  unsigned ThreadCount;
+
+#if LLVM_ENABLE_THREADS
+  struct WorkQueue;
+
+  /// Take a task, preferring the back of queue \p Home and stealing from the
+  /// front of the others.
+  bool popTask(unsigned Home, TaskTy &Task);
+
+  /// Run \p Task and update the bookkeeping.
+  void runTask(TaskTy &Task);
+
+  /// The main loop of worker \p Index.
+  void work(unsigned Index);
+
+  std::vector<std::unique_ptr<WorkQueue> > Queues;
+  std::vector<std::thread> Threads;
+
+  /// Protects the counters below and is used with the condition variables.
+  std::mutex Lock;
+
+  /// Signalled when a task is queued or the pool is destroyed.
+  std::condition_variable WorkAvailable;
+
+  /// Signalled when a task finishes or is queued, for waitUntil().
+  std::condition_variable Progress;
+
+  /// The number of tasks sitting in the queues.
+  unsigned QueuedTasks;
+
+  /// The number of tasks queued or running.
+  unsigned ActiveTasks;
+
+  /// The queue that the next task from outside the pool goes to.
+  unsigned NextQueue;
+
+  bool Stopping;
+#endif
+};
+
+} // End llvm namespace
+
+#endif
@@ -14,7 +14,9 @@
 #ifndef LLVM_SUPPORT_TOOLOUTPUTFILE_H
 #define LLVM_SUPPORT_TOOLOUTPUTFILE_H
 
+#include "llvm/Support/raw_mmap_ostream.h"
 #include "llvm/Support/raw_ostream.h"
+#include <memory>
 
 namespace llvm {
 
@@ -23,11 +25,16 @@ namespace llvm {
 ///   - The file is automatically deleted if the process is killed.
 ///   - The file is automatically deleted when the tool_output_file
 ///     object is destroyed unless the client calls keep().
+///
+/// Optionally, output to a regular file may instead go through a
+/// raw_mmap_ostream, which writes straight into a memory mapping of a
+/// temporary file.  The temporary is trimmed and renamed to the destination
+/// when the tool_output_file is destroyed after keep() was called.
 class tool_output_file {
-  /// Installer - This class is declared before the raw_fd_ostream so that
-  /// it is constructed before the raw_fd_ostream is constructed and
-  /// destructed after the raw_fd_ostream is destructed. It installs
-  /// cleanups in its constructor and uninstalls them in its destructor.
+  /// Installer - This class is declared before the output streams so that
+  /// it is constructed before the streams are constructed and destructed
+  /// after the streams are destructed. It installs cleanups in its
+  /// constructor and uninstalls them in its destructor.
   class CleanupInstaller {
     /// The name of the file.
     std::string Filename;
@@ -39,9 +46,12 @@ class tool_output_file {
     ~CleanupInstaller();
   } Installer;
 
-  /// OS - The contained stream. This is intentionally declared after
-  /// Installer.
-  raw_fd_ostream OS;
+  /// OS - The contained stream, unless the output is mapped. This is
+  /// intentionally declared after Installer.
+  std::unique_ptr<raw_fd_ostream> OS;
+
+  /// MappedOS - The contained stream if the output is mapped.
+  std::unique_ptr<raw_mmap_ostream> MappedOS;
 
 public:
   /// This constructor's arguments are passed to to raw_fd_ostream's
@@ -49,10 +59,34 @@ public:
   tool_output_file(StringRef Filename, std::error_code &EC,
                    sys::fs::OpenFlags Flags);
 
+  /// Like the above, but if \p AllowMapping is true, \p Flags asks for
+  /// plain binary output and \p Filename names a regular file or nothing at
+  /// all, the output is written through a raw_mmap_ostream.  Clients that
+  /// pass true must write through stream() rather than os().
+  tool_output_file(StringRef Filename, std::error_code &EC,
+                   sys::fs::OpenFlags Flags, bool AllowMapping);
+
   tool_output_file(StringRef Filename, int FD);
 
-  /// os - Return the contained raw_fd_ostream.
-  raw_fd_ostream &os() { return OS; }
+  ~tool_output_file();
+
+  /// os - Return the contained raw_fd_ostream.  The output must not be
+  /// mapped.
+  raw_fd_ostream &os() {
+    assert(OS && "Mapped tool_output_file has no raw_fd_ostream!");
+    return *OS;
+  }
+
+  /// stream - Return the stream that writes to the output file.
+  raw_ostream &stream() {
+    if (MappedOS)
+      return *MappedOS;
+    return *OS;
+  }
+
+  /// isMapped - Return true if the output is written through a memory
+  /// mapping.
+  bool isMapped() const { return MappedOS != nullptr; }
 
   /// keep - Indicate that the tool's job wrt this output file has been
   /// successful and the file should not be deleted.
@@ -0,0 +1,86 @@
+//===- raw_mmap_ostream.h - raw_ostream into a mapped file ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the raw_mmap_ostream class.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_RAW_MMAP_OSTREAM_H
+#define LLVM_SUPPORT_RAW_MMAP_OSTREAM_H
+
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <system_error>
+
+namespace llvm {
+class FileOutputBuffer;
+
+/// raw_mmap_ostream - A raw_ostream that formats its output directly into a
+/// memory mapped FileOutputBuffer instead of into a buffer that is copied to
+/// the file with write(2).  The mapping is doubled in size whenever it fills
+/// up.  Nothing appears at the destination path until commit() is called,
+/// which trims the file to the number of bytes written and renames it into
+/// place; if the stream is destroyed without being committed, the output is
+/// discarded.
+///
+/// The stream cannot seek, but already written output can be overwritten
+/// with pwrite().  The destination must be a regular file.
+class raw_mmap_ostream : public raw_ostream {
+  std::unique_ptr<FileOutputBuffer> Buffer;
+
+  /// Pos - The number of bytes handed to write_impl so far.
+  uint64_t Pos;
+
+  /// Error - The first error encountered, if any.  Once set, further output
+  /// is dropped.
+  std::error_code Error;
+
+  bool Committed;
+
+  /// write_impl - See raw_ostream::write_impl.
+  void write_impl(const char *Ptr, size_t Size) override;
+
+  /// pwrite_impl - See raw_ostream::pwrite_impl.
+  void pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset) override;
+
+  /// current_pos - Return the current position within the stream, not
+  /// counting the bytes currently in the buffer.
+  uint64_t current_pos() const override { return Pos; }
+
+  /// reserve - Make the mapping at least \p MinSize bytes large.  Returns
+  /// false, after recording the error, if that was not possible.
+  bool reserve(uint64_t MinSize);
+
+  /// resetBuffer - Point the raw_ostream buffer at the unused tail of the
+  /// mapping.
+  void resetBuffer();
+
+public:
+  /// Open a temporary file next to \p Filename for output.  \p Flags are
+  /// passed to FileOutputBuffer::create and \p SizeHint is the initial size
+  /// of the mapping.  If an error occurs, it is put into \p EC and the stream
+  /// should be immediately destroyed.
+  raw_mmap_ostream(StringRef Filename, std::error_code &EC, unsigned Flags = 0,
+                   size_t SizeHint = 0);
+  ~raw_mmap_ostream();
+
+  bool supportsPwrite() const override { return true; }
+
+  /// commit - Flush the stream, truncate the file to the data written and
+  /// move it to its final name.  The stream must not be written to
+  /// afterwards.
+  std::error_code commit();
+
+  /// getError - Return the first error encountered while writing, if any.
+  std::error_code getError() const { return Error; }
+};
+
+} // end llvm namespace
+
+#endif
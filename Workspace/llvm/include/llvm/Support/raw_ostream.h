@@ -92,6 +92,19 @@ public:
   /// tell - Return the current offset with the file.
   uint64_t tell() const { return current_pos() + GetNumBytesInBuffer(); }
 
+  /// supportsPwrite - Return true if output that was already written can be
+  /// overwritten with pwrite().
+  virtual bool supportsPwrite() const { return false; }
+
+  /// pwrite - Overwrite the \p Size bytes at offset \p Offset, as returned by
+  /// tell() when they were written, with the bytes at \p Ptr.  The stream
+  /// must support this, see supportsPwrite().
+  void pwrite(const char *Ptr, size_t Size, uint64_t Offset) {
+    assert(supportsPwrite() && "Stream does not support pwrite!");
+    flush();
+    pwrite_impl(Ptr, Size, Offset);
+  }
+
   //===--------------------------------------------------------------------===//
   // Configuration Interface
   //===--------------------------------------------------------------------===//
@@ -274,6 +287,10 @@ private:
   /// \invariant { Size > 0 }
   virtual void write_impl(const char *Ptr, size_t Size) = 0;
 
+  /// pwrite_impl - Overwrite already written output; see pwrite().  Only
+  /// called on streams that support it, with the buffer flushed.
+  virtual void pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset);
+
   // An out of line virtual method to provide a home for the class vtable.
   virtual void handle();
 
@@ -335,9 +352,16 @@ class raw_fd_ostream : public raw_ostream {
 
   uint64_t pos;
 
+  /// SupportsSeeking - FD is a regular file that is not appended to, so
+  /// output can be overwritten after seeking back.
+  bool SupportsSeeking;
+
   /// write_impl - See raw_ostream::write_impl.
   void write_impl(const char *Ptr, size_t Size) override;
 
+  /// pwrite_impl - See raw_ostream::pwrite_impl.
+  void pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset) override;
+
   /// current_pos - Return the current position within the stream, not
   /// counting the bytes currently in the buffer.
   uint64_t current_pos() const override { return pos; }
@@ -377,6 +401,8 @@ public:
   /// position to the offset specified from the beginning of the file.
   uint64_t seek(uint64_t off);
 
+  bool supportsPwrite() const override { return SupportsSeeking; }
+
   /// SetUseAtomicWrite - Set the stream to attempt to use atomic writes for
   /// individual output routines where possible.
   ///
@@ -493,6 +519,9 @@ class raw_null_ostream : public raw_ostream {
   /// write_impl - See raw_ostream::write_impl.
   void write_impl(const char *Ptr, size_t size) override;
 
+  /// pwrite_impl - See raw_ostream::pwrite_impl.
+  void pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset) override;
+
   /// current_pos - Return the current position within the stream, not
   /// counting the bytes currently in the buffer.
   uint64_t current_pos() const override;
@@ -500,6 +529,8 @@ class raw_null_ostream : public raw_ostream {
 public:
   explicit raw_null_ostream() {}
   ~raw_null_ostream();
+
+  bool supportsPwrite() const override { return true; }
 };
 
 } // end llvm namespace
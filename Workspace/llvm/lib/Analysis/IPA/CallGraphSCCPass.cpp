@@ -122,8 +122,18 @@ bool CGPassManager::RunPassOnSCC(Pass *P, CallGraphSCC &CurSCC,
     }
 
     {
+      SmallVector<Function *, 4> Functions;
+      for (CallGraphNode *Node : CurSCC)
+        Functions.push_back(Node->getFunction());
       TimeRegion PassTimer(getPassTimer(CGSP));
+      PassProfileRegion Profile(CGSP, Functions);
       Changed = CGSP->runOnSCC(CurSCC);
+
+      // The pass may have replaced functions of the SCC with new ones.
+      Functions.clear();
+      for (CallGraphNode *Node : CurSCC)
+        Functions.push_back(Node->getFunction());
+      Profile.setFunctions(Functions);
     }
     
     // After the CGSCCPass is done, when assertions are enabled, use
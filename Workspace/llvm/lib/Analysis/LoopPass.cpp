@@ -245,6 +245,7 @@ bool LPPassManager::runOnFunction(Function &F) {
       {
         PassManagerPrettyStackEntry X(P, *CurrentLoop->getHeader());
         TimeRegion PassTimer(getPassTimer(P));
+        PassProfileRegion Profile(P, *CurrentLoop->getHeader()->getParent());
 
         Changed |= P->runOnLoop(CurrentLoop, *this);
       }
@@ -93,6 +93,7 @@ bool RGPassManager::runOnFunction(Function &F) {
         PassManagerPrettyStackEntry X(P, *CurrentRegion->getEntry());
 
         TimeRegion PassTimer(getPassTimer(P));
+        PassProfileRegion Profile(P, *CurrentRegion->getEntry()->getParent());
         Changed |= P->runOnRegion(CurrentRegion, *this);
       }
 
@@ -17,15 +17,22 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/OperandTraits.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/DataStream.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MemoryObject.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -34,6 +41,11 @@ enum {
   SWITCH_INST_MAGIC = 0x4B5 // May 2012 => 1205 => Hex
 };
 
+static cl::opt<bool>
+ParallelFunctionBodies("parallel-bitcode-bodies", cl::Hidden,
+  cl::desc("Decode function bodies on the thread pool when reading a whole "
+           "bitcode module"));
+
 BitcodeDiagnosticInfo::BitcodeDiagnosticInfo(std::error_code EC,
                                              DiagnosticSeverity Severity,
                                              const Twine &Msg)
@@ -77,17 +89,23 @@ BitcodeReader::BitcodeReader(MemoryBuffer *buffer, LLVMContext &C,
                              DiagnosticHandlerFunction DiagnosticHandler)
     : Context(C), DiagnosticHandler(getDiagHandler(DiagnosticHandler, C)),
       TheModule(nullptr), Buffer(buffer), LazyStreamer(nullptr),
-      NextUnreadBit(0), SeenValueSymbolTable(false), ValueList(C),
-      MDValueList(C), SeenFirstFunctionBody(false), UseRelativeIDs(false),
-      WillMaterializeAllForwardRefs(false) {}
+      NextUnreadBit(0), SeenValueSymbolTable(false), FunctionIndexBit(0),
+      ValueList(C),
+      MDValueList(C), SeenFirstFunctionBody(false),
+      ShouldLazyLoadMetadata(false), IsMetadataMaterialized(false),
+      StagingTasks(nullptr),
+      UseRelativeIDs(false), WillMaterializeAllForwardRefs(false) {}
 
 BitcodeReader::BitcodeReader(DataStreamer *streamer, LLVMContext &C,
                              DiagnosticHandlerFunction DiagnosticHandler)
     : Context(C), DiagnosticHandler(getDiagHandler(DiagnosticHandler, C)),
       TheModule(nullptr), Buffer(nullptr), LazyStreamer(streamer),
-      NextUnreadBit(0), SeenValueSymbolTable(false), ValueList(C),
-      MDValueList(C), SeenFirstFunctionBody(false), UseRelativeIDs(false),
-      WillMaterializeAllForwardRefs(false) {}
+      NextUnreadBit(0), SeenValueSymbolTable(false), FunctionIndexBit(0),
+      ValueList(C),
+      MDValueList(C), SeenFirstFunctionBody(false),
+      ShouldLazyLoadMetadata(false), IsMetadataMaterialized(false),
+      StagingTasks(nullptr),
+      UseRelativeIDs(false), WillMaterializeAllForwardRefs(false) {}
 
 std::error_code BitcodeReader::materializeForwardReferencedFunctions() {
   if (WillMaterializeAllForwardRefs)
@@ -126,6 +144,7 @@ void BitcodeReader::FreeState() {
   Buffer = nullptr;
   std::vector<Type*>().swap(TypeList);
   ValueList.clear();
+  MDValueList.dropForwardRefs();
   MDValueList.clear();
   std::vector<Comdat *>().swap(ComdatList);
 
@@ -133,6 +152,7 @@ void BitcodeReader::FreeState() {
   std::vector<BasicBlock*>().swap(FunctionBBs);
   std::vector<Function*>().swap(FunctionsWithBodies);
   DeferredFunctionInfo.clear();
+  std::vector<std::pair<uint64_t, unsigned> >().swap(DeferredMetadataInfo);
   MDKindMap.clear();
 
   assert(BasicBlockFwdRefs.empty() && "Unresolved blockaddress fwd references");
@@ -575,6 +595,25 @@ void BitcodeReaderMDValueList::tryToResolveCycles() {
   AnyFwdRefs = false;
 }
 
+/// dropForwardRefs - Free the placeholders of metadata that was never read,
+/// such as the module-level metadata of a module whose functions were read
+/// without it.  Whatever still refers to them is pointed at an empty node.
+void BitcodeReaderMDValueList::dropForwardRefs() {
+  if (!NumFwdRefs)
+    return;
+
+  for (auto &MD : MDValuePtrs) {
+    auto *N = dyn_cast_or_null<MDNodeFwdDecl>(MD.get());
+    if (!N)
+      continue;
+    MD.reset();
+    N->replaceAllUsesWith(MDNode::get(Context, None));
+    MDNode::deleteTemporary(N);
+  }
+  NumFwdRefs = 0;
+  AnyFwdRefs = false;
+}
+
 Type *BitcodeReader::getTypeByID(unsigned ID) {
   // The type table size is always specified correctly.
   if (ID >= TypeList.size())
@@ -1148,9 +1187,9 @@ std::error_code BitcodeReader::ParseValueSymbolTable() {
   }
 }
 
-std::error_code BitcodeReader::ParseMetadata() {
-  unsigned NextMDValueNo = MDValueList.size();
-
+/// ParseMetadata - Parse a METADATA_BLOCK, whose values are numbered from
+/// NextMDValueNo on.
+std::error_code BitcodeReader::ParseMetadata(unsigned NextMDValueNo) {
   if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
     return Error("Invalid record");
 
@@ -1938,6 +1977,117 @@ std::error_code BitcodeReader::RememberAndSkipFunctionBody() {
   return std::error_code();
 }
 
+/// RememberAndSkipMetadata - Note where the METADATA_BLOCK at the current
+/// position is, so that materializeMetadata() can parse it, and skip it.  The
+/// records that define metadata values are counted on the way, so that the
+/// metadata of function bodies is still numbered right without them.  Blocks
+/// with METADATA_KIND records are parsed straight away, as function bodies
+/// need the kinds to read their attachments.
+std::error_code BitcodeReader::RememberAndSkipMetadata() {
+  uint64_t CurBit = Stream.GetCurrentBitNo();
+  if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+    return Error("Invalid record");
+
+  unsigned NumValues = 0;
+  bool HasKinds = false;
+  while (1) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return Error("Malformed block");
+    case BitstreamEntry::EndBlock: {
+      unsigned FirstMDValueNo = MDValueList.size();
+      if (HasKinds) {
+        Stream.JumpToBit(CurBit);
+        return ParseMetadata(FirstMDValueNo);
+      }
+      DeferredMetadataInfo.push_back(std::make_pair(CurBit, FirstMDValueNo));
+      // Reserve the IDs of the values, to be filled in by ParseMetadata().
+      MDValueList.resize(FirstMDValueNo + NumValues);
+      return std::error_code();
+    }
+    case BitstreamEntry::Record:
+      // The interesting case.
+      break;
+    }
+
+    switch (Stream.skipRecord(Entry.ID)) {
+    default: // METADATA_NAME, METADATA_NAMED_NODE and unknown records.
+      break;
+    case bitc::METADATA_OLD_FN_NODE:
+    case bitc::METADATA_OLD_NODE:
+    case bitc::METADATA_VALUE:
+    case bitc::METADATA_NODE:
+    case bitc::METADATA_DISTINCT_NODE:
+    case bitc::METADATA_LOCATION:
+    case bitc::METADATA_STRING:
+      ++NumValues;
+      break;
+    case bitc::METADATA_KIND:
+      HasKinds = true;
+      break;
+    }
+  }
+}
+
+/// ParseFunctionIndex - Read the FUNCTION_INDEX_BLOCK, which records where
+/// each function body is, and leave the stream just after it.  This saves
+/// stepping over the bodies one at a time to find them.
+std::error_code BitcodeReader::ParseFunctionIndex() {
+  if (!Stream.canSkipToPos(FunctionIndexBit / 8))
+    return Error("Malformed function index");
+  Stream.JumpToBit(FunctionIndexBit);
+  BitstreamEntry Entry = Stream.advance();
+  if (Entry.Kind != BitstreamEntry::SubBlock ||
+      Entry.ID != bitc::FUNCTION_INDEX_BLOCK_ID)
+    return Error("Malformed function index");
+  if (Stream.EnterSubBlock(bitc::FUNCTION_INDEX_BLOCK_ID))
+    return Error("Invalid record");
+
+  SmallVector<uint64_t, 2> Record;
+  unsigned NumEntries = 0;
+
+  // Read all the records for this index.
+  while (1) {
+    Entry = Stream.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return Error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      // Every body must be accounted for.
+      if (NumEntries != FunctionsWithBodies.size())
+        return Error("Malformed function index");
+      FunctionsWithBodies.clear();
+      return std::error_code();
+    case BitstreamEntry::Record:
+      // The interesting case.
+      break;
+    }
+
+    // Read a record.
+    Record.clear();
+    switch (Stream.readRecord(Entry.ID, Record)) {
+    default:  // Default behavior: unknown type.
+      break;
+    case bitc::FNINDEX_CODE_ENTRY: { // ENTRY: [valueid, bitoffset]
+      if (Record.size() < 2 || Record[0] >= ValueList.size())
+        return Error("Invalid record");
+      Function *F = dyn_cast_or_null<Function>(ValueList[Record[0]]);
+      if (!F || !F->isMaterializable() || DeferredFunctionInfo.count(F) ||
+          !Stream.canSkipToPos(Record[1] / 8))
+        return Error("Malformed function index");
+      DeferredFunctionInfo[F] = Record[1];
+      ++NumEntries;
+      break;
+    }
+    }
+  }
+}
+
 std::error_code BitcodeReader::GlobalCleanup() {
   // Patch the initializers for globals and aliases up.
   ResolveGlobalAndAliasInits();
@@ -2021,7 +2171,12 @@ std::error_code BitcodeReader::ParseModule(bool Resume) {
           return EC;
         break;
       case bitc::METADATA_BLOCK_ID:
-        if (std::error_code EC = ParseMetadata())
+        if (ShouldLazyLoadMetadata && !IsMetadataMaterialized) {
+          if (std::error_code EC = RememberAndSkipMetadata())
+            return EC;
+          break;
+        }
+        if (std::error_code EC = ParseMetadata(MDValueList.size()))
           return EC;
         break;
       case bitc::FUNCTION_BLOCK_ID:
@@ -2032,6 +2187,15 @@ std::error_code BitcodeReader::ParseModule(bool Resume) {
           if (std::error_code EC = GlobalCleanup())
             return EC;
           SeenFirstFunctionBody = true;
+
+          // If the module has a function index, learn where all the bodies
+          // are from it and continue after it.  Streamed bitcode can't jump
+          // ahead, so it keeps discovering bodies one at a time.
+          if (FunctionIndexBit && !LazyStreamer) {
+            if (std::error_code EC = ParseFunctionIndex())
+              return EC;
+            break;
+          }
         }
 
         if (std::error_code EC = RememberAndSkipFunctionBody())
@@ -2123,6 +2287,20 @@ std::error_code BitcodeReader::ParseModule(bool Resume) {
       GCTable.push_back(S);
       break;
     }
+    case bitc::MODULE_CODE_FNINDEXOFFSET: {
+      // FNINDEXOFFSET: [8 x byte] as a blob, read here byte by byte, or the
+      // older [lo, hi].
+      if (Record.size() == 8) {
+        FunctionIndexBit = 0;
+        for (unsigned i = 0; i != 8; ++i)
+          FunctionIndexBit |= Record[i] << (8 * i);
+      } else if (Record.size() == 2) {
+        FunctionIndexBit = Record[0] | (Record[1] << 32);
+      } else {
+        return Error("Invalid record");
+      }
+      break;
+    }
     case bitc::MODULE_CODE_COMDAT: { // COMDAT: [selection_kind, name]
       if (Record.size() < 2)
         return Error("Invalid record");
@@ -2321,8 +2499,10 @@ std::error_code BitcodeReader::ParseModule(bool Resume) {
   }
 }
 
-std::error_code BitcodeReader::ParseBitcodeInto(Module *M) {
+std::error_code BitcodeReader::ParseBitcodeInto(Module *M,
+                                                bool ShouldLazyLoadMetadata) {
   TheModule = nullptr;
+  this->ShouldLazyLoadMetadata = ShouldLazyLoadMetadata;
 
   if (std::error_code EC = InitStream())
     return EC;
@@ -2467,6 +2647,137 @@ ErrorOr<std::string> BitcodeReader::parseTriple() {
   }
 }
 
+ErrorOr<BitcodeSymbolTable> BitcodeReader::parseSymbolTableBlock() {
+  if (Stream.EnterSubBlock(bitc::SYMTAB_BLOCK_ID))
+    return Error("Invalid record");
+
+  BitcodeSymbolTable Table;
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return Error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return std::move(Table);
+    case BitstreamEntry::Record:
+      // The interesting case.
+      break;
+    }
+
+    Record.clear();
+    switch (Stream.readRecord(Entry.ID, Record)) {
+    default: break;  // Default behavior, ignore unknown content.
+    case bitc::SYMTAB_CODE_TRIPLE:  // TRIPLE: [strchr x N]
+      if (ConvertToString(Record, 0, Table.Triple))
+        return Error("Invalid record");
+      break;
+    case bitc::SYMTAB_CODE_DATALAYOUT:  // DATALAYOUT: [strchr x N]
+      if (ConvertToString(Record, 0, Table.DataLayout))
+        return Error("Invalid record");
+      break;
+    case bitc::SYMTAB_CODE_LINKER_OPTION: {  // LINKER_OPTION: [strchr x N]
+      std::string S;
+      if (ConvertToString(Record, 0, S))
+        return Error("Invalid record");
+      Table.LinkerOptions.push_back(std::move(S));
+      break;
+    }
+    case bitc::SYMTAB_CODE_ENTRY: {
+      // ENTRY: [kind, linkage, visibility, flags, alignment, commonsize,
+      //         namelen, comdatlen, strchr x N]
+      if (Record.size() < 8 || Record[0] > BitcodeSymbol::Alias ||
+          Record[4] > 32 || Record[6] > Record.size() - 8 ||
+          Record[7] > Record.size() - 8 - Record[6])
+        return Error("Invalid record");
+      BitcodeSymbol Sym;
+      Sym.Kind = BitcodeSymbol::SymbolKind(Record[0]);
+      Sym.Linkage = getDecodedLinkage(Record[1]);
+      Sym.Visibility = GetDecodedVisibility(Record[2]);
+      uint64_t Flags = Record[3];
+      Sym.IsUndefined = Flags & bitc::SYMTAB_FLAG_UNDEFINED;
+      Sym.IsConstant = Flags & bitc::SYMTAB_FLAG_CONSTANT;
+      Sym.HasUnnamedAddr = Flags & bitc::SYMTAB_FLAG_UNNAMED_ADDR;
+      Sym.HasFunctionType = Flags & bitc::SYMTAB_FLAG_FUNCTION_TYPE;
+      Sym.HasLLVMName = Flags & bitc::SYMTAB_FLAG_LLVM_NAME;
+      Sym.Alignment = (1ULL << Record[4]) >> 1;
+      Sym.CommonSize = Record[5];
+      ArrayRef<uint64_t> Chars = makeArrayRef(Record).slice(8);
+      ConvertToString(Chars.slice(0, Record[6]), 0, Sym.Name);
+      ConvertToString(Chars.slice(Record[6], Record[7]), 0, Sym.Comdat);
+      ConvertToString(Chars.slice(Record[6] + Record[7]), 0, Sym.Section);
+      Table.Symbols.push_back(std::move(Sym));
+      break;
+    }
+    }
+  }
+}
+
+ErrorOr<BitcodeSymbolTable> BitcodeReader::parseModuleSymbolTable() {
+  if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
+    return Error("Invalid record");
+
+  // The writer puts the symbol table before the other blocks of the module,
+  // so there is none if another block comes first.
+  while (1) {
+    BitstreamEntry Entry = Stream.advance();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return Error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return Error(BitcodeError::MissingSymbolTable);
+    case BitstreamEntry::SubBlock:
+      if (Entry.ID == bitc::SYMTAB_BLOCK_ID)
+        return parseSymbolTableBlock();
+      return Error(BitcodeError::MissingSymbolTable);
+    case BitstreamEntry::Record:
+      Stream.skipRecord(Entry.ID);
+      continue;
+    }
+  }
+}
+
+ErrorOr<BitcodeSymbolTable> BitcodeReader::parseSymbolTable() {
+  if (std::error_code EC = InitStream())
+    return EC;
+
+  // Sniff for the signature.
+  if (Stream.Read(8) != 'B' ||
+      Stream.Read(8) != 'C' ||
+      Stream.Read(4) != 0x0 ||
+      Stream.Read(4) != 0xC ||
+      Stream.Read(4) != 0xE ||
+      Stream.Read(4) != 0xD)
+    return Error("Invalid bitcode signature");
+
+  while (1) {
+    BitstreamEntry Entry = Stream.advance();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return Error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return Error(BitcodeError::MissingSymbolTable);
+
+    case BitstreamEntry::SubBlock:
+      if (Entry.ID == bitc::MODULE_BLOCK_ID)
+        return parseModuleSymbolTable();
+
+      // Ignore other sub-blocks.
+      if (Stream.SkipBlock())
+        return Error("Malformed block");
+      continue;
+
+    case BitstreamEntry::Record:
+      Stream.skipRecord(Entry.ID);
+      continue;
+    }
+  }
+}
+
 /// ParseMetadataAttachment - Parse metadata attachments.
 std::error_code BitcodeReader::ParseMetadataAttachment() {
   if (Stream.EnterSubBlock(bitc::METADATA_ATTACHMENT_ID))
@@ -2576,7 +2887,7 @@ std::error_code BitcodeReader::ParseFunctionBody(Function *F) {
           return EC;
         break;
       case bitc::METADATA_BLOCK_ID:
-        if (std::error_code EC = ParseMetadata())
+        if (std::error_code EC = ParseMetadata(MDValueList.size()))
           return EC;
         break;
       case bitc::USELIST_BLOCK_ID:
@@ -3476,6 +3787,148 @@ std::error_code BitcodeReader::FindFunctionInStream(
   return std::error_code();
 }
 
+//===----------------------------------------------------------------------===//
+// Function body staging
+//===----------------------------------------------------------------------===//
+
+void StagedFunctionBody::decode(BitstreamReader &Reader, uint64_t BitNo) {
+  BitstreamCursor Cursor(Reader);
+  Cursor.JumpToBit(BitNo);
+  Valid = decodeBlock(Cursor);
+  Ready = true;
+}
+
+bool StagedFunctionBody::decodeBlock(BitstreamCursor &Cursor) {
+  if (Cursor.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+    return false;
+
+  SmallVector<uint64_t, 64> Record;
+  unsigned Depth = 1;
+  while (Depth) {
+    BitstreamEntry Next = Cursor.advance();
+    Entry E;
+    E.Kind = Next.Kind;
+    E.ID = 0;
+    E.OpBegin = E.OpEnd = Ops.size();
+
+    switch (Next.Kind) {
+    case BitstreamEntry::Error:
+      return false;
+    case BitstreamEntry::EndBlock:
+      --Depth;
+      break;
+    case BitstreamEntry::SubBlock:
+      E.ID = Next.ID;
+      // Reading a BLOCKINFO block would change the BitstreamReader under the
+      // other threads' feet.  The parser skips them in function bodies anyway.
+      if (Next.ID == bitc::BLOCKINFO_BLOCK_ID) {
+        if (Cursor.SkipBlock())
+          return false;
+        Entries.push_back(E);
+        E.Kind = BitstreamEntry::EndBlock;
+        E.ID = 0;
+        break;
+      }
+      if (Cursor.EnterSubBlock(Next.ID))
+        return false;
+      ++Depth;
+      break;
+    case BitstreamEntry::Record:
+      Record.clear();
+      E.ID = Cursor.readRecord(Next.ID, Record);
+      Ops.insert(Ops.end(), Record.begin(), Record.end());
+      E.OpEnd = Ops.size();
+      break;
+    }
+    Entries.push_back(E);
+  }
+  return true;
+}
+
+BitstreamEntry BitcodeReaderCursor::advance(unsigned Flags) {
+  if (!Replay)
+    return BitstreamCursor::advance(Flags);
+  if (NextEntry == Replay->size())
+    return BitstreamEntry::getError();
+
+  // Records are consumed by readRecord().
+  const StagedFunctionBody::Entry &E = (*Replay)[NextEntry];
+  switch (E.Kind) {
+  case BitstreamEntry::Error:
+    break;
+  case BitstreamEntry::EndBlock:
+    ++NextEntry;
+    return BitstreamEntry::getEndBlock();
+  case BitstreamEntry::SubBlock:
+    ++NextEntry;
+    return BitstreamEntry::getSubBlock(E.ID);
+  case BitstreamEntry::Record:
+    return BitstreamEntry::getRecord(bitc::FIRST_APPLICATION_ABBREV);
+  }
+  return BitstreamEntry::getError();
+}
+
+BitstreamEntry BitcodeReaderCursor::advanceSkippingSubblocks(unsigned Flags) {
+  if (!Replay)
+    return BitstreamCursor::advanceSkippingSubblocks(Flags);
+  while (1) {
+    BitstreamEntry Entry = advance(Flags);
+    if (Entry.Kind != BitstreamEntry::SubBlock)
+      return Entry;
+    if (SkipBlock())
+      return BitstreamEntry::getError();
+  }
+}
+
+bool BitcodeReaderCursor::EnterSubBlock(unsigned BlockID,
+                                        unsigned *NumWordsP) {
+  if (!Replay)
+    return BitstreamCursor::EnterSubBlock(BlockID, NumWordsP);
+  if (NumWordsP)
+    *NumWordsP = 0;
+  return false;
+}
+
+bool BitcodeReaderCursor::SkipBlock() {
+  if (!Replay)
+    return BitstreamCursor::SkipBlock();
+  for (unsigned Depth = 1; Depth; ++NextEntry) {
+    if (NextEntry == Replay->size())
+      return true;
+    switch ((*Replay)[NextEntry].Kind) {
+    case BitstreamEntry::SubBlock:
+      ++Depth;
+      break;
+    case BitstreamEntry::EndBlock:
+      --Depth;
+      break;
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+unsigned BitcodeReaderCursor::ReadCode() {
+  if (!Replay)
+    return BitstreamCursor::ReadCode();
+  return bitc::FIRST_APPLICATION_ABBREV;
+}
+
+unsigned BitcodeReaderCursor::readRecord(unsigned AbbrevID,
+                                         SmallVectorImpl<uint64_t> &Vals,
+                                         StringRef *Blob) {
+  if (!Replay)
+    return BitstreamCursor::readRecord(AbbrevID, Vals, Blob);
+  // Without a record to read, return a code that no block uses.
+  if (NextEntry == Replay->size() ||
+      (*Replay)[NextEntry].Kind != BitstreamEntry::Record)
+    return ~0U;
+  const StagedFunctionBody::Entry &E = (*Replay)[NextEntry++];
+  Vals.append(Replay->op_begin(E), Replay->op_end(E));
+  return E.ID;
+}
+
 //===----------------------------------------------------------------------===//
 // GVMaterializer implementation
 //===----------------------------------------------------------------------===//
@@ -3499,8 +3952,31 @@ std::error_code BitcodeReader::materialize(GlobalValue *GV) {
   // Move the bit stream to the saved position of the deferred function body.
   Stream.JumpToBit(DFII->second);
 
-  if (std::error_code EC = ParseFunctionBody(F))
-    return EC;
+  // If the body has been queued for decoding, wait for it and read it from
+  // the decoded entries instead.  Should decoding have failed, parse it from
+  // the bitstream to report the error.
+  StagedFunctionBody *Staged = StagedBodies.lookup(F);
+  if (Staged) {
+    StagedBodies.erase(F);
+    StagingTasks->getPool().waitUntil([Staged] { return Staged->isReady(); });
+    if (Staged->isValid())
+      Stream.startReplay(Staged);
+  }
+
+  // Give the body its own arena so that its instructions are released in
+  // bulk with it.  The instructions keep the arena alive, not this pointer.
+  IntrusiveRefCntPtr<InstructionArena> Arena;
+  if (InstructionArena::isEnabled())
+    Arena = new InstructionArena();
+  {
+    InstructionArenaScope Scope(Arena.get());
+    std::error_code EC = ParseFunctionBody(F);
+    Stream.stopReplay();
+    if (Staged)
+      Staged->clear();
+    if (EC)
+      return EC;
+  }
   F->setIsMaterializable(false);
 
   // Upgrade any old intrinsic calls in the function.
@@ -3546,13 +4022,35 @@ void BitcodeReader::Dematerialize(GlobalValue *GV) {
   F->setIsMaterializable(true);
 }
 
+std::error_code BitcodeReader::materializeMetadata() {
+  for (const auto &Info : DeferredMetadataInfo) {
+    Stream.JumpToBit(Info.first);
+    if (std::error_code EC = ParseMetadata(Info.second))
+      return EC;
+  }
+  std::vector<std::pair<uint64_t, unsigned> >().swap(DeferredMetadataInfo);
+  IsMetadataMaterialized = true;
+  return std::error_code();
+}
+
 std::error_code BitcodeReader::MaterializeModule(Module *M) {
   assert(M == TheModule &&
          "Can only Materialize the Module this BitcodeReader is attached to.");
 
+  // Read the metadata first, so that the function bodies don't need
+  // placeholders for it.
+  if (std::error_code EC = materializeMetadata())
+    return EC;
+
   // Promise to materialize all forward references.
   WillMaterializeAllForwardRefs = true;
 
+  // Streamed bitcode has to be read in order, so it can't be decoded ahead.
+  if (ParallelFunctionBodies && !LazyStreamer &&
+      ThreadPool::getGlobal().getThreadCount() > 1)
+    if (std::error_code EC = materializeFunctionsInParallel())
+      return EC;
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Module::iterator F = TheModule->begin(), E = TheModule->end();
@@ -3597,10 +4095,223 @@ std::error_code BitcodeReader::MaterializeModule(Module *M) {
   return std::error_code();
 }
 
+/// materializeFunctionsInParallel - Materialize the remaining function bodies
+/// in module order, while the thread pool decodes the bitstream of the ones
+/// coming up next.  Only a bounded window of bodies is decoded ahead, to
+/// keep the memory held by decoded entries in check.
+std::error_code BitcodeReader::materializeFunctionsInParallel() {
+  std::vector<Function *> Bodies;
+  for (Function &F : *TheModule)
+    if (F.isMaterializable() && DeferredFunctionInfo.lookup(&F))
+      Bodies.push_back(&F);
+
+  std::unique_ptr<StagedFunctionBody[]> Staged(
+      new StagedFunctionBody[Bodies.size()]);
+  ThreadPool &Pool = ThreadPool::getGlobal();
+  const size_t Window = Pool.getThreadCount() * 4;
+  std::error_code EC;
+  {
+    TaskGroup Tasks(Pool);
+    StagingTasks = &Tasks;
+    BitstreamReader *Reader = StreamFile.get();
+    size_t NextToQueue = 0;
+    for (size_t I = 0, E = Bodies.size(); I != E && !EC; ++I) {
+      for (; NextToQueue != E && NextToQueue < I + Window; ++NextToQueue) {
+        // Blockaddress references may have pulled bodies in early.
+        Function *F = Bodies[NextToQueue];
+        if (!F->isMaterializable())
+          continue;
+        StagedFunctionBody *Body = &Staged[NextToQueue];
+        uint64_t BitNo = DeferredFunctionInfo[F];
+        StagedBodies[F] = Body;
+        Tasks.spawn([Body, Reader, BitNo] { Body->decode(*Reader, BitNo); });
+      }
+      EC = materialize(Bodies[I]);
+    }
+    // Wait for whatever is still being decoded after an error.
+  }
+  StagedBodies.clear();
+  StagingTasks = nullptr;
+  return EC;
+}
+
 std::vector<StructType *> BitcodeReader::getIdentifiedStructTypes() const {
   return IdentifiedStructTypes;
 }
 
+//===----------------------------------------------------------------------===//
+// Compressed bitcode
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// CompressedBitcode - The bytes of the bitcode file held in compressed
+/// bitcode, each chunk of which is uncompressed when it is first read.  The
+/// chunks may be read from several threads at once.
+class CompressedBitcode : public MemoryObject {
+  std::vector<unsigned char> Contents;
+  const unsigned char *Start;
+  BitcodeCompression Codec;
+  uint32_t ChunkSize;
+  uint32_t BitcodeSize;
+  std::vector<uint32_t> ChunkOffsets;
+
+  enum ChunkState : unsigned char { Compressed, Uncompressed, Corrupted };
+  std::unique_ptr<std::atomic<unsigned char>[]> States;
+  std::unique_ptr<unsigned char[]> Bytes;
+  sys::Mutex Lock;
+
+  CompressedBitcode() {}
+  bool uncompressChunks(uint64_t Begin, uint64_t End) const;
+
+public:
+  /// Return the bitcode file in the compressed bitcode [Start, End), or null
+  /// if its header is malformed.
+  static std::unique_ptr<CompressedBitcode> create(const unsigned char *Start,
+                                                   const unsigned char *End);
+  /// Like create(), but for compressed bitcode that the result owns.
+  static std::unique_ptr<CompressedBitcode>
+  create(std::vector<unsigned char> Contents);
+
+  uint64_t getExtent() const override { return BitcodeSize; }
+  uint64_t readBytes(uint8_t *Buf, uint64_t Size,
+                     uint64_t Address) const override;
+  const uint8_t *getPointer(uint64_t Address, uint64_t Size) const override;
+  bool isValidAddress(uint64_t Address) const override {
+    return Address < BitcodeSize;
+  }
+};
+}
+
+static uint32_t readLE32(const unsigned char *P) {
+  return P[0] | (P[1] << 8) | (P[2] << 16) | (uint32_t(P[3]) << 24);
+}
+
+std::unique_ptr<CompressedBitcode>
+CompressedBitcode::create(const unsigned char *Start,
+                          const unsigned char *End) {
+  uint64_t Size = End - Start;
+  if (Size < 4 * 4 || !isCompressedBitcode(Start, End))
+    return nullptr;
+
+  std::unique_ptr<CompressedBitcode> C(new CompressedBitcode());
+  C->Start = Start;
+  C->Codec = BitcodeCompression(readLE32(Start + 4));
+  C->ChunkSize = readLE32(Start + 8);
+  C->BitcodeSize = readLE32(Start + 12);
+  if ((C->Codec != BitcodeCompression::Zlib &&
+       C->Codec != BitcodeCompression::LZ77) ||
+      !C->ChunkSize || (C->BitcodeSize & 3))
+    return nullptr;
+
+  uint64_t NumChunks =
+      (uint64_t(C->BitcodeSize) + C->ChunkSize - 1) / C->ChunkSize;
+  if (4 * (4 + NumChunks + 1) > Size)
+    return nullptr;
+  C->ChunkOffsets.resize(NumChunks + 1);
+  for (uint64_t I = 0; I != NumChunks + 1; ++I) {
+    uint32_t Offset = readLE32(Start + 4 * (4 + I));
+    if (Offset > Size || (I && Offset < C->ChunkOffsets[I - 1]))
+      return nullptr;
+    C->ChunkOffsets[I] = Offset;
+  }
+
+  C->States.reset(new std::atomic<unsigned char>[NumChunks]);
+  for (uint64_t I = 0; I != NumChunks; ++I)
+    C->States[I] = Compressed;
+  // Pages that are never written to, for bodies that are never read, don't
+  // take up memory.
+  C->Bytes.reset(new unsigned char[C->BitcodeSize]);
+  return C;
+}
+
+std::unique_ptr<CompressedBitcode>
+CompressedBitcode::create(std::vector<unsigned char> Contents) {
+  const unsigned char *Start = Contents.data();
+  std::unique_ptr<CompressedBitcode> C =
+      create(Start, Start + Contents.size());
+  if (C)
+    C->Contents = std::move(Contents);
+  return C;
+}
+
+/// uncompressChunks - Make sure that the chunks holding the bytes [Begin, End)
+/// are uncompressed.  Returns false if one of them is corrupted; its bytes are
+/// read as zeros.
+bool CompressedBitcode::uncompressChunks(uint64_t Begin, uint64_t End) const {
+  auto *This = const_cast<CompressedBitcode *>(this);
+  bool Valid = true;
+  for (uint64_t I = Begin / ChunkSize, E = (End + ChunkSize - 1) / ChunkSize;
+       I < E; ++I) {
+    unsigned char State = States[I].load(std::memory_order_acquire);
+    if (State == Compressed) {
+      MutexGuard Guard(This->Lock);
+      State = States[I].load(std::memory_order_relaxed);
+      if (State == Compressed) {
+        uint64_t ChunkBegin = I * ChunkSize;
+        uint64_t Size = std::min<uint64_t>(ChunkSize, BitcodeSize - ChunkBegin);
+        StringRef Input((const char *)Start + ChunkOffsets[I],
+                        ChunkOffsets[I + 1] - ChunkOffsets[I]);
+        unsigned char *Out = This->Bytes.get() + ChunkBegin;
+        SmallVector<char, 0> Output;
+        if (Input.size() == Size) {
+          memcpy(Out, Input.data(), Size);
+          State = Uncompressed;
+        } else if (Codec == BitcodeCompression::Zlib
+                       ? zlib::uncompress(Input, Output, Size) ==
+                             zlib::StatusOK
+                       : lz77::uncompress(Input, Output, Size)) {
+          memcpy(Out, Output.data(), Size);
+          State = Uncompressed;
+        } else {
+          memset(Out, 0, Size);
+          State = Corrupted;
+        }
+        States[I].store(State, std::memory_order_release);
+      }
+    }
+    Valid &= State == Uncompressed;
+  }
+  return Valid;
+}
+
+uint64_t CompressedBitcode::readBytes(uint8_t *Buf, uint64_t Size,
+                                      uint64_t Address) const {
+  if (Address >= BitcodeSize)
+    return 0;
+  Size = std::min<uint64_t>(Size, BitcodeSize - Address);
+  if (!uncompressChunks(Address, Address + Size)) {
+    // Stop reading before the first corrupted chunk.
+    uint64_t I = Address / ChunkSize;
+    while (States[I] == Uncompressed)
+      ++I;
+    Size = std::max<uint64_t>(I * ChunkSize, Address) - Address;
+  }
+  memcpy(Buf, Bytes.get() + Address, Size);
+  return Size;
+}
+
+const uint8_t *CompressedBitcode::getPointer(uint64_t Address,
+                                             uint64_t Size) const {
+  uncompressChunks(Address, Address + Size);
+  return Bytes.get() + Address;
+}
+
+std::error_code llvm::uncompressBitcode(MemoryBufferRef Buffer,
+                                        SmallVectorImpl<char> &Out) {
+  const unsigned char *Start =
+      (const unsigned char *)Buffer.getBufferStart();
+  std::unique_ptr<CompressedBitcode> C =
+      CompressedBitcode::create(Start, Start + Buffer.getBufferSize());
+  if (!C)
+    return make_error_code(BitcodeError::InvalidBitcodeSignature);
+  size_t OldSize = Out.size();
+  Out.resize(OldSize + C->getExtent());
+  if (C->readBytes((uint8_t *)Out.data() + OldSize, C->getExtent(), 0) !=
+      C->getExtent())
+    return make_error_code(BitcodeError::CorruptedBitcode);
+  return std::error_code();
+}
+
 std::error_code BitcodeReader::InitStream() {
   if (LazyStreamer)
     return InitLazyStream();
@@ -3614,6 +4325,16 @@ std::error_code BitcodeReader::InitStreamFromBuffer() {
   if (Buffer->getBufferSize() & 3)
     return Error("Invalid bitcode signature");
 
+  if (isCompressedBitcode(BufPtr, BufEnd)) {
+    std::unique_ptr<CompressedBitcode> Bytes =
+        CompressedBitcode::create(BufPtr, BufEnd);
+    if (!Bytes)
+      return Error("Invalid compressed bitcode header");
+    StreamFile.reset(new BitstreamReader(std::move(Bytes)));
+    Stream.init(&*StreamFile);
+    return std::error_code();
+  }
+
   // If we have a wrapper header, parse it and ignore the non-bc file contents.
   // The magic number is 0x0B17C0DE stored in little endian.
   if (isBitcodeWrapper(BufPtr, BufEnd))
@@ -3641,6 +4362,28 @@ std::error_code BitcodeReader::InitLazyStream() {
   if (!isBitcode(buf, buf + 16))
     return Error("Invalid bitcode signature");
 
+  if (isCompressedBitcode(buf, buf + 16)) {
+    // The chunks are only uncompressed as they are read, but the compressed
+    // bitcode has to be all there to be able to find them.
+    std::vector<unsigned char> Contents;
+    const uint64_t ReadSize = 64 * 1024;
+    uint64_t Read;
+    do {
+      uint64_t Size = Contents.size();
+      Contents.resize(Size + ReadSize);
+      Read = Bytes.readBytes(&Contents[Size], ReadSize, Size);
+      Contents.resize(Size + Read);
+    } while (Read == ReadSize);
+
+    std::unique_ptr<CompressedBitcode> Uncompressed =
+        CompressedBitcode::create(std::move(Contents));
+    if (!Uncompressed)
+      return Error("Invalid compressed bitcode header");
+    StreamFile = llvm::make_unique<BitstreamReader>(std::move(Uncompressed));
+    Stream.init(&*StreamFile);
+    return std::error_code();
+  }
+
   if (isBitcodeWrapper(buf, buf + 4)) {
     const unsigned char *bitcodeStart = buf;
     const unsigned char *bitcodeEnd = buf + 16;
@@ -3663,6 +4406,8 @@ class BitcodeErrorCategoryType : public std::error_category {
       return "Invalid bitcode signature";
     case BitcodeError::CorruptedBitcode:
       return "Corrupted bitcode";
+    case BitcodeError::MissingSymbolTable:
+      return "Missing symbol table";
     }
     llvm_unreachable("Unknown error type!");
   }
@@ -3687,10 +4432,13 @@ const std::error_category &llvm::BitcodeErrorCategory() {
 ///
 /// \param[in] WillMaterializeAll Set to \c true if the caller promises to
 /// materialize everything -- in particular, if this isn't truly lazy.
+/// \param[in] ShouldLazyLoadMetadata Set to \c true to leave the module-level
+/// metadata to \a Module::materializeMetadata().
 static ErrorOr<Module *>
 getLazyBitcodeModuleImpl(std::unique_ptr<MemoryBuffer> &&Buffer,
                          LLVMContext &Context, bool WillMaterializeAll,
-                         DiagnosticHandlerFunction DiagnosticHandler) {
+                         DiagnosticHandlerFunction DiagnosticHandler,
+                         bool ShouldLazyLoadMetadata = false) {
   Module *M = new Module(Buffer->getBufferIdentifier(), Context);
   BitcodeReader *R =
       new BitcodeReader(Buffer.get(), Context, DiagnosticHandler);
@@ -3702,7 +4450,7 @@ getLazyBitcodeModuleImpl(std::unique_ptr<MemoryBuffer> &&Buffer,
     return EC;
   };
 
-  if (std::error_code EC = R->ParseBitcodeInto(M))
+  if (std::error_code EC = R->ParseBitcodeInto(M, ShouldLazyLoadMetadata))
     return cleanupOnError(EC);
 
   if (!WillMaterializeAll)
@@ -3717,9 +4465,10 @@ getLazyBitcodeModuleImpl(std::unique_ptr<MemoryBuffer> &&Buffer,
 ErrorOr<Module *>
 llvm::getLazyBitcodeModule(std::unique_ptr<MemoryBuffer> &&Buffer,
                            LLVMContext &Context,
-                           DiagnosticHandlerFunction DiagnosticHandler) {
+                           DiagnosticHandlerFunction DiagnosticHandler,
+                           bool ShouldLazyLoadMetadata) {
   return getLazyBitcodeModuleImpl(std::move(Buffer), Context, false,
-                                  DiagnosticHandler);
+                                  DiagnosticHandler, ShouldLazyLoadMetadata);
 }
 
 ErrorOr<std::unique_ptr<Module>>
@@ -3755,6 +4504,14 @@ llvm::parseBitcodeFile(MemoryBufferRef Buffer, LLVMContext &Context,
   return M;
 }
 
+ErrorOr<BitcodeSymbolTable>
+llvm::readBitcodeSymbolTable(MemoryBufferRef Buffer, LLVMContext &Context) {
+  std::unique_ptr<MemoryBuffer> Buf = MemoryBuffer::getMemBuffer(Buffer, false);
+  auto R = llvm::make_unique<BitcodeReader>(Buf.release(), Context,
+                                            [](const DiagnosticInfo &) {});
+  return R->parseSymbolTable();
+}
+
 std::string
 llvm::getBitcodeTargetTriple(MemoryBufferRef Buffer, LLVMContext &Context,
                              DiagnosticHandlerFunction DiagnosticHandler) {
@@ -24,6 +24,7 @@
 #include "llvm/IR/TrackingMDRef.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/ValueHandle.h"
+#include <atomic>
 #include <deque>
 #include <system_error>
 #include <vector>
@@ -32,6 +33,7 @@ namespace llvm {
   class Comdat;
   class MemoryBuffer;
   class LLVMContext;
+  class TaskGroup;
 
 //===----------------------------------------------------------------------===//
 //                          BitcodeReaderValueList Class
@@ -130,6 +132,99 @@ public:
   Metadata *getValueFwdRef(unsigned Idx);
   void AssignValue(Metadata *MD, unsigned Idx);
   void tryToResolveCycles();
+  void dropForwardRefs();
+};
+
+//===----------------------------------------------------------------------===//
+//                          StagedFunctionBody Class
+//===----------------------------------------------------------------------===//
+
+/// StagedFunctionBody - The entries of a FUNCTION_BLOCK and its sub-blocks,
+/// decoded from the bitstream ahead of time.  Decoding only reads the
+/// BitstreamReader, so the bodies of a module can be decoded on several
+/// threads at once; building the IR from them touches the LLVMContext and
+/// the use lists of globals and constants, so that is left to the reader's
+/// own thread.
+class StagedFunctionBody {
+public:
+  struct Entry {
+    decltype(BitstreamEntry::Kind) Kind;
+    /// The block ID of a SubBlock, or the code of a Record.
+    unsigned ID;
+    /// The operands of a Record are Ops[OpBegin, OpEnd).
+    unsigned OpBegin, OpEnd;
+  };
+
+private:
+  std::vector<Entry> Entries;
+  std::vector<uint64_t> Ops;
+  std::atomic<bool> Ready;
+  bool Valid;
+
+  StagedFunctionBody(const StagedFunctionBody &) LLVM_DELETED_FUNCTION;
+  void operator=(const StagedFunctionBody &) LLVM_DELETED_FUNCTION;
+
+  bool decodeBlock(BitstreamCursor &Cursor);
+
+public:
+  StagedFunctionBody() : Ready(false), Valid(false) {}
+
+  /// decode - Decode the function block whose ENTER_SUBBLOCK abbrev ID and
+  /// block ID end at bit \p BitNo of \p Reader.  This may run concurrently
+  /// with other cursors reading \p Reader, as long as none of them reads a
+  /// BLOCKINFO block.
+  void decode(BitstreamReader &Reader, uint64_t BitNo);
+
+  /// isReady - Return true once decode() has finished.
+  bool isReady() const { return Ready; }
+
+  /// isValid - Return true if the block was decoded successfully.  If not,
+  /// it should be parsed from the bitstream to diagnose the problem.
+  bool isValid() const { return Valid; }
+
+  /// clear - Release the decoded entries.
+  void clear() {
+    std::vector<Entry>().swap(Entries);
+    std::vector<uint64_t>().swap(Ops);
+  }
+
+  size_t size() const { return Entries.size(); }
+  const Entry &operator[](size_t I) const { return Entries[I]; }
+  const uint64_t *op_begin(const Entry &E) const {
+    return Ops.data() + E.OpBegin;
+  }
+  const uint64_t *op_end(const Entry &E) const {
+    return Ops.data() + E.OpEnd;
+  }
+};
+
+/// BitcodeReaderCursor - A BitstreamCursor that can instead return the
+/// entries of a StagedFunctionBody, so that the parsing code doesn't have to
+/// care where a function body comes from.  While replaying, EnterSubBlock()
+/// has nothing left to do since advance() already consumed the SubBlock
+/// entry, and the body's outer block counts as entered from the start.
+class BitcodeReaderCursor : public BitstreamCursor {
+  const StagedFunctionBody *Replay;
+  size_t NextEntry;
+
+public:
+  BitcodeReaderCursor() : Replay(nullptr), NextEntry(0) {}
+
+  /// startReplay - Read the entries of \p Body instead of the bitstream until
+  /// stopReplay() is called.
+  void startReplay(const StagedFunctionBody *Body) {
+    Replay = Body;
+    NextEntry = 0;
+  }
+  void stopReplay() { Replay = nullptr; }
+
+  BitstreamEntry advance(unsigned Flags = 0);
+  BitstreamEntry advanceSkippingSubblocks(unsigned Flags = 0);
+  bool EnterSubBlock(unsigned BlockID, unsigned *NumWordsP = nullptr);
+  bool SkipBlock();
+  unsigned ReadCode();
+  unsigned readRecord(unsigned AbbrevID, SmallVectorImpl<uint64_t> &Vals,
+                      StringRef *Blob = nullptr);
 };
 
 class BitcodeReader : public GVMaterializer {
@@ -138,11 +233,15 @@ class BitcodeReader : public GVMaterializer {
   Module *TheModule;
   std::unique_ptr<MemoryBuffer> Buffer;
   std::unique_ptr<BitstreamReader> StreamFile;
-  BitstreamCursor Stream;
+  BitcodeReaderCursor Stream;
   DataStreamer *LazyStreamer;
   uint64_t NextUnreadBit;
   bool SeenValueSymbolTable;
 
+  /// FunctionIndexBit - The position of the FUNCTION_INDEX_BLOCK given by a
+  /// FNINDEXOFFSET record, or 0 if the module has none.
+  uint64_t FunctionIndexBit;
+
   std::vector<Type*> TypeList;
   BitcodeReaderValueList ValueList;
   BitcodeReaderMDValueList MDValueList;
@@ -185,11 +284,29 @@ class BitcodeReader : public GVMaterializer {
   // we've done this yet.
   bool SeenFirstFunctionBody;
 
+  /// ShouldLazyLoadMetadata - Whether module-level METADATA_BLOCKs are left
+  /// for materializeMetadata() to parse.
+  bool ShouldLazyLoadMetadata;
+
+  /// IsMetadataMaterialized - Set once materializeMetadata() has run, after
+  /// which metadata blocks are parsed as soon as they are seen.
+  bool IsMetadataMaterialized;
+
+  /// DeferredMetadataInfo - The module-level METADATA_BLOCKs that have been
+  /// skipped: where they start in the stream, and the ID of the first
+  /// metadata value they define.
+  std::vector<std::pair<uint64_t, unsigned> > DeferredMetadataInfo;
+
   /// DeferredFunctionInfo - When function bodies are initially scanned, this
   /// map contains info about where to find deferred function body in the
   /// stream.
   DenseMap<Function*, uint64_t> DeferredFunctionInfo;
 
+  /// StagedBodies - While materializeFunctionsInParallel() runs, the function
+  /// bodies that have been queued for decoding on StagingTasks.
+  DenseMap<Function *, StagedFunctionBody *> StagedBodies;
+  TaskGroup *StagingTasks;
+
   /// These are basic blocks forward-referenced by block addresses.  They are
   /// inserted lazily into functions when they're loaded.  The basic block ID is
   /// its index into the vector.
@@ -232,17 +349,22 @@ public:
   bool isDematerializable(const GlobalValue *GV) const override;
   std::error_code materialize(GlobalValue *GV) override;
   std::error_code MaterializeModule(Module *M) override;
+  std::error_code materializeMetadata() override;
   std::vector<StructType *> getIdentifiedStructTypes() const override;
   void Dematerialize(GlobalValue *GV) override;
 
   /// @brief Main interface to parsing a bitcode buffer.
   /// @returns true if an error occurred.
-  std::error_code ParseBitcodeInto(Module *M);
+  std::error_code ParseBitcodeInto(Module *M,
+                                   bool ShouldLazyLoadMetadata = false);
 
   /// @brief Cheap mechanism to just extract module triple
   /// @returns true if an error occurred.
   ErrorOr<std::string> parseTriple();
 
+  /// @brief Cheap mechanism to just read the symbol table of the module.
+  ErrorOr<BitcodeSymbolTable> parseSymbolTable();
+
   static uint64_t decodeSignRotatedValue(uint64_t V);
 
 private:
@@ -345,12 +467,17 @@ private:
   std::error_code ParseValueSymbolTable();
   std::error_code ParseConstants();
   std::error_code RememberAndSkipFunctionBody();
+  std::error_code RememberAndSkipMetadata();
+  std::error_code ParseFunctionIndex();
   std::error_code ParseFunctionBody(Function *F);
+  std::error_code materializeFunctionsInParallel();
   std::error_code GlobalCleanup();
   std::error_code ResolveGlobalAndAliasInits();
-  std::error_code ParseMetadata();
+  std::error_code ParseMetadata(unsigned NextMDValueNo);
   std::error_code ParseMetadataAttachment();
   ErrorOr<std::string> parseModuleTriple();
+  ErrorOr<BitcodeSymbolTable> parseModuleSymbolTable();
+  ErrorOr<BitcodeSymbolTable> parseSymbolTableBlock();
   std::error_code ParseUseLists();
   std::error_code InitStream();
   std::error_code InitStreamFromBuffer();
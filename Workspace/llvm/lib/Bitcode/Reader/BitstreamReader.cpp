@@ -92,21 +92,29 @@ static void skipAbbreviatedField(BitstreamCursor &Cursor,
 
 
 
-/// skipRecord - Read the current record and discard it.
-void BitstreamCursor::skipRecord(unsigned AbbrevID) {
+/// skipRecord - Read the current record and discard it, returning its code.
+unsigned BitstreamCursor::skipRecord(unsigned AbbrevID) {
   // Skip unabbreviated records by reading past their entries.
   if (AbbrevID == bitc::UNABBREV_RECORD) {
     unsigned Code = ReadVBR(6);
-    (void)Code;
     unsigned NumElts = ReadVBR(6);
     for (unsigned i = 0; i != NumElts; ++i)
       (void)ReadVBR64(6);
-    return;
+    return Code;
   }
 
   const BitCodeAbbrev *Abbv = getAbbrev(AbbrevID);
 
-  for (unsigned i = 0, e = Abbv->getNumOperandInfos(); i != e; ++i) {
+  // Read the record code first.
+  assert(Abbv->getNumOperandInfos() != 0 && "no record code in abbreviation?");
+  const BitCodeAbbrevOp &CodeOp = Abbv->getOperandInfo(0);
+  unsigned Code;
+  if (CodeOp.isLiteral())
+    Code = CodeOp.getLiteralValue();
+  else
+    Code = readAbbreviatedField(*this, CodeOp);
+
+  for (unsigned i = 1, e = Abbv->getNumOperandInfos(); i != e; ++i) {
     const BitCodeAbbrevOp &Op = Abbv->getOperandInfo(i);
     if (Op.isLiteral())
       continue;
@@ -149,6 +157,7 @@ void BitstreamCursor::skipRecord(unsigned AbbrevID) {
     // Skip over the blob.
     JumpToBit(NewEnd);
   }
+  return Code;
 }
 
 unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
@@ -217,17 +226,17 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
       break;
     }
 
-    // Otherwise, inform the streamer that we need these bytes in memory.
-    const char *Ptr = (const char*)
-      BitStream->getBitcodeBytes().getPointer(CurBitPos/8, NumElts);
-
-    // If we can return a reference to the data, do so to avoid copying it.
     if (Blob) {
+      // Return a reference to the data to avoid copying it.  Inform the
+      // streamer that we need these bytes in memory.
+      const char *Ptr = (const char*)
+        BitStream->getBitcodeBytes().getPointer(CurBitPos/8, NumElts);
       *Blob = StringRef(Ptr, NumElts);
     } else {
-      // Otherwise, unpack into Vals with zero extension.
+      // Otherwise, unpack into Vals with zero extension.  This works with
+      // streamers that can't hand out pointers, too.
       for (; NumElts; --NumElts)
-        Vals.push_back((unsigned char)*Ptr++);
+        Vals.push_back(Read(8));
     }
     // Skip over tail padding.
     JumpToBit(NewEnd);
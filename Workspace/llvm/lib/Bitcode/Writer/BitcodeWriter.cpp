@@ -13,6 +13,7 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "ValueEnumerator.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Bitcode/BitstreamWriter.h"
 #include "llvm/Bitcode/LLVMBitCodes.h"
@@ -20,11 +21,13 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/UseListOrder.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
@@ -58,6 +61,35 @@ enum {
   FUNCTION_INST_UNREACHABLE_ABBREV
 };
 
+static cl::opt<bool>
+AutoAbbrev("bitcode-auto-abbrev", cl::init(false),
+           cl::desc("Add abbreviations for the records of each module that "
+                    "would otherwise be written unabbreviated (writes the "
+                    "module twice)"));
+
+static cl::opt<unsigned>
+FlushThresholdKB("bitcode-flush-threshold", cl::init(1024), cl::Hidden,
+                 cl::desc("Move bitcode on to seekable output streams in "
+                          "pieces of this many KB (0 to buffer it all)"));
+
+static cl::opt<bool>
+SymbolTable("bitcode-symbol-table", cl::init(true), cl::Hidden,
+            cl::desc("Write a symbol table that linkers can read without "
+                     "reading the module"));
+
+static cl::opt<BitcodeCompression> Compression(
+    "bitcode-compression", cl::init(BitcodeCompression::None),
+    cl::desc("Write bitcode in independently compressed chunks"),
+    cl::values(clEnumValN(BitcodeCompression::None, "none", "Don't compress"),
+               clEnumValN(BitcodeCompression::Zlib, "zlib", "Use zlib"),
+               clEnumValN(BitcodeCompression::LZ77, "lz77",
+                          "Use a codec that decompresses faster than zlib"),
+               clEnumValEnd));
+
+static cl::opt<unsigned>
+CompressionChunkKB("bitcode-compression-chunk-size", cl::init(64), cl::Hidden,
+                   cl::desc("Compress bitcode in chunks of this many KB"));
+
 static unsigned GetEncodedCastOpcode(unsigned Opcode) {
   switch (Opcode) {
   default: llvm_unreachable("Unknown cast instruction!");
@@ -1772,8 +1804,240 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
   Stream.ExitBlock();
 }
 
-// Emit blockinfo, which defines the standard abbreviations etc.
-static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
+void BitstreamRecordObserver::anchor() {}
+
+namespace {
+/// RecordProfile - Collects the shape of the records that a module writes
+/// without an abbreviation, and picks abbreviations for the record codes
+/// where they would make the bitcode smaller.
+class RecordProfile : public BitstreamRecordObserver {
+  /// Records with more operands than this are abbreviated with an array.
+  enum { MaxScalarOps = 16 };
+
+  /// FieldStats - The values seen in one operand position.
+  struct FieldStats {
+    uint64_t NumValues;
+    uint64_t NumWithWidth[65]; // Number of values with each active width.
+    uint64_t FirstValue;
+    bool AllSame, AllChar6;
+
+    FieldStats() : NumValues(0), FirstValue(0), AllSame(true), AllChar6(true) {
+      std::fill(std::begin(NumWithWidth), std::end(NumWithWidth), 0);
+    }
+
+    void add(uint64_t V) {
+      if (NumValues++ == 0)
+        FirstValue = V;
+      AllSame &= V == FirstValue;
+      AllChar6 &= V < 128 && BitCodeAbbrevOp::isChar6((char)V);
+      ++NumWithWidth[V ? 64 - countLeadingZeros(V) : 0];
+    }
+
+    /// getBestEncoding - Set \p Op to the cheapest encoding of these values
+    /// and return the number of bits it takes.  Literals are only allowed if
+    /// \p AllowLiteral.
+    uint64_t getBestEncoding(BitCodeAbbrevOp &Op, bool AllowLiteral) const {
+      if (AllowLiteral && AllSame) {
+        Op = BitCodeAbbrevOp(FirstValue);
+        return 0;
+      }
+      unsigned MaxWidth = 64;
+      while (MaxWidth && !NumWithWidth[MaxWidth])
+        --MaxWidth;
+
+      uint64_t Best = ~0ULL;
+      if (MaxWidth && MaxWidth <= 32) {
+        Op = BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, MaxWidth);
+        Best = NumValues * MaxWidth;
+      }
+      if (AllChar6 && NumValues * 6 < Best) {
+        Op = BitCodeAbbrevOp(BitCodeAbbrevOp::Char6);
+        Best = NumValues * 6;
+      }
+      for (unsigned ChunkWidth = 2; ChunkWidth <= 32; ++ChunkWidth) {
+        uint64_t Bits = 0;
+        for (unsigned W = 0; W <= MaxWidth; ++W)
+          Bits += NumWithWidth[W] * getVBRSize(W, ChunkWidth);
+        if (Bits < Best) {
+          Op = BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, ChunkWidth);
+          Best = Bits;
+        }
+      }
+      return Best;
+    }
+  };
+
+  /// CodeStats - The records seen with one code in one block ID.
+  struct CodeStats {
+    uint64_t NumRecords;
+    uint64_t UnabbrevBits;  // Size of the records apart from the abbrev ID.
+    uint64_t ArraySizeBits; // Size of the array lengths if all are arrays.
+    unsigned MinOps, MaxOps;
+    std::vector<FieldStats> Fields; // Per operand, up to MaxScalarOps.
+    FieldStats AllOps;
+
+    CodeStats()
+      : NumRecords(0), UnabbrevBits(0), ArraySizeBits(0), MinOps(~0U),
+        MaxOps(0) {}
+  };
+
+  struct BlockStats {
+    unsigned CodeLen, MaxNumAbbrevs;
+    std::map<unsigned, CodeStats> Codes;
+    BlockStats() : CodeLen(~0U), MaxNumAbbrevs(0) {}
+  };
+
+  std::map<unsigned, BlockStats> Blocks;
+
+  /// getVBRSize - Return the size of a \p Width bit value as a VBR with
+  /// \p ChunkWidth bit chunks.
+  static unsigned getVBRSize(unsigned Width, unsigned ChunkWidth) {
+    unsigned NumChunks = (Width + ChunkWidth - 2) / (ChunkWidth - 1);
+    return std::max(NumChunks, 1U) * ChunkWidth;
+  }
+  static unsigned getVBRSize(uint64_t V) {
+    return getVBRSize(V ? 64 - countLeadingZeros(V) : 0, 6);
+  }
+
+  /// getDefinitionSize - Return roughly how many bits the DEFINE_ABBREV
+  /// record for \p Abbv takes in the BLOCKINFO block.
+  static uint64_t getDefinitionSize(const BitCodeAbbrev &Abbv) {
+    uint64_t Bits = 2 + 5; // Abbrev ID and number of operands.
+    for (unsigned i = 0, e = Abbv.getNumOperandInfos(); i != e; ++i) {
+      const BitCodeAbbrevOp &Op = Abbv.getOperandInfo(i);
+      if (Op.isLiteral())
+        Bits += 1 + getVBRSize(64 - countLeadingZeros(Op.getLiteralValue()),
+                               8);
+      else
+        Bits += 1 + 3 + (Op.hasEncodingData() ? 5 : 0);
+    }
+    return Bits;
+  }
+
+  /// getBestAbbrev - Return an abbreviation for the records \p CS and the
+  /// number of bits it saves, or null if it doesn't save any.
+  static IntrusiveRefCntPtr<BitCodeAbbrev>
+  getBestAbbrev(unsigned Code, const CodeStats &CS, uint64_t &Savings) {
+    IntrusiveRefCntPtr<BitCodeAbbrev> Best;
+    uint64_t BestBits = CS.UnabbrevBits;
+
+    // All records have the same number of operands, each with an encoding.
+    if (CS.MinOps == CS.MaxOps && CS.MaxOps <= MaxScalarOps) {
+      IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
+      Abbv->Add(BitCodeAbbrevOp(Code));
+      uint64_t Bits = 0;
+      for (const FieldStats &F : CS.Fields) {
+        BitCodeAbbrevOp Op(0);
+        Bits += F.getBestEncoding(Op, true);
+        Abbv->Add(Op);
+      }
+      Bits += getDefinitionSize(*Abbv);
+      if (Bits < BestBits) {
+        Best = Abbv;
+        BestBits = Bits;
+      }
+    }
+
+    // The operands as an array with a single element encoding.
+    if (CS.AllOps.NumValues) {
+      IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
+      Abbv->Add(BitCodeAbbrevOp(Code));
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+      BitCodeAbbrevOp Op(0);
+      uint64_t Bits = CS.ArraySizeBits + CS.AllOps.getBestEncoding(Op, false);
+      Abbv->Add(Op);
+      Bits += getDefinitionSize(*Abbv);
+      if (Bits < BestBits) {
+        Best = Abbv;
+        BestBits = Bits;
+      }
+    }
+
+    Savings = CS.UnabbrevBits - BestBits;
+    return Best;
+  }
+
+public:
+  void observeRecord(unsigned BlockID, unsigned Code,
+                     ArrayRef<uint64_t> Vals) override {
+    // The module block is not entered again, so abbreviations in BLOCKINFO
+    // would not reach it.
+    if (BlockID == bitc::MODULE_BLOCK_ID || BlockID == bitc::BLOCKINFO_BLOCK_ID)
+      return;
+
+    CodeStats &CS = Blocks[BlockID].Codes[Code];
+    ++CS.NumRecords;
+    CS.MinOps = std::min(CS.MinOps, (unsigned)Vals.size());
+    CS.MaxOps = std::max(CS.MaxOps, (unsigned)Vals.size());
+    CS.UnabbrevBits += getVBRSize(Code) + getVBRSize(Vals.size());
+    CS.ArraySizeBits += getVBRSize(Vals.size());
+    if (Vals.size() <= MaxScalarOps && CS.Fields.size() < Vals.size())
+      CS.Fields.resize(Vals.size());
+    for (unsigned i = 0, e = Vals.size(); i != e; ++i) {
+      CS.UnabbrevBits += getVBRSize(Vals[i]);
+      if (i < CS.Fields.size())
+        CS.Fields[i].add(Vals[i]);
+      CS.AllOps.add(Vals[i]);
+    }
+  }
+
+  void observeBlock(unsigned BlockID, unsigned CodeLen,
+                    unsigned NumAbbrevs) override {
+    BlockStats &B = Blocks[BlockID];
+    B.CodeLen = std::min(B.CodeLen, CodeLen);
+    B.MaxNumAbbrevs = std::max(B.MaxNumAbbrevs, NumAbbrevs);
+  }
+
+  /// emitAbbrevs - Add the chosen abbreviations to the BLOCKINFO block
+  /// being written to \p Stream, and make them the default for their record
+  /// codes.
+  void emitAbbrevs(BitstreamWriter &Stream) const {
+    for (const auto &BI : Blocks) {
+      const BlockStats &B = BI.second;
+      if (B.CodeLen >= 32)
+        continue;
+      // Every instance of the block must still be able to number its own
+      // abbreviations with the abbrev ID width it uses.
+      uint64_t NumIDs = 1ULL << B.CodeLen;
+      uint64_t NumUsed = bitc::FIRST_APPLICATION_ABBREV + B.MaxNumAbbrevs;
+      if (NumUsed >= NumIDs)
+        continue;
+
+      // Take the abbreviations that save the most first.
+      struct Candidate {
+        uint64_t Savings;
+        unsigned Code;
+        IntrusiveRefCntPtr<BitCodeAbbrev> Abbv;
+      };
+      std::vector<Candidate> Candidates;
+      for (const auto &CI : B.Codes) {
+        Candidate C;
+        C.Code = CI.first;
+        C.Abbv = getBestAbbrev(CI.first, CI.second, C.Savings);
+        if (C.Abbv)
+          Candidates.push_back(C);
+      }
+      std::stable_sort(Candidates.begin(), Candidates.end(),
+                       [](const Candidate &L, const Candidate &R) {
+        return L.Savings > R.Savings;
+      });
+
+      Candidates.resize(std::min<uint64_t>(Candidates.size(),
+                                           NumIDs - NumUsed));
+      for (unsigned i = 0, e = Candidates.size(); i != e; ++i) {
+        unsigned AbbrevID =
+            Stream.EmitBlockInfoAbbrev(BI.first, Candidates[i].Abbv.get());
+        Stream.SetDefaultAbbrev(BI.first, Candidates[i].Code, AbbrevID);
+      }
+    }
+  }
+};
+}
+
+// Emit blockinfo, which defines the standard abbreviations etc.  If \p Profile
+// is given, also add the abbreviations it picked.
+static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream,
+                           const RecordProfile *Profile) {
   // We only want to emit block info records for blocks that have multiple
   // instances: CONSTANTS_BLOCK, FUNCTION_BLOCK and VALUE_SYMTAB_BLOCK.
   // Other blocks can define their abbrevs inline.
@@ -1930,11 +2194,174 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
       llvm_unreachable("Unexpected abbrev ordering!");
   }
 
+  // These come after the standard abbreviations to keep their IDs fixed.
+  if (Profile)
+    Profile->emitAbbrevs(Stream);
+
+  Stream.ExitBlock();
+}
+
+/// WriteFunctionIndexOffsetPlaceholder - Emit a FNINDEXOFFSET record whose
+/// 8-byte blob is filled in by WriteFunctionIndex once the function bodies
+/// have been written.  Blobs are word aligned, so the placeholder can still be
+/// patched after it has been moved on to the output file.  Return the bit
+/// position of the blob.
+static uint64_t WriteFunctionIndexOffsetPlaceholder(BitstreamWriter &Stream) {
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::MODULE_CODE_FNINDEXOFFSET));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+  unsigned AbbrevToUse = Stream.EmitAbbrev(Abbv);
+
+  static const char Zeros[8] = {};
+  SmallVector<uint64_t, 1> Vals;
+  Vals.push_back(bitc::MODULE_CODE_FNINDEXOFFSET);
+  Stream.EmitRecordWithBlob(AbbrevToUse, Vals, StringRef(Zeros, 8));
+  return Stream.GetCurrentBitNo() - 64;
+}
+
+/// WriteFunctionIndex - Emit the position of every function body in the
+/// module, and patch the FNINDEXOFFSET record at \p PlaceholderBit to point
+/// at the index.  Positions are relative to \p BitcodeStartBit.
+static void
+WriteFunctionIndex(ArrayRef<std::pair<unsigned, uint64_t> > Index,
+                   uint64_t PlaceholderBit, uint64_t BitcodeStartBit,
+                   BitstreamWriter &Stream) {
+  uint64_t IndexBit = Stream.GetCurrentBitNo() - BitcodeStartBit;
+  Stream.EnterSubblock(bitc::FUNCTION_INDEX_BLOCK_ID, 3);
+
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::FNINDEX_CODE_ENTRY));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8));
+  unsigned EntryAbbrev = Stream.EmitAbbrev(Abbv);
+
+  // FNINDEX_ENTRY: [valueid, bitoffset]
+  SmallVector<uint64_t, 2> Vals;
+  for (const auto &Entry : Index) {
+    Vals.push_back(Entry.first);
+    Vals.push_back(Entry.second);
+    Stream.EmitRecord(bitc::FNINDEX_CODE_ENTRY, Vals, EntryAbbrev);
+    Vals.clear();
+  }
+  Stream.ExitBlock();
+
+  Stream.BackpatchWordAtBit(PlaceholderBit, (uint32_t)IndexBit);
+  Stream.BackpatchWordAtBit(PlaceholderBit + 32, (uint32_t)(IndexBit >> 32));
+}
+
+static void WriteSymbolTableEntry(const GlobalValue &GV, const Mangler *Mang,
+                                  const DataLayout &DL, unsigned AbbrevToUse,
+                                  BitstreamWriter &Stream) {
+  SmallString<64> Name;
+  if (Mang)
+    Mang->getNameWithPrefix(Name, &GV, false);
+  else
+    Name = GV.getName();
+  const GlobalObject *Base = isa<GlobalAlias>(GV)
+                                 ? cast<GlobalAlias>(GV).getBaseObject()
+                                 : &cast<GlobalObject>(GV);
+  StringRef ComdatName;
+  if (const Comdat *C = Base->getComdat())
+    ComdatName = C->getName();
+  StringRef Section = GV.getSection();
+
+  unsigned Flags = 0;
+  if (GV.isDeclarationForLinker())
+    Flags |= bitc::SYMTAB_FLAG_UNDEFINED;
+  if (auto *Var = dyn_cast<GlobalVariable>(&GV))
+    if (Var->isConstant())
+      Flags |= bitc::SYMTAB_FLAG_CONSTANT;
+  if (GV.hasUnnamedAddr())
+    Flags |= bitc::SYMTAB_FLAG_UNNAMED_ADDR;
+  Type *ValueTy = GV.getType()->getElementType();
+  if (ValueTy->isFunctionTy())
+    Flags |= bitc::SYMTAB_FLAG_FUNCTION_TYPE;
+  if (GV.getName().startswith("llvm."))
+    Flags |= bitc::SYMTAB_FLAG_LLVM_NAME;
+
+  // ENTRY: [kind, linkage, visibility, flags, alignment, commonsize,
+  //         namelen, comdatlen, strchr x N]
+  SmallVector<uint64_t, 64> Vals;
+  Vals.push_back(isa<Function>(GV) ? 0 : isa<GlobalVariable>(GV) ? 1 : 2);
+  Vals.push_back(getEncodedLinkage(GV));
+  Vals.push_back(getEncodedVisibility(GV));
+  Vals.push_back(Flags);
+  Vals.push_back(Log2_32(GV.getAlignment()) + 1);
+  Vals.push_back(GV.hasCommonLinkage() ? DL.getTypeAllocSize(ValueTy) : 0);
+  Vals.push_back(Name.size());
+  Vals.push_back(ComdatName.size());
+  Vals.append(Name.begin(), Name.end());
+  Vals.append(ComdatName.begin(), ComdatName.end());
+  Vals.append(Section.begin(), Section.end());
+  Stream.EmitRecord(bitc::SYMTAB_CODE_ENTRY, Vals, AbbrevToUse);
+}
+
+/// WriteSymbolTable - Emit the symbols of the module, the way IRObjectFile
+/// lists them, so that linkers and tools like llvm-nm don't have to read the
+/// module.  Modules whose symbols IRObjectFile needs the target to find, in
+/// module-level inline asm, don't get a symbol table.
+static void WriteSymbolTable(const Module *M, BitstreamWriter &Stream) {
+  if (!M->getModuleInlineAsm().empty())
+    return;
+  for (const GlobalAlias &A : M->aliases())
+    if (!A.getBaseObject())
+      return;
+
+  Stream.EnterSubblock(bitc::SYMTAB_BLOCK_ID, 3);
+
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::SYMTAB_CODE_ENTRY));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 2));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 5));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 2));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 4));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 4));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
+  unsigned EntryAbbrev = Stream.EmitAbbrev(Abbv);
+
+  WriteStringRecord(bitc::SYMTAB_CODE_TRIPLE, M->getTargetTriple(), 0,
+                    Stream);
+  WriteStringRecord(bitc::SYMTAB_CODE_DATALAYOUT, M->getDataLayoutStr(), 0,
+                    Stream);
+
+  // The options that LTOModule reads from the "Linker Options" flag.
+  if (Metadata *Val = M->getModuleFlag("Linker Options")) {
+    MDNode *LinkerOptions = cast<MDNode>(Val);
+    for (unsigned i = 0, e = LinkerOptions->getNumOperands(); i != e; ++i) {
+      MDNode *Options = cast<MDNode>(LinkerOptions->getOperand(i));
+      for (unsigned ii = 0, ie = Options->getNumOperands(); ii != ie; ++ii)
+        WriteStringRecord(bitc::SYMTAB_CODE_LINKER_OPTION,
+                          cast<MDString>(Options->getOperand(ii))->getString(),
+                          0, Stream);
+    }
+  }
+
+  // Name the symbols like IRObjectFile does, which only mangles them if the
+  // module has a DataLayout.
+  std::unique_ptr<Mangler> Mang;
+  if (M->getDataLayout())
+    Mang.reset(new Mangler(M->getDataLayout()));
+  DataLayout DL(M);
+  for (const Function &F : *M)
+    WriteSymbolTableEntry(F, Mang.get(), DL, EntryAbbrev, Stream);
+  for (const GlobalVariable &GV : M->globals())
+    WriteSymbolTableEntry(GV, Mang.get(), DL, EntryAbbrev, Stream);
+  for (const GlobalAlias &A : M->aliases())
+    WriteSymbolTableEntry(A, Mang.get(), DL, EntryAbbrev, Stream);
+
   Stream.ExitBlock();
 }
 
-/// WriteModule - Emit the specified module to the bitstream.
-static void WriteModule(const Module *M, BitstreamWriter &Stream) {
+/// WriteModule - Emit the specified module to the bitstream.  Stream
+/// positions recorded in the module are relative to \p BitcodeStartBit.  If
+/// \p Profile is given, add the abbreviations it picked.
+static void WriteModule(const Module *M, BitstreamWriter &Stream,
+                        uint64_t BitcodeStartBit,
+                        const RecordProfile *Profile) {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
   SmallVector<unsigned, 1> Vals;
@@ -1942,11 +2369,25 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   Vals.push_back(CurVersion);
   Stream.EmitRecord(bitc::MODULE_CODE_VERSION, Vals);
 
+  // If there are function bodies, lazy readers can find them through an index
+  // at the end of the module.  Say where it is up front.
+  bool HasFunctionBodies = false;
+  for (const Function &F : *M)
+    HasFunctionBodies |= !F.isDeclaration();
+  uint64_t FnIndexOffsetBit = 0;
+  if (HasFunctionBodies)
+    FnIndexOffsetBit = WriteFunctionIndexOffsetPlaceholder(Stream);
+
+  // Emit the symbol table before anything else, so that readers that only
+  // want the symbols can stop there.
+  if (SymbolTable)
+    WriteSymbolTable(M, Stream);
+
   // Analyze the module, enumerating globals, functions, etc.
   ValueEnumerator VE(*M);
 
   // Emit blockinfo, which defines the standard abbreviations etc.
-  WriteBlockInfo(VE, Stream);
+  WriteBlockInfo(VE, Stream, Profile);
 
   // Emit information about attribute groups.
   WriteAttributeGroupTable(VE, Stream);
@@ -1979,10 +2420,23 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   if (shouldPreserveBitcodeUseListOrder())
     WriteUseListBlock(nullptr, VE, Stream);
 
-  // Emit function bodies.
+  // Emit function bodies, remembering for each the position a reader is at
+  // after reading the ENTER_SUBBLOCK abbrev ID and block ID, which is where
+  // it resumes to parse the body.
+  std::vector<std::pair<unsigned, uint64_t> > FunctionIndex;
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
-    if (!F->isDeclaration())
+    if (!F->isDeclaration()) {
+      static_assert(bitc::FUNCTION_BLOCK_ID < (1 << (bitc::BlockIDWidth - 1)),
+                    "FUNCTION_BLOCK_ID must fit in a single VBR chunk");
+      FunctionIndex.push_back(std::make_pair(
+          VE.getValueID(F), Stream.GetCurrentBitNo() - BitcodeStartBit +
+                                Stream.GetAbbrevIDWidth() + bitc::BlockIDWidth));
       WriteFunction(*F, VE, Stream);
+    }
+
+  if (HasFunctionBodies)
+    WriteFunctionIndex(FunctionIndex, FnIndexOffsetBit, BitcodeStartBit,
+                       Stream);
 
   Stream.ExitBlock();
 }
@@ -2014,8 +2468,12 @@ static void WriteInt32ToBuffer(uint32_t Value, SmallVectorImpl<char> &Buffer,
   Position += 4;
 }
 
+/// EmitDarwinBCHeaderAndTrailer - \p Buffer holds what is still to be written
+/// of the bitcode, the rest has been written to \p Out from \p StartPos on.
+/// Either way the header space is reserved at the start.
 static void EmitDarwinBCHeaderAndTrailer(SmallVectorImpl<char> &Buffer,
-                                         const Triple &TT) {
+                                         const Triple &TT, raw_ostream &Out,
+                                         uint64_t StartPos) {
   unsigned CPUType = ~0U;
 
   // Match x86_64-*, i[3-9]86-*, powerpc-*, powerpc64-*, arm-*, thumb-*,
@@ -2042,39 +2500,69 @@ static void EmitDarwinBCHeaderAndTrailer(SmallVectorImpl<char> &Buffer,
     CPUType = DARWIN_CPU_TYPE_ARM;
 
   // Traditional Bitcode starts after header.
-  assert(Buffer.size() >= DarwinBCHeaderSize &&
-         "Expected header size to be reserved");
+  uint64_t FlushedSize = Out.tell() - StartPos;
+  uint64_t Size = FlushedSize + Buffer.size();
+  assert(Size >= DarwinBCHeaderSize && "Expected header size to be reserved");
   unsigned BCOffset = DarwinBCHeaderSize;
-  unsigned BCSize = Buffer.size()-DarwinBCHeaderSize;
+  unsigned BCSize = Size-DarwinBCHeaderSize;
 
   // Write the magic and version.
+  SmallVector<char, DarwinBCHeaderSize> Header(DarwinBCHeaderSize);
   unsigned Position = 0;
-  WriteInt32ToBuffer(0x0B17C0DE , Buffer, Position);
-  WriteInt32ToBuffer(0          , Buffer, Position); // Version.
-  WriteInt32ToBuffer(BCOffset   , Buffer, Position);
-  WriteInt32ToBuffer(BCSize     , Buffer, Position);
-  WriteInt32ToBuffer(CPUType    , Buffer, Position);
+  WriteInt32ToBuffer(0x0B17C0DE , Header, Position);
+  WriteInt32ToBuffer(0          , Header, Position); // Version.
+  WriteInt32ToBuffer(BCOffset   , Header, Position);
+  WriteInt32ToBuffer(BCSize     , Header, Position);
+  WriteInt32ToBuffer(CPUType    , Header, Position);
+  if (FlushedSize)
+    Out.pwrite(Header.data(), DarwinBCHeaderSize, StartPos);
+  else
+    std::copy(Header.begin(), Header.end(), Buffer.begin());
 
   // If the file is not a multiple of 16 bytes, insert dummy padding.
-  while (Buffer.size() & 15)
+  for (; Size & 15; ++Size)
     Buffer.push_back(0);
 }
 
 /// WriteBitcodeToFile - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out) {
+  // To pick abbreviations for the module, write it once to nowhere and see
+  // which records end up unabbreviated.
+  std::unique_ptr<RecordProfile> Profile;
+  if (AutoAbbrev) {
+    Profile.reset(new RecordProfile());
+    SmallVector<char, 0> Buffer;
+    raw_null_ostream Null;
+    BitstreamWriter Stream(Buffer, &Null, 64*1024);
+    Stream.SetObserver(Profile.get());
+    WriteModule(M, Stream, 0, nullptr);
+  }
+
+  // If Out can be patched, the writer only keeps the last piece of the
+  // bitcode in memory and moves the rest on as it goes.  Compressed bitcode
+  // is written once it is complete.
+  bool Compress = Compression != BitcodeCompression::None;
+  uint64_t FlushThreshold = uint64_t(FlushThresholdKB) * 1024;
+  bool Streaming = FlushThreshold && !Compress && Out.supportsPwrite();
+  uint64_t StartPos = Out.tell();
+
   SmallVector<char, 0> Buffer;
-  Buffer.reserve(256*1024);
+  Buffer.reserve(Streaming ? FlushThreshold + 64*1024 : 256*1024);
 
   // If this is darwin or another generic macho target, reserve space for the
-  // header.
+  // header.  Compressed bitcode goes without it: the system linker that
+  // wants it can't read compressed bitcode anyway.
   Triple TT(M->getTargetTriple());
-  if (TT.isOSDarwin())
+  bool DarwinHeader = TT.isOSDarwin() && !Compress;
+  if (DarwinHeader)
     Buffer.insert(Buffer.begin(), DarwinBCHeaderSize, 0);
 
   // Emit the module into the buffer.
   {
-    BitstreamWriter Stream(Buffer);
+    uint64_t BitcodeStartBit = Buffer.size() * 8;
+    BitstreamWriter Stream(Buffer, Streaming ? &Out : nullptr,
+                           FlushThreshold);
 
     // Emit the file header.
     Stream.Emit((unsigned)'B', 8);
@@ -2085,12 +2573,67 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out) {
     Stream.Emit(0xD, 4);
 
     // Emit the module.
-    WriteModule(M, Stream);
+    WriteModule(M, Stream, BitcodeStartBit, Profile.get());
   }
 
-  if (TT.isOSDarwin())
-    EmitDarwinBCHeaderAndTrailer(Buffer, TT);
+  if (DarwinHeader)
+    EmitDarwinBCHeaderAndTrailer(Buffer, TT, Out, StartPos);
+
+  if (Compress) {
+    SmallVector<char, 0> Compressed;
+    compressBitcode(StringRef(Buffer.data(), Buffer.size()), Compressed,
+                    Compression, std::max(1U, CompressionChunkKB.getValue()) *
+                                     1024);
+    Out.write(Compressed.data(), Compressed.size());
+    return;
+  }
+
+  // Write the rest of the generated bitstream to "Out".
+  Out.write(Buffer.data(), Buffer.size());
+}
+
+static void writeLE32(char *P, uint32_t V) {
+  P[0] = char(V);
+  P[1] = char(V >> 8);
+  P[2] = char(V >> 16);
+  P[3] = char(V >> 24);
+}
+
+void llvm::compressBitcode(StringRef Bitcode, SmallVectorImpl<char> &Out,
+                           BitcodeCompression Codec, unsigned ChunkSize) {
+  assert(Codec != BitcodeCompression::None && ChunkSize &&
+         "Invalid compression");
+  size_t NumChunks = (Bitcode.size() + ChunkSize - 1) / ChunkSize;
+  size_t Start = Out.size();
+  Out.resize(Start + 4 * (4 + NumChunks + 1));
+  char *Header = Out.data() + Start;
+  Header[0] = 'B';
+  Header[1] = 'C';
+  Header[2] = 'Z';
+  Header[3] = '1';
+  writeLE32(Header + 4, unsigned(Codec));
+  writeLE32(Header + 8, ChunkSize);
+  writeLE32(Header + 12, Bitcode.size());
+
+  SmallVector<char, 0> Compressed;
+  for (size_t I = 0; I != NumChunks; ++I) {
+    writeLE32(Out.data() + Start + 4 * (4 + I), Out.size() - Start);
+    StringRef Chunk = Bitcode.substr(I * ChunkSize, ChunkSize);
+    bool Compressible;
+    if (Codec == BitcodeCompression::Zlib) {
+      Compressible = zlib::compress(Chunk, Compressed) == zlib::StatusOK;
+    } else {
+      lz77::compress(Chunk, Compressed);
+      Compressible = true;
+    }
+    if (Compressible && Compressed.size() < Chunk.size())
+      Out.append(Compressed.begin(), Compressed.end());
+    else
+      Out.append(Chunk.begin(), Chunk.end());
+  }
+  writeLE32(Out.data() + Start + 4 * (4 + NumChunks), Out.size() - Start);
 
-  // Write the generated bitstream to "Out".
-  Out.write((char*)&Buffer.front(), Buffer.size());
+  // Keep the file a multiple of four bytes long, like bitcode.
+  while ((Out.size() - Start) & 3)
+    Out.push_back(0);
 }
@@ -0,0 +1,570 @@
+//===-- GlobalsSnapshot.cpp - Save and restore global variable state ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements ExecutionEngine::saveGlobalsSnapshot and
+// ExecutionEngine::restoreGlobalsSnapshot, which let a client skip the static
+// constructors of a program it runs repeatedly.
+//
+// A snapshot is only meaningful in a process running the same modules, so the
+// file is a simple host-endian dump:
+//
+//   magic, version, signature of the loaded modules, number of globals, then
+//   for each saved global: its index, its bytes and a list of relocations.
+//
+// Globals and functions are identified by their position in the modules, which
+// the signature guarantees to be the same.  Each relocation names a pointer
+// sized slot in a global and the global (plus offset) or function it points
+// to; the slot is rewritten with that object's address in the new process.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <map>
+
+using namespace llvm;
+
+namespace {
+
+const char SnapshotMagic[8] = { 'L', 'L', 'V', 'M', 'G', 'S', 'N', 'P' };
+const uint32_t SnapshotVersion = 1;
+
+enum RelocKind {
+  RK_Global = 0,
+  RK_Function = 1
+};
+
+struct SnapshotReloc {
+  uint64_t Offset;  // Offset of the pointer within the global.
+  uint32_t Kind;    // RelocKind.
+  uint32_t Target;  // Index of the target global or function.
+  uint64_t Addend;  // Offset into the target global.
+};
+
+/// Feeds the contents of modules to an MD5 hash: the globals with their
+/// initializers and the functions with their code, without printing them.
+/// Every type and constant is hashed in full once and then by number, and
+/// values local to a function by their position in it.
+class ModuleHasher {
+  MD5 &Hash;
+  SmallVector<uint64_t, 64> Words;
+  DenseMap<Type *, unsigned> TypeNumbers;
+  DenseMap<const Value *, unsigned> ValueNumbers;
+
+  void flush() {
+    Hash.update(ArrayRef<uint8_t>((const uint8_t *)Words.data(),
+                                  Words.size() * sizeof(uint64_t)));
+    Words.clear();
+  }
+
+  void add(uint64_t Word) {
+    Words.push_back(Word);
+    if (Words.size() == 64)
+      flush();
+  }
+
+  void add(StringRef Str) {
+    add(Str.size());
+    flush();
+    Hash.update(Str);
+  }
+
+  void add(const APInt &Val) {
+    add(Val.getBitWidth());
+    for (unsigned i = 0, e = Val.getNumWords(); i != e; ++i)
+      add(Val.getRawData()[i]);
+  }
+
+  void addType(Type *Ty) {
+    auto Inserted = TypeNumbers.insert(std::make_pair(Ty, TypeNumbers.size()));
+    if (!Inserted.second) {
+      add(Inserted.first->second);
+      return;
+    }
+    add(~0ULL);
+    add(Ty->getTypeID());
+    if (IntegerType *ITy = dyn_cast<IntegerType>(Ty))
+      add(ITy->getBitWidth());
+    else if (PointerType *PTy = dyn_cast<PointerType>(Ty))
+      add(PTy->getAddressSpace());
+    else if (SequentialType *STy = dyn_cast<SequentialType>(Ty))
+      add(STy->isArrayTy() ? cast<ArrayType>(STy)->getNumElements()
+                           : cast<VectorType>(STy)->getNumElements());
+    else if (FunctionType *FTy = dyn_cast<FunctionType>(Ty))
+      add(FTy->isVarArg());
+    // Named structs may be recursive; their name stands for their body.
+    if (StructType *STy = dyn_cast<StructType>(Ty)) {
+      if (STy->hasName()) {
+        add(STy->getName());
+        return;
+      }
+      add(STy->isPacked());
+    }
+    add(Ty->getNumContainedTypes());
+    for (Type *Contained : Ty->subtypes())
+      addType(Contained);
+  }
+
+  void addValue(const Value *V) {
+    auto Found = ValueNumbers.find(V);
+    if (Found != ValueNumbers.end()) {
+      add(Found->second);
+      return;
+    }
+    // Only globals and constants get here; functions number their own
+    // arguments, blocks and instructions up front.
+    unsigned Number = ValueNumbers.size();
+    ValueNumbers[V] = Number;
+    add(~0ULL);
+    add(V->getValueID());
+    addType(V->getType());
+    if (const GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+      add(GV->getName());
+    } else if (const ConstantInt *CI = dyn_cast<ConstantInt>(V)) {
+      add(CI->getValue());
+    } else if (const ConstantFP *CFP = dyn_cast<ConstantFP>(V)) {
+      add(CFP->getValueAPF().bitcastToAPInt());
+    } else if (const ConstantDataSequential *CDS =
+                   dyn_cast<ConstantDataSequential>(V)) {
+      add(CDS->getRawDataValues());
+    } else if (const InlineAsm *IA = dyn_cast<InlineAsm>(V)) {
+      add(IA->getAsmString());
+      add(IA->getConstraintString());
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+      add(CE->getOpcode());
+      add(CE->getRawSubclassOptionalData());
+      if (CE->isCompare())
+        add(CE->getPredicate());
+      if (CE->hasIndices())
+        for (unsigned Idx : CE->getIndices())
+          add(Idx);
+      addOperands(CE);
+    } else if (const User *U = dyn_cast<User>(V)) {
+      addOperands(U);
+    }
+  }
+
+  void addOperands(const User *U) {
+    add(U->getNumOperands());
+    for (const Use &Op : U->operands())
+      if (isa<MetadataAsValue>(Op))
+        add(~1ULL);
+      else
+        addValue(Op);
+  }
+
+  void addInstruction(const Instruction &I) {
+    add(I.getOpcode());
+    add(I.getRawSubclassOptionalData());
+    addType(I.getType());
+    if (const CmpInst *CI = dyn_cast<CmpInst>(&I))
+      add(CI->getPredicate());
+    else if (const PHINode *PN = dyn_cast<PHINode>(&I))
+      for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i)
+        addValue(PN->getIncomingBlock(i));
+    else if (const ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(&I))
+      for (unsigned Idx : EVI->getIndices())
+        add(Idx);
+    else if (const InsertValueInst *IVI = dyn_cast<InsertValueInst>(&I))
+      for (unsigned Idx : IVI->getIndices())
+        add(Idx);
+    addOperands(&I);
+  }
+
+public:
+  explicit ModuleHasher(MD5 &Hash) : Hash(Hash) {}
+  ~ModuleHasher() { flush(); }
+
+  void addGlobal(const GlobalVariable &GV) {
+    addValue(&GV);
+    add(GV.getLinkage());
+    add(GV.isConstant());
+    add(GV.isThreadLocal());
+    add(GV.hasInitializer());
+    if (GV.hasInitializer())
+      addValue(GV.getInitializer());
+  }
+
+  void addFunction(const Function &F) {
+    addValue(&F);
+    add(F.getLinkage());
+    add(F.getCallingConv());
+    add(F.size());
+    if (F.isDeclaration())
+      return;
+
+    // Number the values of the function first: they may be used before
+    // they are defined.
+    SmallVector<const Value *, 64> Locals;
+    for (const Argument &A : F.args())
+      Locals.push_back(&A);
+    for (const BasicBlock &BB : F) {
+      Locals.push_back(&BB);
+      for (const Instruction &I : BB)
+        Locals.push_back(&I);
+    }
+    for (const Value *V : Locals)
+      ValueNumbers[V] = ValueNumbers.size();
+
+    for (const BasicBlock &BB : F) {
+      add(BB.size());
+      for (const Instruction &I : BB)
+        addInstruction(I);
+    }
+    for (const Value *V : Locals)
+      ValueNumbers.erase(V);
+  }
+};
+
+/// Everything needed to map addresses to and from the loaded modules.
+class GlobalIndex {
+  std::vector<Module *> Modules;
+
+public:
+  std::vector<GlobalVariable *> Globals;
+  std::vector<Function *> Functions;
+
+  GlobalIndex(ArrayRef<Module *> Modules) : Modules(Modules) {
+    for (Module *M : Modules) {
+      for (GlobalVariable &GV : M->globals())
+        Globals.push_back(&GV);
+      for (Function &F : *M)
+        Functions.push_back(&F);
+    }
+  }
+
+  /// Compute a signature of the loaded modules.  It covers the indices and
+  /// sizes in a snapshot, and also the initializers and function bodies: a
+  /// snapshot of a program whose code changed would be stale.
+  void computeSignature(const DataLayout &DL, MD5::MD5Result &Result) const {
+    MD5 Hash;
+    for (GlobalVariable *GV : Globals) {
+      uint64_t Size = DL.getTypeAllocSize(GV->getType()->getElementType());
+      Hash.update(ArrayRef<uint8_t>((const uint8_t *)&Size, sizeof(Size)));
+    }
+    {
+      ModuleHasher Hasher(Hash);
+      for (Module *M : Modules) {
+        for (GlobalVariable &GV : M->globals())
+          Hasher.addGlobal(GV);
+        for (Function &F : *M)
+          Hasher.addFunction(F);
+      }
+    }
+    Hash.final(Result);
+  }
+};
+
+/// Collect the offsets of all pointers within a value of type \p Ty.
+void collectPointerOffsets(const DataLayout &DL, Type *Ty, uint64_t Base,
+                           SmallVectorImpl<uint64_t> &Offsets) {
+  switch (Ty->getTypeID()) {
+  case Type::PointerTyID:
+    Offsets.push_back(Base);
+    return;
+  case Type::StructTyID: {
+    StructType *STy = cast<StructType>(Ty);
+    const StructLayout *SL = DL.getStructLayout(STy);
+    for (unsigned i = 0, e = STy->getNumElements(); i != e; ++i)
+      collectPointerOffsets(DL, STy->getElementType(i),
+                            Base + SL->getElementOffset(i), Offsets);
+    return;
+  }
+  case Type::ArrayTyID:
+  case Type::VectorTyID: {
+    SequentialType *SeqTy = cast<SequentialType>(Ty);
+    Type *EltTy = SeqTy->getElementType();
+    uint64_t NumElts = Ty->isArrayTy() ? cast<ArrayType>(Ty)->getNumElements()
+                                       : cast<VectorType>(Ty)->getNumElements();
+    // Don't walk big arrays of plain data element by element.
+    SmallVector<uint64_t, 4> EltOffsets;
+    collectPointerOffsets(DL, EltTy, 0, EltOffsets);
+    if (EltOffsets.empty())
+      return;
+    uint64_t EltSize = DL.getTypeAllocSize(EltTy);
+    for (uint64_t i = 0; i != NumElts; ++i)
+      for (uint64_t Off : EltOffsets)
+        Offsets.push_back(Base + i * EltSize + Off);
+    return;
+  }
+  default:
+    return;
+  }
+}
+
+/// A cursor over the bytes of a snapshot file.
+class SnapshotReader {
+  const char *Cur, *End;
+
+public:
+  SnapshotReader(StringRef Data) : Cur(Data.begin()), End(Data.end()) {}
+
+  bool read(void *Dst, size_t Size) {
+    if ((size_t)(End - Cur) < Size)
+      return false;
+    memcpy(Dst, Cur, Size);
+    Cur += Size;
+    return true;
+  }
+
+  template <typename T> bool read(T &Val) { return read(&Val, sizeof(T)); }
+
+  size_t remaining() const { return End - Cur; }
+
+  const char *skip(size_t Size) {
+    if ((size_t)(End - Cur) < Size)
+      return nullptr;
+    const char *Ret = Cur;
+    Cur += Size;
+    return Ret;
+  }
+};
+
+template <typename T> void write(raw_ostream &OS, const T &Val) {
+  OS.write(reinterpret_cast<const char *>(&Val), sizeof(T));
+}
+
+} // end anonymous namespace
+
+bool ExecutionEngine::saveGlobalsSnapshot(StringRef Path,
+                                          std::string &ErrMsg) {
+  const DataLayout &TD = *getDataLayout();
+  SmallVector<Module *, 1> Mods;
+  for (auto &M : Modules)
+    Mods.push_back(M.get());
+  GlobalIndex Index(Mods);
+
+  // Map the memory of every global back to its index, and every function
+  // address back to its function.
+  std::map<uintptr_t, std::pair<unsigned, uint64_t> > GlobalRanges;
+  for (unsigned i = 0, e = Index.Globals.size(); i != e; ++i) {
+    GlobalVariable *GV = Index.Globals[i];
+    if (void *Addr = getPointerToGlobalIfAvailable(GV))
+      GlobalRanges[(uintptr_t)Addr] = std::make_pair(
+          i, TD.getTypeAllocSize(GV->getType()->getElementType()));
+  }
+  DenseMap<void *, unsigned> FunctionAddrs;
+  for (unsigned i = 0, e = Index.Functions.size(); i != e; ++i)
+    if (void *Addr = getPointerToGlobal(Index.Functions[i]))
+      FunctionAddrs[Addr] = i;
+
+  std::string Data;
+  raw_string_ostream OS(Data);
+  unsigned NumSaved = 0;
+  SmallVector<uint64_t, 16> PtrOffsets;
+  std::vector<SnapshotReloc> Relocs;
+
+  for (unsigned i = 0, e = Index.Globals.size(); i != e; ++i) {
+    GlobalVariable *GV = Index.Globals[i];
+    // Constants can't have changed since the globals were emitted, and
+    // declarations live in memory the engine doesn't own.
+    if (GV->isConstant() || GV->isDeclaration())
+      continue;
+    char *Addr = (char *)getPointerToGlobalIfAvailable(GV);
+    if (!Addr)
+      continue;
+
+    Type *Ty = GV->getType()->getElementType();
+    uint64_t Size = TD.getTypeAllocSize(Ty);
+
+    PtrOffsets.clear();
+    Relocs.clear();
+    collectPointerOffsets(TD, Ty, 0, PtrOffsets);
+    for (uint64_t Off : PtrOffsets) {
+      void *Ptr;
+      memcpy(&Ptr, Addr + Off, sizeof(Ptr));
+      if (!Ptr)
+        continue;
+
+      SnapshotReloc R;
+      R.Offset = Off;
+      DenseMap<void *, unsigned>::iterator FI = FunctionAddrs.find(Ptr);
+      if (FI != FunctionAddrs.end()) {
+        R.Kind = RK_Function;
+        R.Target = FI->second;
+        R.Addend = 0;
+        Relocs.push_back(R);
+        continue;
+      }
+
+      // Find the global whose memory contains Ptr.  One past the end is a
+      // valid pointer too.
+      std::map<uintptr_t, std::pair<unsigned, uint64_t> >::iterator GI =
+          GlobalRanges.upper_bound((uintptr_t)Ptr);
+      if (GI != GlobalRanges.begin()) {
+        --GI;
+        if ((uintptr_t)Ptr - GI->first <= GI->second.second) {
+          R.Kind = RK_Global;
+          R.Target = GI->second.first;
+          R.Addend = (uintptr_t)Ptr - GI->first;
+          Relocs.push_back(R);
+          continue;
+        }
+      }
+
+      ErrMsg = "global '" + GV->getName().str() +
+               "' holds a pointer that cannot be saved in a snapshot";
+      return true;
+    }
+
+    write(OS, (uint32_t)i);
+    write(OS, Size);
+    OS.write(Addr, Size);
+    write(OS, (uint64_t)Relocs.size());
+    for (const SnapshotReloc &R : Relocs)
+      write(OS, R);
+    ++NumSaved;
+  }
+  OS.flush();
+
+  MD5::MD5Result Signature;
+  Index.computeSignature(TD, Signature);
+
+  std::error_code EC;
+  raw_fd_ostream Out(Path, EC, sys::fs::F_None);
+  if (EC) {
+    ErrMsg = EC.message();
+    return true;
+  }
+  Out.write(SnapshotMagic, sizeof(SnapshotMagic));
+  write(Out, SnapshotVersion);
+  Out.write((const char *)Signature, sizeof(Signature));
+  write(Out, (uint32_t)NumSaved);
+  Out << Data;
+  Out.close();
+  if (Out.has_error()) {
+    Out.clear_error();
+    ErrMsg = "error writing snapshot '" + Path.str() + "'";
+    return true;
+  }
+  return false;
+}
+
+bool ExecutionEngine::restoreGlobalsSnapshot(StringRef Path,
+                                             std::string &ErrMsg) {
+  // Large snapshots are mapped rather than read.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufOrErr =
+      MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufOrErr.getError()) {
+    ErrMsg = EC.message();
+    return true;
+  }
+
+  const DataLayout &TD = *getDataLayout();
+  SmallVector<Module *, 1> Mods;
+  for (auto &M : Modules)
+    Mods.push_back(M.get());
+  GlobalIndex Index(Mods);
+
+  SnapshotReader Reader(BufOrErr.get()->getBuffer());
+  char Magic[sizeof(SnapshotMagic)];
+  uint32_t Version, NumSaved;
+  MD5::MD5Result FileSignature, Signature;
+  if (!Reader.read(Magic, sizeof(Magic)) ||
+      memcmp(Magic, SnapshotMagic, sizeof(Magic)) != 0 ||
+      !Reader.read(Version) || Version != SnapshotVersion) {
+    ErrMsg = "'" + Path.str() + "' is not a globals snapshot";
+    return true;
+  }
+  Index.computeSignature(TD, Signature);
+  if (!Reader.read(FileSignature, sizeof(FileSignature)) ||
+      memcmp(FileSignature, Signature, sizeof(Signature)) != 0) {
+    ErrMsg = "snapshot '" + Path.str() + "' was taken from different modules";
+    return true;
+  }
+
+  // Validate the whole file before touching any global, so that a truncated
+  // or corrupt snapshot leaves the program in its initial state.
+  struct PendingGlobal {
+    char *Addr;
+    const char *Bytes;
+    uint64_t Size;
+    std::vector<SnapshotReloc> Relocs;
+  };
+  std::vector<PendingGlobal> Pending;
+  const char *Corrupt = "snapshot file is corrupt";
+  // Don't trust the counts in the file for allocating memory: each global is
+  // saved at most once with at least its index, size and relocation count,
+  // and holds at most one relocation per pointer sized slot.
+  const size_t MinGlobalSize =
+      sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t);
+  if (!Reader.read(NumSaved) || NumSaved > Index.Globals.size() ||
+      NumSaved > Reader.remaining() / MinGlobalSize) {
+    ErrMsg = Corrupt;
+    return true;
+  }
+  Pending.resize(NumSaved);
+  for (PendingGlobal &PG : Pending) {
+    uint32_t GlobalNo;
+    uint64_t NumRelocs;
+    if (!Reader.read(GlobalNo) || GlobalNo >= Index.Globals.size() ||
+        !Reader.read(PG.Size)) {
+      ErrMsg = Corrupt;
+      return true;
+    }
+    GlobalVariable *GV = Index.Globals[GlobalNo];
+    PG.Addr = (char *)getPointerToGlobal(GV);
+    PG.Bytes = Reader.skip(PG.Size);
+    if (!PG.Addr || !PG.Bytes ||
+        PG.Size != TD.getTypeAllocSize(GV->getType()->getElementType()) ||
+        !Reader.read(NumRelocs) || NumRelocs > PG.Size / sizeof(void *) ||
+        NumRelocs > Reader.remaining() / sizeof(SnapshotReloc)) {
+      ErrMsg = Corrupt;
+      return true;
+    }
+    PG.Relocs.resize(NumRelocs);
+    for (SnapshotReloc &R : PG.Relocs) {
+      if (!Reader.read(R) || R.Offset > PG.Size - sizeof(void *)) {
+        ErrMsg = Corrupt;
+        return true;
+      }
+      // A pointer into a global may point one past its end.
+      bool Valid;
+      if (R.Kind == RK_Function) {
+        Valid = R.Target < Index.Functions.size() && R.Addend == 0;
+      } else if (R.Kind == RK_Global && R.Target < Index.Globals.size()) {
+        Type *Ty = Index.Globals[R.Target]->getType()->getElementType();
+        Valid = R.Addend <= TD.getTypeAllocSize(Ty);
+      } else {
+        Valid = false;
+      }
+      if (!Valid) {
+        ErrMsg = Corrupt;
+        return true;
+      }
+    }
+  }
+
+  for (PendingGlobal &PG : Pending) {
+    memcpy(PG.Addr, PG.Bytes, PG.Size);
+    for (const SnapshotReloc &R : PG.Relocs) {
+      char *Target;
+      if (R.Kind == RK_Function)
+        Target = (char *)getPointerToGlobal(Index.Functions[R.Target]);
+      else
+        Target = (char *)getPointerToGlobal(Index.Globals[R.Target]) +
+                 R.Addend;
+      memcpy(PG.Addr + R.Offset, &Target, sizeof(Target));
+    }
+  }
+  return false;
+}
@@ -31,6 +31,10 @@ using namespace llvm;
 
 STATISTIC(NumDynamicInsts, "Number of dynamic instructions executed");
 
+// Number of instructions a thread interprets before letting other threads that
+// are waiting for the interpreter lock run.
+static const unsigned YieldInterval = 1024;
+
 static cl::opt<bool> PrintVolatile("interpreter-print-volatile", cl::Hidden,
           cl::desc("make the interpreter print every volatile load and store"));
 
@@ -275,7 +279,7 @@ static GenericValue executeICMP_SGE(GenericValue Src1, GenericValue Src2,
 }
 
 void Interpreter::visitICmpInst(ICmpInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Type *Ty    = I.getOperand(0)->getType();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
@@ -607,7 +611,7 @@ static GenericValue executeFCMP_BOOL(GenericValue Src1, GenericValue Src2,
 }
 
 void Interpreter::visitFCmpInst(FCmpInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Type *Ty    = I.getOperand(0)->getType();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
@@ -678,7 +682,7 @@ static GenericValue executeCmpInst(unsigned predicate, GenericValue Src1,
 }
 
 void Interpreter::visitBinaryOperator(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Type *Ty    = I.getOperand(0)->getType();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
@@ -803,7 +807,7 @@ static GenericValue executeSelectInst(GenericValue Src1, GenericValue Src2,
 }
 
 void Interpreter::visitSelectInst(SelectInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   const Type * Ty = I.getOperand(0)->getType();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
@@ -820,7 +824,7 @@ void Interpreter::exitCalled(GenericValue GV) {
   // runAtExitHandlers() assumes there are no stack frames, but
   // if exit() was called, then it had a stack frame. Blow away
   // the stack before interpreting atexit handlers.
-  ECStack.clear();
+  getECStack().clear();
   runAtExitHandlers();
   exit(GV.IntVal.zextOrTrunc(32).getZExtValue());
 }
@@ -835,14 +839,17 @@ void Interpreter::exitCalled(GenericValue GV) {
 ///
 void Interpreter::popStackAndReturnValueToCaller(Type *RetTy,
                                                  GenericValue Result) {
+  InterpreterThread &T = getThread();
+  std::vector<ExecutionContext> &ECStack = T.ECStack;
+
   // Pop the current stack frame.
   ECStack.pop_back();
 
   if (ECStack.empty()) {  // Finished main.  Put result into exit code...
     if (RetTy && !RetTy->isVoidTy()) {          // Nonvoid return type?
-      ExitValue = Result;   // Capture the exit value of the program
+      T.ExitValue = Result;   // Capture the exit value of the program
     } else {
-      memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
+      memset(&T.ExitValue.Untyped, 0, sizeof(T.ExitValue.Untyped));
     }
   } else {
     // If we have a previous stack frame, and we have a previous call,
@@ -860,7 +867,7 @@ void Interpreter::popStackAndReturnValueToCaller(Type *RetTy,
 }
 
 void Interpreter::visitReturnInst(ReturnInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Type *RetTy = Type::getVoidTy(I.getContext());
   GenericValue Result;
 
@@ -878,7 +885,7 @@ void Interpreter::visitUnreachableInst(UnreachableInst &I) {
 }
 
 void Interpreter::visitBranchInst(BranchInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   BasicBlock *Dest;
 
   Dest = I.getSuccessor(0);          // Uncond branches have a fixed dest...
@@ -891,7 +898,7 @@ void Interpreter::visitBranchInst(BranchInst &I) {
 }
 
 void Interpreter::visitSwitchInst(SwitchInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Value* Cond = I.getCondition();
   Type *ElTy = Cond->getType();
   GenericValue CondVal = getOperandValue(Cond, SF);
@@ -910,7 +917,7 @@ void Interpreter::visitSwitchInst(SwitchInst &I) {
 }
 
 void Interpreter::visitIndirectBrInst(IndirectBrInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   void *Dest = GVTOP(getOperandValue(I.getAddress(), SF));
   SwitchToNewBasicBlock((BasicBlock*)Dest, SF);
 }
@@ -959,7 +966,7 @@ void Interpreter::SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF){
 //===----------------------------------------------------------------------===//
 
 void Interpreter::visitAllocaInst(AllocaInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
 
   Type *Ty = I.getType()->getElementType();  // Type to be allocated
 
@@ -984,7 +991,7 @@ void Interpreter::visitAllocaInst(AllocaInst &I) {
   SetValue(&I, Result, SF);
 
   if (I.getOpcode() == Instruction::Alloca)
-    ECStack.back().Allocas.add(Memory);
+    getECStack().back().Allocas.add(Memory);
 }
 
 // getElementOffset - The workhorse for getelementptr.
@@ -1030,13 +1037,13 @@ GenericValue Interpreter::executeGEPOperation(Value *Ptr, gep_type_iterator I,
 }
 
 void Interpreter::visitGetElementPtrInst(GetElementPtrInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeGEPOperation(I.getPointerOperand(),
                                    gep_type_begin(I), gep_type_end(I), SF), SF);
 }
 
 void Interpreter::visitLoadInst(LoadInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   GenericValue SRC = getOperandValue(I.getPointerOperand(), SF);
   GenericValue *Ptr = (GenericValue*)GVTOP(SRC);
   GenericValue Result;
@@ -1047,7 +1054,7 @@ void Interpreter::visitLoadInst(LoadInst &I) {
 }
 
 void Interpreter::visitStoreInst(StoreInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   GenericValue Val = getOperandValue(I.getOperand(0), SF);
   GenericValue SRC = getOperandValue(I.getPointerOperand(), SF);
   StoreValueToMemory(Val, (GenericValue *)GVTOP(SRC),
@@ -1061,7 +1068,7 @@ void Interpreter::visitStoreInst(StoreInst &I) {
 //===----------------------------------------------------------------------===//
 
 void Interpreter::visitCallSite(CallSite CS) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
 
   // Check to see if this is an intrinsic function call...
   Function *F = CS.getCalledFunction();
@@ -1071,7 +1078,7 @@ void Interpreter::visitCallSite(CallSite CS) {
       break;
     case Intrinsic::vastart: { // va_start
       GenericValue ArgIndex;
-      ArgIndex.UIntPairVal.first = ECStack.size() - 1;
+      ArgIndex.UIntPairVal.first = getECStack().size() - 1;
       ArgIndex.UIntPairVal.second = 0;
       SetValue(CS.getInstruction(), ArgIndex, SF);
       return;
@@ -1085,21 +1092,10 @@ void Interpreter::visitCallSite(CallSite CS) {
       // If it is an unknown intrinsic function, use the intrinsic lowering
       // class to transform it into hopefully tasty LLVM code.
       //
-      BasicBlock::iterator me(CS.getInstruction());
-      BasicBlock *Parent = CS.getInstruction()->getParent();
-      bool atBegin(Parent->begin() == me);
-      if (!atBegin)
-        --me;
-      IL->LowerIntrinsicCall(cast<CallInst>(CS.getInstruction()));
-
-      // Restore the CurInst pointer to the first instruction newly inserted, if
-      // any.
-      if (atBegin) {
-        SF.CurInst = Parent->begin();
-      } else {
-        SF.CurInst = me;
-        ++SF.CurInst;
-      }
+      // Back up so that this thread, like any other thread stopped at this
+      // call, resumes at the first instruction newly inserted.
+      --SF.CurInst;
+      lowerIntrinsicCall(cast<CallInst>(CS.getInstruction()));
       return;
     }
 
@@ -1121,6 +1117,30 @@ void Interpreter::visitCallSite(CallSite CS) {
   callFunction((Function*)GVTOP(SRC), ArgVals);
 }
 
+void Interpreter::lowerIntrinsicCall(CallInst *CI) {
+  BasicBlock::iterator me(CI);
+  BasicBlock *Parent = CI->getParent();
+  bool atBegin(Parent->begin() == me);
+  BasicBlock::iterator Prev = me;
+  if (!atBegin)
+    --Prev;
+  IL->LowerIntrinsicCall(CI);
+
+  // The call has been erased.  Point any frame that was about to execute it at
+  // the first instruction newly inserted, if any.
+  BasicBlock::iterator Next = Prev;
+  if (atBegin)
+    Next = Parent->begin();
+  else
+    ++Next;
+
+  sys::ScopedLock Guard(ThreadsLock);
+  for (auto &T : Threads)
+    for (ExecutionContext &Frame : T->ECStack)
+      if (Frame.CurInst == me)
+        Frame.CurInst = Next;
+}
+
 // auxiliary function for shift operations
 static unsigned getShiftAmount(uint64_t orgShiftAmount,
                                llvm::APInt valueToShift) {
@@ -1134,7 +1154,7 @@ static unsigned getShiftAmount(uint64_t orgShiftAmount,
 
 
 void Interpreter::visitShl(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
   GenericValue Dest;
@@ -1161,7 +1181,7 @@ void Interpreter::visitShl(BinaryOperator &I) {
 }
 
 void Interpreter::visitLShr(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
   GenericValue Dest;
@@ -1188,7 +1208,7 @@ void Interpreter::visitLShr(BinaryOperator &I) {
 }
 
 void Interpreter::visitAShr(BinaryOperator &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
   GenericValue Dest;
@@ -1652,62 +1672,62 @@ GenericValue Interpreter::executeBitCastInst(Value *SrcVal, Type *DstTy,
 }
 
 void Interpreter::visitTruncInst(TruncInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeTruncInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitSExtInst(SExtInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeSExtInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitZExtInst(ZExtInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeZExtInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitFPTruncInst(FPTruncInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeFPTruncInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitFPExtInst(FPExtInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeFPExtInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitUIToFPInst(UIToFPInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeUIToFPInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitSIToFPInst(SIToFPInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeSIToFPInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitFPToUIInst(FPToUIInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeFPToUIInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitFPToSIInst(FPToSIInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeFPToSIInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitPtrToIntInst(PtrToIntInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executePtrToIntInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitIntToPtrInst(IntToPtrInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeIntToPtrInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
 void Interpreter::visitBitCastInst(BitCastInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   SetValue(&I, executeBitCastInst(I.getOperand(0), I.getType(), SF), SF);
 }
 
@@ -1715,13 +1735,13 @@ void Interpreter::visitBitCastInst(BitCastInst &I) {
    case Type::TY##TyID: Dest.TY##Val = Src.TY##Val; break
 
 void Interpreter::visitVAArgInst(VAArgInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
 
   // Get the incoming valist parameter.  LLI treats the valist as a
   // (ec-stack-depth var-arg-index) pair.
   GenericValue VAList = getOperandValue(I.getOperand(0), SF);
   GenericValue Dest;
-  GenericValue Src = ECStack[VAList.UIntPairVal.first]
+  GenericValue Src = getECStack()[VAList.UIntPairVal.first]
                       .VarArgs[VAList.UIntPairVal.second];
   Type *Ty = I.getType();
   switch (Ty->getTypeID()) {
@@ -1744,7 +1764,7 @@ void Interpreter::visitVAArgInst(VAArgInst &I) {
 }
 
 void Interpreter::visitExtractElementInst(ExtractElementInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   GenericValue Src1 = getOperandValue(I.getOperand(0), SF);
   GenericValue Src2 = getOperandValue(I.getOperand(1), SF);
   GenericValue Dest;
@@ -1777,7 +1797,7 @@ void Interpreter::visitExtractElementInst(ExtractElementInst &I) {
 }
 
 void Interpreter::visitInsertElementInst(InsertElementInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Type *Ty = I.getType();
 
   if(!(Ty->isVectorTy()) )
@@ -1812,7 +1832,7 @@ void Interpreter::visitInsertElementInst(InsertElementInst &I) {
 }
 
 void Interpreter::visitShuffleVectorInst(ShuffleVectorInst &I){
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
 
   Type *Ty = I.getType();
   if(!(Ty->isVectorTy()))
@@ -1882,7 +1902,7 @@ void Interpreter::visitShuffleVectorInst(ShuffleVectorInst &I){
 }
 
 void Interpreter::visitExtractValueInst(ExtractValueInst &I) {
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Value *Agg = I.getAggregateOperand();
   GenericValue Dest;
   GenericValue Src = getOperandValue(Agg, SF);
@@ -1925,7 +1945,7 @@ void Interpreter::visitExtractValueInst(ExtractValueInst &I) {
 
 void Interpreter::visitInsertValueInst(InsertValueInst &I) {
 
-  ExecutionContext &SF = ECStack.back();
+  ExecutionContext &SF = getECStack().back();
   Value *Agg = I.getAggregateOperand();
 
   GenericValue Src1 = getOperandValue(Agg, SF);
@@ -2074,6 +2094,7 @@ GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
 //
 void Interpreter::callFunction(Function *F,
                                const std::vector<GenericValue> &ArgVals) {
+  std::vector<ExecutionContext> &ECStack = getECStack();
   assert((ECStack.empty() || !ECStack.back().Caller.getInstruction() ||
           ECStack.back().Caller.arg_size() == ArgVals.size()) &&
          "Incorrect number of arguments passed into function call!");
@@ -2111,9 +2132,18 @@ void Interpreter::callFunction(Function *F,
 
 
 void Interpreter::run() {
+  std::vector<ExecutionContext> &ECStack = getECStack();
+  unsigned InstsUntilYield = YieldInterval;
   while (!ECStack.empty()) {
+    // Give other threads waiting to run interpreted code a turn.  Do this
+    // before fetching the next instruction, which they may lower.
+    if (--InstsUntilYield == 0) {
+      InstsUntilYield = YieldInterval;
+      yieldInterpreter();
+    }
+
     // Interpret a single instruction & increment the "PC".
-    ExecutionContext &SF = ECStack.back();  // Current stack frame
+    ExecutionContext &SF = getECStack().back();  // Current stack frame
     Instruction &I = *SF.CurInst++;         // Increment before execute
 
     // Track the number of dynamic instructions executed.
@@ -34,6 +34,11 @@
 #include <cstdio>
 #include <cstring>
 #include <map>
+#include <memory>
+
+#if LLVM_ENABLE_THREADS && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
 
 #ifdef HAVE_FFI_CALL
 #ifdef HAVE_FFI_H
@@ -56,7 +61,22 @@ static ManagedStatic<std::map<std::string, ExFunc> > FuncNames;
 
 #ifdef USE_LIBFFI
 typedef void (*RawFunc)();
-static ManagedStatic<std::map<const Function *, RawFunc> > RawFunctions;
+
+// FFICallInfo - Everything needed to invoke an external function through
+// libffi that only depends on the callee.  The call interface is prepared the
+// first time the function is called and reused on every later call.
+namespace {
+struct FFICallInfo {
+  RawFunc Fn;
+  bool Prepared;
+  ffi_cif Cif;
+  std::vector<ffi_type *> ArgTypes;
+  unsigned ArgBytes;
+
+  FFICallInfo() : Fn(nullptr), Prepared(false), ArgBytes(0) {}
+};
+}
+static ManagedStatic<std::map<const Function *, FFICallInfo> > RawFunctions;
 #endif
 
 static Interpreter *TheInterpreter;
@@ -105,8 +125,9 @@ static ExFunc lookupFunction(const Function *F) {
     FnPtr = (ExFunc)(intptr_t)
       sys::DynamicLibrary::SearchForAddressOfSymbol("lle_X_" +
                                                     F->getName().str());
-  if (FnPtr)
-    ExportedFunctions->insert(std::make_pair(F, FnPtr));  // Cache for later
+  // Cache the result for later, including a failed lookup, so that functions
+  // called through libffi don't rebuild and search for the name every call.
+  ExportedFunctions->insert(std::make_pair(F, FnPtr));
   return FnPtr;
 }
 
@@ -179,10 +200,29 @@ static void *ffiValueFor(Type *Ty, const GenericValue &AV,
   return NULL;
 }
 
-static bool ffiInvoke(RawFunc Fn, Function *F,
+static bool ffiPrepare(FFICallInfo &CI, Function *F, const DataLayout *TD) {
+  FunctionType *FTy = F->getFunctionType();
+  const unsigned NumArgs = F->arg_size();
+
+  CI.ArgBytes = 0;
+  CI.ArgTypes.resize(NumArgs);
+  for (Function::const_arg_iterator A = F->arg_begin(), E = F->arg_end();
+       A != E; ++A) {
+    const unsigned ArgNo = A->getArgNo();
+    Type *ArgTy = FTy->getParamType(ArgNo);
+    CI.ArgTypes[ArgNo] = ffiTypeFor(ArgTy);
+    CI.ArgBytes += TD->getTypeStoreSize(ArgTy);
+  }
+
+  ffi_type *rtype = ffiTypeFor(FTy->getReturnType());
+  CI.Prepared = ffi_prep_cif(&CI.Cif, FFI_DEFAULT_ABI, NumArgs, rtype,
+                             CI.ArgTypes.data()) == FFI_OK;
+  return CI.Prepared;
+}
+
+static bool ffiInvoke(FFICallInfo &CI, Function *F,
                       const std::vector<GenericValue> &ArgVals,
                       const DataLayout *TD, GenericValue &Result) {
-  ffi_cif cif;
   FunctionType *FTy = F->getFunctionType();
   const unsigned NumArgs = F->arg_size();
 
@@ -193,19 +233,11 @@ static bool ffiInvoke(RawFunc Fn, Function *F,
                       + "' is not supported by the Interpreter.");
   }
 
-  unsigned ArgBytes = 0;
-
-  std::vector<ffi_type*> args(NumArgs);
-  for (Function::const_arg_iterator A = F->arg_begin(), E = F->arg_end();
-       A != E; ++A) {
-    const unsigned ArgNo = A->getArgNo();
-    Type *ArgTy = FTy->getParamType(ArgNo);
-    args[ArgNo] = ffiTypeFor(ArgTy);
-    ArgBytes += TD->getTypeStoreSize(ArgTy);
-  }
+  if (!CI.Prepared)
+    return false;
 
   SmallVector<uint8_t, 128> ArgData;
-  ArgData.resize(ArgBytes);
+  ArgData.resize(CI.ArgBytes);
   uint8_t *ArgDataPtr = ArgData.data();
   SmallVector<void*, 16> values(NumArgs);
   for (Function::const_arg_iterator A = F->arg_begin(), E = F->arg_end();
@@ -217,31 +249,25 @@ static bool ffiInvoke(RawFunc Fn, Function *F,
   }
 
   Type *RetTy = FTy->getReturnType();
-  ffi_type *rtype = ffiTypeFor(RetTy);
-
-  if (ffi_prep_cif(&cif, FFI_DEFAULT_ABI, NumArgs, rtype, &args[0]) == FFI_OK) {
-    SmallVector<uint8_t, 128> ret;
-    if (RetTy->getTypeID() != Type::VoidTyID)
-      ret.resize(TD->getTypeStoreSize(RetTy));
-    ffi_call(&cif, Fn, ret.data(), values.data());
-    switch (RetTy->getTypeID()) {
-      case Type::IntegerTyID:
-        switch (cast<IntegerType>(RetTy)->getBitWidth()) {
-          case 8:  Result.IntVal = APInt(8 , *(int8_t *) ret.data()); break;
-          case 16: Result.IntVal = APInt(16, *(int16_t*) ret.data()); break;
-          case 32: Result.IntVal = APInt(32, *(int32_t*) ret.data()); break;
-          case 64: Result.IntVal = APInt(64, *(int64_t*) ret.data()); break;
-        }
-        break;
-      case Type::FloatTyID:   Result.FloatVal   = *(float *) ret.data(); break;
-      case Type::DoubleTyID:  Result.DoubleVal  = *(double*) ret.data(); break;
-      case Type::PointerTyID: Result.PointerVal = *(void **) ret.data(); break;
-      default: break;
-    }
-    return true;
+  SmallVector<uint8_t, 128> ret;
+  if (RetTy->getTypeID() != Type::VoidTyID)
+    ret.resize(TD->getTypeStoreSize(RetTy));
+  ffi_call(&CI.Cif, CI.Fn, ret.data(), values.data());
+  switch (RetTy->getTypeID()) {
+    case Type::IntegerTyID:
+      switch (cast<IntegerType>(RetTy)->getBitWidth()) {
+        case 8:  Result.IntVal = APInt(8 , *(int8_t *) ret.data()); break;
+        case 16: Result.IntVal = APInt(16, *(int16_t*) ret.data()); break;
+        case 32: Result.IntVal = APInt(32, *(int32_t*) ret.data()); break;
+        case 64: Result.IntVal = APInt(64, *(int64_t*) ret.data()); break;
+      }
+      break;
+    case Type::FloatTyID:   Result.FloatVal   = *(float *) ret.data(); break;
+    case Type::DoubleTyID:  Result.DoubleVal  = *(double*) ret.data(); break;
+    case Type::PointerTyID: Result.PointerVal = *(void **) ret.data(); break;
+    default: break;
   }
-
-  return false;
+  return true;
 }
 #endif // USE_LIBFFI
 
@@ -261,24 +287,36 @@ GenericValue Interpreter::callExternalFunction(Function *F,
   }
 
 #ifdef USE_LIBFFI
-  std::map<const Function *, RawFunc>::iterator RF = RawFunctions->find(F);
-  RawFunc RawFn;
+  std::map<const Function *, FFICallInfo>::iterator RF = RawFunctions->find(F);
   if (RF == RawFunctions->end()) {
-    RawFn = (RawFunc)(intptr_t)
+    RF = RawFunctions->insert(std::make_pair(F, FFICallInfo())).first;
+    RawFunc RawFn = (RawFunc)(intptr_t)
       sys::DynamicLibrary::SearchForAddressOfSymbol(F->getName());
     if (!RawFn)
       RawFn = (RawFunc)(intptr_t)getPointerToGlobalIfAvailable(F);
-    if (RawFn != 0)
-      RawFunctions->insert(std::make_pair(F, RawFn));  // Cache for later
-  } else {
-    RawFn = RF->second;
+    RF->second.Fn = RawFn;
   }
+  // Entries are only erased when their module goes away, so the reference
+  // stays valid after the lock is dropped.
+  FFICallInfo &CI = RF->second;
+  if (CI.Fn != 0 && !CI.Prepared)
+    ffiPrepare(CI, F, getDataLayout());
 
   Guard.unlock();
 
-  GenericValue Result;
-  if (RawFn != 0 && ffiInvoke(RawFn, F, ArgVals, getDataLayout(), Result))
-    return Result;
+  if (CI.Fn != 0 && CI.Prepared) {
+    // Other threads may run interpreted code while this one is in native
+    // code, which may itself block waiting for them (pthread_join, say).
+    GenericValue Result;
+    bool Locked = getThread().LockDepth != 0;
+    if (Locked)
+      unlockInterpreter();
+    bool Called = ffiInvoke(CI, F, ArgVals, getDataLayout(), Result);
+    if (Locked)
+      lockInterpreter();
+    if (Called)
+      return Result;
+  }
 #endif // USE_LIBFFI
 
   if (F->getName() == "__main")
@@ -293,6 +331,16 @@ GenericValue Interpreter::callExternalFunction(Function *F,
   return GenericValue();
 }
 
+void Interpreter::forgetExternalFunctions(Module *M) {
+  sys::ScopedLock Writer(*FunctionsLock);
+  for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F) {
+    ExportedFunctions->erase(F);
+#ifdef USE_LIBFFI
+    RawFunctions->erase(F);
+#endif
+  }
+}
+
 
 //===----------------------------------------------------------------------===//
 //  Functions "exported" to the running application...
@@ -496,6 +544,69 @@ static GenericValue lle_X_memcpy(FunctionType *FT,
   return GV;
 }
 
+#if LLVM_ENABLE_THREADS && defined(HAVE_PTHREAD_H)
+namespace {
+// The interpreted function a new thread should run, and its argument.
+struct ThreadStart {
+  Interpreter *Interp;
+  Function *F;
+  GenericValue Arg;
+};
+}
+
+static void *runInterpretedThread(void *Arg) {
+  std::unique_ptr<ThreadStart> Start(static_cast<ThreadStart *>(Arg));
+  Function *F = Start->F;
+  GenericValue Result =
+      Start->Interp->runFunction(F, std::vector<GenericValue>(1, Start->Arg));
+  Start->Interp->releaseThread();
+  return F->getReturnType()->isPointerTy() ? GVTOP(Result) : nullptr;
+}
+
+// int pthread_create(pthread_t *, const pthread_attr_t *,
+//                    void *(*)(void *), void *)
+static GenericValue lle_X_pthread_create(FunctionType *FT,
+                                         const std::vector<GenericValue> &Args) {
+  assert(Args.size() == 4);
+  ThreadStart *Start = new ThreadStart();
+  Start->Interp = TheInterpreter;
+  Start->F = (Function*)GVTOP(Args[2]);
+  Start->Arg = Args[3];
+
+  int Err = pthread_create((pthread_t *)GVTOP(Args[0]),
+                           (const pthread_attr_t *)GVTOP(Args[1]),
+                           runInterpretedThread, Start);
+  if (Err)
+    delete Start;
+  GenericValue GV;
+  GV.IntVal = APInt(32, Err);
+  return GV;
+}
+#endif
+
+// void *malloc(size_t)
+static GenericValue lle_X_malloc(FunctionType *FT,
+                                 const std::vector<GenericValue> &Args) {
+  assert(Args.size() == 1);
+  return PTOGV(malloc((size_t)Args[0].IntVal.getZExtValue()));
+}
+
+// void *calloc(size_t, size_t)
+static GenericValue lle_X_calloc(FunctionType *FT,
+                                 const std::vector<GenericValue> &Args) {
+  assert(Args.size() == 2);
+  return PTOGV(calloc((size_t)Args[0].IntVal.getZExtValue(),
+                      (size_t)Args[1].IntVal.getZExtValue()));
+}
+
+// void free(void *)
+static GenericValue lle_X_free(FunctionType *FT,
+                               const std::vector<GenericValue> &Args) {
+  assert(Args.size() == 1);
+  free(GVTOP(Args[0]));
+  return GenericValue();
+}
+
 void Interpreter::initializeExternalFunctions() {
   sys::ScopedLock Writer(*FunctionsLock);
   (*FuncNames)["lle_X_atexit"]       = lle_X_atexit;
@@ -509,4 +620,10 @@ void Interpreter::initializeExternalFunctions() {
   (*FuncNames)["lle_X_fprintf"]      = lle_X_fprintf;
   (*FuncNames)["lle_X_memset"]       = lle_X_memset;
   (*FuncNames)["lle_X_memcpy"]       = lle_X_memcpy;
+  (*FuncNames)["lle_X_malloc"]       = lle_X_malloc;
+  (*FuncNames)["lle_X_calloc"]       = lle_X_calloc;
+  (*FuncNames)["lle_X_free"]         = lle_X_free;
+#if LLVM_ENABLE_THREADS && defined(HAVE_PTHREAD_H)
+  (*FuncNames)["lle_X_pthread_create"] = lle_X_pthread_create;
+#endif
 }
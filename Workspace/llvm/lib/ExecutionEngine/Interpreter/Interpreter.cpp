@@ -15,9 +15,13 @@
 
 #include "Interpreter.h"
 #include "llvm/CodeGen/IntrinsicLowering.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
 #include <cstring>
+#if LLVM_ENABLE_THREADS
+#include <thread>
+#endif
 using namespace llvm;
 
 namespace {
@@ -49,9 +53,9 @@ ExecutionEngine *Interpreter::create(std::unique_ptr<Module> M,
 // Interpreter ctor - Initialize stuff
 //
 Interpreter::Interpreter(std::unique_ptr<Module> M)
-  : ExecutionEngine(std::move(M)), TD(Modules.back().get()) {
+  : ExecutionEngine(std::move(M)), TD(Modules.back().get()),
+    InterpreterLock(/*recursive=*/false), NumWaiting(0) {
 
-  memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
   setDataLayout(&TD);
   // Initialize the "backend"
   initializeExecutionEngine();
@@ -62,15 +66,94 @@ Interpreter::Interpreter(std::unique_ptr<Module> M)
 }
 
 Interpreter::~Interpreter() {
+  for (auto &M : Modules)
+    forgetExternalFunctions(M.get());
   delete IL;
 }
 
+bool Interpreter::removeModule(Module *M) {
+  if (!ExecutionEngine::removeModule(M))
+    return false;
+  forgetExternalFunctions(M);
+  return true;
+}
+
+bool Interpreter::saveGlobalsSnapshot(StringRef Path, std::string &ErrMsg) {
+  if (!AtExitHandlers.empty()) {
+    ErrMsg = "program registered atexit handlers, which cannot be saved in "
+             "a snapshot";
+    return true;
+  }
+  return ExecutionEngine::saveGlobalsSnapshot(Path, ErrMsg);
+}
+
+InterpreterThread &Interpreter::getThread() {
+  if (InterpreterThread *T = CurrentThread.get())
+    return *T;
+
+  InterpreterThread *T = new InterpreterThread();
+  {
+    sys::ScopedLock Guard(ThreadsLock);
+    Threads.push_back(std::unique_ptr<InterpreterThread>(T));
+  }
+  CurrentThread.set(T);
+  return *T;
+}
+
+void Interpreter::releaseThread() {
+  InterpreterThread *T = CurrentThread.get();
+  if (!T)
+    return;
+  assert(T->LockDepth == 0 && T->ECStack.empty() &&
+         "Releasing a thread that is still running code!");
+  CurrentThread.set(nullptr);
+
+  sys::ScopedLock Guard(ThreadsLock);
+  for (auto I = Threads.begin(), E = Threads.end(); I != E; ++I)
+    if (I->get() == T) {
+      Threads.erase(I);
+      break;
+    }
+}
+
+void Interpreter::lockInterpreter() {
+  if (InterpreterLock.try_lock())
+    return;
+  sys::AtomicIncrement(&NumWaiting);
+  InterpreterLock.lock();
+  sys::AtomicDecrement(&NumWaiting);
+}
+
+void Interpreter::enterInterpreter(InterpreterThread &T) {
+  if (T.LockDepth++ == 0)
+    lockInterpreter();
+}
+
+void Interpreter::leaveInterpreter(InterpreterThread &T) {
+  assert(T.LockDepth && "Interpreter lock not held!");
+  if (--T.LockDepth == 0)
+    unlockInterpreter();
+}
+
+void Interpreter::yieldInterpreter() {
+  if (!NumWaiting)
+    return;
+  unlockInterpreter();
+#if LLVM_ENABLE_THREADS
+  std::this_thread::yield();
+#endif
+  lockInterpreter();
+}
+
 void Interpreter::runAtExitHandlers () {
+  InterpreterThread &T = getThread();
+  enterInterpreter(T);
   while (!AtExitHandlers.empty()) {
     callFunction(AtExitHandlers.back(), std::vector<GenericValue>());
     AtExitHandlers.pop_back();
     run();
   }
+  leaveInterpreter(T);
 }
 
 /// run - Start execution with the specified function and arguments.
@@ -92,11 +175,16 @@ Interpreter::runFunction(Function *F,
   for (unsigned i = 0; i < ArgCount; ++i)
     ActualArgs.push_back(ArgValues[i]);
 
+  InterpreterThread &T = getThread();
+  enterInterpreter(T);
+
   // Set up the function call.
   callFunction(F, ActualArgs);
 
   // Start executing the function.
   run();
 
-  return ExitValue;
+  GenericValue Result = T.ExitValue;
+  leaveInterpreter(T);
+  return Result;
 }
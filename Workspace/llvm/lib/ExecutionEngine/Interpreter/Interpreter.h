@@ -20,9 +20,14 @@
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstVisitor.h"
+#include "llvm/Support/Atomic.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadLocal.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <memory>
 namespace llvm {
 
 class IntrinsicLowering;
@@ -91,17 +96,46 @@ struct ExecutionContext {
   }
 };
 
-// Interpreter - This class represents the entirety of the interpreter.
+// InterpreterThread - The execution state of one native thread running
+// interpreted code.
 //
-class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
+struct InterpreterThread {
   GenericValue ExitValue;          // The return value of the called function
-  DataLayout TD;
-  IntrinsicLowering *IL;
 
   // The runtime stack of executing code.  The top of the stack is the current
   // function record.
   std::vector<ExecutionContext> ECStack;
 
+  // Number of nested runFunction/runAtExitHandlers calls on this thread that
+  // hold the interpreter lock.
+  unsigned LockDepth;
+
+  InterpreterThread() : LockDepth(0) {
+    memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
+  }
+};
+
+// Interpreter - This class represents the entirety of the interpreter.
+//
+// Every native thread that runs interpreted code gets its own
+// InterpreterThread.  Everything else (the module, the intrinsic lowering and
+// the atexit handlers) is shared and protected by InterpreterLock, which a
+// thread holds while it interprets and drops around calls to native code and
+// periodically to let other threads make progress.
+//
+class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
+  DataLayout TD;
+  IntrinsicLowering *IL;
+
+  // The interpreter lock, and the number of threads waiting to acquire it.
+  sys::Mutex InterpreterLock;
+  volatile sys::cas_flag NumWaiting;
+
+  // The state of the calling thread, and of every thread that has run code.
+  sys::ThreadLocal<InterpreterThread> CurrentThread;
+  sys::Mutex ThreadsLock;
+  std::vector<std::unique_ptr<InterpreterThread> > Threads;
+
   // AtExitHandlers - List of functions to call when the program exits,
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
@@ -124,6 +158,15 @@ public:
   static ExecutionEngine *create(std::unique_ptr<Module> M,
                                  std::string *ErrorStr = nullptr);
 
+  /// removeModule - Remove a Module from the list of modules, dropping any
+  /// cached external function information for its functions.
+  bool removeModule(Module *M) override;
+
+  /// saveGlobalsSnapshot - As ExecutionEngine::saveGlobalsSnapshot, but fail
+  /// if the program has registered atexit handlers, which aren't part of a
+  /// snapshot.
+  bool saveGlobalsSnapshot(StringRef Path, std::string &ErrMsg) override;
+
   /// run - Start execution with the specified function and arguments.
   ///
   GenericValue runFunction(Function *F,
@@ -202,10 +245,37 @@ public:
   }
 
   GenericValue *getFirstVarArg () {
-    return &(ECStack.back ().VarArgs[0]);
+    return &(getECStack().back ().VarArgs[0]);
   }
 
+  /// releaseThread - Discard the state of the calling thread once it has
+  /// finished running interpreted code.
+  void releaseThread();
+
 private:  // Helper functions
+  /// getThread - Return the state of the calling thread, creating it the first
+  /// time the thread runs interpreted code.
+  InterpreterThread &getThread();
+
+  std::vector<ExecutionContext> &getECStack() { return getThread().ECStack; }
+
+  // Acquire and release the interpreter lock on behalf of thread T.  The lock
+  // itself is not recursive, so nested calls only adjust T.LockDepth.
+  void enterInterpreter(InterpreterThread &T);
+  void leaveInterpreter(InterpreterThread &T);
+
+  // Drop the interpreter lock while the calling thread runs native code, and
+  // take it back afterwards.
+  void lockInterpreter();
+  void unlockInterpreter() { InterpreterLock.unlock(); }
+
+  // Let waiting threads take the interpreter lock, if there are any.
+  void yieldInterpreter();
+
+  // Lower the call to an intrinsic CI into plain instructions, moving any
+  // thread that was about to execute it to the replacement code.
+  void lowerIntrinsicCall(CallInst *CI);
+
   GenericValue executeGEPOperation(Value *Ptr, gep_type_iterator I,
                                    gep_type_iterator E, ExecutionContext &SF);
 
@@ -219,6 +289,7 @@ private:  // Helper functions
 
   void initializeExecutionEngine() { }
   void initializeExternalFunctions();
+  void forgetExternalFunctions(Module *M);
   GenericValue getConstantExprValue(ConstantExpr *CE, ExecutionContext &SF);
   GenericValue getOperandValue(Value *V, ExecutionContext &SF);
   GenericValue executeTruncInst(Value *SrcVal, Type *DstTy,
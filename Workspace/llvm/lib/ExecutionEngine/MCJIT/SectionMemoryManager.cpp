@@ -15,9 +15,17 @@
 #include "llvm/Config/config.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
 
 namespace llvm {
 
+SectionMemoryManager::SectionMemoryManager(uintptr_t SlabSize,
+                                           bool UseHugePages)
+    : SlabSize(SlabSize), UseHugePages(UseHugePages) {
+  if (UseHugePages)
+    this->SlabSize = RoundUpToAlignment(SlabSize, HugePageSize);
+}
+
 uint8_t *SectionMemoryManager::allocateDataSection(uintptr_t Size,
                                                    unsigned Alignment,
                                                    unsigned SectionID,
@@ -58,24 +66,28 @@ uint8_t *SectionMemoryManager::allocateSection(MemoryGroup &MemGroup,
       // Store cutted free memory block.
       MemGroup.FreeMem[i] = sys::MemoryBlock((void*)(Addr + Size),
                                              EndOfBlock - Addr - Size);
+      MemGroup.PendingMem.push_back(sys::MemoryBlock((void*)Addr, Size));
       return (uint8_t*)Addr;
     }
   }
 
-  // No pre-allocated free block was large enough. Allocate a new memory region.
-  // Note that all sections get allocated as read-write.  The permissions will
-  // be updated later based on memory group.
-  //
-  // FIXME: It would be useful to define a default allocation size (or add
-  // it as a constructor parameter) to minimize the number of allocations.
+  // No pre-allocated free block was large enough. Allocate a new slab.  Note
+  // that all sections get allocated as read-write.  The permissions will be
+  // updated later based on memory group.
   //
   // FIXME: Initialize the Near member for each memory group to avoid
   // interleaving.
+  unsigned Flags = sys::Memory::MF_READ | sys::Memory::MF_WRITE;
+  uintptr_t MapSize = std::max(RequiredSize, SlabSize);
+  if (UseHugePages) {
+    MapSize = RoundUpToAlignment(MapSize, HugePageSize);
+    Flags |= sys::Memory::MF_HUGE_HINT;
+  }
+
   std::error_code ec;
-  sys::MemoryBlock MB = sys::Memory::allocateMappedMemory(RequiredSize,
+  sys::MemoryBlock MB = sys::Memory::allocateMappedMemory(MapSize,
                                                           &MemGroup.Near,
-                                                          sys::Memory::MF_READ |
-                                                            sys::Memory::MF_WRITE,
+                                                          Flags,
                                                           ec);
   if (ec) {
     // FIXME: Add error propagation to the interface.
@@ -91,10 +103,11 @@ uint8_t *SectionMemoryManager::allocateSection(MemoryGroup &MemGroup,
 
   // Align the address.
   Addr = (Addr + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+  MemGroup.PendingMem.push_back(sys::MemoryBlock((void*)Addr, Size));
 
-  // The allocateMappedMemory may allocate much more memory than we need. In
-  // this case, we store the unused memory as a free memory block.
-  unsigned FreeSize = EndOfBlock-Addr-Size;
+  // The slab is usually much larger than the section. Store the unused memory
+  // as a free memory block.
+  uintptr_t FreeSize = EndOfBlock-Addr-Size;
   if (FreeSize > 16)
     MemGroup.FreeMem.push_back(sys::MemoryBlock((void*)(Addr + Size), FreeSize));
 
@@ -102,13 +115,48 @@ uint8_t *SectionMemoryManager::allocateSection(MemoryGroup &MemGroup,
   return (uint8_t*)Addr;
 }
 
+// Round a block out to whole pages.
+static sys::MemoryBlock extendToPageBoundaries(const sys::MemoryBlock &M) {
+  static const uintptr_t PageSize = sys::Process::getPageSize();
+
+  uintptr_t Start = (uintptr_t)M.base() & ~(PageSize - 1);
+  uintptr_t End = RoundUpToAlignment((uintptr_t)M.base() + M.size(),
+                                     PageSize);
+  return sys::MemoryBlock((void *)Start, End - Start);
+}
+
+// Shrink a free block to the whole pages it contains, so that it no longer
+// shares a page with memory whose permissions are about to change.
+static sys::MemoryBlock trimToPageBoundaries(const sys::MemoryBlock &M) {
+  static const uintptr_t PageSize = sys::Process::getPageSize();
+
+  uintptr_t Start = RoundUpToAlignment((uintptr_t)M.base(), PageSize);
+  uintptr_t End = ((uintptr_t)M.base() + M.size()) & ~(PageSize - 1);
+  if (End <= Start)
+    return sys::MemoryBlock();
+  return sys::MemoryBlock((void *)Start, End - Start);
+}
+
+// Keep only the whole free pages of a group whose permissions are changing.
+// They are still read-write and can be handed out for later objects.
+static void trimFreeMemory(SmallVectorImpl<sys::MemoryBlock> &FreeMem) {
+  unsigned Kept = 0;
+  for (unsigned i = 0, e = FreeMem.size(); i != e; ++i) {
+    sys::MemoryBlock Trimmed = trimToPageBoundaries(FreeMem[i]);
+    if (Trimmed.size())
+      FreeMem[Kept++] = Trimmed;
+  }
+  FreeMem.resize(Kept);
+}
+
 bool SectionMemoryManager::finalizeMemory(std::string *ErrMsg)
 {
   // FIXME: Should in-progress permissions be reverted if an error occurs?
   std::error_code ec;
 
-  // Don't allow free memory blocks to be used after setting protection flags.
-  CodeMem.FreeMem.clear();
+  // Don't allow free memory that shares a page with finalized code to be used
+  // after setting protection flags.
+  trimFreeMemory(CodeMem.FreeMem);
 
   // Make code memory executable.
   ec = applyMemoryGroupPermissions(CodeMem,
@@ -120,8 +168,9 @@ bool SectionMemoryManager::finalizeMemory(std::string *ErrMsg)
     return true;
   }
 
-  // Don't allow free memory blocks to be used after setting protection flags.
-  RODataMem.FreeMem.clear();
+  // Don't allow free memory that shares a page with finalized read-only data
+  // to be used after setting protection flags.
+  trimFreeMemory(RODataMem.FreeMem);
 
   // Make read-only data memory read-only.
   ec = applyMemoryGroupPermissions(RODataMem,
@@ -134,12 +183,16 @@ bool SectionMemoryManager::finalizeMemory(std::string *ErrMsg)
   }
 
   // Read-write data memory already has the correct permissions
+  RWDataMem.PendingMem.clear();
 
   // Some platforms with separate data cache and instruction cache require
   // explicit cache flush, otherwise JIT code manipulations (like resolved
   // relocations) will get to the data cache but not to the instruction cache.
   invalidateInstructionCache();
 
+  CodeMem.PendingMem.clear();
+  RODataMem.PendingMem.clear();
+
   return false;
 }
 
@@ -147,22 +200,36 @@ std::error_code
 SectionMemoryManager::applyMemoryGroupPermissions(MemoryGroup &MemGroup,
                                                   unsigned Permissions) {
 
-  for (int i = 0, e = MemGroup.AllocatedMem.size(); i != e; ++i) {
-    std::error_code ec;
-    ec =
-        sys::Memory::protectMappedMemory(MemGroup.AllocatedMem[i], Permissions);
-    if (ec) {
-      return ec;
+  // Only the sections allocated since the last finalization need their
+  // permissions changed; everything else already has them.  Adjacent pending
+  // sections usually share pages, so merge them into as few mprotect calls as
+  // possible.
+  sys::MemoryBlock Range;
+  for (int i = 0, e = MemGroup.PendingMem.size(); i != e; ++i) {
+    sys::MemoryBlock Pages = extendToPageBoundaries(MemGroup.PendingMem[i]);
+    uintptr_t RangeEnd = (uintptr_t)Range.base() + Range.size();
+    if (Range.size() && (uintptr_t)Pages.base() >= (uintptr_t)Range.base() &&
+        (uintptr_t)Pages.base() <= RangeEnd) {
+      uintptr_t PagesEnd = (uintptr_t)Pages.base() + Pages.size();
+      if (PagesEnd > RangeEnd)
+        Range = sys::MemoryBlock(Range.base(),
+                                 PagesEnd - (uintptr_t)Range.base());
+      continue;
     }
+
+    if (std::error_code ec = sys::Memory::protectMappedMemory(Range,
+                                                              Permissions))
+      return ec;
+    Range = Pages;
   }
 
-  return std::error_code();
+  return sys::Memory::protectMappedMemory(Range, Permissions);
 }
 
 void SectionMemoryManager::invalidateInstructionCache() {
-  for (int i = 0, e = CodeMem.AllocatedMem.size(); i != e; ++i)
-    sys::Memory::InvalidateInstructionCache(CodeMem.AllocatedMem[i].base(),
-                                            CodeMem.AllocatedMem[i].size());
+  for (int i = 0, e = CodeMem.PendingMem.size(); i != e; ++i)
+    sys::Memory::InvalidateInstructionCache(CodeMem.PendingMem[i].base(),
+                                            CodeMem.PendingMem[i].size());
 }
 
 SectionMemoryManager::~SectionMemoryManager() {
@@ -0,0 +1,373 @@
+//===-- PerfJITEventListener.cpp - Tell Linux's perf about JITted code ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a JITEventListener object that tells Linux's perf about
+// JITted functions.  Two files are written:
+//
+//  * /tmp/perf-<pid>.map, a plain "START SIZE NAME" symbol map that perf
+//    report uses to name samples falling into anonymous executable memory.
+//  * jit-<pid>.dump, in the jitdump format understood by "perf inject --jit".
+//    Every function is recorded together with a copy of its code, taken from
+//    the object file, and the line table found in the object's DWARF, so that
+//    perf can annotate the JITted code after the process has exited.
+//
+// The jitdump file is created in the directory named by the JITDUMPDIR
+// environment variable, or in the current directory if it is unset.  Note that
+// timestamps use CLOCK_MONOTONIC, so perf must be run with "-k 1".
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/config.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace llvm::object;
+
+#define DEBUG_TYPE "perf-jit-event-listener"
+
+namespace {
+
+// The jitdump on-disk format, see
+// tools/perf/Documentation/jitdump-specification.txt
+// in the Linux kernel sources.
+const uint32_t JitDumpMagic = 0x4A695444;
+const uint32_t JitDumpVersion = 1;
+
+enum JitDumpRecordType {
+  JIT_CODE_LOAD = 0,
+  JIT_CODE_MOVE = 1,
+  JIT_CODE_DEBUG_INFO = 2,
+  JIT_CODE_CLOSE = 3
+};
+
+struct JitDumpHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t TotalSize;
+  uint32_t ElfMach;
+  uint32_t Pad1;
+  uint32_t Pid;
+  uint64_t Timestamp;
+  uint64_t Flags;
+};
+
+struct JitDumpRecordPrefix {
+  uint32_t Id;
+  uint32_t TotalSize;
+  uint64_t Timestamp;
+};
+
+struct JitDumpCodeLoad {
+  JitDumpRecordPrefix Prefix;
+  uint32_t Pid;
+  uint32_t Tid;
+  uint64_t Vma;
+  uint64_t CodeAddr;
+  uint64_t CodeSize;
+  uint64_t CodeIndex;
+  // Followed by the NUL-terminated name and the code bytes.
+};
+
+struct JitDumpDebugInfo {
+  JitDumpRecordPrefix Prefix;
+  uint64_t CodeAddr;
+  uint64_t NrEntry;
+  // Followed by NrEntry JitDumpDebugEntry records.
+};
+
+struct JitDumpDebugEntry {
+  uint64_t Addr;
+  int32_t Line;
+  int32_t Discrim;
+  // Followed by the NUL-terminated file name.
+};
+
+class PerfJITEventListener : public JITEventListener {
+  sys::Mutex Lock;
+
+  // Output streams, null if the corresponding file could not be opened.
+  std::unique_ptr<raw_fd_ostream> PerfMap;
+  std::unique_ptr<raw_fd_ostream> JitDump;
+
+  // perf only picks up a jitdump file when it sees an executable mapping of
+  // it, so keep the header page mapped for the lifetime of the listener.
+  void *JitDumpMarker;
+
+  uint64_t CodeIndex;
+
+  void openPerfMap(uint32_t Pid);
+  void openJitDump(uint32_t Pid);
+
+  void writeCodeLoad(StringRef Name, uint64_t Addr, StringRef Code);
+  void writeDebugInfo(uint64_t Addr, const DILineInfoTable &Lines);
+
+public:
+  PerfJITEventListener();
+  ~PerfJITEventListener();
+
+  void NotifyObjectEmitted(const ObjectFile &Obj,
+                           const RuntimeDyld::LoadedObjectInfo &L) override;
+
+  void NotifyFreeingObject(const ObjectFile &Obj) override;
+};
+
+uint64_t getTimestamp() {
+  struct timespec TS;
+  if (clock_gettime(CLOCK_MONOTONIC, &TS))
+    return 0;
+  return (uint64_t)TS.tv_sec * 1000000000 + TS.tv_nsec;
+}
+
+uint32_t getThreadId() {
+  return (uint32_t)syscall(SYS_gettid);
+}
+
+// Find the code of the function \p Sym, which is loaded at \p Addr, in its
+// section of \p Obj.  The loaded code itself must not be read: with a remote
+// target it lives in another process.  Returns false if it can't be found.
+bool getFunctionCode(const ObjectFile &Obj, const SymbolRef &Sym,
+                     uint64_t Addr, uint64_t Size, StringRef &Code) {
+  section_iterator Sec = Obj.section_end();
+  StringRef Contents;
+  if (Sym.getSection(Sec) || Sec == Obj.section_end() ||
+      Sec->getContents(Contents))
+    return false;
+  uint64_t SecAddr = Sec->getAddress();
+  if (Addr < SecAddr || Addr - SecAddr > Contents.size() ||
+      Size > Contents.size() - (Addr - SecAddr))
+    return false;
+  Code = Contents.substr(Addr - SecAddr, Size);
+  return true;
+}
+
+// Read the ELF machine of the running executable, which is what perf expects
+// in the jitdump header.
+uint32_t getHostElfMachine() {
+  int FD = ::open("/proc/self/exe", O_RDONLY);
+  if (FD < 0)
+    return ELF::EM_NONE;
+  unsigned char Ident[20];
+  uint32_t Machine = ELF::EM_NONE;
+  if (::read(FD, Ident, sizeof(Ident)) == (ssize_t)sizeof(Ident) &&
+      memcmp(Ident, ELF::ElfMagic, strlen(ELF::ElfMagic)) == 0) {
+    // e_machine is a half-word at offset 18 in the target's byte order.
+    if (Ident[ELF::EI_DATA] == ELF::ELFDATA2LSB)
+      Machine = Ident[18] | (Ident[19] << 8);
+    else
+      Machine = (Ident[18] << 8) | Ident[19];
+  }
+  ::close(FD);
+  return Machine;
+}
+
+PerfJITEventListener::PerfJITEventListener()
+    : JitDumpMarker(nullptr), CodeIndex(0) {
+  uint32_t Pid = ::getpid();
+  openPerfMap(Pid);
+  openJitDump(Pid);
+}
+
+void PerfJITEventListener::openPerfMap(uint32_t Pid) {
+  SmallString<64> Path;
+  raw_svector_ostream(Path) << "/tmp/perf-" << Pid << ".map";
+
+  std::error_code EC;
+  PerfMap.reset(new raw_fd_ostream(Path, EC, sys::fs::F_Text));
+  if (EC) {
+    DEBUG(dbgs() << "Failed to open perf map " << Path << ": "
+                 << EC.message() << "\n");
+    PerfMap.reset();
+    return;
+  }
+  PerfMap->SetUnbuffered();
+}
+
+void PerfJITEventListener::openJitDump(uint32_t Pid) {
+  SmallString<128> Path;
+  if (const char *Dir = getenv("JITDUMPDIR"))
+    Path = Dir;
+  else if (sys::fs::current_path(Path))
+    return;
+  SmallString<32> FileName;
+  raw_svector_ostream(FileName) << "jit-" << Pid << ".dump";
+  sys::path::append(Path, FileName.str());
+
+  int FD;
+  if (std::error_code EC =
+          sys::fs::openFileForWrite(Path.str(), FD, sys::fs::F_RW)) {
+    DEBUG(dbgs() << "Failed to open jitdump file " << Path << ": "
+                 << EC.message() << "\n");
+    return;
+  }
+
+  JitDumpHeader Header;
+  memset(&Header, 0, sizeof(Header));
+  Header.Magic = JitDumpMagic;
+  Header.Version = JitDumpVersion;
+  Header.TotalSize = sizeof(Header);
+  Header.ElfMach = getHostElfMachine();
+  Header.Pid = Pid;
+  Header.Timestamp = getTimestamp();
+
+  JitDump.reset(new raw_fd_ostream(FD, /*shouldClose=*/true));
+  JitDump->write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+  JitDump->flush();
+
+  JitDumpMarker = ::mmap(nullptr, sys::Process::getPageSize(),
+                         PROT_READ | PROT_EXEC, MAP_PRIVATE, FD, 0);
+  if (JitDumpMarker == MAP_FAILED) {
+    DEBUG(dbgs() << "Failed to map jitdump marker: " << sys::StrError()
+                 << "\n");
+    JitDumpMarker = nullptr;
+  }
+}
+
+PerfJITEventListener::~PerfJITEventListener() {
+  MutexGuard Guard(Lock);
+  if (JitDump) {
+    JitDumpRecordPrefix Close;
+    Close.Id = JIT_CODE_CLOSE;
+    Close.TotalSize = sizeof(Close);
+    Close.Timestamp = getTimestamp();
+    JitDump->write(reinterpret_cast<const char *>(&Close), sizeof(Close));
+    JitDump->flush();
+  }
+  if (JitDumpMarker)
+    ::munmap(JitDumpMarker, sys::Process::getPageSize());
+}
+
+void PerfJITEventListener::writeCodeLoad(StringRef Name, uint64_t Addr,
+                                         StringRef Code) {
+  JitDumpCodeLoad Rec;
+  Rec.Prefix.Id = JIT_CODE_LOAD;
+  Rec.Prefix.TotalSize = sizeof(Rec) + Name.size() + 1 + Code.size();
+  Rec.Prefix.Timestamp = getTimestamp();
+  Rec.Pid = ::getpid();
+  Rec.Tid = getThreadId();
+  Rec.Vma = Addr;
+  Rec.CodeAddr = Addr;
+  Rec.CodeSize = Code.size();
+  Rec.CodeIndex = CodeIndex++;
+
+  JitDump->write(reinterpret_cast<const char *>(&Rec), sizeof(Rec));
+  JitDump->write(Name.data(), Name.size());
+  JitDump->write('\0');
+  JitDump->write(Code.data(), Code.size());
+}
+
+void PerfJITEventListener::writeDebugInfo(uint64_t Addr,
+                                          const DILineInfoTable &Lines) {
+  JitDumpDebugInfo Rec;
+  uint64_t TotalSize = sizeof(Rec);
+  for (const auto &Line : Lines)
+    TotalSize += sizeof(JitDumpDebugEntry) + Line.second.FileName.size() + 1;
+
+  Rec.Prefix.Id = JIT_CODE_DEBUG_INFO;
+  Rec.Prefix.TotalSize = TotalSize;
+  Rec.Prefix.Timestamp = getTimestamp();
+  Rec.CodeAddr = Addr;
+  Rec.NrEntry = Lines.size();
+  JitDump->write(reinterpret_cast<const char *>(&Rec), sizeof(Rec));
+
+  for (const auto &Line : Lines) {
+    JitDumpDebugEntry Entry;
+    Entry.Addr = Line.first;
+    Entry.Line = Line.second.Line;
+    Entry.Discrim = 0;
+    JitDump->write(reinterpret_cast<const char *>(&Entry), sizeof(Entry));
+    *JitDump << Line.second.FileName;
+    JitDump->write('\0');
+  }
+}
+
+void PerfJITEventListener::NotifyObjectEmitted(
+                                       const ObjectFile &Obj,
+                                       const RuntimeDyld::LoadedObjectInfo &L) {
+  if (!PerfMap && !JitDump)
+    return;
+
+  OwningBinary<ObjectFile> DebugObjOwner = L.getObjectForDebug(Obj);
+  const ObjectFile &DebugObj = *DebugObjOwner.getBinary();
+  std::unique_ptr<DIContext> Context;
+  if (JitDump)
+    Context.reset(DIContext::getDWARFContext(DebugObj));
+
+  MutexGuard Guard(Lock);
+
+  // Use symbol info to iterate functions in the object.
+  for (symbol_iterator I = DebugObj.symbol_begin(), E = DebugObj.symbol_end();
+       I != E; ++I) {
+    SymbolRef::Type SymType;
+    if (I->getType(SymType)) continue;
+    if (SymType != SymbolRef::ST_Function) continue;
+
+    StringRef Name;
+    uint64_t  Addr;
+    uint64_t  Size;
+    if (I->getName(Name)) continue;
+    if (I->getAddress(Addr)) continue;
+    if (I->getSize(Size)) continue;
+    if (Size == 0) continue;
+
+    if (PerfMap)
+      *PerfMap << format("%" PRIx64 " %" PRIx64 " ", Addr, Size) << Name
+               << "\n";
+
+    // The code comes from the object, so the jitdump shows it as it was
+    // before relocation.
+    StringRef Code;
+    if (JitDump && getFunctionCode(DebugObj, *I, Addr, Size, Code)) {
+      // perf expects the line table for a function before its code.
+      if (Context) {
+        DILineInfoTable Lines = Context->getLineInfoForAddressRange(Addr, Size);
+        if (!Lines.empty())
+          writeDebugInfo(Addr, Lines);
+      }
+      writeCodeLoad(Name, Addr, Code);
+    }
+  }
+
+  if (JitDump)
+    JitDump->flush();
+}
+
+void PerfJITEventListener::NotifyFreeingObject(const ObjectFile &Obj) {
+  // Neither format has a way to describe code being unloaded; perf resolves
+  // samples using the most recent load covering an address, so records for
+  // reused memory simply supersede the old ones.
+}
+
+}  // anonymous namespace.
+
+namespace llvm {
+JITEventListener *JITEventListener::createPerfJITEventListener() {
+  return new PerfJITEventListener();
+}
+
+} // namespace llvm
@@ -558,7 +558,9 @@ Constant *ConstantInt::getFalse(Type *Ty) {
 ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   // get an existing value or the insertion position
   LLVMContextImpl *pImpl = Context.pImpl;
-  ConstantInt *&Slot = pImpl->IntConstants[V];
+  unsigned Shard = LLVMContextImpl::getIntConstantsShard(V);
+  UniquingGuard Guard(pImpl->IntConstantsLocks[Shard]);
+  ConstantInt *&Slot = pImpl->IntConstants[Shard][V];
   if (!Slot) {
     // Get the corresponding integer type for the bit width of the value.
     IntegerType *ITy = IntegerType::get(Context, V.getBitWidth());
@@ -687,6 +689,7 @@ Constant *ConstantFP::getZeroValueForNegation(Type *Ty) {
 ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   LLVMContextImpl* pImpl = Context.pImpl;
 
+  UniquingGuard Guard(pImpl->FPConstantsLock);
   ConstantFP *&Slot = pImpl->FPConstants[V];
 
   if (!Slot) {
@@ -1344,7 +1347,9 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
   assert((Ty->isStructTy() || Ty->isArrayTy() || Ty->isVectorTy()) &&
          "Cannot create an aggregate zero of non-aggregate type!");
   
-  ConstantAggregateZero *&Entry = Ty->getContext().pImpl->CAZConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  UniquingGuard Guard(pImpl->ConstantsLock);
+  ConstantAggregateZero *&Entry = pImpl->CAZConstants[Ty];
   if (!Entry)
     Entry = new ConstantAggregateZero(Ty);
 
@@ -1354,7 +1359,10 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
 /// destroyConstant - Remove the constant from the constant table.
 ///
 void ConstantAggregateZero::destroyConstant() {
-  getContext().pImpl->CAZConstants.erase(getType());
+  {
+    UniquingGuard Guard(getContext().pImpl->ConstantsLock);
+    getContext().pImpl->CAZConstants.erase(getType());
+  }
   destroyConstantImpl();
 }
 
@@ -1424,7 +1432,9 @@ const APInt &Constant::getUniqueInteger() const {
 //
 
 ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
-  ConstantPointerNull *&Entry = Ty->getContext().pImpl->CPNConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  UniquingGuard Guard(pImpl->ConstantsLock);
+  ConstantPointerNull *&Entry = pImpl->CPNConstants[Ty];
   if (!Entry)
     Entry = new ConstantPointerNull(Ty);
 
@@ -1434,7 +1444,10 @@ ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
 // destroyConstant - Remove the constant from the constant table...
 //
 void ConstantPointerNull::destroyConstant() {
-  getContext().pImpl->CPNConstants.erase(getType());
+  {
+    UniquingGuard Guard(getContext().pImpl->ConstantsLock);
+    getContext().pImpl->CPNConstants.erase(getType());
+  }
   // Free the constant and any dangling references to it.
   destroyConstantImpl();
 }
@@ -1444,7 +1457,9 @@ void ConstantPointerNull::destroyConstant() {
 //
 
 UndefValue *UndefValue::get(Type *Ty) {
-  UndefValue *&Entry = Ty->getContext().pImpl->UVConstants[Ty];
+  LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  UniquingGuard Guard(pImpl->ConstantsLock);
+  UndefValue *&Entry = pImpl->UVConstants[Ty];
   if (!Entry)
     Entry = new UndefValue(Ty);
 
@@ -1454,8 +1469,11 @@ UndefValue *UndefValue::get(Type *Ty) {
 // destroyConstant - Remove the constant from the constant table.
 //
 void UndefValue::destroyConstant() {
+  {
+    UniquingGuard Guard(getContext().pImpl->ConstantsLock);
+    getContext().pImpl->UVConstants.erase(getType());
+  }
   // Free the constant and any dangling references to it.
-  getContext().pImpl->UVConstants.erase(getType());
   destroyConstantImpl();
 }
 
@@ -2449,6 +2467,7 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
     return ConstantAggregateZero::get(Ty);
 
   // Do a lookup to see if we have already formed one of these.
+  UniquingGuard Guard(Ty->getContext().pImpl->ConstantsLock);
   auto &Slot =
       *Ty->getContext()
            .pImpl->CDSConstants.insert(std::make_pair(Elements, nullptr))
@@ -2475,6 +2494,7 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
 
 void ConstantDataSequential::destroyConstant() {
   // Remove the constant from the StringMap.
+  UniquingGuard Guard(getContext().pImpl->ConstantsLock);
   StringMap<ConstantDataSequential*> &CDSConstants = 
     getType()->getContext().pImpl->CDSConstants;
 
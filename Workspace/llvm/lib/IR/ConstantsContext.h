@@ -22,6 +22,7 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 #include <map>
 #include <tuple>
@@ -30,6 +31,41 @@
 
 namespace llvm {
 
+/// UniquingLock - A lock protecting one of the uniquing tables of an
+/// LLVMContext.  It does nothing until the context is asked to unique
+/// concurrently, so that single-threaded clients don't pay for it.
+class UniquingLock {
+  sys::Mutex M;
+  bool Enabled;
+
+public:
+  UniquingLock() : Enabled(false) {}
+
+  /// enable - Start locking.  Only call this while no other thread can be
+  /// using the table.
+  void enable() { Enabled = true; }
+
+  void lock() {
+    if (Enabled)
+      M.lock();
+  }
+  void unlock() {
+    if (Enabled)
+      M.unlock();
+  }
+};
+
+/// UniquingGuard - Holds a UniquingLock for the lifetime of the guard.
+class UniquingGuard {
+  UniquingLock &L;
+  UniquingGuard(const UniquingGuard &) LLVM_DELETED_FUNCTION;
+  void operator=(const UniquingGuard &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit UniquingGuard(UniquingLock &L) : L(L) { L.lock(); }
+  ~UniquingGuard() { L.unlock(); }
+};
+
 /// UnaryConstantExpr - This class is private to Constants.cpp, and is used
 /// behind the scenes to implement unary constant exprs.
 class UnaryConstantExpr : public ConstantExpr {
@@ -548,8 +584,12 @@ public:
 
 private:
   MapTy Map;
+  UniquingLock Lock;
 
 public:
+  /// enableLocking - Make the table safe to use from several threads.
+  void enableLocking() { Lock.enable(); }
+
   typename MapTy::iterator map_begin() { return Map.begin(); }
   typename MapTy::iterator map_end() { return Map.end(); }
 
@@ -572,6 +612,7 @@ private:
 public:
   /// Return the specified constant from the map, creating it if necessary.
   ConstantClass *getOrCreate(TypeClass *Ty, ValType V) {
+    UniquingGuard Guard(Lock);
     LookupKey Lookup(Ty, V);
     ConstantClass *Result = nullptr;
 
@@ -595,6 +636,7 @@ public:
 
   /// Remove this constant from the map
   void remove(ConstantClass *CP) {
+    UniquingGuard Guard(Lock);
     typename MapTy::iterator I = Map.find(CP);
     assert(I != Map.end() && "Constant not found in constant table!");
     assert(I->first == CP && "Didn't find correct element?");
@@ -605,6 +647,7 @@ public:
                                         ConstantClass *CP, Value *From,
                                         Constant *To, unsigned NumUpdated = 0,
                                         unsigned OperandNo = ~0u) {
+    UniquingGuard Guard(Lock);
     LookupKey Lookup(CP->getType(), ValType(Operands, CP));
     auto I = find(Lookup);
     if (I != Map.end())
@@ -0,0 +1,44 @@
+//===-- InstructionArena.cpp - Bump allocation of IR ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the InstructionArena class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/InstructionArena.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/ThreadLocal.h"
+using namespace llvm;
+
+static cl::opt<bool>
+EnableInstructionArenas("instruction-arenas", cl::Hidden,
+  cl::desc("Allocate instructions read from bitcode in per-function arenas"));
+
+static ManagedStatic<sys::ThreadLocal<InstructionArena> > CurrentArena;
+
+bool InstructionArena::isEnabled() {
+  // User::operator delete relies on every User having been allocated the same
+  // way, so the answer must never change once the first User exists.
+  static const bool Enabled = EnableInstructionArenas;
+  return Enabled;
+}
+
+InstructionArena *InstructionArena::getCurrent() {
+  return CurrentArena->get();
+}
+
+InstructionArenaScope::InstructionArenaScope(InstructionArena *Arena)
+    : Previous(CurrentArena->get()) {
+  CurrentArena->set(Arena);
+}
+
+InstructionArenaScope::~InstructionArenaScope() {
+  CurrentArena->set(Previous);
+}
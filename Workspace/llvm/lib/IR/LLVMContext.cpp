@@ -155,6 +155,14 @@ void LLVMContext::yield() {
     pImpl->YieldCallback(this, pImpl->YieldOpaqueHandle);
 }
 
+void LLVMContext::enableConcurrentUniquing() {
+  pImpl->enableConcurrentUniquing();
+}
+
+bool LLVMContext::isConcurrentUniquingEnabled() const {
+  return pImpl->ConcurrentUniquing;
+}
+
 void LLVMContext::emitError(const Twine &ErrorStr) {
   diagnose(DiagnosticInfoInlineAsm(ErrorStr));
 }
@@ -44,6 +44,24 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
   YieldCallback = nullptr;
   YieldOpaqueHandle = nullptr;
   NamedStructTypesUniqueID = 0;
+  ConcurrentUniquing = false;
+}
+
+void LLVMContextImpl::enableConcurrentUniquing() {
+  if (ConcurrentUniquing)
+    return;
+  ConcurrentUniquing = true;
+
+  for (UniquingLock &L : IntConstantsLocks)
+    L.enable();
+  FPConstantsLock.enable();
+  ConstantsLock.enable();
+  ArrayConstants.enableLocking();
+  StructConstants.enableLocking();
+  VectorConstants.enableLocking();
+  ExprConstants.enableLocking();
+  InlineAsms.enableLocking();
+  TypesLock.enable();
 }
 
 namespace {
@@ -114,7 +132,8 @@ LLVMContextImpl::~LLVMContextImpl() {
   DeleteContainerSeconds(CPNConstants);
   DeleteContainerSeconds(UVConstants);
   InlineAsms.freeConstants();
-  DeleteContainerSeconds(IntConstants);
+  for (IntMapTy &Shard : IntConstants)
+    DeleteContainerSeconds(Shard);
   DeleteContainerSeconds(FPConstants);
   
   for (StringMap<ConstantDataSequential*>::iterator I = CDSConstants.begin(),
@@ -273,11 +273,24 @@ public:
   LLVMContext::YieldCallbackTy YieldCallback;
   void *YieldOpaqueHandle;
 
+  /// ConcurrentUniquing - Whether the uniquing tables below are locked, set
+  /// by LLVMContext::enableConcurrentUniquing().
+  bool ConcurrentUniquing;
+
+  /// The ConstantInt table is split into shards with separate locks, so that
+  /// threads creating different integers rarely contend.
+  static const unsigned NumIntConstantsShards = 16;
+  static unsigned getIntConstantsShard(const APInt &V) {
+    return (V.getRawData()[0] ^ V.getBitWidth()) % NumIntConstantsShards;
+  }
+
   typedef DenseMap<APInt, ConstantInt *, DenseMapAPIntKeyInfo> IntMapTy;
-  IntMapTy IntConstants;
+  IntMapTy IntConstants[NumIntConstantsShards];
+  UniquingLock IntConstantsLocks[NumIntConstantsShards];
 
   typedef DenseMap<APFloat, ConstantFP *, DenseMapAPFloatKeyInfo> FPMapTy;
   FPMapTy FPConstants;
+  UniquingLock FPConstantsLock;
 
   FoldingSet<AttributeImpl> AttrsSet;
   FoldingSet<AttributeSetImpl> AttrsLists;
@@ -296,6 +309,10 @@ public:
   // on Context destruction.
   SmallPtrSet<UniquableMDNode *, 1> DistinctMDNodes;
 
+  /// ConstantsLock - Protects CAZConstants, CPNConstants, UVConstants and
+  /// CDSConstants.
+  UniquingLock ConstantsLock;
+
   DenseMap<Type*, ConstantAggregateZero*> CAZConstants;
 
   typedef ConstantUniqueMap<ConstantArray> ArrayConstantsTy;
@@ -331,6 +348,9 @@ public:
   IntegerType Int1Ty, Int8Ty, Int16Ty, Int32Ty, Int64Ty;
 
   
+  /// TypesLock - Protects TypeAllocator and the type tables below.
+  UniquingLock TypesLock;
+
   /// TypeAllocator - All dynamically allocated types are allocated from this.
   /// They live forever until the context is torn down.
   BumpPtrAllocator TypeAllocator;
@@ -387,6 +407,10 @@ public:
   typedef DenseMap<const Function *, ReturnInst *> PrologueDataMapTy;
   PrologueDataMapTy PrologueDataMap;
 
+  /// enableConcurrentUniquing - Start locking the constant and type uniquing
+  /// tables.
+  void enableConcurrentUniquing();
+
   int getOrAddScopeRecordIdxEntry(MDNode *N, int ExistingIdx);
   int getOrAddScopeInlinedAtIdxEntry(MDNode *Scope, MDNode *IA,int ExistingIdx);
   
@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -21,8 +22,11 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/TimeValue.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
@@ -494,6 +498,306 @@ public:
 
 static TimingInfo *TheTimeInfo;
 
+//===----------------------------------------------------------------------===//
+/// PassProfiler Class - This class records every run of a pass when
+/// -pass-profile is given, either as a summary per pass or as Chrome trace
+/// events.
+///
+
+namespace {
+
+enum PassProfileFormatTy { PPF_JSON, PPF_Chrome };
+
+static ManagedStatic<sys::SmartMutex<true> > PassProfilerMutex;
+
+class PassProfiler {
+  // Totals for one pass instance, in the order passes first ran.
+  struct PassTotals {
+    std::string Name;
+    unsigned Runs;
+    double Wall;
+    int64_t Insts;
+    int64_t Malloc;
+    // The run that took longest, and the ones that grew the IR and the heap
+    // the most.
+    double SlowestWall;
+    std::string SlowestIR;
+    int64_t MostInsts;
+    std::string MostInstsIR;
+    int64_t MostMalloc;
+    std::string MostMallocIR;
+
+    PassTotals()
+        : Runs(0), Wall(0), Insts(0), Malloc(0), SlowestWall(-1),
+          MostInsts(INT64_MIN), MostMalloc(INT64_MIN) {}
+  };
+
+  std::unique_ptr<raw_fd_ostream> OS;
+  PassProfileFormatTy Format;
+  sys::TimeValue StartTime;
+  bool FirstEvent;
+  size_t PeakMalloc;
+  DenseMap<Pass *, unsigned> PassIndex;
+  std::vector<PassTotals> Passes;
+
+  void writeString(StringRef Str);
+  void writeSummary();
+
+public:
+  PassProfiler();
+  ~PassProfiler();
+
+  // createThePassProfiler - This method either initializes ThePassProfiler to
+  // a non-null value (if -pass-profile is given) or it leaves it null.  It may
+  // be called multiple times.
+  static void createThePassProfiler();
+
+  /// getTime - Return the time since profiling started, in seconds.
+  double getTime() const {
+    sys::TimeValue Elapsed = sys::TimeValue::now() - StartTime;
+    return Elapsed.seconds() + Elapsed.microseconds() / 1e6;
+  }
+
+  /// record - Record that P ran on IR, described by IRName.
+  void record(Pass *P, StringRef IRName, double Start, double End,
+              int64_t Insts, int64_t Malloc);
+};
+
+} // End of anon namespace
+
+static PassProfiler *ThePassProfiler;
+
+static cl::opt<std::string>
+PassProfileFile("pass-profile", cl::value_desc("filename"),
+    cl::desc("Record the time, instruction count change and memory change "
+             "of every pass run in <filename>"));
+
+static cl::opt<PassProfileFormatTy>
+PassProfileFormat("pass-profile-format",
+    cl::desc("Choose the format of the -pass-profile output:"),
+    cl::init(PPF_JSON),
+    cl::values(
+      clEnumValN(PPF_JSON, "json", "JSON summary of each pass"),
+      clEnumValN(PPF_Chrome, "chrome",
+                 "Chrome trace event for every pass run"),
+      clEnumValEnd));
+
+PassProfiler::PassProfiler()
+    : Format(PassProfileFormat), StartTime(sys::TimeValue::now()),
+      FirstEvent(true), PeakMalloc(0) {
+  std::error_code EC;
+  OS.reset(new raw_fd_ostream(PassProfileFile, EC, sys::fs::F_Text));
+  if (EC) {
+    errs() << "Error opening pass profile file '" << PassProfileFile
+           << "': " << EC.message() << '\n';
+    OS.reset();
+    return;
+  }
+  // Chrome trace events are written as they happen, so that a profile of a
+  // run that never finishes can still be loaded.
+  if (Format == PPF_Chrome)
+    *OS << "[\n";
+}
+
+PassProfiler::~PassProfiler() {
+  if (!OS)
+    return;
+  if (Format == PPF_Chrome)
+    *OS << "\n]\n";
+  else
+    writeSummary();
+}
+
+void PassProfiler::writeString(StringRef Str) {
+  *OS << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\')
+      *OS << '\\' << C;
+    else if (C < 0x20)
+      *OS << format("\\u%04x", C);
+    else
+      *OS << C;
+  }
+  *OS << '"';
+}
+
+void PassProfiler::record(Pass *P, StringRef IRName, double Start, double End,
+                          int64_t Insts, int64_t Malloc) {
+  sys::SmartScopedLock<true> Lock(*PassProfilerMutex);
+  if (!OS)
+    return;
+
+  size_t CurMalloc = sys::Process::GetMallocUsage();
+  if (CurMalloc > PeakMalloc)
+    PeakMalloc = CurMalloc;
+
+  if (Format == PPF_Chrome) {
+    if (!FirstEvent)
+      *OS << ",\n";
+    FirstEvent = false;
+    *OS << "{\"name\":";
+    writeString(P->getPassName());
+    *OS << ",\"cat\":\"pass\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+        << format("%.0f", Start * 1e6) << ",\"dur\":"
+        << format("%.0f", (End - Start) * 1e6) << ",\"args\":{\"ir\":";
+    writeString(IRName);
+    *OS << ",\"instructions\":" << Insts << ",\"malloc\":" << Malloc
+        << "}}";
+    return;
+  }
+
+  unsigned &Index = PassIndex[P];
+  if (!Index) {
+    Passes.push_back(PassTotals());
+    Passes.back().Name = P->getPassName();
+    Index = Passes.size();
+  }
+  PassTotals &T = Passes[Index - 1];
+  double Wall = End - Start;
+  ++T.Runs;
+  T.Wall += Wall;
+  T.Insts += Insts;
+  T.Malloc += Malloc;
+  if (Wall > T.SlowestWall) {
+    T.SlowestWall = Wall;
+    T.SlowestIR = IRName;
+  }
+  if (Insts > T.MostInsts) {
+    T.MostInsts = Insts;
+    T.MostInstsIR = IRName;
+  }
+  if (Malloc > T.MostMalloc) {
+    T.MostMalloc = Malloc;
+    T.MostMallocIR = IRName;
+  }
+}
+
+void PassProfiler::writeSummary() {
+  *OS << "{\n  \"peak-malloc\": " << PeakMalloc << ",\n  \"passes\": [";
+  for (unsigned I = 0, E = Passes.size(); I != E; ++I) {
+    const PassTotals &T = Passes[I];
+    *OS << (I ? ",\n" : "\n") << "    {\"name\": ";
+    writeString(T.Name);
+    *OS << ", \"runs\": " << T.Runs << ", \"wall\": "
+        << format("%.6f", T.Wall) << ", \"instructions\": " << T.Insts
+        << ", \"malloc\": " << T.Malloc << ",\n     \"slowest\": {\"ir\": ";
+    writeString(T.SlowestIR);
+    *OS << ", \"wall\": " << format("%.6f", T.SlowestWall)
+        << "},\n     \"most-instructions\": {\"ir\": ";
+    writeString(T.MostInstsIR);
+    *OS << ", \"instructions\": " << T.MostInsts
+        << "},\n     \"most-malloc\": {\"ir\": ";
+    writeString(T.MostMallocIR);
+    *OS << ", \"malloc\": " << T.MostMalloc << "}}";
+  }
+  *OS << "\n  ]\n}\n";
+}
+
+void PassProfiler::createThePassProfiler() {
+  if (PassProfileFile.empty() || ThePassProfiler)
+    return;
+
+  // As with TimingInfo, constructing this the first time it is needed makes
+  // sure it is destroyed, writing the profile, before static globals.
+  static ManagedStatic<PassProfiler> TPP;
+  ThePassProfiler = &*TPP;
+}
+
+static int64_t countInstructions(const BasicBlock &BB) {
+  return BB.size();
+}
+
+static int64_t countInstructions(const Function &F) {
+  int64_t N = 0;
+  for (const BasicBlock &BB : F)
+    N += countInstructions(BB);
+  return N;
+}
+
+static int64_t countInstructions(const Module &M) {
+  int64_t N = 0;
+  for (const Function &F : M)
+    N += countInstructions(F);
+  return N;
+}
+
+PassProfileRegion::PassProfileRegion(Pass *P, Module &M)
+    : P(P), M(&M), BB(nullptr) {
+  start();
+}
+
+PassProfileRegion::PassProfileRegion(Pass *P, Function &F)
+    : P(P), M(nullptr), BB(nullptr) {
+  if (ThePassProfiler)
+    Fs.push_back(&F);
+  start();
+}
+
+PassProfileRegion::PassProfileRegion(Pass *P, ArrayRef<Function *> Functions)
+    : P(P), M(nullptr), BB(nullptr) {
+  if (ThePassProfiler)
+    setFunctions(Functions);
+  start();
+}
+
+PassProfileRegion::PassProfileRegion(Pass *P, BasicBlock &BB)
+    : P(P), M(nullptr), BB(&BB) {
+  start();
+}
+
+void PassProfileRegion::setFunctions(ArrayRef<Function *> Functions) {
+  if (!P)
+    return;
+  Fs.clear();
+  for (Function *F : Functions)
+    if (F)
+      Fs.push_back(F);
+}
+
+int64_t PassProfileRegion::countInstructions() const {
+  if (M)
+    return ::countInstructions(*M);
+  if (BB)
+    return ::countInstructions(*BB);
+  int64_t N = 0;
+  for (const WeakVH &V : Fs)
+    if (const Function *F = dyn_cast_or_null<Function>(V))
+      N += ::countInstructions(*F);
+  return N;
+}
+
+void PassProfileRegion::start() {
+  // Pass managers are accounted to the passes they contain.
+  if (!ThePassProfiler || P->getAsPMDataManager()) {
+    P = nullptr;
+    return;
+  }
+
+  // Name the IR now: the pass may delete or rename it. Basic blocks are
+  // reported by the name of their function.
+  if (M)
+    IRName = M->getModuleIdentifier();
+  else if (BB)
+    IRName = BB->getParent()->getName();
+  else if (!Fs.empty())
+    IRName = Fs[0]->getName();
+  if (Fs.size() > 1)
+    IRName += " and " + utostr(Fs.size() - 1) + " more";
+
+  StartInsts = countInstructions();
+  StartMalloc = sys::Process::GetMallocUsage();
+  StartTime = ThePassProfiler->getTime();
+}
+
+PassProfileRegion::~PassProfileRegion() {
+  if (!P)
+    return;
+  double EndTime = ThePassProfiler->getTime();
+  int64_t Malloc = (int64_t)sys::Process::GetMallocUsage() - StartMalloc;
+  ThePassProfiler->record(P, IRName, StartTime, EndTime,
+                          countInstructions() - StartInsts, Malloc);
+}
+
 //===----------------------------------------------------------------------===//
 // PMTopLevelManager implementation
 
@@ -1313,6 +1617,7 @@ bool BBPassManager::runOnFunction(Function &F) {
         // If the pass crashes, remember this.
         PassManagerPrettyStackEntry X(BP, *I);
         TimeRegion PassTimer(getPassTimer(BP));
+        PassProfileRegion Profile(BP, *I);
 
         LocalChanged |= BP->runOnBasicBlock(*I);
       }
@@ -1481,6 +1786,7 @@ void FunctionPassManagerImpl::releaseMemoryOnTheFly() {
 bool FunctionPassManagerImpl::run(Function &F) {
   bool Changed = false;
   TimingInfo::createTheTimeInfo();
+  PassProfiler::createThePassProfiler();
 
   initializeAllAnalysisInfo();
   for (unsigned Index = 0; Index < getNumContainedManagers(); ++Index) {
@@ -1534,6 +1840,7 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      PassProfileRegion Profile(FP, F);
 
       LocalChanged |= FP->runOnFunction(F);
     }
@@ -1612,6 +1919,7 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      PassProfileRegion Profile(MP, M);
 
       LocalChanged |= MP->runOnModule(M);
     }
@@ -1708,6 +2016,7 @@ Pass* MPPassManager::getOnTheFlyPass(Pass *MP, AnalysisID PI, Function &F){
 bool PassManagerImpl::run(Module &M) {
   bool Changed = false;
   TimingInfo::createTheTimeInfo();
+  PassProfiler::createThePassProfiler();
 
   dumpArguments();
   dumpPasses();
@@ -315,6 +315,7 @@ IntegerType *IntegerType::get(LLVMContext &C, unsigned NumBits) {
     break;
   }
   
+  UniquingGuard Guard(C.pImpl->TypesLock);
   IntegerType *&Entry = C.pImpl->IntegerTypes[NumBits];
 
   if (!Entry)
@@ -360,6 +361,7 @@ FunctionType *FunctionType::get(Type *ReturnType,
                                 ArrayRef<Type*> Params, bool isVarArg) {
   LLVMContextImpl *pImpl = ReturnType->getContext().pImpl;
   FunctionTypeKeyInfo::KeyTy Key(ReturnType, Params, isVarArg);
+  UniquingGuard Guard(pImpl->TypesLock);
   auto I = pImpl->FunctionTypes.find_as(Key);
   FunctionType *FT;
 
@@ -403,6 +405,7 @@ StructType *StructType::get(LLVMContext &Context, ArrayRef<Type*> ETypes,
                             bool isPacked) {
   LLVMContextImpl *pImpl = Context.pImpl;
   AnonStructTypeKeyInfo::KeyTy Key(ETypes, isPacked);
+  UniquingGuard Guard(pImpl->TypesLock);
   auto I = pImpl->AnonStructTypes.find_as(Key);
   StructType *ST;
 
@@ -427,7 +430,11 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
     setSubclassData(getSubclassData() | SCDB_Packed);
 
   unsigned NumElements = Elements.size();
-  Type **Elts = getContext().pImpl->TypeAllocator.Allocate<Type*>(NumElements);
+  Type **Elts;
+  {
+    UniquingGuard Guard(getContext().pImpl->TypesLock);
+    Elts = getContext().pImpl->TypeAllocator.Allocate<Type*>(NumElements);
+  }
   memcpy(Elts, Elements.data(), sizeof(Elements[0]) * NumElements);
   
   ContainedTys = Elts;
@@ -437,6 +444,7 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
 void StructType::setName(StringRef Name) {
   if (Name == getName()) return;
 
+  UniquingGuard Guard(getContext().pImpl->TypesLock);
   StringMap<StructType *> &SymbolTable = getContext().pImpl->NamedStructTypes;
   typedef StringMap<StructType *>::MapEntryTy EntryTy;
 
@@ -486,7 +494,11 @@ void StructType::setName(StringRef Name) {
 // StructType Helper functions.
 
 StructType *StructType::create(LLVMContext &Context, StringRef Name) {
-  StructType *ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  StructType *ST;
+  {
+    UniquingGuard Guard(Context.pImpl->TypesLock);
+    ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  }
   if (!Name.empty())
     ST->setName(Name);
   return ST;
@@ -618,6 +630,7 @@ bool StructType::isLayoutIdentical(StructType *Other) const {
 /// getTypeByName - Return the type with the specified name, or null if there
 /// is none by that name.
 StructType *Module::getTypeByName(StringRef Name) const {
+  UniquingGuard Guard(getContext().pImpl->TypesLock);
   return getContext().pImpl->NamedStructTypes.lookup(Name);
 }
 
@@ -683,6 +696,7 @@ ArrayType *ArrayType::get(Type *elementType, uint64_t NumElements) {
   assert(isValidElementType(ElementType) && "Invalid type for array element!");
     
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  UniquingGuard Guard(pImpl->TypesLock);
   ArrayType *&Entry = 
     pImpl->ArrayTypes[std::make_pair(ElementType, NumElements)];
 
@@ -713,6 +727,7 @@ VectorType *VectorType::get(Type *elementType, unsigned NumElements) {
                                             "pointer type.");
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  UniquingGuard Guard(pImpl->TypesLock);
   VectorType *&Entry = ElementType->getContext().pImpl
     ->VectorTypes[std::make_pair(ElementType, NumElements)];
 
@@ -735,7 +750,8 @@ PointerType *PointerType::get(Type *EltTy, unsigned AddressSpace) {
   assert(isValidElementType(EltTy) && "Invalid type for pointer element!");
   
   LLVMContextImpl *CImpl = EltTy->getContext().pImpl;
-  
+  UniquingGuard Guard(CImpl->TypesLock);
+
   // Since AddressSpace #0 is the common case, we special case it.
   PointerType *&Entry = AddressSpace == 0 ? CImpl->PointerTypes[EltTy]
      : CImpl->ASPointerTypes[std::make_pair(EltTy, AddressSpace)];
@@ -10,6 +10,7 @@
 #include "llvm/IR/User.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/InstructionArena.h"
 #include "llvm/IR/Operator.h"
 
 namespace llvm {
@@ -53,8 +54,24 @@ Use *User::allocHungoffUses(unsigned N) const {
 //                         User operator new Implementations
 //===----------------------------------------------------------------------===//
 
-void *User::operator new(size_t s, unsigned Us) {
-  void *Storage = ::operator new(s + sizeof(Use) * Us);
+// When instruction arenas are enabled, every User is preceded by a header
+// recording the arena it came from, or null if it came from operator new.
+typedef InstructionArena *UserHeader;
+
+void *User::allocateFixedOperandUser(size_t s, unsigned Us, bool UseArena) {
+  size_t Size = s + sizeof(Use) * Us;
+  void *Storage;
+  if (!InstructionArena::isEnabled()) {
+    Storage = ::operator new(Size);
+  } else {
+    InstructionArena *Arena =
+        UseArena ? InstructionArena::getCurrent() : nullptr;
+    Size += sizeof(UserHeader);
+    UserHeader *Header = static_cast<UserHeader*>(
+        Arena ? Arena->allocate(Size) : ::operator new(Size));
+    *Header = Arena;
+    Storage = Header + 1;
+  }
   Use *Start = static_cast<Use*>(Storage);
   Use *End = Start + Us;
   User *Obj = reinterpret_cast<User*>(End);
@@ -64,6 +81,10 @@ void *User::operator new(size_t s, unsigned Us) {
   return Obj;
 }
 
+void *User::operator new(size_t s, unsigned Us) {
+  return allocateFixedOperandUser(s, Us, false);
+}
+
 //===----------------------------------------------------------------------===//
 //                         User operator delete Implementation
 //===----------------------------------------------------------------------===//
@@ -73,7 +94,15 @@ void User::operator delete(void *Usr) {
   Use *Storage = static_cast<Use*>(Usr) - Start->NumOperands;
   // If there were hung-off uses, they will have been freed already and
   // NumOperands reset to 0, so here we just free the User itself.
-  ::operator delete(Storage);
+  if (!InstructionArena::isEnabled()) {
+    ::operator delete(Storage);
+    return;
+  }
+  UserHeader *Header = reinterpret_cast<UserHeader*>(Storage) - 1;
+  if (InstructionArena *Arena = *Header)
+    Arena->deallocate(Header);
+  else
+    ::operator delete(Header);
 }
 
 //===----------------------------------------------------------------------===//
@@ -347,6 +347,91 @@ void Value::replaceAllUsesWith(Value *New) {
     BB->replaceSuccessorsPhiUsesWith(cast<BasicBlock>(New));
 }
 
+/// Return \p C with every operand found in \p Map replaced by its mapping, or
+/// null if \p C is not a kind of constant that can be rebuilt from operands.
+static Constant *remapConstantOperands(Constant *C,
+                                       const DenseMap<Value *, WeakVH> &Map) {
+  SmallVector<Constant *, 8> Ops;
+  Ops.reserve(C->getNumOperands());
+  for (Value *Op : C->operand_values()) {
+    auto I = Map.find(Op);
+    if (I != Map.end())
+      Op = I->second;
+    Ops.push_back(cast<Constant>(Op));
+  }
+
+  if (auto *CE = dyn_cast<ConstantExpr>(C))
+    return CE->getWithOperands(Ops);
+  if (auto *CA = dyn_cast<ConstantArray>(C))
+    return ConstantArray::get(CA->getType(), Ops);
+  if (auto *CS = dyn_cast<ConstantStruct>(C))
+    return ConstantStruct::get(CS->getType(), Ops);
+  if (isa<ConstantVector>(C))
+    return ConstantVector::get(Ops);
+  return nullptr;
+}
+
+void Value::batchReplaceAllUsesWith(
+    ArrayRef<std::pair<Value *, Value *>> Replacements) {
+  // Build the final mapping first, so that chains of replacements collapse
+  // and every use is rewritten exactly once.  The targets are held in WeakVHs
+  // because a constant target may itself be rebuilt below.
+  DenseMap<Value *, WeakVH> Map;
+  for (const auto &R : Replacements) {
+    assert(R.first && R.second && "batchReplaceAllUsesWith(<null>) is invalid!");
+    assert(R.first->getType() == R.second->getType() &&
+           "replaceAllUses of value with new value of different type!");
+    if (R.first != R.second)
+      Map.insert(std::make_pair(R.first, WeakVH(R.second)));
+  }
+  for (auto &M : Map) {
+    unsigned Steps = 0;
+    for (auto I = Map.find(M.second); I != Map.end(); I = Map.find(M.second)) {
+      assert(++Steps <= Map.size() && "Cyclic replacements!");
+      (void)Steps;
+      M.second = I->second;
+    }
+  }
+
+  for (const auto &R : Replacements) {
+    Value *Old = R.first;
+    if (Old == R.second)
+      continue;
+    Value *New = Map.find(Old)->second;
+    assert(!contains(New, Old) &&
+           "this->replaceAllUsesWith(expr(this)) is NOT valid!");
+
+    // The first pair for Old does the work; later ones find it unused.
+    if (Old->HasValueHandle)
+      ValueHandleBase::ValueIsRAUWd(Old, New);
+    if (Old->isUsedByMetadata())
+      ValueAsMetadata::handleRAUW(Old, New);
+
+    while (!Old->use_empty()) {
+      Use &U = *Old->UseList;
+      // Constants are uniqued, so a constant user is replaced by a new one
+      // built from all of its remapped operands at once.  This drops it from
+      // the use lists of every value being replaced, not just Old.
+      if (auto *C = dyn_cast<Constant>(U.getUser())) {
+        if (!isa<GlobalValue>(C)) {
+          if (Constant *NewC = remapConstantOperands(C, Map)) {
+            C->replaceAllUsesWith(NewC);
+            C->destroyConstant();
+          } else {
+            C->replaceUsesOfWithOnConstant(Old, New, &U);
+          }
+          continue;
+        }
+      }
+
+      U.set(New);
+    }
+
+    if (BasicBlock *BB = dyn_cast<BasicBlock>(Old))
+      BB->replaceSuccessorsPhiUsesWith(cast<BasicBlock>(New));
+  }
+}
+
 // Like replaceAllUsesWith except it does not handle constants or basic blocks.
 // This routine leaves uses within BB.
 void Value::replaceUsesOutsideBlock(Value *New, BasicBlock *BB) {
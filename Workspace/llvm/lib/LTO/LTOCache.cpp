@@ -0,0 +1,47 @@
+//===-LTOCache.cpp - Cache of LTO partition object files ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the LTOCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/LTOCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+using namespace llvm;
+
+std::string LTOCache::getEntryPath(StringRef Key) const {
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, "llvmcache-" + Key);
+  return Path.str();
+}
+
+bool LTOCache::lookup(StringRef Key, const Twine &Path) const {
+  std::string Entry = getEntryPath(Key);
+  if (!sys::fs::exists(Entry))
+    return false;
+  return !sys::fs::copy_file(Entry, Path);
+}
+
+void LTOCache::insert(StringRef Key, const Twine &Path) const {
+  if (sys::fs::create_directories(Dir))
+    return;
+
+  // Copy to a temporary file first and rename it into place, so that other
+  // links never see a partial entry.
+  SmallString<128> Model(Dir);
+  sys::path::append(Model, "llvmcache-tmp-%%%%%%%%");
+  SmallString<128> TempPath;
+  if (sys::fs::createUniqueFile(Model.str(), TempPath))
+    return;
+  if (sys::fs::copy_file(Path, TempPath.str()) ||
+      sys::fs::rename(TempPath.str(), getEntryPath(Key)))
+    sys::fs::remove(TempPath.str());
+}
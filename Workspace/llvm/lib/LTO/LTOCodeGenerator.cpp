@@ -28,6 +28,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/InitializePasses.h"
+#include "llvm/LTO/LTOCache.h"
 #include "llvm/LTO/LTOModule.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/MCAsmInfo.h"
@@ -38,7 +39,11 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
@@ -81,6 +86,7 @@ void LTOCodeGenerator::initialize() {
   CodeModel = LTO_CODEGEN_PIC_MODEL_DEFAULT;
   DiagHandler = nullptr;
   DiagContext = nullptr;
+  NumPartitions = 1;
 
   initializeLTOPasses();
 }
@@ -131,7 +137,18 @@ bool LTOCodeGenerator::addModule(LTOModule *mod) {
   assert(&mod->getModule().getContext() == &Context &&
          "Expected module in same context");
 
-  bool ret = IRLinker.linkInModule(&mod->getModule());
+  bool ret = false;
+  if (isPartitioned()) {
+    // Only summarize the module now; the partitions are linked at compile
+    // time. The merged module is left empty but for the target triple.
+    Module &M = mod->getModule();
+    Module *MergedModule = IRLinker.getModule();
+    if (MergedModule->getTargetTriple().empty())
+      MergedModule->setTargetTriple(M.getTargetTriple());
+    Partitioner.addModule(M);
+  } else {
+    ret = IRLinker.linkInModule(&mod->getModule());
+  }
 
   const std::vector<const char*> &undefs = mod->getAsmUndefinedRefs();
   for (int i = 0, e = undefs.size(); i != e; ++i)
@@ -171,6 +188,11 @@ void LTOCodeGenerator::setCodePICModel(lto_codegen_model model) {
 
 bool LTOCodeGenerator::writeMergedModules(const char *path,
                                           std::string &errMsg) {
+  if (isPartitioned()) {
+    errMsg = "partitioned LTO does not merge the modules";
+    return false;
+  }
+
   if (!determineTarget(errMsg))
     return false;
 
@@ -207,6 +229,17 @@ bool LTOCodeGenerator::compile_to_file(const char** name,
                                        bool disableGVNLoadPRE,
                                        bool disableVectorization,
                                        std::string& errMsg) {
+  if (isPartitioned()) {
+    errMsg = "partitioned LTO produces several object files";
+    return false;
+  }
+
+  if (!determineTarget(errMsg))
+    return false;
+
+  // Mark which symbols can not be internalized
+  applyScopeRestrictions();
+
   // make unique temp .o file to put generated object file
   SmallString<128> Filename;
   int FD;
@@ -220,9 +253,9 @@ bool LTOCodeGenerator::compile_to_file(const char** name,
   // generate object file
   tool_output_file objFile(Filename.c_str(), FD);
 
-  bool genResult =
-      generateObjectFile(objFile.os(), disableOpt, disableInline,
-                         disableGVNLoadPRE, disableVectorization, errMsg);
+  bool genResult = generateObjectFile(
+      objFile.os(), *IRLinker.getModule(), *TargetMach, disableOpt,
+      disableInline, disableGVNLoadPRE, disableVectorization, errMsg);
   objFile.os().close();
   if (objFile.os().has_error()) {
     objFile.os().clear_error();
@@ -272,10 +305,220 @@ const void* LTOCodeGenerator::compile(size_t* length,
   return NativeObjectFile->getBufferStart();
 }
 
+bool LTOCodeGenerator::compile_to_files(std::vector<std::string> &names,
+                                        StringRef prefix,
+                                        bool disableOpt,
+                                        bool disableInline,
+                                        bool disableGVNLoadPRE,
+                                        bool disableVectorization,
+                                        std::string &errMsg) {
+  if (!isPartitioned()) {
+    errMsg = "partitioned LTO was not requested";
+    return false;
+  }
+
+  // Settle the target on this thread; the partitions each create a target
+  // machine of their own from the same settings.
+  if (!determineTarget(errMsg))
+    return false;
+
+  Partitioner.plan(NumPartitions);
+  unsigned N = Partitioner.getNumPartitions();
+
+  std::vector<std::string> Paths(N);
+  for (unsigned I = 0; I != N; ++I) {
+    if (!prefix.empty()) {
+      Paths[I] = (prefix + "." + Twine(I)).str();
+      continue;
+    }
+    SmallString<128> Filename;
+    if (std::error_code EC =
+            sys::fs::createTemporaryFile("lto-llvm", "o", Filename)) {
+      errMsg = EC.message();
+      for (unsigned J = 0; J != I; ++J)
+        sys::fs::remove(Paths[J]);
+      return false;
+    }
+    Paths[I] = Filename.str();
+  }
+
+  std::unique_ptr<LTOCache> Cache;
+  std::vector<std::string> Keys(N);
+  if (!CacheDir.empty()) {
+    Cache.reset(new LTOCache(CacheDir));
+    for (unsigned I = 0; I != N; ++I)
+      Keys[I] = getCacheKey(I, disableOpt, disableInline, disableGVNLoadPRE,
+                            disableVectorization);
+  }
+
+  std::vector<std::string> Errors(N);
+  std::vector<char> Succeeded(N);
+  parallel_for_each_n(0u, N, [&](unsigned I) {
+    if (Cache && Cache->lookup(Keys[I], Paths[I])) {
+      Succeeded[I] = true;
+      return;
+    }
+    Succeeded[I] = compilePartition(I, Paths[I], disableOpt, disableInline,
+                                    disableGVNLoadPRE, disableVectorization,
+                                    Errors[I]);
+    if (Cache && Succeeded[I])
+      Cache->insert(Keys[I], Paths[I]);
+  });
+
+  for (unsigned I = 0; I != N; ++I) {
+    if (Succeeded[I])
+      continue;
+    errMsg = Errors[I];
+    for (const std::string &Path : Paths)
+      sys::fs::remove(Path);
+    return false;
+  }
+
+  names = std::move(Paths);
+  return true;
+}
+
+/// Add the options in \p Options that affect code generation to \p Hasher.
+static void hashTargetOptions(MD5 &Hasher, const TargetOptions &Options) {
+  SmallString<128> Str;
+  raw_svector_ostream OS(Str);
+#define HASH(X) OS << Options.X << ' '
+  HASH(NoFramePointerElim);
+  HASH(LessPreciseFPMADOption);
+  HASH(UnsafeFPMath);
+  HASH(NoInfsFPMath);
+  HASH(NoNaNsFPMath);
+  HASH(HonorSignDependentRoundingFPMathOption);
+  HASH(UseSoftFloat);
+  HASH(NoZerosInBSS);
+  HASH(GuaranteedTailCallOpt);
+  HASH(DisableTailCalls);
+  HASH(StackAlignmentOverride);
+  HASH(EnableFastISel);
+  HASH(PositionIndependentExecutable);
+  HASH(UseInitArray);
+  HASH(DisableIntegratedAS);
+  HASH(CompressDebugSections);
+  HASH(FunctionSections);
+  HASH(DataSections);
+  HASH(TrapUnreachable);
+  OS << Options.TrapFuncName.size() << ':' << Options.TrapFuncName << ' ';
+  HASH(FloatABIType);
+  HASH(AllowFPOpFusion);
+  HASH(JTType);
+  HASH(FCFI);
+  HASH(ThreadModel);
+  OS << unsigned(Options.CFIType) << ' ';
+  HASH(CFIEnforcing);
+  OS << Options.CFIFuncName.size() << ':' << Options.CFIFuncName << ' ';
+  HASH(MCOptions.SanitizeAddress);
+  HASH(MCOptions.MCRelaxAll);
+  HASH(MCOptions.MCNoExecStack);
+  HASH(MCOptions.MCFatalWarnings);
+  HASH(MCOptions.MCSaveTempLabels);
+  HASH(MCOptions.MCUseDwarfDirectory);
+  HASH(MCOptions.DwarfVersion);
+#undef HASH
+  Hasher.update(OS.str());
+}
+
+/// Return the key of the object file of partition \p I in the cache: a hash
+/// of the partition's inputs and of everything else that affects its code.
+std::string LTOCodeGenerator::getCacheKey(unsigned I, bool disableOpt,
+                                          bool disableInline,
+                                          bool disableGVNLoadPRE,
+                                          bool disableVectorization) {
+  MD5 Hasher;
+  auto AddString = [&](StringRef S) {
+    Hasher.update(utostr(S.size()) + ":");
+    Hasher.update(S);
+  };
+
+  AddString(getVersionString());
+  AddString(TargetMach->getTargetTriple());
+  AddString(MCpu);
+  AddString(MAttr);
+  AddString(utostr(CodeModel));
+  for (unsigned J = 1, E = CodegenOptions.size(); J < E; ++J)
+    AddString(CodegenOptions[J]);
+  AddString(utostr(disableOpt | disableInline << 1 | disableGVNLoadPRE << 2 |
+                   disableVectorization << 3));
+  hashTargetOptions(Hasher, Options);
+
+  // Which symbols the linker needs decides what applyScopeRestrictions()
+  // internalizes.
+  Mangler Mangler(TargetMach->getSubtargetImpl()->getDataLayout());
+  Partitioner.hashPartition(I, Hasher, [&](StringRef Name) {
+    SmallString<64> Buffer;
+    Mangler.getNameWithPrefix(Buffer, Name);
+    return unsigned(MustPreserveSymbols.count(Buffer)) |
+           unsigned(AsmUndefinedRefs.count(Buffer)) << 1;
+  });
+
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+/// Load, optimize and compile partition \p I into the object file \p Path.
+/// Runs concurrently with the other partitions.
+bool LTOCodeGenerator::compilePartition(unsigned I, StringRef Path,
+                                        bool disableOpt, bool disableInline,
+                                        bool disableGVNLoadPRE,
+                                        bool disableVectorization,
+                                        std::string &errMsg) {
+  LLVMContext PartitionContext;
+  if (DiagHandler)
+    PartitionContext.setDiagnosticHandler(LTOCodeGenerator::DiagnosticHandler,
+                                          this, /* RespectFilters */ true);
+
+  std::unique_ptr<Module> M =
+      Partitioner.buildPartition(I, PartitionContext, errMsg);
+  if (!M)
+    return false;
+
+  std::unique_ptr<TargetMachine> TM(createTargetMachine(errMsg));
+  if (!TM)
+    return false;
+
+  applyScopeRestrictions(*M, *TM);
+
+  std::error_code EC;
+  tool_output_file objFile(Path, EC, sys::fs::F_None);
+  if (EC) {
+    errMsg = "could not open object file for writing: ";
+    errMsg += Path;
+    return false;
+  }
+
+  bool genResult =
+      generateObjectFile(objFile.os(), *M, *TM, disableOpt, disableInline,
+                         disableGVNLoadPRE, disableVectorization, errMsg);
+  objFile.os().close();
+  if (objFile.os().has_error()) {
+    objFile.os().clear_error();
+    errMsg = "could not write object file: ";
+    errMsg += Path;
+    return false;
+  }
+  if (!genResult)
+    return false;
+
+  objFile.keep();
+  return true;
+}
+
 bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
   if (TargetMach)
     return true;
 
+  TargetMach = createTargetMachine(errMsg);
+  return TargetMach != nullptr;
+}
+
+TargetMachine *LTOCodeGenerator::createTargetMachine(std::string &errMsg) {
   std::string TripleStr = IRLinker.getModule()->getTargetTriple();
   if (TripleStr.empty())
     TripleStr = sys::getDefaultTargetTriple();
@@ -284,7 +527,7 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
   // create target machine from info for merged modules
   const Target *march = TargetRegistry::lookupTarget(TripleStr, errMsg);
   if (!march)
-    return false;
+    return nullptr;
 
   // The relocation model is actually a static member of TargetMachine and
   // needs to be set before the TargetMachine is instantiated.
@@ -319,14 +562,14 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
       MCpu = "cyclone";
   }
 
-  TargetMach = march->createTargetMachine(TripleStr, MCpu, FeatureStr, Options,
-                                          RelocModel, CodeModel::Default,
-                                          CodeGenOpt::Aggressive);
-  return true;
+  return march->createTargetMachine(TripleStr, MCpu, FeatureStr, Options,
+                                    RelocModel, CodeModel::Default,
+                                    CodeGenOpt::Aggressive);
 }
 
 void LTOCodeGenerator::
 applyRestriction(GlobalValue &GV,
+                 TargetMachine &TM,
                  ArrayRef<StringRef> Libcalls,
                  std::vector<const char*> &MustPreserveList,
                  SmallPtrSetImpl<GlobalValue*> &AsmUsed,
@@ -340,9 +583,12 @@ applyRestriction(GlobalValue &GV,
     return;
 
   SmallString<64> Buffer;
-  TargetMach->getNameWithPrefix(Buffer, &GV, Mangler);
+  TM.getNameWithPrefix(Buffer, &GV, Mangler);
 
-  if (MustPreserveSymbols.count(Buffer))
+  // In partitioned mode, symbols used by other partitions must stay visible
+  // as well.
+  if (MustPreserveSymbols.count(Buffer) ||
+      (isPartitioned() && Partitioner.isExported(GV.getName())))
     MustPreserveList.push_back(GV.getName().data());
   if (AsmUndefinedRefs.count(Buffer))
     AsmUsed.insert(&GV);
@@ -398,7 +644,14 @@ static void accumulateAndSortLibcalls(std::vector<StringRef> &Libcalls,
 void LTOCodeGenerator::applyScopeRestrictions() {
   if (ScopeRestrictionsDone)
     return;
-  Module *mergedModule = IRLinker.getModule();
+
+  applyScopeRestrictions(*IRLinker.getModule(), *TargetMach);
+
+  ScopeRestrictionsDone = true;
+}
+
+void LTOCodeGenerator::applyScopeRestrictions(Module &M, TargetMachine &TM) {
+  Module *mergedModule = &M;
 
   // Start off with a verification pass.
   PassManager passes;
@@ -406,23 +659,23 @@ void LTOCodeGenerator::applyScopeRestrictions() {
   passes.add(createDebugInfoVerifierPass());
 
   // mark which symbols can not be internalized
-  Mangler Mangler(TargetMach->getSubtargetImpl()->getDataLayout());
+  Mangler Mangler(TM.getSubtargetImpl()->getDataLayout());
   std::vector<const char*> MustPreserveList;
   SmallPtrSet<GlobalValue*, 8> AsmUsed;
   std::vector<StringRef> Libcalls;
-  TargetLibraryInfo TLI(Triple(TargetMach->getTargetTriple()));
+  TargetLibraryInfo TLI(Triple(TM.getTargetTriple()));
   accumulateAndSortLibcalls(
-      Libcalls, TLI, TargetMach->getSubtargetImpl()->getTargetLowering());
+      Libcalls, TLI, TM.getSubtargetImpl()->getTargetLowering());
 
   for (Module::iterator f = mergedModule->begin(),
          e = mergedModule->end(); f != e; ++f)
-    applyRestriction(*f, Libcalls, MustPreserveList, AsmUsed, Mangler);
+    applyRestriction(*f, TM, Libcalls, MustPreserveList, AsmUsed, Mangler);
   for (Module::global_iterator v = mergedModule->global_begin(),
          e = mergedModule->global_end(); v !=  e; ++v)
-    applyRestriction(*v, Libcalls, MustPreserveList, AsmUsed, Mangler);
+    applyRestriction(*v, TM, Libcalls, MustPreserveList, AsmUsed, Mangler);
   for (Module::alias_iterator a = mergedModule->alias_begin(),
          e = mergedModule->alias_end(); a != e; ++a)
-    applyRestriction(*a, Libcalls, MustPreserveList, AsmUsed, Mangler);
+    applyRestriction(*a, TM, Libcalls, MustPreserveList, AsmUsed, Mangler);
 
   GlobalVariable *LLVMCompilerUsed =
     mergedModule->getGlobalVariable("llvm.compiler.used");
@@ -431,7 +684,7 @@ void LTOCodeGenerator::applyScopeRestrictions() {
     LLVMCompilerUsed->eraseFromParent();
 
   if (!AsmUsed.empty()) {
-    llvm::Type *i8PTy = llvm::Type::getInt8PtrTy(Context);
+    llvm::Type *i8PTy = llvm::Type::getInt8PtrTy(M.getContext());
     std::vector<Constant*> asmUsed2;
     for (auto *GV : AsmUsed) {
       Constant *c = ConstantExpr::getBitCast(GV, i8PTy);
@@ -452,32 +705,26 @@ void LTOCodeGenerator::applyScopeRestrictions() {
 
   // apply scope restrictions
   passes.run(*mergedModule);
-
-  ScopeRestrictionsDone = true;
 }
 
 /// Optimize merged modules using various IPO passes
 bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
+                                          Module &M,
+                                          TargetMachine &TM,
                                           bool DisableOpt,
                                           bool DisableInline,
                                           bool DisableGVNLoadPRE,
                                           bool DisableVectorization,
                                           std::string &errMsg) {
-  if (!this->determineTarget(errMsg))
-    return false;
-
-  Module *mergedModule = IRLinker.getModule();
-
-  // Mark which symbols can not be internalized
-  this->applyScopeRestrictions();
+  Module *mergedModule = &M;
 
   // Instantiate the pass manager to organize the passes.
   PassManager passes;
 
   // Add an appropriate DataLayout instance for this module...
-  mergedModule->setDataLayout(TargetMach->getSubtargetImpl()->getDataLayout());
+  mergedModule->setDataLayout(TM.getSubtargetImpl()->getDataLayout());
 
-  Triple TargetTriple(TargetMach->getTargetTriple());
+  Triple TargetTriple(TM.getTargetTriple());
   PassManagerBuilder PMB;
   PMB.DisableGVNLoadPRE = DisableGVNLoadPRE;
   PMB.LoopVectorize = !DisableVectorization;
@@ -490,7 +737,7 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
   PMB.VerifyInput = true;
   PMB.VerifyOutput = true;
 
-  PMB.populateLTOPassManager(passes, TargetMach);
+  PMB.populateLTOPassManager(passes, &TM);
 
   PassManager codeGenPasses;
 
@@ -502,8 +749,8 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
   // the ObjCARCContractPass must be run, so do it unconditionally here.
   codeGenPasses.add(createObjCARCContractPass());
 
-  if (TargetMach->addPassesToEmitFile(codeGenPasses, Out,
-                                      TargetMachine::CGFT_ObjectFile)) {
+  if (TM.addPassesToEmitFile(codeGenPasses, Out,
+                             TargetMachine::CGFT_ObjectFile)) {
     errMsg = "target file type not supported";
     return false;
   }
@@ -537,8 +784,12 @@ void LTOCodeGenerator::parseCodeGenDebugOptions() {
                                 const_cast<char **>(&CodegenOptions[0]));
 }
 
+/// Serializes the diagnostics of partitions compiled concurrently.
+static ManagedStatic<sys::Mutex> DiagnosticLock;
+
 void LTOCodeGenerator::DiagnosticHandler(const DiagnosticInfo &DI,
                                          void *Context) {
+  sys::ScopedLock Lock(*DiagnosticLock);
   ((LTOCodeGenerator *)Context)->DiagnosticHandler2(DI);
 }
 
@@ -17,6 +17,7 @@
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/Analysis.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
@@ -33,6 +34,7 @@
 #include "llvm/Object/IRObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -50,13 +52,16 @@ using namespace llvm;
 using namespace llvm::object;
 
 LTOModule::LTOModule(std::unique_ptr<object::IRObjectFile> Obj,
-                     llvm::TargetMachine *TM)
-    : IRFile(std::move(Obj)), _target(TM) {}
+                     llvm::TargetMachine *TM, LLVMContext &Context,
+                     std::unique_ptr<LLVMContext> OwnedContext)
+    : OwnedContext(std::move(OwnedContext)), Context(Context),
+      IRFile(std::move(Obj)), _target(TM) {}
 
-LTOModule::LTOModule(std::unique_ptr<object::IRObjectFile> Obj,
-                     llvm::TargetMachine *TM,
-                     std::unique_ptr<LLVMContext> Context)
-    : OwnedContext(std::move(Context)), IRFile(std::move(Obj)), _target(TM) {}
+LTOModule::LTOModule(std::unique_ptr<MemoryBuffer> Bitcode, StringRef Triple,
+                     llvm::TargetMachine *TM, LLVMContext &Context,
+                     std::unique_ptr<LLVMContext> OwnedContext)
+    : OwnedContext(std::move(OwnedContext)), Context(Context),
+      Bitcode(std::move(Bitcode)), BitcodeTriple(Triple), _target(TM) {}
 
 LTOModule::~LTOModule() {}
 
@@ -185,6 +190,21 @@ static Module *parseBitcodeFileImpl(MemoryBufferRef Buffer,
   return *M;
 }
 
+/// canUseSymbolTable - Return true if the symbols of the bitcode's symbol
+/// table are the ones parseSymbols() would find in its module for \p Target:
+/// the module has to be named for the target's DataLayout, and must not have
+/// ObjC data structures, from which addDefinedDataSymbol() makes symbols.
+static bool canUseSymbolTable(const BitcodeSymbolTable &Table,
+                              const TargetMachine &Target) {
+  if (DataLayout(Table.DataLayout) !=
+      *Target.getSubtargetImpl()->getDataLayout())
+    return false;
+  for (const BitcodeSymbol &Sym : Table.Symbols)
+    if (StringRef(Sym.Section).startswith("__OBJC,"))
+      return false;
+  return true;
+}
+
 LTOModule *LTOModule::makeLTOModule(MemoryBufferRef Buffer,
                                     TargetOptions options, std::string &errMsg,
                                     LLVMContext *Context) {
@@ -194,15 +214,30 @@ LTOModule *LTOModule::makeLTOModule(MemoryBufferRef Buffer,
     Context = OwnedContext.get();
   }
 
-  // If we own a context, we know this is being used only for symbol
-  // extraction, not linking.  Be lazy in that case.
-  std::unique_ptr<Module> M(parseBitcodeFileImpl(
-      Buffer, *Context,
-      /* ShouldBeLazy */ static_cast<bool>(OwnedContext), errMsg));
-  if (!M)
-    return nullptr;
+  // Take the symbols from the symbol table of the bitcode if it has one, and
+  // only read the module if it is needed.
+  ErrorOr<BitcodeSymbolTable> Table =
+      make_error_code(BitcodeError::MissingSymbolTable);
+  ErrorOr<MemoryBufferRef> MBOrErr =
+      IRObjectFile::findBitcodeInMemBuffer(Buffer);
+  if (MBOrErr)
+    Table = readBitcodeSymbolTable(*MBOrErr, *Context);
+
+  std::unique_ptr<Module> M;
+  std::string TripleStr;
+  if (Table) {
+    TripleStr = Table->Triple;
+  } else {
+    // If we own a context, we know this is being used only for symbol
+    // extraction, not linking.  Be lazy in that case.
+    M.reset(parseBitcodeFileImpl(
+        Buffer, *Context,
+        /* ShouldBeLazy */ static_cast<bool>(OwnedContext), errMsg));
+    if (!M)
+      return nullptr;
+    TripleStr = M->getTargetTriple();
+  }
 
-  std::string TripleStr = M->getTargetTriple();
   if (TripleStr.empty())
     TripleStr = sys::getDefaultTargetTriple();
   llvm::Triple Triple(TripleStr);
@@ -229,16 +264,40 @@ LTOModule *LTOModule::makeLTOModule(MemoryBufferRef Buffer,
 
   TargetMachine *target = march->createTargetMachine(TripleStr, CPU, FeatureStr,
                                                      options);
+
+  if (Table && canUseSymbolTable(*Table, *target)) {
+    // The buffer isn't ours to keep until the module is read.
+    bool Lazy = static_cast<bool>(OwnedContext);
+    LTOModule *Ret = new LTOModule(
+        MemoryBuffer::getMemBufferCopy(MBOrErr->getBuffer(),
+                                       MBOrErr->getBufferIdentifier()),
+        Table->Triple, target, *Context, std::move(OwnedContext));
+    // A module in a shared context is going to be linked, so read it now:
+    // an invalid module must be reported here, not while linking.
+    if (!Lazy && Ret->parseModule(errMsg)) {
+      delete Ret;
+      return nullptr;
+    }
+    Ret->parseSymbolTable(*Table);
+    return Ret;
+  }
+
+  if (!M) {
+    M.reset(parseBitcodeFileImpl(
+        Buffer, *Context,
+        /* ShouldBeLazy */ static_cast<bool>(OwnedContext), errMsg));
+    if (!M) {
+      delete target;
+      return nullptr;
+    }
+  }
   M->setDataLayout(target->getSubtargetImpl()->getDataLayout());
 
   std::unique_ptr<object::IRObjectFile> IRObj(
       new object::IRObjectFile(Buffer, std::move(M)));
 
-  LTOModule *Ret;
-  if (OwnedContext)
-    Ret = new LTOModule(std::move(IRObj), target, std::move(OwnedContext));
-  else
-    Ret = new LTOModule(std::move(IRObj), target);
+  LTOModule *Ret = new LTOModule(std::move(IRObj), target, *Context,
+                                 std::move(OwnedContext));
 
   if (Ret->parseSymbols(errMsg)) {
     delete Ret;
@@ -250,6 +309,33 @@ LTOModule *LTOModule::makeLTOModule(MemoryBufferRef Buffer,
   return Ret;
 }
 
+/// parseModule - Read the module of the bitcode whose symbol table the
+/// symbols came from.
+bool LTOModule::parseModule(std::string &errMsg) {
+  std::unique_ptr<Module> M(parseBitcodeFileImpl(
+      Bitcode->getMemBufferRef(), Context,
+      /* ShouldBeLazy */ static_cast<bool>(OwnedContext), errMsg));
+  if (!M)
+    return true;
+  M->setDataLayout(_target->getSubtargetImpl()->getDataLayout());
+  if (!BitcodeTriple.empty())
+    M->setTargetTriple(BitcodeTriple);
+  IRFile.reset(new object::IRObjectFile(Bitcode->getMemBufferRef(),
+                                        std::move(M)));
+  return false;
+}
+
+Module &LTOModule::getModule() {
+  // Only modules in a context of their own, which are not linked, are read
+  // this late.
+  if (!IRFile) {
+    std::string ErrMsg;
+    if (parseModule(ErrMsg))
+      report_fatal_error("Invalid bitcode module: " + ErrMsg);
+  }
+  return IRFile->getModule();
+}
+
 /// Create a MemoryBuffer from a memory range with an optional name.
 std::unique_ptr<MemoryBuffer>
 LTOModule::makeBuffer(const void *mem, size_t length, StringRef name) {
@@ -429,44 +515,63 @@ void LTOModule::addDefinedFunctionSymbol(const char *Name, const Function *F) {
   addDefinedSymbol(Name, F, true);
 }
 
-void LTOModule::addDefinedSymbol(const char *Name, const GlobalValue *def,
-                                 bool isFunction) {
+/// getDefinedSymbolAttributes - Return the attributes of a defined symbol
+/// with the given properties.
+static uint32_t getDefinedSymbolAttributes(uint32_t align, bool isFunction,
+                                           bool isConstantVar,
+                                           GlobalValue::LinkageTypes linkage,
+                                           GlobalValue::VisibilityTypes vis,
+                                           bool canBeHidden) {
   // set alignment part log2() can have rounding errors
-  uint32_t align = def->getAlignment();
   uint32_t attr = align ? countTrailingZeros(align) : 0;
 
   // set permissions part
   if (isFunction) {
     attr |= LTO_SYMBOL_PERMISSIONS_CODE;
   } else {
-    const GlobalVariable *gv = dyn_cast<GlobalVariable>(def);
-    if (gv && gv->isConstant())
+    if (isConstantVar)
       attr |= LTO_SYMBOL_PERMISSIONS_RODATA;
     else
       attr |= LTO_SYMBOL_PERMISSIONS_DATA;
   }
 
   // set definition part
-  if (def->hasWeakLinkage() || def->hasLinkOnceLinkage())
+  if (GlobalValue::isWeakLinkage(linkage) ||
+      GlobalValue::isLinkOnceLinkage(linkage))
     attr |= LTO_SYMBOL_DEFINITION_WEAK;
-  else if (def->hasCommonLinkage())
+  else if (GlobalValue::isCommonLinkage(linkage))
     attr |= LTO_SYMBOL_DEFINITION_TENTATIVE;
   else
     attr |= LTO_SYMBOL_DEFINITION_REGULAR;
 
   // set scope part
-  if (def->hasLocalLinkage())
+  if (GlobalValue::isLocalLinkage(linkage))
     // Ignore visibility if linkage is local.
     attr |= LTO_SYMBOL_SCOPE_INTERNAL;
-  else if (def->hasHiddenVisibility())
+  else if (vis == GlobalValue::HiddenVisibility)
     attr |= LTO_SYMBOL_SCOPE_HIDDEN;
-  else if (def->hasProtectedVisibility())
+  else if (vis == GlobalValue::ProtectedVisibility)
     attr |= LTO_SYMBOL_SCOPE_PROTECTED;
-  else if (canBeOmittedFromSymbolTable(def))
+  else if (canBeHidden)
     attr |= LTO_SYMBOL_SCOPE_DEFAULT_CAN_BE_HIDDEN;
   else
     attr |= LTO_SYMBOL_SCOPE_DEFAULT;
 
+  return attr;
+}
+
+void LTOModule::addDefinedSymbol(const char *Name, const GlobalValue *def,
+                                 bool isFunction) {
+  const GlobalVariable *gv = dyn_cast<GlobalVariable>(def);
+  uint32_t attr = getDefinedSymbolAttributes(
+      def->getAlignment(), isFunction, gv && gv->isConstant(),
+      def->getLinkage(), def->getVisibility(),
+      canBeOmittedFromSymbolTable(def));
+  addDefinedSymbol(Name, attr, isFunction, def);
+}
+
+void LTOModule::addDefinedSymbol(StringRef Name, uint32_t attr,
+                                 bool isFunction, const GlobalValue *def) {
   auto Iter = _defines.insert(Name).first;
 
   // fill information structure
@@ -553,7 +658,15 @@ void LTOModule::addPotentialUndefinedSymbol(const object::BasicSymbolRef &Sym,
     Sym.printName(OS);
   }
 
-  auto IterBool = _undefines.insert(std::make_pair(name, NameAndAttributes()));
+  const GlobalValue *decl = IRFile->getSymbolGV(Sym.getRawDataRefImpl());
+  addPotentialUndefinedSymbol(name, decl->hasExternalWeakLinkage(), isFunc,
+                              decl);
+}
+
+void LTOModule::addPotentialUndefinedSymbol(StringRef Name,
+                                            bool isExternalWeak, bool isFunc,
+                                            const GlobalValue *decl) {
+  auto IterBool = _undefines.insert(std::make_pair(Name, NameAndAttributes()));
 
   // we already have the symbol
   if (!IterBool.second)
@@ -563,9 +676,7 @@ void LTOModule::addPotentialUndefinedSymbol(const object::BasicSymbolRef &Sym,
 
   info.name = IterBool.first->first().data();
 
-  const GlobalValue *decl = IRFile->getSymbolGV(Sym.getRawDataRefImpl());
-
-  if (decl->hasExternalWeakLinkage())
+  if (isExternalWeak)
     info.attributes = LTO_SYMBOL_DEFINITION_WEAKUNDEF;
   else
     info.attributes = LTO_SYMBOL_DEFINITION_UNDEFINED;
@@ -622,7 +733,12 @@ bool LTOModule::parseSymbols(std::string &errMsg) {
     addDefinedDataSymbol(Sym);
   }
 
-  // make symbols for all undefines
+  addUndefinedSymbols();
+  return false;
+}
+
+/// addUndefinedSymbols - Make symbols for all undefines.
+void LTOModule::addUndefinedSymbols() {
   for (StringMap<NameAndAttributes>::iterator u =_undefines.begin(),
          e = _undefines.end(); u != e; ++u) {
     // If this symbol also has a definition, then don't make an undefine because
@@ -631,8 +747,40 @@ bool LTOModule::parseSymbols(std::string &errMsg) {
     NameAndAttributes info = u->getValue();
     _symbols.push_back(info);
   }
+}
 
-  return false;
+/// canBeHidden - The part of llvm::canBeOmittedFromSymbolTable that doesn't
+/// need the module: symbols whose uses would have to be analyzed are assumed
+/// to need a symbol table entry.
+static bool canBeHidden(const BitcodeSymbol &Sym) {
+  return GlobalValue::isLinkOnceODRLinkage(Sym.Linkage) && Sym.HasUnnamedAddr;
+}
+
+/// parseSymbolTable - Add the symbols of the bitcode's symbol table the way
+/// parseSymbols() adds the symbols of its module, and its linker options.
+void LTOModule::parseSymbolTable(const BitcodeSymbolTable &Table) {
+  for (const BitcodeSymbol &Sym : Table.Symbols) {
+    uint32_t Flags = IRObjectFile::getBitcodeSymbolFlags(Sym);
+    if (Flags & object::BasicSymbolRef::SF_FormatSpecific)
+      continue;
+
+    bool IsFunction = Sym.Kind == BitcodeSymbol::Function;
+    if (Flags & object::BasicSymbolRef::SF_Undefined) {
+      addPotentialUndefinedSymbol(
+          Sym.Name, GlobalValue::isExternalWeakLinkage(Sym.Linkage),
+          IsFunction, nullptr);
+      continue;
+    }
+
+    uint32_t attr = getDefinedSymbolAttributes(
+        Sym.Alignment, IsFunction, Sym.IsConstant, Sym.Linkage, Sym.Visibility,
+        canBeHidden(Sym));
+    addDefinedSymbol(Sym.Name, attr, IsFunction, nullptr);
+  }
+  addUndefinedSymbols();
+
+  for (const std::string &Opt : Table.LinkerOptions)
+    addLinkerOpt(Opt);
 }
 
 /// parseMetadata - Parse metadata from the module
@@ -644,22 +792,25 @@ void LTOModule::parseMetadata() {
       MDNode *MDOptions = cast<MDNode>(LinkerOptions->getOperand(i));
       for (unsigned ii = 0, ie = MDOptions->getNumOperands(); ii != ie; ++ii) {
         MDString *MDOption = cast<MDString>(MDOptions->getOperand(ii));
-        // FIXME: Make StringSet::insert match Self-Associative Container
-        // requirements, returning <iter,bool> rather than bool, and use that
-        // here.
-        StringRef Op =
-            _linkeropt_strings.insert(MDOption->getString()).first->first();
-        StringRef DepLibName = _target->getSubtargetImpl()
-                                   ->getTargetLowering()
-                                   ->getObjFileLowering()
-                                   .getDepLibFromLinkerOpt(Op);
-        if (!DepLibName.empty())
-          _deplibs.push_back(DepLibName.data());
-        else if (!Op.empty())
-          _linkeropts.push_back(Op.data());
+        addLinkerOpt(MDOption->getString());
       }
     }
   }
 
   // Add other interesting metadata here.
 }
+
+void LTOModule::addLinkerOpt(StringRef Opt) {
+  // FIXME: Make StringSet::insert match Self-Associative Container
+  // requirements, returning <iter,bool> rather than bool, and use that
+  // here.
+  StringRef Op = _linkeropt_strings.insert(Opt).first->first();
+  StringRef DepLibName = _target->getSubtargetImpl()
+                             ->getTargetLowering()
+                             ->getObjFileLowering()
+                             .getDepLibFromLinkerOpt(Op);
+  if (!DepLibName.empty())
+    _deplibs.push_back(DepLibName.data());
+  else if (!Op.empty())
+    _linkeropts.push_back(Op.data());
+}
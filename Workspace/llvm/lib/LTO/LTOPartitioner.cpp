@@ -0,0 +1,466 @@
+//===-LTOPartitioner.cpp - Summary-based partitioned LTO -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the LTOPartitioner class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/LTOPartitioner.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+static cl::opt<unsigned>
+ImportInstrLimit("lto-import-instr-limit", cl::init(100), cl::Hidden,
+  cl::desc("Only import functions with at most this many instructions into "
+           "other LTO partitions"));
+
+LTOPartitioner::LTOPartitioner() {}
+
+LTOPartitioner::~LTOPartitioner() {}
+
+unsigned LTOPartitioner::getNameID(StringRef Name) {
+  auto Inserted = NameIDs.insert(std::make_pair(Name, Names.size()));
+  if (Inserted.second)
+    Names.push_back(Inserted.first->first());
+  return Inserted.first->second;
+}
+
+/// Add the global values that \p C refers to to \p Refs.
+static void findRefs(const Constant *C,
+                     SmallPtrSetImpl<const GlobalValue *> &Refs,
+                     SmallPtrSetImpl<const Constant *> &Visited) {
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    Refs.insert(GV);
+    return;
+  }
+  if (!Visited.insert(C).second)
+    return;
+  for (const Use &Op : C->operands())
+    if (const Constant *OpC = dyn_cast<Constant>(Op))
+      findRefs(OpC, Refs, Visited);
+}
+
+/// Return true if partitioning ignores \p GV: it only exists within its
+/// module, or it is one of the special globals of the IR linker.
+static bool isIgnored(const GlobalValue &GV) {
+  return GV.hasLocalLinkage() || GV.hasAvailableExternallyLinkage() ||
+         GV.hasAppendingLinkage() || !GV.hasName() ||
+         GV.getName().startswith("llvm.");
+}
+
+void LTOPartitioner::addModule(Module &M) {
+  M.materializeAll();
+
+  Modules.push_back(ModuleSummary());
+  ModuleSummary &MS = Modules.back();
+  MS.Size = 0;
+
+  SmallPtrSet<const GlobalValue *, 64> ModuleRefs;
+  SmallPtrSet<const GlobalValue *, 16> Refs;
+  SmallPtrSet<const Constant *, 16> Visited;
+
+  auto Summarize = [&](const GlobalValue &GV, unsigned Size) {
+    ModuleRefs.insert(Refs.begin(), Refs.end());
+    if (isIgnored(GV) || GV.isDeclaration())
+      return;
+
+    GlobalSummary GS;
+    GS.NameID = getNameID(GV.getName());
+    GS.Linkage = GV.getLinkage();
+    GS.Size = Size;
+    GS.IsFunction = isa<Function>(GV);
+    GS.IsCold = GS.IsFunction &&
+                cast<Function>(GV).hasFnAttribute(Attribute::Cold);
+    GS.InComdat = GV.hasComdat();
+    GS.RefsLocals = false;
+    for (const GlobalValue *Ref : Refs) {
+      if (Ref->hasLocalLinkage() || !Ref->hasName()) {
+        GS.RefsLocals = true;
+        continue;
+      }
+      if (!Ref->getName().startswith("llvm."))
+        GS.Refs.push_back(getNameID(Ref->getName()));
+    }
+    std::sort(GS.Refs.begin(), GS.Refs.end());
+    MS.Globals.push_back(std::move(GS));
+  };
+
+  for (const Function &F : M) {
+    Refs.clear();
+    Visited.clear();
+    unsigned Size = 0;
+    for (const BasicBlock &BB : F) {
+      Size += BB.size();
+      for (const Instruction &I : BB)
+        for (const Use &Op : I.operands())
+          if (const Constant *C = dyn_cast<Constant>(Op))
+            findRefs(C, Refs, Visited);
+    }
+    MS.Size += Size;
+    Summarize(F, Size);
+  }
+
+  for (const GlobalVariable &GV : M.globals()) {
+    Refs.clear();
+    Visited.clear();
+    if (GV.hasInitializer())
+      findRefs(GV.getInitializer(), Refs, Visited);
+    Summarize(GV, 0);
+  }
+
+  for (const GlobalAlias &GA : M.aliases()) {
+    Refs.clear();
+    Visited.clear();
+    findRefs(GA.getAliasee(), Refs, Visited);
+    Summarize(GA, 0);
+  }
+
+  for (const GlobalValue *Ref : ModuleRefs)
+    if (!Ref->hasLocalLinkage() && Ref->hasName() &&
+        !Ref->getName().startswith("llvm."))
+      MS.Refs.push_back(getNameID(Ref->getName()));
+  std::sort(MS.Refs.begin(), MS.Refs.end());
+
+  SmallString<0> Bitcode;
+  {
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&M, OS);
+  }
+  MS.Bitcode =
+      MemoryBuffer::getMemBufferCopy(Bitcode.str(), M.getModuleIdentifier());
+
+  MD5 Hasher;
+  Hasher.update(Bitcode.str());
+  Hasher.final(MS.Hash);
+}
+
+bool LTOPartitioner::isImportable(const GlobalSummary &GS) const {
+  // Definitions that another module could override must not be copied:
+  // code that inlined the copy would not see the override.
+  switch (GS.Linkage) {
+  case GlobalValue::ExternalLinkage:
+  case GlobalValue::LinkOnceODRLinkage:
+  case GlobalValue::WeakODRLinkage:
+    break;
+  default:
+    return false;
+  }
+  return GS.IsFunction && !GS.IsCold && !GS.InComdat && !GS.RefsLocals &&
+         GS.Size <= ImportInstrLimit;
+}
+
+void LTOPartitioner::plan(unsigned MaxPartitions) {
+  unsigned NumNames = Names.size();
+  Prevailing.assign(NumNames, -1);
+  PrevailingGlobal.assign(NumNames, 0);
+  Exported.reset();
+  Exported.resize(NumNames);
+
+  // The first strong definition of a name prevails, or else the first weak
+  // one, like when linking the inputs in order. The native linker gets to
+  // choose among commons and comdat groups, so all of those are kept.
+  for (unsigned MI = 0, ME = Modules.size(); MI != ME; ++MI) {
+    const std::vector<GlobalSummary> &Globals = Modules[MI].Globals;
+    for (unsigned GI = 0, GE = Globals.size(); GI != GE; ++GI) {
+      const GlobalSummary &GS = Globals[GI];
+      if (GS.InComdat || GS.Linkage == GlobalValue::CommonLinkage) {
+        Exported.set(GS.NameID);
+        continue;
+      }
+      int &Def = Prevailing[GS.NameID];
+      if (Def != -1) {
+        const GlobalSummary &Prev =
+            Modules[Def].Globals[PrevailingGlobal[GS.NameID]];
+        if (!GlobalValue::isWeakForLinker(Prev.Linkage) ||
+            GlobalValue::isWeakForLinker(GS.Linkage))
+          continue;
+      }
+      Def = MI;
+      PrevailingGlobal[GS.NameID] = GI;
+    }
+  }
+
+  // Spread the inputs over the partitions, largest first, each to the
+  // partition with the fewest instructions so far.
+  unsigned NumPartitions =
+      std::max(1u, std::min<unsigned>(MaxPartitions, Modules.size()));
+  std::vector<unsigned> Order(Modules.size());
+  for (unsigned MI = 0, ME = Modules.size(); MI != ME; ++MI)
+    Order[MI] = MI;
+  std::stable_sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B) {
+    return Modules[A].Size > Modules[B].Size;
+  });
+  std::vector<uint64_t> Load(NumPartitions);
+  PartitionOf.assign(Modules.size(), 0);
+  for (unsigned MI : Order) {
+    unsigned P = std::min_element(Load.begin(), Load.end()) - Load.begin();
+    PartitionOf[MI] = P;
+    // Count every input, so that empty ones are spread out too.
+    Load[P] += Modules[MI].Size + 1;
+  }
+  Partitions.assign(NumPartitions, std::vector<unsigned>());
+  for (unsigned MI = 0, ME = Modules.size(); MI != ME; ++MI)
+    Partitions[PartitionOf[MI]].push_back(MI);
+
+  // A name referenced by a partition other than the one with its prevailing
+  // definition must stay visible. Small functions are also imported, which
+  // makes what they reference visible in turn.
+  Imports.assign(NumPartitions, std::vector<unsigned>());
+  for (unsigned P = 0; P != NumPartitions; ++P) {
+    BitVector Used(NumNames);
+    for (unsigned MI : Partitions[P])
+      for (unsigned ID : Modules[MI].Refs)
+        Used.set(ID);
+
+    for (int ID = Used.find_first(); ID != -1; ID = Used.find_next(ID)) {
+      int Def = Prevailing[ID];
+      if (Def == -1 || PartitionOf[Def] == P)
+        continue;
+      Exported.set(ID);
+
+      const GlobalSummary &GS = Modules[Def].Globals[PrevailingGlobal[ID]];
+      if (!isImportable(GS))
+        continue;
+      Imports[P].push_back(ID);
+      for (unsigned Ref : GS.Refs)
+        if (Prevailing[Ref] != -1 && PartitionOf[Prevailing[Ref]] != P)
+          Exported.set(Ref);
+    }
+  }
+}
+
+void LTOPartitioner::hashPartition(
+    unsigned I, MD5 &Hasher,
+    function_ref<unsigned(StringRef)> Resolution) const {
+  auto AddInt = [&](uint32_t V) {
+    uint8_t Bytes[4] = {uint8_t(V), uint8_t(V >> 8), uint8_t(V >> 16),
+                        uint8_t(V >> 24)};
+    Hasher.update(Bytes);
+  };
+  auto AddString = [&](StringRef S) {
+    AddInt(S.size());
+    Hasher.update(S);
+  };
+
+  AddInt(Partitions[I].size());
+  for (unsigned MI : Partitions[I]) {
+    Hasher.update(Modules[MI].Hash);
+    const std::vector<GlobalSummary> &Globals = Modules[MI].Globals;
+    AddInt(Globals.size());
+    for (const GlobalSummary &GS : Globals) {
+      StringRef Name = Names[GS.NameID];
+      int Def = Prevailing[GS.NameID];
+      AddString(Name);
+      AddInt(Def == -1 || unsigned(Def) == MI);
+      AddInt(Exported.test(GS.NameID));
+      AddInt(Resolution(Name));
+    }
+  }
+
+  // An imported function only depends on the input it comes from, which is
+  // hashed whole.
+  AddInt(Imports[I].size());
+  for (unsigned ID : Imports[I]) {
+    AddString(Names[ID]);
+    Hasher.update(Modules[Prevailing[ID]].Hash);
+  }
+}
+
+bool LTOPartitioner::isExported(StringRef Name) const {
+  assert(Exported.size() == Names.size() && "plan() not called");
+  StringMap<unsigned>::const_iterator I = NameIDs.find(Name);
+  return I != NameIDs.end() && Exported.test(I->second);
+}
+
+bool LTOPartitioner::isPrevailing(unsigned Module, StringRef Name) const {
+  StringMap<unsigned>::const_iterator I = NameIDs.find(Name);
+  if (I == NameIDs.end())
+    return true;
+  int Def = Prevailing[I->second];
+  return Def == -1 || unsigned(Def) == Module;
+}
+
+/// Load \p Bitcode into \p Context, leaving function bodies to be read when
+/// they are needed.
+static std::unique_ptr<Module> loadModule(const MemoryBuffer &Bitcode,
+                                          LLVMContext &Context,
+                                          std::string &ErrMsg) {
+  std::unique_ptr<MemoryBuffer> Buffer =
+      MemoryBuffer::getMemBuffer(Bitcode.getMemBufferRef(), false);
+  ErrorOr<Module *> M = getLazyBitcodeModule(std::move(Buffer), Context);
+  if (std::error_code EC = M.getError()) {
+    ErrMsg = (Twine("could not read ") + Bitcode.getBufferIdentifier() + ": " +
+              EC.message()).str();
+    return nullptr;
+  }
+  return std::unique_ptr<Module>(M.get());
+}
+
+/// Return the functions, variables and aliases of \p M.
+static std::vector<GlobalValue *> getGlobalValues(Module &M) {
+  std::vector<GlobalValue *> GVs;
+  for (Function &F : M)
+    GVs.push_back(&F);
+  for (GlobalVariable &GV : M.globals())
+    GVs.push_back(&GV);
+  for (GlobalAlias &GA : M.aliases())
+    GVs.push_back(&GA);
+  return GVs;
+}
+
+/// Turn the definition \p GV into a declaration.
+static void dropDefinition(GlobalValue &GV) {
+  if (Function *F = dyn_cast<Function>(&GV)) {
+    F->deleteBody();
+    F->setComdat(nullptr);
+    return;
+  }
+
+  if (GlobalVariable *Var = dyn_cast<GlobalVariable>(&GV)) {
+    Var->setInitializer(nullptr);
+    Var->setLinkage(GlobalValue::ExternalLinkage);
+    Var->setComdat(nullptr);
+    return;
+  }
+
+  // Aliases can't be declarations; replace them with a function or variable.
+  GlobalAlias &GA = cast<GlobalAlias>(GV);
+  Module &M = *GA.getParent();
+  PointerType *Ty = GA.getType();
+  GlobalValue *Declaration;
+  if (FunctionType *FTy = dyn_cast<FunctionType>(Ty->getElementType()))
+    Declaration = Function::Create(FTy, GlobalValue::ExternalLinkage, "", &M);
+  else
+    Declaration = new GlobalVariable(
+        M, Ty->getElementType(), /*isConstant*/ false,
+        GlobalValue::ExternalLinkage, /*Initializer*/ nullptr, "", nullptr,
+        GA.getThreadLocalMode(), Ty->getAddressSpace());
+  Declaration->setVisibility(GA.getVisibility());
+  Declaration->takeName(&GA);
+  GA.replaceAllUsesWith(Declaration);
+  GA.eraseFromParent();
+}
+
+/// Make sure that the prevailing definition \p GV, which other partitions
+/// use, is emitted even if nothing in its own partition refers to it any
+/// more, e.g. once all calls to it are inlined.
+static void keepForOtherPartitions(GlobalValue &GV) {
+  if (GV.hasLinkOnceODRLinkage())
+    GV.setLinkage(GlobalValue::WeakODRLinkage);
+  else if (GV.hasLinkOnceLinkage())
+    GV.setLinkage(GlobalValue::WeakAnyLinkage);
+}
+
+std::unique_ptr<Module>
+LTOPartitioner::buildPartition(unsigned I, LLVMContext &Context,
+                               std::string &ErrMsg) const {
+  std::unique_ptr<Module> Composite(new Module("ld-temp.o", Context));
+  Linker L(Composite.get());
+
+  std::vector<GlobalValue *> Drop;
+  for (unsigned MI : Partitions[I]) {
+    std::unique_ptr<Module> M =
+        loadModule(*Modules[MI].Bitcode, Context, ErrMsg);
+    if (!M)
+      return nullptr;
+
+    Drop.clear();
+    for (GlobalValue *GV : getGlobalValues(*M)) {
+      if (isIgnored(*GV) || GV->isDeclaration() || GV->hasComdat() ||
+          GV->hasCommonLinkage())
+        continue;
+      if (!isPrevailing(MI, GV->getName()))
+        Drop.push_back(GV);
+      else if (isExported(GV->getName()))
+        keepForOtherPartitions(*GV);
+    }
+    for (GlobalValue *GV : Drop)
+      dropDefinition(*GV);
+
+    if (L.linkInModule(M.get())) {
+      ErrMsg = std::string("could not link ") +
+               Modules[MI].Bitcode->getBufferIdentifier();
+      return nullptr;
+    }
+  }
+
+  // Import from one input at a time, in input order.
+  std::vector<std::pair<unsigned, unsigned> > BySource;
+  for (unsigned ID : Imports[I])
+    BySource.push_back(std::make_pair(unsigned(Prevailing[ID]), ID));
+  std::sort(BySource.begin(), BySource.end());
+
+  for (unsigned Begin = 0, End; Begin != BySource.size(); Begin = End) {
+    unsigned MI = BySource[Begin].first;
+    std::unique_ptr<Module> M =
+        loadModule(*Modules[MI].Bitcode, Context, ErrMsg);
+    if (!M)
+      return nullptr;
+
+    SmallPtrSet<GlobalValue *, 16> Imported;
+    for (End = Begin; End != BySource.size() && BySource[End].first == MI;
+         ++End) {
+      Function *F = M->getFunction(Names[BySource[End].second]);
+      if (std::error_code EC = F->materialize()) {
+        ErrMsg = EC.message();
+        return nullptr;
+      }
+      F->setLinkage(GlobalValue::AvailableExternallyLinkage);
+      Imported.insert(F);
+    }
+
+    // Keep only the imported functions; everything else is the business of
+    // the partition that defines it. Locals are only linked if referenced,
+    // and imported functions don't reference any.
+    Drop.clear();
+    std::vector<GlobalVariable *> Appending;
+    for (GlobalValue *GV : getGlobalValues(*M)) {
+      if (GV->hasAppendingLinkage())
+        Appending.push_back(cast<GlobalVariable>(GV));
+      else if (!GV->hasLocalLinkage() && !GV->isDeclaration() &&
+               !Imported.count(GV))
+        Drop.push_back(GV);
+    }
+    for (GlobalValue *GV : Drop)
+      dropDefinition(*GV);
+    for (GlobalVariable *GV : Appending)
+      GV->eraseFromParent();
+
+    // The partition that defines the imported functions emits their debug
+    // info; copies that are never emitted don't need any.
+    StripDebugInfo(*M);
+    for (Module::named_metadata_iterator NMI = M->named_metadata_begin(),
+                                         NME = M->named_metadata_end();
+         NMI != NME;) {
+      NamedMDNode *NMD = NMI++;
+      if (NMD->getName() != "llvm.module.flags")
+        NMD->eraseFromParent();
+    }
+
+    if (L.linkInModule(M.get())) {
+      ErrMsg = std::string("could not import from ") +
+               Modules[MI].Bitcode->getBufferIdentifier();
+      return nullptr;
+    }
+  }
+
+  return Composite;
+}
@@ -16,8 +16,10 @@
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DiagnosticInfo.h"
@@ -27,8 +29,12 @@
 #include "llvm/IR/TypeFinder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 #include <cctype>
 #include <tuple>
 using namespace llvm;
@@ -96,17 +102,30 @@ public:
 private:
   Type *remapType(Type *SrcTy) override { return get(SrcTy); }
 
-  bool areTypesIsomorphic(Type *DstTy, Type *SrcTy);
+  /// Map \p SrcTy to \p DstTy if they are isomorphic.  Unless \p MatchOpaque
+  /// is set, opaque structs only match themselves, so that nothing is left
+  /// for linkDefinedTypeBodies() to do.  Returns true if the types were
+  /// mapped.
+  bool tryTypeMapping(Type *DstTy, Type *SrcTy, bool MatchOpaque);
+
+  bool areTypesIsomorphic(Type *DstTy, Type *SrcTy, bool MatchOpaque);
+
+  StructType *findIsomorphicStruct(StructType *SrcSTy);
 };
 }
 
 void TypeMapTy::addTypeMapping(Type *DstTy, Type *SrcTy) {
+  tryTypeMapping(DstTy, SrcTy, /*MatchOpaque=*/true);
+}
+
+bool TypeMapTy::tryTypeMapping(Type *DstTy, Type *SrcTy, bool MatchOpaque) {
   assert(SpeculativeTypes.empty());
   assert(SpeculativeDstOpaqueTypes.empty());
 
   // Check to see if these types are recursively isomorphic and establish a
   // mapping between them if so.
-  if (!areTypesIsomorphic(DstTy, SrcTy)) {
+  bool Isomorphic = areTypesIsomorphic(DstTy, SrcTy, MatchOpaque);
+  if (!Isomorphic) {
     // Oops, they aren't isomorphic.  Just discard this request by rolling out
     // any speculative mappings we've established.
     for (Type *Ty : SpeculativeTypes)
@@ -124,11 +143,25 @@ void TypeMapTy::addTypeMapping(Type *DstTy, Type *SrcTy) {
   }
   SpeculativeTypes.clear();
   SpeculativeDstOpaqueTypes.clear();
+  return Isomorphic;
+}
+
+/// Look for a struct in the destination module that \p SrcSTy is isomorphic
+/// to among those with the same shape, and map SrcSTy to it.  Unlike mapping
+/// the elements and looking the struct up by them, this finds the structs of
+/// recursive types too.
+StructType *TypeMapTy::findIsomorphicStruct(StructType *SrcSTy) {
+  unsigned ShapeHash = Linker::IdentifiedStructTypeSet::getShapeHash(SrcSTy);
+  for (StructType *DstSTy : DstStructTypesSet.findNonOpaqueByShape(ShapeHash))
+    if (tryTypeMapping(DstSTy, SrcSTy, /*MatchOpaque=*/false))
+      return DstSTy;
+  return nullptr;
 }
 
 /// Recursively walk this pair of types, returning true if they are isomorphic,
 /// false if they are not.
-bool TypeMapTy::areTypesIsomorphic(Type *DstTy, Type *SrcTy) {
+bool TypeMapTy::areTypesIsomorphic(Type *DstTy, Type *SrcTy,
+                                   bool MatchOpaque) {
   // Two types with differing kinds are clearly not isomorphic.
   if (DstTy->getTypeID() != SrcTy->getTypeID())
     return false;
@@ -151,6 +184,8 @@ bool TypeMapTy::areTypesIsomorphic(Type *DstTy, Type *SrcTy) {
   if (StructType *SSTy = dyn_cast<StructType>(SrcTy)) {
     // Mapping an opaque type to any struct, just keep the dest struct.
     if (SSTy->isOpaque()) {
+      if (!MatchOpaque)
+        return false;
       Entry = DstTy;
       SpeculativeTypes.push_back(SrcTy);
       return true;
@@ -161,6 +196,8 @@ bool TypeMapTy::areTypesIsomorphic(Type *DstTy, Type *SrcTy) {
     // the dest, but fill it in later. If this is the second (different) type
     // that we're trying to map onto the same opaque type then we fail.
     if (cast<StructType>(DstTy)->isOpaque()) {
+      if (!MatchOpaque)
+        return false;
       // We can only map one source type onto the opaque destination type.
       if (!DstResolvedOpaqueTypes.insert(cast<StructType>(DstTy)).second)
         return false;
@@ -206,7 +243,7 @@ bool TypeMapTy::areTypesIsomorphic(Type *DstTy, Type *SrcTy) {
 
   for (unsigned I = 0, E = SrcTy->getNumContainedTypes(); I != E; ++I)
     if (!areTypesIsomorphic(DstTy->getContainedType(I),
-                            SrcTy->getContainedType(I)))
+                            SrcTy->getContainedType(I), MatchOpaque))
       return false;
 
   // If everything seems to have lined up, then everything is great.
@@ -267,6 +304,14 @@ Type *TypeMapTy::get(Type *Ty, SmallPtrSet<StructType *, 8> &Visited) {
   }
 #endif
 
+  // Reuse an isomorphic struct of the destination module if there is one.
+  // Structs that are being mapped further up have to get a type of their own.
+  if (!IsUniqued && !cast<StructType>(Ty)->isOpaque() &&
+      !Visited.count(cast<StructType>(Ty)))
+    if (StructType *DTy = findIsomorphicStruct(cast<StructType>(Ty)))
+      return DTy;
+  Entry = &MappedTypes[Ty];
+
   if (!IsUniqued && !Visited.insert(cast<StructType>(Ty)).second) {
     StructType *DTy = StructType::create(Ty->getContext());
     return *Entry = DTy;
@@ -367,14 +412,24 @@ class ValueMaterializerTy : public ValueMaterializer {
   TypeMapTy &TypeMap;
   Module *DstM;
   std::vector<GlobalValue *> &LazilyLinkGlobalValues;
+  ValueToValueMapTy &ValueMap;
+  Linker::MergeableConstantMap &MergeableConstants;
+  const SmallPtrSetImpl<GlobalValue *> &UsedGlobals;
 
 public:
   ValueMaterializerTy(TypeMapTy &TypeMap, Module *DstM,
-                      std::vector<GlobalValue *> &LazilyLinkGlobalValues)
+                      std::vector<GlobalValue *> &LazilyLinkGlobalValues,
+                      ValueToValueMapTy &ValueMap,
+                      Linker::MergeableConstantMap &MergeableConstants,
+                      const SmallPtrSetImpl<GlobalValue *> &UsedGlobals)
       : ValueMaterializer(), TypeMap(TypeMap), DstM(DstM),
-        LazilyLinkGlobalValues(LazilyLinkGlobalValues) {}
+        LazilyLinkGlobalValues(LazilyLinkGlobalValues), ValueMap(ValueMap),
+        MergeableConstants(MergeableConstants), UsedGlobals(UsedGlobals) {}
 
   Value *materializeValueFor(Value *V) override;
+
+private:
+  GlobalVariable *linkMergeableConstant(GlobalVariable &SGVar);
 };
 
 class LinkDiagnosticInfo : public DiagnosticInfo {
@@ -420,14 +475,28 @@ class ModuleLinker {
   /// Functions that have replaced other functions.
   SmallPtrSet<const Function *, 16> OverridingFunctions;
 
+  /// The globals of the source module in llvm.used or llvm.compiler.used,
+  /// which are never merged with other constants.
+  SmallPtrSet<GlobalValue *, 8> UsedGlobals;
+
   DiagnosticHandlerFunction DiagnosticHandler;
 
+  /// Whether to link linkonce and available_externally globals even if
+  /// nothing references them.  Modules that merge several inputs need this,
+  /// since a global dropped as unreferenced by one run of inputs may be
+  /// needed by another.
+  bool KeepUnreferencedLinkOnce;
+
 public:
-  ModuleLinker(Module *dstM, Linker::IdentifiedStructTypeSet &Set, Module *srcM,
-               DiagnosticHandlerFunction DiagnosticHandler)
+  ModuleLinker(Module *dstM, Linker::IdentifiedStructTypeSet &Set,
+               Linker::MergeableConstantMap &Constants, Module *srcM,
+               DiagnosticHandlerFunction DiagnosticHandler,
+               bool KeepUnreferencedLinkOnce = false)
       : DstM(dstM), SrcM(srcM), TypeMap(Set),
-        ValMaterializer(TypeMap, DstM, LazilyLinkGlobalValues),
-        DiagnosticHandler(DiagnosticHandler) {}
+        ValMaterializer(TypeMap, DstM, LazilyLinkGlobalValues, ValueMap,
+                        Constants, UsedGlobals),
+        DiagnosticHandler(DiagnosticHandler),
+        KeepUnreferencedLinkOnce(KeepUnreferencedLinkOnce) {}
 
   bool run();
 
@@ -592,11 +661,72 @@ static GlobalValue *copyGlobalValueProto(TypeMapTy &TypeMap, Module &DstM,
   return NewGV;
 }
 
+/// Return true if \p C refers to no global values, directly or through other
+/// constants, so that it maps to the same constant whatever module it is
+/// linked into.
+static bool refersToNoGlobals(const Constant *C) {
+  SmallPtrSet<const Constant *, 16> Visited;
+  SmallVector<const Constant *, 16> Worklist;
+  Visited.insert(C);
+  Worklist.push_back(C);
+  while (!Worklist.empty()) {
+    const Constant *Cur = Worklist.pop_back_val();
+    if (isa<GlobalValue>(Cur))
+      return false;
+    for (const Use &Op : Cur->operands()) {
+      auto *OpC = dyn_cast<Constant>(Op);
+      if (!OpC)
+        return false;
+      if (Visited.insert(OpC).second)
+        Worklist.push_back(OpC);
+    }
+  }
+  return true;
+}
+
+/// Return true if \p GV is a constant whose address nothing depends on and
+/// whose initializer refers to no globals, so that it can be merged with an
+/// identical one from another module, as ConstantMerge would.
+static bool isMergeableConstant(const GlobalVariable &GV) {
+  return GV.hasLocalLinkage() && GV.hasUnnamedAddr() && GV.isConstant() &&
+         GV.hasDefinitiveInitializer() && !GV.hasSection() &&
+         !GV.hasComdat() && !GV.isThreadLocal() &&
+         GV.getType()->getAddressSpace() == 0 &&
+         refersToNoGlobals(GV.getInitializer());
+}
+
+/// Return the constant of the destination module that \p SGVar is identical
+/// to, or else a copy of SGVar that later ones can be merged into.
+GlobalVariable *
+ValueMaterializerTy::linkMergeableConstant(GlobalVariable &SGVar) {
+  // The initializer refers to no globals, so mapping it only maps its type.
+  Constant *Init = MapValue(SGVar.getInitializer(), ValueMap, RF_None,
+                            &TypeMap, this);
+  WeakVH &Slot =
+      MergeableConstants[std::make_pair(Init, SGVar.getAlignment())];
+
+  // The client may have changed the composite module since.
+  auto *DGVar = dyn_cast_or_null<GlobalVariable>(Slot);
+  if (DGVar && DGVar->getParent() == DstM && isMergeableConstant(*DGVar) &&
+      DGVar->getInitializer() == Init)
+    return DGVar;
+
+  DGVar = copyGlobalVariableProto(TypeMap, *DstM, &SGVar);
+  copyGVAttributes(DGVar, &SGVar);
+  DGVar->setInitializer(Init);
+  Slot = DGVar;
+  return DGVar;
+}
+
 Value *ValueMaterializerTy::materializeValueFor(Value *V) {
   auto *SGV = dyn_cast<GlobalValue>(V);
   if (!SGV)
     return nullptr;
 
+  if (auto *SGVar = dyn_cast<GlobalVariable>(SGV))
+    if (!UsedGlobals.count(SGVar) && isMergeableConstant(*SGVar))
+      return linkMergeableConstant(*SGVar);
+
   GlobalValue *DGV = copyGlobalValueProto(TypeMap, *DstM, SGV);
 
   if (Comdat *SC = SGV->getComdat()) {
@@ -738,6 +868,11 @@ bool ModuleLinker::shouldLinkFromSource(bool &LinkFromSrc,
   bool DestIsDeclaration = Dest.isDeclarationForLinker();
 
   if (SrcIsDeclaration) {
+    // An available_externally body is better than no body at all.
+    if (Src.hasAvailableExternallyLinkage() && Dest.isDeclaration()) {
+      LinkFromSrc = true;
+      return false;
+    }
     // If Src is external or if both Src & Dest are external..  Just link the
     // external globals, we aren't adding anything.
     if (Src.hasDLLImportStorageClass()) {
@@ -1076,8 +1211,10 @@ bool ModuleLinker::linkGlobalValueProto(GlobalValue *SGV) {
   } else {
     // If the GV is to be lazily linked, don't create it just yet.
     // The ValueMaterializerTy will deal with creating it if it's used.
-    if (!DGV && (SGV->hasLocalLinkage() || SGV->hasLinkOnceLinkage() ||
-                 SGV->hasAvailableExternallyLinkage())) {
+    if (!DGV && (SGV->hasLocalLinkage() ||
+                 (!KeepUnreferencedLinkOnce &&
+                  (SGV->hasLinkOnceLinkage() ||
+                   SGV->hasAvailableExternallyLinkage())))) {
       DoNotLinkFromSource.insert(SGV);
       return false;
     }
@@ -1461,6 +1598,14 @@ bool ModuleLinker::run() {
   assert(DstM && "Null destination module");
   assert(SrcM && "Null source module");
 
+  // The source may have been read without its metadata, which the linked
+  // functions and named metadata need.
+  if (std::error_code EC = SrcM->materializeMetadata())
+    return emitError(EC.message());
+
+  collectUsedGlobalVariables(*SrcM, UsedGlobals, /*CompilerUsed=*/false);
+  collectUsedGlobalVariables(*SrcM, UsedGlobals, /*CompilerUsed=*/true);
+
   // Inherit the target data from the source module if the destination module
   // doesn't have one already.
   if (!DstM->getDataLayout() && SrcM->getDataLayout())
@@ -1659,7 +1804,8 @@ bool Linker::StructTypeKeyInfo::isEqual(const StructType *LHS,
 
 void Linker::IdentifiedStructTypeSet::addNonOpaque(StructType *Ty) {
   assert(!Ty->isOpaque());
-  NonOpaqueStructTypes.insert(Ty);
+  if (NonOpaqueStructTypes.insert(Ty).second)
+    NonOpaqueStructTypesByShape[getShapeHash(Ty)].push_back(Ty);
 }
 
 void Linker::IdentifiedStructTypeSet::addOpaque(StructType *Ty) {
@@ -1677,6 +1823,47 @@ Linker::IdentifiedStructTypeSet::findNonOpaque(ArrayRef<Type *> ETypes,
   return *I;
 }
 
+ArrayRef<StructType *> Linker::IdentifiedStructTypeSet::findNonOpaqueByShape(
+    unsigned ShapeHash) const {
+  auto I = NonOpaqueStructTypesByShape.find(ShapeHash);
+  if (I == NonOpaqueStructTypesByShape.end())
+    return None;
+  return I->second;
+}
+
+/// Hash the shape of \p Ty, treating identified structs as opaque.
+static hash_code hashTypeShape(Type *Ty) {
+  auto *STy = dyn_cast<StructType>(Ty);
+  if (STy && !STy->isLiteral())
+    return hash_value(unsigned(Type::StructTyID));
+
+  hash_code Hash = hash_value(unsigned(Ty->getTypeID()));
+  if (auto *ITy = dyn_cast<IntegerType>(Ty))
+    Hash = hash_combine(Hash, ITy->getBitWidth());
+  else if (auto *PTy = dyn_cast<PointerType>(Ty))
+    Hash = hash_combine(Hash, PTy->getAddressSpace());
+  else if (auto *FTy = dyn_cast<FunctionType>(Ty))
+    Hash = hash_combine(Hash, FTy->isVarArg());
+  else if (STy)
+    Hash = hash_combine(Hash, STy->isPacked());
+  else if (auto *ATy = dyn_cast<ArrayType>(Ty))
+    Hash = hash_combine(Hash, ATy->getNumElements());
+  else if (auto *VTy = dyn_cast<VectorType>(Ty))
+    Hash = hash_combine(Hash, VTy->getNumElements());
+
+  for (unsigned I = 0, E = Ty->getNumContainedTypes(); I != E; ++I)
+    Hash = hash_combine(Hash, hashTypeShape(Ty->getContainedType(I)));
+  return Hash;
+}
+
+unsigned Linker::IdentifiedStructTypeSet::getShapeHash(StructType *Ty) {
+  hash_code Hash = hash_value(Ty->isPacked());
+  for (Type *ElTy : Ty->elements())
+    Hash = hash_combine(Hash, hashTypeShape(ElTy));
+  // Keep clear of the keys DenseMap reserves.
+  return unsigned(size_t(Hash)) & 0x7fffffffU;
+}
+
 bool Linker::IdentifiedStructTypeSet::hasType(StructType *Ty) {
   if (Ty->isOpaque())
     return OpaqueStructTypes.count(Ty);
@@ -1686,20 +1873,37 @@ bool Linker::IdentifiedStructTypeSet::hasType(StructType *Ty) {
   return *I == Ty;
 }
 
-void Linker::init(Module *M, DiagnosticHandlerFunction DiagnosticHandler) {
-  this->Composite = M;
-  this->DiagnosticHandler = DiagnosticHandler;
-
+/// Add the identified struct types of \p M to \p Set.
+static void findIdentifiedStructTypes(Module &M,
+                                      Linker::IdentifiedStructTypeSet &Set) {
   TypeFinder StructTypes;
-  StructTypes.run(*M, true);
+  StructTypes.run(M, true);
   for (StructType *Ty : StructTypes) {
     if (Ty->isOpaque())
-      IdentifiedStructTypes.addOpaque(Ty);
+      Set.addOpaque(Ty);
     else
-      IdentifiedStructTypes.addNonOpaque(Ty);
+      Set.addNonOpaque(Ty);
   }
 }
 
+/// Add the constants of \p M that constants linked in later can be merged
+/// into to \p Constants.
+static void findMergeableConstants(Module &M,
+                                   Linker::MergeableConstantMap &Constants) {
+  for (GlobalVariable &GV : M.globals())
+    if (isMergeableConstant(GV))
+      Constants.insert(std::make_pair(
+          std::make_pair(GV.getInitializer(), GV.getAlignment()),
+          WeakVH(&GV)));
+}
+
+void Linker::init(Module *M, DiagnosticHandlerFunction DiagnosticHandler) {
+  this->Composite = M;
+  this->DiagnosticHandler = DiagnosticHandler;
+  findIdentifiedStructTypes(*M, IdentifiedStructTypes);
+  findMergeableConstants(*M, MergeableConstants);
+}
+
 Linker::Linker(Module *M, DiagnosticHandlerFunction DiagnosticHandler) {
   init(M, DiagnosticHandler);
 }
@@ -1719,8 +1923,8 @@ void Linker::deleteModule() {
 }
 
 bool Linker::linkInModule(Module *Src) {
-  ModuleLinker TheLinker(Composite, IdentifiedStructTypes, Src,
-                         DiagnosticHandler);
+  ModuleLinker TheLinker(Composite, IdentifiedStructTypes, MergeableConstants,
+                         Src, DiagnosticHandler);
   return TheLinker.run();
 }
 
@@ -1744,6 +1948,138 @@ bool Linker::LinkModules(Module *Dest, Module *Src) {
   return L.linkInModule(Src);
 }
 
+//===----------------------------------------------------------------------===//
+// Parallel linking.
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A module built by linkInModules() from a run of its inputs, and the
+/// context it lives in.
+struct LinkedRun {
+  std::unique_ptr<LLVMContext> Context;
+  std::unique_ptr<Module> M;
+  Linker::IdentifiedStructTypeSet IdentifiedStructTypes;
+  Linker::MergeableConstantMap MergeableConstants;
+  bool Failed;
+
+  LinkedRun() : Failed(false) {}
+
+  /// Link \p Src into M.  Other runs may be linked in later, so linkonce
+  /// globals that nothing references yet are kept.
+  bool link(Module *Src, DiagnosticHandlerFunction DiagnosticHandler) {
+    ModuleLinker TheLinker(M.get(), IdentifiedStructTypes, MergeableConstants,
+                           Src, DiagnosticHandler,
+                           /*KeepUnreferencedLinkOnce=*/true);
+    return TheLinker.run();
+  }
+
+  void reset() {
+    MergeableConstants.clear();
+    M.reset();
+    Context.reset();
+  }
+};
+}
+
+/// Move \p Src into \p Context by writing it to bitcode and lazily reading it
+/// back.  Returns null on error.
+static std::unique_ptr<Module> moveToContext(Module &Src,
+                                             LLVMContext &Context) {
+  SmallString<0> Bitcode;
+  {
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&Src, OS);
+  }
+  std::unique_ptr<MemoryBuffer> Buffer = MemoryBuffer::getMemBufferCopy(
+      Bitcode.str(), Src.getModuleIdentifier());
+  ErrorOr<Module *> M = getLazyBitcodeModule(std::move(Buffer), Context);
+  if (!M)
+    return nullptr;
+  return std::unique_ptr<Module>(M.get());
+}
+
+/// Link inputs [Begin, End) into \p Result, splitting them in halves until at
+/// most \p RunSize are left and linking the halves concurrently.
+static void linkInputRange(unsigned Begin, unsigned End, unsigned RunSize,
+                           StringRef ModuleID,
+                           const Linker::ModuleLoaderTy &Load,
+                           DiagnosticHandlerFunction DiagnosticHandler,
+                           LinkedRun &Result) {
+  if (End - Begin > RunSize) {
+    unsigned Mid = Begin + (End - Begin) / 2;
+    LinkedRun Right;
+    {
+      TaskGroup Tasks;
+      Tasks.spawn([&] {
+        linkInputRange(Mid, End, RunSize, ModuleID, Load, DiagnosticHandler,
+                       Right);
+      });
+      linkInputRange(Begin, Mid, RunSize, ModuleID, Load, DiagnosticHandler,
+                     Result);
+    }
+
+    // Merge the right half into the left one.
+    if (Right.Failed)
+      Result.Failed = true;
+    if (Result.Failed)
+      return;
+    std::unique_ptr<Module> M = moveToContext(*Right.M, *Result.Context);
+    Right.reset();
+    if (!M || Result.link(M.get(), DiagnosticHandler))
+      Result.Failed = true;
+    return;
+  }
+
+  Result.Context.reset(new LLVMContext());
+  Result.M.reset(new Module(ModuleID, *Result.Context));
+  for (unsigned I = Begin; I != End; ++I) {
+    std::unique_ptr<Module> Src = Load(I, *Result.Context);
+    if (!Src || Result.link(Src.get(), DiagnosticHandler)) {
+      Result.Failed = true;
+      return;
+    }
+  }
+}
+
+bool Linker::linkInModules(unsigned NumInputs, ModuleLoaderTy Load) {
+  unsigned ThreadCount = ThreadPool::getGlobal().getThreadCount();
+  if (ThreadCount <= 1 || NumInputs <= 1) {
+    for (unsigned I = 0; I != NumInputs; ++I) {
+      std::unique_ptr<Module> Src = Load(I, Composite->getContext());
+      if (!Src || linkInModule(Src.get()))
+        return true;
+    }
+    return false;
+  }
+
+  sys::Mutex DiagnosticLock;
+  DiagnosticHandlerFunction SerializedHandler =
+      [&](const DiagnosticInfo &DI) {
+    sys::ScopedLock Guard(DiagnosticLock);
+    DiagnosticHandler(DI);
+  };
+
+  // One run of inputs per thread.
+  unsigned RunSize = (NumInputs + ThreadCount - 1) / ThreadCount;
+  LinkedRun Result;
+  linkInputRange(0, NumInputs, RunSize, Composite->getModuleIdentifier(), Load,
+                 SerializedHandler, Result);
+  if (Result.Failed)
+    return true;
+
+  std::unique_ptr<Module> M = moveToContext(*Result.M,
+                                            Composite->getContext());
+  Result.reset();
+  if (!M)
+    return true;
+  // Whether a linkonce global in M was referenced by the inputs before the
+  // one it came from is no longer known, so keep them all.
+  ModuleLinker TheLinker(Composite, IdentifiedStructTypes, MergeableConstants,
+                         M.get(), DiagnosticHandler,
+                         /*KeepUnreferencedLinkOnce=*/true);
+  return TheLinker.run();
+}
+
 //===----------------------------------------------------------------------===//
 // C API.
 //===----------------------------------------------------------------------===//
@@ -206,37 +206,52 @@ std::error_code IRObjectFile::printSymbolName(raw_ostream &OS,
   return object_error::success;
 }
 
-uint32_t IRObjectFile::getSymbolFlags(DataRefImpl Symb) const {
-  const GlobalValue *GV = getGV(Symb);
-
-  if (!GV) {
-    unsigned Index = getAsmSymIndex(Symb);
-    assert(Index <= AsmSymbols.size());
-    return AsmSymbols[Index].second;
-  }
-
+/// getGlobalValueFlags - Return the symbol flags of a global value with the
+/// given properties.
+static uint32_t getGlobalValueFlags(GlobalValue::LinkageTypes Linkage,
+                                    bool IsDeclarationForLinker,
+                                    bool HasLLVMName, bool IsMetadataVar) {
   uint32_t Res = BasicSymbolRef::SF_None;
-  if (GV->isDeclarationForLinker())
+  if (IsDeclarationForLinker)
     Res |= BasicSymbolRef::SF_Undefined;
-  if (GV->hasPrivateLinkage())
+  if (GlobalValue::isPrivateLinkage(Linkage))
     Res |= BasicSymbolRef::SF_FormatSpecific;
-  if (!GV->hasLocalLinkage())
+  if (!GlobalValue::isLocalLinkage(Linkage))
     Res |= BasicSymbolRef::SF_Global;
-  if (GV->hasCommonLinkage())
+  if (GlobalValue::isCommonLinkage(Linkage))
     Res |= BasicSymbolRef::SF_Common;
-  if (GV->hasLinkOnceLinkage() || GV->hasWeakLinkage())
+  if (GlobalValue::isLinkOnceLinkage(Linkage) ||
+      GlobalValue::isWeakLinkage(Linkage))
     Res |= BasicSymbolRef::SF_Weak;
 
-  if (GV->getName().startswith("llvm."))
+  if (HasLLVMName || IsMetadataVar)
     Res |= BasicSymbolRef::SF_FormatSpecific;
-  else if (auto *Var = dyn_cast<GlobalVariable>(GV)) {
-    if (Var->getSection() == StringRef("llvm.metadata"))
-      Res |= BasicSymbolRef::SF_FormatSpecific;
-  }
 
   return Res;
 }
 
+uint32_t IRObjectFile::getSymbolFlags(DataRefImpl Symb) const {
+  const GlobalValue *GV = getGV(Symb);
+
+  if (!GV) {
+    unsigned Index = getAsmSymIndex(Symb);
+    assert(Index <= AsmSymbols.size());
+    return AsmSymbols[Index].second;
+  }
+
+  auto *Var = dyn_cast<GlobalVariable>(GV);
+  return getGlobalValueFlags(
+      GV->getLinkage(), GV->isDeclarationForLinker(),
+      GV->getName().startswith("llvm."),
+      Var && Var->getSection() == StringRef("llvm.metadata"));
+}
+
+uint32_t IRObjectFile::getBitcodeSymbolFlags(const BitcodeSymbol &Sym) {
+  return getGlobalValueFlags(Sym.Linkage, Sym.IsUndefined, Sym.HasLLVMName,
+                             Sym.Kind == BitcodeSymbol::Variable &&
+                                 Sym.Section == "llvm.metadata");
+}
+
 GlobalValue *IRObjectFile::getSymbolGV(DataRefImpl Symb) { return getGV(Symb); }
 
 std::unique_ptr<Module> IRObjectFile::takeModule() { return std::move(M); }
@@ -301,7 +316,10 @@ llvm::object::IRObjectFile::create(MemoryBufferRef Object,
   std::unique_ptr<MemoryBuffer> Buff(
       MemoryBuffer::getMemBuffer(BCOrErr.get(), false));
 
-  ErrorOr<Module *> MOrErr = getLazyBitcodeModule(std::move(Buff), Context);
+  // The symbol table doesn't depend on metadata, which is read if the module
+  // is linked.
+  ErrorOr<Module *> MOrErr = getLazyBitcodeModule(
+      std::move(Buff), Context, nullptr, /*ShouldLazyLoadMetadata=*/true);
   if (std::error_code EC = MOrErr.getError())
     return EC;
 
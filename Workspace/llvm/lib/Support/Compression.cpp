@@ -16,6 +16,9 @@
 #include "llvm/Config/config.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/ErrorHandling.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
 #if LLVM_ENABLE_ZLIB == 1 && HAVE_ZLIB_H
 #include <zlib.h>
 #endif
@@ -96,3 +99,143 @@ uint32_t zlib::crc32(StringRef Buffer) {
 }
 #endif
 
+// The compressed data is a sequence of matches, each preceded by the literal
+// bytes since the previous one:
+//
+//   token    - the number of literals in the high nibble and the length of
+//              the match minus MinMatch in the low nibble.  A nibble of 15
+//              is followed by bytes that are added to it, up to one that is
+//              less than 255.
+//   literals
+//   offset   - 16 bits, little endian, back from the end of the literals.
+//
+// The last sequence only has literals and ends the data.
+namespace {
+enum {
+  MinMatch = 4,
+  MaxOffset = 0xFFFF,
+  HashBits = 14
+};
+}
+
+static uint32_t readLE32(const unsigned char *P) {
+  return P[0] | (P[1] << 8) | (P[2] << 16) | (uint32_t(P[3]) << 24);
+}
+
+static void writeLength(SmallVectorImpl<char> &Out, size_t Len) {
+  for (; Len >= 255; Len -= 255)
+    Out.push_back(char(255));
+  Out.push_back(char(Len));
+}
+
+static void writeSequence(SmallVectorImpl<char> &Out,
+                          const unsigned char *Literals, size_t NumLiterals,
+                          size_t Offset, size_t MatchLen) {
+  size_t ExtraMatch = MatchLen ? MatchLen - MinMatch : 0;
+  Out.push_back(char((std::min<size_t>(NumLiterals, 15) << 4) |
+                     std::min<size_t>(ExtraMatch, 15)));
+  if (NumLiterals >= 15)
+    writeLength(Out, NumLiterals - 15);
+  Out.append(Literals, Literals + NumLiterals);
+  if (!MatchLen)
+    return;
+  Out.push_back(char(Offset & 0xFF));
+  Out.push_back(char(Offset >> 8));
+  if (ExtraMatch >= 15)
+    writeLength(Out, ExtraMatch - 15);
+}
+
+void lz77::compress(StringRef InputBuffer,
+                    SmallVectorImpl<char> &CompressedBuffer) {
+  const unsigned char *In = InputBuffer.bytes_begin();
+  size_t Size = InputBuffer.size();
+  CompressedBuffer.clear();
+  CompressedBuffer.reserve(Size + Size / 255 + 16);
+
+  // Positions (plus one) of the last occurrence of each hashed four bytes.
+  std::vector<uint32_t> Table(1 << HashBits, 0);
+  size_t Anchor = 0, Pos = 0;
+  while (Pos + MinMatch <= Size) {
+    uint32_t Seq = readLE32(In + Pos);
+    uint32_t &Entry = Table[(Seq * 2654435761U) >> (32 - HashBits)];
+    size_t Candidate = Entry;
+    Entry = uint32_t(Pos + 1);
+    if (!Candidate || Pos - (Candidate - 1) > MaxOffset ||
+        readLE32(In + Candidate - 1) != Seq) {
+      // Step faster through data that doesn't compress.
+      Pos += 1 + ((Pos - Anchor) >> 6);
+      continue;
+    }
+
+    size_t Match = Candidate - 1;
+    size_t Len = MinMatch;
+    while (Pos + Len < Size && In[Match + Len] == In[Pos + Len])
+      ++Len;
+    writeSequence(CompressedBuffer, In + Anchor, Pos - Anchor, Pos - Match,
+                  Len);
+    Pos += Len;
+    Anchor = Pos;
+  }
+  if (Anchor < Size)
+    writeSequence(CompressedBuffer, In + Anchor, Size - Anchor, 0, 0);
+}
+
+/// Read the rest of a length whose nibble was 15.  Returns false if the
+/// input ends first.
+static bool readLength(const unsigned char *&In, const unsigned char *End,
+                       size_t &Len) {
+  unsigned char Byte;
+  do {
+    if (In == End)
+      return false;
+    Byte = *In++;
+    Len += Byte;
+  } while (Byte == 255);
+  return true;
+}
+
+bool lz77::uncompress(StringRef InputBuffer,
+                      SmallVectorImpl<char> &UncompressedBuffer,
+                      size_t UncompressedSize) {
+  UncompressedBuffer.resize(UncompressedSize);
+  const unsigned char *In = InputBuffer.bytes_begin();
+  const unsigned char *End = InputBuffer.bytes_end();
+  char *Out = UncompressedBuffer.data();
+  size_t Pos = 0;
+
+  while (In != End) {
+    unsigned Token = *In++;
+    size_t NumLiterals = Token >> 4;
+    if (NumLiterals == 15 && !readLength(In, End, NumLiterals))
+      return false;
+    if (NumLiterals > size_t(End - In) ||
+        NumLiterals > UncompressedSize - Pos)
+      return false;
+    memcpy(Out + Pos, In, NumLiterals);
+    In += NumLiterals;
+    Pos += NumLiterals;
+    if (In == End)
+      break;
+
+    if (End - In < 2)
+      return false;
+    size_t Offset = In[0] | (In[1] << 8);
+    In += 2;
+    size_t Len = Token & 15;
+    if (Len == 15 && !readLength(In, End, Len))
+      return false;
+    Len += MinMatch;
+    if (!Offset || Offset > Pos || Len > UncompressedSize - Pos)
+      return false;
+
+    // The match may overlap the bytes it produces.
+    const char *From = Out + Pos - Offset;
+    if (Offset >= Len)
+      memcpy(Out + Pos, From, Len);
+    else
+      for (size_t I = 0; I != Len; ++I)
+        Out[Pos + I] = From[I];
+    Pos += Len;
+  }
+  return Pos == UncompressedSize;
+}
@@ -15,6 +15,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/Signals.h"
 #include "llvm/Support/raw_ostream.h"
 #include <system_error>
 
@@ -32,7 +33,33 @@ FileOutputBuffer::FileOutputBuffer(std::unique_ptr<mapped_file_region> R,
     : Region(std::move(R)), FinalPath(Path), TempPath(TmpPath) {}
 
 FileOutputBuffer::~FileOutputBuffer() {
+  // Unmap before removing the file; Windows refuses to delete mapped files.
+  Region.reset();
   sys::fs::remove(Twine(TempPath));
+  sys::DontRemoveFileOnSignal(TempPath);
+}
+
+/// Set the size of the file at \p Path to \p Size bytes.  If \p MapResult is
+/// non-null, also map the whole file read/write into it.
+static std::error_code
+resizeAndMap(StringRef Path, uint64_t Size,
+             std::unique_ptr<mapped_file_region> *MapResult) {
+  int FD;
+  std::error_code EC = sys::fs::openFileForWrite(
+      Path, FD, sys::fs::F_RW | sys::fs::F_Append);
+  if (EC)
+    return EC;
+
+  EC = sys::fs::resize_file(FD, Size);
+  if (!EC && MapResult)
+    MapResult->reset(new mapped_file_region(
+        FD, mapped_file_region::readwrite, Size, 0, EC));
+  int Ret = close(FD);
+  if (EC)
+    return EC;
+  if (Ret)
+    return std::error_code(errno, std::generic_category());
+  return std::error_code();
 }
 
 std::error_code
@@ -77,6 +104,9 @@ FileOutputBuffer::create(StringRef FilePath, size_t Size,
   if (EC)
     return EC;
 
+  // Don't leave the temporary file behind if we are killed before commit().
+  sys::RemoveFileOnSignal(TempFilePath);
+
   EC = sys::fs::resize_file(FD, Size);
   if (EC)
     return EC;
@@ -95,10 +125,23 @@ FileOutputBuffer::create(StringRef FilePath, size_t Size,
   return std::error_code();
 }
 
-std::error_code FileOutputBuffer::commit() {
+std::error_code FileOutputBuffer::resize(size_t NewSize) {
+  // Unmap buffer, letting OS flush dirty pages to file on disk, and map the
+  // resized file again.  The pages stay in the page cache, so nothing is
+  // actually read back.
+  Region.reset();
+  return resizeAndMap(TempPath, NewSize, &Region);
+}
+
+std::error_code FileOutputBuffer::commit(int64_t NewSmallerSize) {
   // Unmap buffer, letting OS flush dirty pages to file on disk.
   Region.reset();
 
+  // If requested, resize file as part of commit.
+  if (NewSmallerSize != -1) {
+    if (std::error_code EC = resizeAndMap(TempPath, NewSmallerSize, nullptr))
+      return EC;
+  }
 
   // Rename file to final name.
   return sys::fs::rename(Twine(TempPath), Twine(FinalPath));
@@ -945,6 +945,8 @@ file_magic identify_magic(StringRef Magic) {
     case 'B':
       if (Magic[1] == 'C' && Magic[2] == (char)0xC0 && Magic[3] == (char)0xDE)
         return file_magic::bitcode;
+      if (Magic[1] == 'C' && Magic[2] == 'Z' && Magic[3] == '1')
+        return file_magic::bitcode; // Compressed bitcode.
       break;
     case '!':
       if (Magic.size() >= 8)
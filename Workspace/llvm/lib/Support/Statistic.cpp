@@ -44,6 +44,10 @@ Enabled(
     "stats",
     cl::desc("Enable statistics output from program (available with Asserts)"));
 
+/// -stats-json - Print the statistics as a JSON object instead of a table.
+static cl::opt<bool>
+StatsAsJSON("stats-json", cl::desc("Display statistics as json data"));
+
 
 namespace {
 /// StatisticInfo - This class is used in a ManagedStatic so that it is created
@@ -53,18 +57,45 @@ class StatisticInfo {
   std::vector<const Statistic*> Stats;
   friend void llvm::PrintStatistics();
   friend void llvm::PrintStatistics(raw_ostream &OS);
+  friend void llvm::PrintStatisticsJSON(raw_ostream &OS);
+  friend std::vector<StatisticSnapshot> llvm::GetStatistics();
 public:
   ~StatisticInfo();
 
   void addStatistic(const Statistic *S) {
     Stats.push_back(S);
   }
+
+  void sort();
 };
 }
 
 static ManagedStatic<StatisticInfo> StatInfo;
 static ManagedStatic<sys::SmartMutex<true> > StatLock;
 
+// Each thread adds to the counters of one of NumShards shards.  A shard holds
+// one counter per statistic, in chunks that are allocated as statistics get
+// registered and are never freed, because statistics can be bumped until the
+// very end of the process.  Statistics registered once every chunk is in use
+// fall back to their own Value field.
+static const unsigned NumShards = 16;
+static const unsigned ShardChunkSize = 1024;
+static const unsigned MaxShardChunks = 64;
+static const unsigned NoShard = ~0U;
+
+static volatile sys::cas_flag *ShardChunks[NumShards][MaxShardChunks];
+static unsigned NumShardedStatistics;
+static volatile sys::cas_flag NextThreadShard;
+// The shard of the current thread plus one, or zero if it has none yet.
+static LLVM_THREAD_LOCAL unsigned ThreadShard;
+
+static unsigned getThreadShard() {
+  unsigned Shard = ThreadShard;
+  if (!Shard)
+    ThreadShard = Shard = sys::AtomicIncrement(&NextThreadShard) % NumShards + 1;
+  return Shard - 1;
+}
+
 /// RegisterStatistic - The first time a statistic is bumped, this method is
 /// called.
 void Statistic::RegisterStatistic() {
@@ -72,6 +103,16 @@ void Statistic::RegisterStatistic() {
   // printed.
   sys::SmartScopedLock<true> Writer(*StatLock);
   if (!Initialized) {
+    if (NumShardedStatistics < MaxShardChunks * ShardChunkSize) {
+      ID = NumShardedStatistics++;
+      unsigned Chunk = ID / ShardChunkSize;
+      if (ID % ShardChunkSize == 0)
+        for (unsigned S = 0; S != NumShards; ++S)
+          ShardChunks[S][Chunk] = new sys::cas_flag[ShardChunkSize]();
+    } else {
+      ID = NoShard;
+    }
+
     if (Enabled)
       StatInfo->addStatistic(this);
 
@@ -84,6 +125,31 @@ void Statistic::RegisterStatistic() {
   }
 }
 
+volatile sys::cas_flag *Statistic::getShardCounter() {
+  if (ID == NoShard)
+    return &Value;
+  return &ShardChunks[getThreadShard()][ID / ShardChunkSize]
+                     [ID % ShardChunkSize];
+}
+
+unsigned Statistic::getValue() const {
+  bool tmp = Initialized;
+  sys::MemoryFence();
+  unsigned Sum = Value;
+  if (!tmp || ID == NoShard)
+    return Sum;
+  for (unsigned S = 0; S != NumShards; ++S)
+    Sum += ShardChunks[S][ID / ShardChunkSize][ID % ShardChunkSize];
+  return Sum;
+}
+
+void Statistic::setValue(unsigned Val) {
+  if (ID != NoShard)
+    for (unsigned S = 0; S != NumShards; ++S)
+      ShardChunks[S][ID / ShardChunkSize][ID % ShardChunkSize] = 0;
+  Value = Val;
+}
+
 // Print information when destroyed, iff command line option is specified.
 StatisticInfo::~StatisticInfo() {
   llvm::PrintStatistics();
@@ -97,7 +163,21 @@ bool llvm::AreStatisticsEnabled() {
   return Enabled;
 }
 
+void StatisticInfo::sort() {
+  std::stable_sort(Stats.begin(), Stats.end(),
+                   [](const Statistic *LHS, const Statistic *RHS) {
+    if (int Cmp = std::strcmp(LHS->getName(), RHS->getName()))
+      return Cmp < 0;
+
+    // Secondary key is the description.
+    return std::strcmp(LHS->getDesc(), RHS->getDesc()) < 0;
+  });
+}
+
 void llvm::PrintStatistics(raw_ostream &OS) {
+  if (StatsAsJSON)
+    return PrintStatisticsJSON(OS);
+
   StatisticInfo &Stats = *StatInfo;
 
   // Figure out how long the biggest Value and Name fields are.
@@ -110,14 +190,7 @@ void llvm::PrintStatistics(raw_ostream &OS) {
   }
 
   // Sort the fields by name.
-  std::stable_sort(Stats.Stats.begin(), Stats.Stats.end(),
-                   [](const Statistic *LHS, const Statistic *RHS) {
-    if (int Cmp = std::strcmp(LHS->getName(), RHS->getName()))
-      return Cmp < 0;
-
-    // Secondary key is the description.
-    return std::strcmp(LHS->getDesc(), RHS->getDesc()) < 0;
-  });
+  Stats.sort();
 
   // Print out the statistics header...
   OS << "===" << std::string(73, '-') << "===\n"
@@ -136,6 +209,34 @@ void llvm::PrintStatistics(raw_ostream &OS) {
 
 }
 
+void llvm::PrintStatisticsJSON(raw_ostream &OS) {
+  StatisticInfo &Stats = *StatInfo;
+  Stats.sort();
+
+  // Debug types and variable names never need escaping.
+  OS << "{\n";
+  const char *Delim = "";
+  for (const Statistic *Stat : Stats.Stats) {
+    OS << Delim << "\t\"" << Stat->getName() << '.' << Stat->getVarName()
+       << "\": " << Stat->getValue();
+    Delim = ",\n";
+  }
+  OS << "\n}\n";
+  OS.flush();
+}
+
+std::vector<StatisticSnapshot> llvm::GetStatistics() {
+  sys::SmartScopedLock<true> Reader(*StatLock);
+  std::vector<StatisticSnapshot> Snapshot;
+  Snapshot.reserve(StatInfo->Stats.size());
+  for (const Statistic *Stat : StatInfo->Stats) {
+    StatisticSnapshot Entry = { Stat->getName(), Stat->getVarName(),
+                                Stat->getDesc(), Stat->getValue() };
+    Snapshot.push_back(Entry);
+  }
+  return Snapshot;
+}
+
 void llvm::PrintStatistics() {
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
   StatisticInfo &Stats = *StatInfo;
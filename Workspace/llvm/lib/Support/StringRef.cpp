@@ -135,6 +135,20 @@ std::string StringRef::upper() const {
 //===----------------------------------------------------------------------===//
 
 
+/// findNaive - Search for \p Str by looking for its first character with
+/// memchr and comparing the rest at each hit.  Str must not be empty.
+size_t StringRef::findNaive(StringRef Str, size_t From) const {
+  size_t N = Str.size();
+  if (N > Length)
+    return npos;
+  size_t Last = Length - N;
+  for (size_t i = find(Str[0], From); i != npos && i <= Last;
+       i = find(Str[0], i + 1))
+    if (compareMemory(Data + i + 1, Str.data() + 1, N - 1) == 0)
+      return i;
+  return npos;
+}
+
 /// find - Search for the first string \arg Str in the string.
 ///
 /// \return - The index of the first occurrence of \arg Str, or npos if not
@@ -144,13 +158,15 @@ size_t StringRef::find(StringRef Str, size_t From) const {
   if (N > Length)
     return npos;
 
-  // For short haystacks or unsupported needles fall back to the naive algorithm
-  if (Length < 16 || N > 255 || N == 0) {
-    for (size_t e = Length - N + 1, i = std::min(From, e); i != e; ++i)
-      if (substr(i, N).equals(Str))
-        return i;
-    return npos;
-  }
+  if (N == 0)
+    return From <= Length ? From : npos;
+  if (N == 1)
+    return find(Str[0], From);
+
+  // For short haystacks or unsupported needles fall back to the naive
+  // algorithm, using memchr to skip to candidate positions.
+  if (Length < 16 || N > 255)
+    return findNaive(Str, From);
 
   if (From >= Length)
     return npos;
@@ -305,9 +321,11 @@ size_t StringRef::count(StringRef Str) const {
   size_t N = Str.size();
   if (N > Length)
     return 0;
-  for (size_t i = 0, e = Length - N + 1; i != e; ++i)
-    if (substr(i, N).equals(Str))
-      ++Count;
+  if (N == 0)
+    return Length + 1;
+  // Occurrences may overlap, so restart the search one past each match.
+  for (size_t i = findNaive(Str, 0); i != npos; i = findNaive(Str, i + 1))
+    ++Count;
   return Count;
 }
 
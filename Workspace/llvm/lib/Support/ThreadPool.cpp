@@ -0,0 +1,357 @@
+//===-- ThreadPool.cpp - A work-stealing thread pool ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ThreadPool class and the client side of the GNU
+// make jobserver protocol.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include <cassert>
+#include <cstdlib>
+#include <deque>
+
+#if LLVM_ENABLE_THREADS && defined(LLVM_ON_UNIX)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+static cl::opt<unsigned>
+NumThreads("threads", cl::init(0),
+           cl::desc("Number of threads to use for parallel work "
+                    "(default: one per hardware thread)"));
+
+static ManagedStatic<ThreadPool> GlobalPool;
+
+ThreadPool &ThreadPool::getGlobal() {
+  return *GlobalPool;
+}
+
+#if LLVM_ENABLE_THREADS
+
+unsigned ThreadPool::getDefaultThreadCount() {
+  if (NumThreads)
+    return NumThreads;
+  // hardware_concurrency() returns 0 if it cannot tell.
+  unsigned HardwareThreads = std::thread::hardware_concurrency();
+  return HardwareThreads ? HardwareThreads : 1;
+}
+
+//===----------------------------------------------------------------------===//
+//                            Jobserver client
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Jobserver - The client side of the GNU make jobserver protocol.  make
+/// passes a pipe (or, from make 4.4 on, a named FIFO) in MAKEFLAGS that holds
+/// one byte per job slot beyond the one every job implicitly owns.  A job
+/// that wants to run more work in parallel reads a byte before doing so and
+/// writes the same byte back when done.
+///
+/// Tokens are only ever taken with non-blocking reads, so a worker that
+/// cannot get one can go back to sleep rather than getting stuck in read().
+class Jobserver {
+  int ReadFD;
+  int WriteFD;
+
+  Jobserver(int ReadFD, int WriteFD) : ReadFD(ReadFD), WriteFD(WriteFD) {}
+
+public:
+  /// Return the jobserver of the make that started this process, or null if
+  /// there is none or it cannot be used.
+  static Jobserver *get();
+
+  /// Try to take a token without blocking.  On success, return true and put
+  /// the token in \p Token.
+  bool tryAcquire(char &Token);
+
+  /// Give back a token obtained from tryAcquire().
+  void release(char Token);
+};
+} // end anonymous namespace
+
+#ifdef LLVM_ON_UNIX
+/// Parse the jobserver argument out of MAKEFLAGS and open it for
+/// non-blocking reads.  Return false if there is no usable jobserver.
+static bool openJobserver(int &ReadFD, int &WriteFD) {
+  const char *MakeFlags = std::getenv("MAKEFLAGS");
+  if (!MakeFlags)
+    return false;
+
+  // make 4.2 renamed --jobserver-fds to --jobserver-auth; the last occurrence
+  // is the one that applies to us.
+  StringRef Auth;
+  SmallVector<StringRef, 8> Args;
+  StringRef(MakeFlags).split(Args, " ", -1, false);
+  for (StringRef Arg : Args)
+    if (Arg.startswith("--jobserver-auth=") ||
+        Arg.startswith("--jobserver-fds="))
+      Auth = Arg.split('=').second;
+  if (Auth.empty())
+    return false;
+
+  if (Auth.startswith("fifo:")) {
+    std::string Path = Auth.substr(5);
+    ReadFD = ::open(Path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (ReadFD < 0)
+      return false;
+    WriteFD = ::open(Path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (WriteFD < 0) {
+      ::close(ReadFD);
+      return false;
+    }
+    return true;
+  }
+
+  std::pair<StringRef, StringRef> FDs = Auth.split(',');
+  int InheritedRead, InheritedWrite;
+  if (FDs.first.getAsInteger(10, InheritedRead) ||
+      FDs.second.getAsInteger(10, InheritedWrite))
+    return false;
+  // make closes the pipe for commands it doesn't consider recursive, and the
+  // numbers may since have been reused for something else.
+  if (::fcntl(InheritedRead, F_GETFD) == -1 ||
+      ::fcntl(InheritedWrite, F_GETFD) == -1)
+    return false;
+  // Reopening the read end through /proc gives us a file description of our
+  // own, so that we can make it non-blocking without affecting make and the
+  // other jobs sharing the pipe.
+  std::string Path = "/proc/self/fd/" + FDs.first.str();
+  ReadFD = ::open(Path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (ReadFD < 0)
+    return false;
+  WriteFD = InheritedWrite;
+  return true;
+}
+
+Jobserver *Jobserver::get() {
+  // Deliberately leaked: worker threads of pools that outlive llvm_shutdown()
+  // may still return their tokens.
+  static Jobserver *const Instance = []() -> Jobserver * {
+    int ReadFD, WriteFD;
+    if (!openJobserver(ReadFD, WriteFD))
+      return nullptr;
+    return new Jobserver(ReadFD, WriteFD);
+  }();
+  return Instance;
+}
+
+bool Jobserver::tryAcquire(char &Token) {
+  ssize_t Read;
+  do
+    Read = ::read(ReadFD, &Token, 1);
+  while (Read == -1 && errno == EINTR);
+  return Read == 1;
+}
+
+void Jobserver::release(char Token) {
+  while (::write(WriteFD, &Token, 1) == -1 && errno == EINTR)
+    ;
+}
+#else
+Jobserver *Jobserver::get() { return nullptr; }
+bool Jobserver::tryAcquire(char &) { return false; }
+void Jobserver::release(char) {}
+#endif
+
+//===----------------------------------------------------------------------===//
+//                              ThreadPool
+//===----------------------------------------------------------------------===//
+
+/// The pool and queue index of the worker running on this thread, if any.
+static LLVM_THREAD_LOCAL ThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentWorker = 0;
+
+struct ThreadPool::WorkQueue {
+  std::mutex Lock;
+  std::deque<TaskTy> Tasks;
+};
+
+ThreadPool::ThreadPool(unsigned ThreadCount)
+    : ThreadCount(ThreadCount ? ThreadCount : getDefaultThreadCount()),
+      QueuedTasks(0), ActiveTasks(0), NextQueue(0), Stopping(false) {
+  for (unsigned I = 0; I != this->ThreadCount; ++I)
+    Queues.emplace_back(new WorkQueue());
+  for (unsigned I = 0; I != this->ThreadCount; ++I)
+    Threads.emplace_back([this, I] { work(I); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> L(Lock);
+    Stopping = true;
+  }
+  WorkAvailable.notify_all();
+  for (std::thread &T : Threads)
+    T.join();
+}
+
+void ThreadPool::async(TaskTy Task) {
+  unsigned Q;
+  {
+    std::lock_guard<std::mutex> L(Lock);
+    // Count the task before it becomes visible so that the counters never
+    // drop below the number of tasks that can be taken.
+    ++QueuedTasks;
+    ++ActiveTasks;
+    // Tasks spawned by a worker stay with it; others are spread round-robin.
+    if (CurrentPool == this) {
+      Q = CurrentWorker;
+    } else {
+      Q = NextQueue;
+      NextQueue = (NextQueue + 1) % ThreadCount;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> L(Queues[Q]->Lock);
+    Queues[Q]->Tasks.push_back(std::move(Task));
+  }
+  WorkAvailable.notify_one();
+  Progress.notify_all();
+}
+
+bool ThreadPool::popTask(unsigned Home, TaskTy &Task) {
+  bool Found = false;
+  {
+    // Newest first from our own queue, to keep its data in cache...
+    WorkQueue &Own = *Queues[Home];
+    std::lock_guard<std::mutex> L(Own.Lock);
+    if (!Own.Tasks.empty()) {
+      Task = std::move(Own.Tasks.back());
+      Own.Tasks.pop_back();
+      Found = true;
+    }
+  }
+  // ...and oldest first from the others, since those tend to be the largest
+  // pieces of work left.
+  for (unsigned I = 1; !Found && I != ThreadCount; ++I) {
+    WorkQueue &Victim = *Queues[(Home + I) % ThreadCount];
+    std::lock_guard<std::mutex> L(Victim.Lock);
+    if (!Victim.Tasks.empty()) {
+      Task = std::move(Victim.Tasks.front());
+      Victim.Tasks.pop_front();
+      Found = true;
+    }
+  }
+  if (!Found)
+    return false;
+
+  std::lock_guard<std::mutex> L(Lock);
+  --QueuedTasks;
+  return true;
+}
+
+void ThreadPool::runTask(TaskTy &Task) {
+  Task();
+  // Destroy whatever the task captured before anyone is told it finished.
+  Task = nullptr;
+  {
+    std::lock_guard<std::mutex> L(Lock);
+    --ActiveTasks;
+  }
+  Progress.notify_all();
+}
+
+void ThreadPool::work(unsigned Index) {
+  CurrentPool = this;
+  CurrentWorker = Index;
+
+  // With a jobserver, every worker needs a token to run tasks.  The token
+  // this process implicitly owns is left to the thread that created it,
+  // which runs tasks while it waits for them.
+  Jobserver *JS = Jobserver::get();
+  bool HasToken = false;
+  char Token = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> L(Lock);
+      if (HasToken && !QueuedTasks) {
+        // Out of work: let other jobs of the build use the slot.
+        L.unlock();
+        JS->release(Token);
+        HasToken = false;
+        continue;
+      }
+      WorkAvailable.wait(L, [this] { return QueuedTasks || Stopping; });
+      if (!QueuedTasks)
+        return;
+    }
+
+    if (JS && !HasToken) {
+      if (!JS->tryAcquire(Token)) {
+        // The jobserver pipe can't be waited on together with our condition
+        // variable, so poll it.
+        std::unique_lock<std::mutex> L(Lock);
+        WorkAvailable.wait_for(L, std::chrono::milliseconds(10));
+        continue;
+      }
+      HasToken = true;
+    }
+
+    TaskTy Task;
+    if (popTask(Index, Task))
+      runTask(Task);
+  }
+}
+
+bool ThreadPool::runPendingTask() {
+  TaskTy Task;
+  if (!popTask(CurrentPool == this ? CurrentWorker : 0, Task))
+    return false;
+  runTask(Task);
+  return true;
+}
+
+void ThreadPool::waitUntil(const std::function<bool()> &Done) {
+  for (;;) {
+    if (runPendingTask())
+      continue;
+    std::unique_lock<std::mutex> L(Lock);
+    if (Done())
+      return;
+    Progress.wait(L, [&] { return QueuedTasks || Done(); });
+    if (Done())
+      return;
+  }
+}
+
+void ThreadPool::wait() {
+  assert(CurrentPool != this &&
+         "A task can't wait for the whole pool; use a TaskGroup");
+  // Done is evaluated with Lock held.
+  waitUntil([this] { return ActiveTasks == 0; });
+}
+
+#else // !LLVM_ENABLE_THREADS
+
+unsigned ThreadPool::getDefaultThreadCount() { return 1; }
+
+ThreadPool::ThreadPool(unsigned ThreadCount) : ThreadCount(1) {}
+
+ThreadPool::~ThreadPool() {}
+
+void ThreadPool::async(TaskTy Task) { Task(); }
+
+void ThreadPool::wait() {}
+
+void ThreadPool::waitUntil(const std::function<bool()> &Done) {
+  assert(Done() && "Tasks run synchronously without threads");
+}
+
+bool ThreadPool::runPendingTask() { return false; }
+
+#endif
@@ -12,10 +12,31 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Signals.h"
 using namespace llvm;
 
+static cl::opt<bool>
+MapOutputFiles("map-output-files", cl::Hidden, cl::init(true),
+  cl::desc("Write tool output files through a memory mapping when possible"));
+
+/// Return true if output to \p Filename, opened with \p Flags, can go
+/// through a raw_mmap_ostream.
+static bool canMapOutput(StringRef Filename, sys::fs::OpenFlags Flags) {
+  if (!MapOutputFiles || Filename == "-")
+    return false;
+  // Text mode translation and appending are up to raw_fd_ostream.
+  if (Flags & (sys::fs::F_Text | sys::fs::F_Append | sys::fs::F_Excl))
+    return false;
+  // Devices, pipes and the like cannot be mapped.
+  sys::fs::file_status Stat;
+  sys::fs::status(Filename, Stat);
+  return Stat.type() == sys::fs::file_type::file_not_found ||
+         Stat.type() == sys::fs::file_type::regular_file;
+}
+
 tool_output_file::CleanupInstaller::CleanupInstaller(StringRef Filename)
     : Filename(Filename), Keep(false) {
   // Arrange for the file to be deleted if the process is killed.
@@ -36,11 +57,32 @@ tool_output_file::CleanupInstaller::~CleanupInstaller() {
 
 tool_output_file::tool_output_file(StringRef Filename, std::error_code &EC,
                                    sys::fs::OpenFlags Flags)
-    : Installer(Filename), OS(Filename, EC, Flags) {
+    : Installer(Filename), OS(new raw_fd_ostream(Filename, EC, Flags)) {
   // If open fails, no cleanup is needed.
   if (EC)
     Installer.Keep = true;
 }
 
+tool_output_file::tool_output_file(StringRef Filename, std::error_code &EC,
+                                   sys::fs::OpenFlags Flags, bool AllowMapping)
+    : Installer(Filename) {
+  if (AllowMapping && canMapOutput(Filename, Flags))
+    MappedOS.reset(new raw_mmap_ostream(Filename, EC));
+  else
+    OS.reset(new raw_fd_ostream(Filename, EC, Flags));
+  // If open fails, no cleanup is needed.
+  if (EC) {
+    Installer.Keep = true;
+    MappedOS.reset();
+  }
+}
+
 tool_output_file::tool_output_file(StringRef Filename, int FD)
-    : Installer(Filename), OS(FD, true) {}
+    : Installer(Filename), OS(new raw_fd_ostream(FD, true)) {}
+
+tool_output_file::~tool_output_file() {
+  // Mapped output only shows up at its destination once committed.  Like
+  // raw_fd_ostream, treat a failure to produce a kept file as fatal.
+  if (MappedOS && Installer.Keep && MappedOS->commit())
+    report_fatal_error("IO failure on output stream.", /*GenCrashDiag=*/false);
+}
@@ -0,0 +1,103 @@
+//===--- raw_mmap_ostream.cpp - raw_ostream writing to a mapped file ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This implements the raw_mmap_ostream class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/raw_mmap_ostream.h"
+#include "llvm/Support/FileOutputBuffer.h"
+#include <algorithm>
+#include <cstring>
+using namespace llvm;
+
+/// The initial size of the mapping when the client doesn't give a hint.
+static const size_t DefaultInitialSize = 64 * 1024;
+
+raw_mmap_ostream::raw_mmap_ostream(StringRef Filename, std::error_code &EC,
+                                   unsigned Flags, size_t SizeHint)
+    : Pos(0), Committed(false) {
+  if (!SizeHint)
+    SizeHint = DefaultInitialSize;
+  EC = FileOutputBuffer::create(Filename, SizeHint, Buffer, Flags);
+  if (EC) {
+    Error = EC;
+    SetUnbuffered();
+    return;
+  }
+  resetBuffer();
+}
+
+raw_mmap_ostream::~raw_mmap_ostream() {
+  // Anything still buffered is dropped together with the uncommitted file,
+  // but ~raw_ostream insists on an empty buffer.
+  flush();
+}
+
+void raw_mmap_ostream::resetBuffer() {
+  char *Start = reinterpret_cast<char *>(Buffer->getBufferStart());
+  SetBuffer(Start + Pos, Buffer->getBufferSize() - Pos);
+}
+
+bool raw_mmap_ostream::reserve(uint64_t MinSize) {
+  uint64_t Size = Buffer->getBufferSize();
+  if (MinSize <= Size)
+    return true;
+
+  Error = Buffer->resize(std::max(Size * 2, MinSize));
+  if (!Error)
+    return true;
+
+  // The mapping is gone; drop everything from now on.
+  SetUnbuffered();
+  return false;
+}
+
+void raw_mmap_ostream::write_impl(const char *Ptr, size_t Size) {
+  assert(!Committed && "Output to a committed raw_mmap_ostream!");
+  if (Error)
+    return;
+
+  if (Ptr == reinterpret_cast<char *>(Buffer->getBufferStart()) + Pos) {
+    // The data was formatted in place; just claim it.
+    assert(Pos + Size <= Buffer->getBufferSize() && "Invalid write_impl call!");
+    Pos += Size;
+  } else {
+    assert(!GetNumBytesInBuffer());
+    if (!reserve(Pos + Size))
+      return;
+    memcpy(Buffer->getBufferStart() + Pos, Ptr, Size);
+    Pos += Size;
+  }
+
+  // raw_ostream requires a non-empty buffer, so grow a full mapping now.
+  if (reserve(Pos + 1))
+    resetBuffer();
+}
+
+void raw_mmap_ostream::pwrite_impl(const char *Ptr, size_t Size,
+                                   uint64_t Offset) {
+  assert(!Committed && "Output to a committed raw_mmap_ostream!");
+  assert(Offset + Size <= Pos && "pwrite past the end of the stream!");
+  if (Error)
+    return;
+  memcpy(Buffer->getBufferStart() + Offset, Ptr, Size);
+}
+
+std::error_code raw_mmap_ostream::commit() {
+  assert(!Committed && "raw_mmap_ostream committed twice!");
+  // Flush the buffered bytes into the mapping and stop buffering; the
+  // mapping goes away below.
+  SetUnbuffered();
+  Committed = true;
+  if (Error)
+    return Error;
+  Error = Buffer->commit(Pos);
+  return Error;
+}
@@ -72,6 +72,10 @@ raw_ostream::~raw_ostream() {
 // An out of line virtual method to provide a home for the class vtable.
 void raw_ostream::handle() {}
 
+void raw_ostream::pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset) {
+  llvm_unreachable("Stream does not support pwrite!");
+}
+
 size_t raw_ostream::preferred_buffer_size() const {
   // BUFSIZ is intended to be a reasonable default.
   return BUFSIZ;
@@ -484,9 +488,23 @@ void format_object_base::home() {
 //  raw_fd_ostream
 //===----------------------------------------------------------------------===//
 
+/// canOverwrite - Return true if output written to \p FD can be overwritten
+/// after seeking back: it must be a regular file not opened for appending.
+static bool canOverwrite(int FD) {
+  sys::fs::file_status Status;
+  if (sys::fs::status(FD, Status) || !sys::fs::is_regular_file(Status))
+    return false;
+#if defined(HAVE_FCNTL_H) && defined(F_GETFL)
+  int Flags = ::fcntl(FD, F_GETFL);
+  if (Flags == -1 || (Flags & O_APPEND))
+    return false;
+#endif
+  return true;
+}
+
 raw_fd_ostream::raw_fd_ostream(StringRef Filename, std::error_code &EC,
                                sys::fs::OpenFlags Flags)
-    : Error(false), UseAtomicWrites(false), pos(0) {
+    : Error(false), UseAtomicWrites(false), pos(0), SupportsSeeking(false) {
   EC = std::error_code();
   // Handle "-" as stdout. Note that when we do this, we consider ourself
   // the owner of stdout. This means that we can do things like close the
@@ -499,6 +517,9 @@ raw_fd_ostream::raw_fd_ostream(StringRef Filename, std::error_code &EC,
       sys::ChangeStdoutToBinary();
     // Close stdout when we're done, to detect any output errors.
     ShouldClose = true;
+    // Only overwrite output written from the start of the file; stdout may
+    // be at any position.
+    SupportsSeeking = ::lseek(FD, 0, SEEK_CUR) == 0 && canOverwrite(FD);
     return;
   }
 
@@ -511,6 +532,7 @@ raw_fd_ostream::raw_fd_ostream(StringRef Filename, std::error_code &EC,
 
   // Ok, we successfully opened the file, so it'll need to be closed.
   ShouldClose = true;
+  SupportsSeeking = !(Flags & sys::fs::F_Append) && canOverwrite(FD);
 }
 
 /// raw_fd_ostream ctor - FD is the file descriptor that this writes to.  If
@@ -532,6 +554,7 @@ raw_fd_ostream::raw_fd_ostream(int fd, bool shouldClose, bool unbuffered)
     pos = 0;
   else
     pos = static_cast<uint64_t>(loc);
+  SupportsSeeking = loc != (off_t)-1 && canOverwrite(FD);
 }
 
 raw_fd_ostream::~raw_fd_ostream() {
@@ -617,6 +640,15 @@ void raw_fd_ostream::close() {
   FD = -1;
 }
 
+void raw_fd_ostream::pwrite_impl(const char *Ptr, size_t Size,
+                                 uint64_t Offset) {
+  assert(Offset + Size <= pos && "pwrite past the end of the file!");
+  uint64_t Pos = tell();
+  seek(Offset);
+  write(Ptr, Size);
+  seek(Pos);
+}
+
 uint64_t raw_fd_ostream::seek(uint64_t off) {
   flush();
   pos = ::lseek(FD, off, SEEK_SET);
@@ -811,6 +843,10 @@ raw_null_ostream::~raw_null_ostream() {
 void raw_null_ostream::write_impl(const char *Ptr, size_t Size) {
 }
 
+void raw_null_ostream::pwrite_impl(const char *Ptr, size_t Size,
+                                   uint64_t Offset) {
+}
+
 uint64_t raw_null_ostream::current_pos() const {
   return 0;
 }
@@ -0,0 +1,48 @@
+; RUN: llvm-as -bitcode-auto-abbrev < %s | llvm-dis | FileCheck %s
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=DEFAULT
+; RUN: llvm-as -bitcode-auto-abbrev < %s | llvm-bcanalyzer -dump \
+; RUN:   | FileCheck %s -check-prefix=AUTO
+
+; The store records have no standard abbreviation, but there are enough of
+; them for one to pay off.
+; DEFAULT: <INST_STORE op0=
+; AUTO: <INST_STORE abbrevid=
+
+; CHECK: define void @fill(i32* %p)
+; CHECK: store i32 1, i32* %p
+; CHECK: store i32 16, i32* %p16
+
+define void @fill(i32* %p) {
+  store i32 1, i32* %p
+  %p2 = getelementptr i32* %p, i32 1
+  store i32 2, i32* %p2
+  %p3 = getelementptr i32* %p, i32 2
+  store i32 3, i32* %p3
+  %p4 = getelementptr i32* %p, i32 3
+  store i32 4, i32* %p4
+  %p5 = getelementptr i32* %p, i32 4
+  store i32 5, i32* %p5
+  %p6 = getelementptr i32* %p, i32 5
+  store i32 6, i32* %p6
+  %p7 = getelementptr i32* %p, i32 6
+  store i32 7, i32* %p7
+  %p8 = getelementptr i32* %p, i32 7
+  store i32 8, i32* %p8
+  %p9 = getelementptr i32* %p, i32 8
+  store i32 9, i32* %p9
+  %p10 = getelementptr i32* %p, i32 9
+  store i32 10, i32* %p10
+  %p11 = getelementptr i32* %p, i32 10
+  store i32 11, i32* %p11
+  %p12 = getelementptr i32* %p, i32 11
+  store i32 12, i32* %p12
+  %p13 = getelementptr i32* %p, i32 12
+  store i32 13, i32* %p13
+  %p14 = getelementptr i32* %p, i32 13
+  store i32 14, i32* %p14
+  %p15 = getelementptr i32* %p, i32 14
+  store i32 15, i32* %p15
+  %p16 = getelementptr i32* %p, i32 15
+  store i32 16, i32* %p16
+  ret void
+}
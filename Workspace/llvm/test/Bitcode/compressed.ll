@@ -0,0 +1,48 @@
+; Compressed bitcode reads back the same, whether it is read from a buffer or
+; streamed, with chunks that are stored as they are or compressed, and however
+; the chunks split up the blocks.
+; RUN: llvm-as -bitcode-compression=lz77 %s -o %t.bc
+; RUN: llvm-dis < %t.bc | FileCheck %s
+; RUN: llvm-dis %t.bc -o - | FileCheck %s
+; RUN: llvm-as -bitcode-compression=lz77 -bitcode-compression-chunk-size=1 \
+; RUN:   < %s | llvm-dis | FileCheck %s
+; RUN: llvm-as -bitcode-compression=zlib < %s | llvm-dis | FileCheck %s
+; RUN: llvm-nm %t.bc | FileCheck %s -check-prefix=NM
+; RUN: llvm-bcanalyzer -dump %t.bc | FileCheck %s -check-prefix=DUMP
+
+; No Darwin wrapper around compressed bitcode.
+; RUN: opt -mtriple=x86_64-apple-macosx10.10 -bitcode-compression=lz77 %s \
+; RUN:   -o - | llvm-dis | FileCheck %s
+
+; CHECK: @table = constant [64 x i32]
+; CHECK: define i32 @lookup(i32 %i)
+; CHECK: define i32 @twice(i32 %i)
+
+; NM: T lookup
+; NM: D table
+; NM: T twice
+
+; DUMP: <MODULE_BLOCK
+; DUMP: <FUNCTION_BLOCK
+
+@table = constant [64 x i32] [
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+  i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7]
+
+define i32 @lookup(i32 %i) {
+  %p = getelementptr [64 x i32]* @table, i32 0, i32 %i
+  %v = load i32* %p
+  ret i32 %v
+}
+
+define i32 @twice(i32 %i) {
+  %a = call i32 @lookup(i32 %i)
+  %b = add i32 %a, %a
+  ret i32 %b
+}
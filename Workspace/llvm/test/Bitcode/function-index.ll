@@ -0,0 +1,27 @@
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BC
+; RUN: llvm-as < %s | opt -S | FileCheck %s
+; Modules with function bodies get a function index that lets the reader
+; jump straight to each body instead of skipping over them one by one.
+
+; BC: <MODULE_BLOCK
+; BC: <FNINDEXOFFSET
+; BC: <FUNCTION_INDEX_BLOCK
+; BC-NEXT: <ENTRY {{.*}}op0=1
+; BC-NEXT: <ENTRY {{.*}}op0=2
+; BC-NEXT: </FUNCTION_INDEX_BLOCK>
+
+declare void @ext()
+
+; CHECK-LABEL: define void @f()
+; CHECK-NEXT: call void @ext()
+define void @f() {
+  call void @ext()
+  ret void
+}
+
+; CHECK-LABEL: define i32 @g(i32 %x)
+; CHECK-NEXT: %y = add i32 %x, 1
+define i32 @g(i32 %x) {
+  %y = add i32 %x, 1
+  ret i32 %y
+}
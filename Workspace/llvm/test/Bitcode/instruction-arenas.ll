@@ -0,0 +1,21 @@
+; RUN: llvm-as < %s | opt -instruction-arenas -instcombine -globaldce -S | FileCheck %s
+; Instructions read from bitcode are allocated in per-function arenas; make
+; sure they can be rewritten, deleted and dropped together with their function.
+
+; CHECK-NOT: @dead
+define internal i32 @dead(i32 %x) {
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 2
+  ret i32 %b
+}
+
+; CHECK-LABEL: define i32 @live(
+; CHECK-NEXT: %a = zext i1 %c to i32
+; CHECK-NEXT: %sel = shl i32 %x, %a
+; CHECK-NEXT: ret i32 %sel
+define i32 @live(i32 %x, i1 %c) {
+  %a = mul i32 %x, 2
+  %unused = add i32 %a, 7
+  %sel = select i1 %c, i32 %a, i32 %x
+  ret i32 %sel
+}
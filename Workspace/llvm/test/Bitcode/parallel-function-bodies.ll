@@ -0,0 +1,36 @@
+; RUN: llvm-as < %s | opt -parallel-bitcode-bodies -threads=4 -S | FileCheck %s
+; Function bodies decoded on the thread pool must read back exactly like
+; serially parsed ones, including forward references between bodies.
+
+@g = global i32 0
+
+; CHECK-LABEL: define i8* @takes_address()
+; CHECK-NEXT: ret i8* blockaddress(@target, %bb)
+define i8* @takes_address() {
+  ret i8* blockaddress(@target, %bb)
+}
+
+; CHECK-LABEL: define i32 @constants(i32 %x)
+; CHECK-NEXT: %a = add i32 %x, 12345
+; CHECK-NEXT: %v = load i32* @g, !range !0
+; CHECK-NEXT: %s = add i32 %v, ptrtoint (i32* @g to i32)
+define i32 @constants(i32 %x) {
+  %a = add i32 %x, 12345
+  %v = load i32* @g, !range !0
+  %s = add i32 %v, ptrtoint (i32* @g to i32)
+  ret i32 %s
+}
+
+; CHECK-LABEL: define void @target()
+; CHECK: bb:
+; CHECK-NEXT: call void @target()
+define void @target() {
+entry:
+  br label %bb
+bb:
+  call void @target()
+  ret void
+}
+
+; CHECK: !0 = !{i32 0, i32 10}
+!0 = !{i32 0, i32 10}
@@ -0,0 +1,83 @@
+; Writing the bitcode to the output file in pieces gives the same bytes as
+; writing it all at once, also with the Darwin wrapper header, which is filled
+; in last. Pipes can't be patched, so the whole bitcode is kept in memory.
+; RUN: llvm-as -bitcode-flush-threshold=0 %s -o %t.buffered.bc
+; RUN: llvm-as -bitcode-flush-threshold=1 %s -o %t.streamed.bc
+; RUN: cmp %t.buffered.bc %t.streamed.bc
+; RUN: llvm-as -bitcode-flush-threshold=1 < %s | cat > %t.piped.bc
+; RUN: cmp %t.buffered.bc %t.piped.bc
+; RUN: llvm-dis < %t.streamed.bc | FileCheck %s
+
+; RUN: opt -mtriple=x86_64-apple-macosx10.10 -bitcode-flush-threshold=0 %s \
+; RUN:   -o %t.darwin.buffered.bc
+; RUN: opt -mtriple=x86_64-apple-macosx10.10 -bitcode-flush-threshold=1 %s \
+; RUN:   -o %t.darwin.streamed.bc
+; RUN: cmp %t.darwin.buffered.bc %t.darwin.streamed.bc
+; RUN: llvm-dis < %t.darwin.streamed.bc | FileCheck %s
+
+; CHECK: @table = constant [192 x i64]
+; CHECK: define i64 @lookup(i64 %i)
+; CHECK: define i64 @sum(i64 %a, i64 %b)
+
+@table = constant [192 x i64] [
+  i64 1099511627776, i64 1099511635695, i64 1099511659452, i64 1099511699047,
+  i64 1099511754480, i64 1099511825751, i64 1099511912860, i64 1099512015807,
+  i64 1099512134592, i64 1099512269215, i64 1099512419676, i64 1099512585975,
+  i64 1099512768112, i64 1099512966087, i64 1099513179900, i64 1099513409551,
+  i64 1099513655040, i64 1099513916367, i64 1099514193532, i64 1099514486535,
+  i64 1099514795376, i64 1099515120055, i64 1099515460572, i64 1099515816927,
+  i64 1099516189120, i64 1099516577151, i64 1099516981020, i64 1099517400727,
+  i64 1099517836272, i64 1099518287655, i64 1099518754876, i64 1099519237935,
+  i64 1099519736832, i64 1099520251567, i64 1099520782140, i64 1099521328551,
+  i64 1099521890800, i64 1099522468887, i64 1099523062812, i64 1099523672575,
+  i64 1099524298176, i64 1099524939615, i64 1099525596892, i64 1099526270007,
+  i64 1099526958960, i64 1099527663751, i64 1099528384380, i64 1099529120847,
+  i64 1099529873152, i64 1099530641295, i64 1099531425276, i64 1099532225095,
+  i64 1099533040752, i64 1099533872247, i64 1099534719580, i64 1099535582751,
+  i64 1099536461760, i64 1099537356607, i64 1099538267292, i64 1099539193815,
+  i64 1099540136176, i64 1099541094375, i64 1099542068412, i64 1099543058287,
+  i64 1099544064000, i64 1099545085551, i64 1099546122940, i64 1099547176167,
+  i64 1099548245232, i64 1099549330135, i64 1099550430876, i64 1099551547455,
+  i64 1099552679872, i64 1099553828127, i64 1099554992220, i64 1099556172151,
+  i64 1099557367920, i64 1099558579527, i64 1099559806972, i64 1099561050255,
+  i64 1099562309376, i64 1099563584335, i64 1099564875132, i64 1099566181767,
+  i64 1099567504240, i64 1099568842551, i64 1099570196700, i64 1099571566687,
+  i64 1099572952512, i64 1099574354175, i64 1099575771676, i64 1099577205015,
+  i64 1099578654192, i64 1099580119207, i64 1099581600060, i64 1099583096751,
+  i64 1099584609280, i64 1099586137647, i64 1099587681852, i64 1099589241895,
+  i64 1099590817776, i64 1099592409495, i64 1099594017052, i64 1099595640447,
+  i64 1099597279680, i64 1099598934751, i64 1099600605660, i64 1099602292407,
+  i64 1099603994992, i64 1099605713415, i64 1099607447676, i64 1099609197775,
+  i64 1099610963712, i64 1099612745487, i64 1099614543100, i64 1099616356551,
+  i64 1099618185840, i64 1099620030967, i64 1099621891932, i64 1099623768735,
+  i64 1099625661376, i64 1099627569855, i64 1099629494172, i64 1099631434327,
+  i64 1099633390320, i64 1099635362151, i64 1099637349820, i64 1099639353327,
+  i64 1099641372672, i64 1099643407855, i64 1099645458876, i64 1099647525735,
+  i64 1099649608432, i64 1099651706967, i64 1099653821340, i64 1099655951551,
+  i64 1099658097600, i64 1099660259487, i64 1099662437212, i64 1099664630775,
+  i64 1099666840176, i64 1099669065415, i64 1099671306492, i64 1099673563407,
+  i64 1099675836160, i64 1099678124751, i64 1099680429180, i64 1099682749447,
+  i64 1099685085552, i64 1099687437495, i64 1099689805276, i64 1099692188895,
+  i64 1099694588352, i64 1099697003647, i64 1099699434780, i64 1099701881751,
+  i64 1099704344560, i64 1099706823207, i64 1099709317692, i64 1099711828015,
+  i64 1099714354176, i64 1099716896175, i64 1099719454012, i64 1099722027687,
+  i64 1099724617200, i64 1099727222551, i64 1099729843740, i64 1099732480767,
+  i64 1099735133632, i64 1099737802335, i64 1099740486876, i64 1099743187255,
+  i64 1099745903472, i64 1099748635527, i64 1099751383420, i64 1099754147151,
+  i64 1099756926720, i64 1099759722127, i64 1099762533372, i64 1099765360455,
+  i64 1099768203376, i64 1099771062135, i64 1099773936732, i64 1099776827167,
+  i64 1099779733440, i64 1099782655551, i64 1099785593500, i64 1099788547287,
+  i64 1099791516912, i64 1099794502375, i64 1099797503676, i64 1099800520815]
+
+define i64 @lookup(i64 %i) {
+  %p = getelementptr [192 x i64]* @table, i64 0, i64 %i
+  %v = load i64* %p
+  ret i64 %v
+}
+
+define i64 @sum(i64 %a, i64 %b) {
+  %x = call i64 @lookup(i64 %a)
+  %y = call i64 @lookup(i64 %b)
+  %s = add i64 %x, %y
+  ret i64 %s
+}
@@ -0,0 +1,66 @@
+; The bitcode symbol table lists the symbols of the module the way reading the
+; module does, so llvm-nm prints the same with or without it.
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BC
+; RUN: llvm-as -bitcode-symbol-table=false < %s | llvm-bcanalyzer -dump \
+; RUN:   | FileCheck %s -check-prefix=NOTABLE
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-as -bitcode-symbol-table=false %s -o %t.notable.bc
+; RUN: llvm-nm %t.bc > %t.nm
+; RUN: llvm-nm %t.notable.bc > %t.notable.nm
+; RUN: cmp %t.nm %t.notable.nm
+; RUN: FileCheck %s -check-prefix=NM < %t.nm
+
+; Symbols in module-level inline asm need the target to find, so modules with
+; it don't get a symbol table.
+; RUN: echo 'module asm ".globl asm_sym"' | llvm-as | llvm-bcanalyzer -dump \
+; RUN:   | FileCheck %s -check-prefix=NOTABLE
+
+; BC: <SYMTAB_BLOCK
+; BC: <TRIPLE
+; BC: <DATALAYOUT
+; BC: <LINKER_OPTION
+; BC: <ENTRY
+; BC: </SYMTAB_BLOCK>
+; NOTABLE-NOT: SYMTAB_BLOCK
+
+; NM: U ext_fn
+; NM: D ext_var
+; NM: t internal_fn
+; NM: W linkonce_fn
+; NM: C tentative
+; NM: T used_fn
+; NM: U weak_ref
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+$linkonce_fn = comdat any
+
+@ext_var = global i32 1, section "data_sec", align 8
+@const_var = hidden constant i32 2
+@tentative = common global [16 x i32] zeroinitializer, align 16
+@weak_ref = extern_weak global i32
+@llvm.used = appending global [1 x i8*] [i8* bitcast (void ()* @used_fn to i8*)], section "llvm.metadata"
+@fn_alias = alias void ()* @used_fn
+
+declare void @ext_fn()
+
+define internal void @internal_fn() {
+  call void @ext_fn()
+  ret void
+}
+
+define linkonce_odr void @linkonce_fn() unnamed_addr comdat {
+  call void @internal_fn()
+  ret void
+}
+
+define void @used_fn() {
+  call void @linkonce_fn()
+  ret void
+}
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 6, !"Linker Options", !1}
+!1 = !{!2}
+!2 = !{!"-lsomelib"}
@@ -0,0 +1,27 @@
+; RUN: lli -O0 -force-interpreter < %s
+
+; Calls the same external functions repeatedly so that the cached lookups are
+; exercised, and uses the malloc/calloc/free fast paths.
+declare i8* @malloc(i64)
+declare i8* @calloc(i64, i64)
+declare void @free(i8*)
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %a = call i8* @malloc(i64 16)
+  %b = call i8* @calloc(i64 4, i64 4)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %a, i8* %b, i64 16, i32 1, i1 false)
+  call void @free(i8* %a)
+  call void @free(i8* %b)
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, 100
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 0
+}
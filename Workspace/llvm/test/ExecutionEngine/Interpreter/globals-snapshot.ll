@@ -0,0 +1,49 @@
+; RUN: rm -f %t.snap
+; RUN: cp %s %t.ll
+; RUN: lli -force-interpreter -globals-snapshot=%t.snap %t.ll | FileCheck %s --check-prefix=INIT
+; RUN: lli -force-interpreter -globals-snapshot=%t.snap %t.ll | FileCheck %s --check-prefix=RESTORE
+; RUN: sed -e 's/store i32 42/store i32 43/' %s > %t.ll
+; RUN: lli -force-interpreter -globals-snapshot=%t.snap %t.ll | FileCheck %s --check-prefix=CHANGED
+
+; The first run executes the constructor and saves the globals; the second
+; restores them, including the pointers to a global and a function, without
+; running the constructor.  Once the constructor changes, the snapshot is
+; stale and the constructor runs again.
+
+; INIT: in constructor
+; INIT: value = 49
+; RESTORE-NOT: in constructor
+; RESTORE: value = 49
+; CHANGED: in constructor
+; CHANGED: value = 50
+
+@counter = global i32 0
+@ptr = global i32* null
+@fp = global i32 ()* null
+@msg = private constant [16 x i8] c"in constructor\0A\00"
+@fmt = private constant [12 x i8] c"value = %d\0A\00"
+@llvm.global_ctors = appending global [1 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @init, i8* null }]
+
+declare i32 @printf(i8*, ...)
+
+define i32 @seven() {
+  ret i32 7
+}
+
+define void @init() {
+  %1 = call i32 (i8*, ...)* @printf(i8* getelementptr ([16 x i8]* @msg, i32 0, i32 0))
+  store i32 42, i32* @counter
+  store i32* @counter, i32** @ptr
+  store i32 ()* @seven, i32 ()** @fp
+  ret void
+}
+
+define i32 @main() {
+  %p = load i32** @ptr
+  %v = load i32* %p
+  %f = load i32 ()** @fp
+  %r = call i32 %f()
+  %sum = add i32 %v, %r
+  %1 = call i32 (i8*, ...)* @printf(i8* getelementptr ([12 x i8]* @fmt, i32 0, i32 0), i32 %sum)
+  ret i32 0
+}
@@ -0,0 +1,69 @@
+; RUN: lli -O0 -force-interpreter %s
+; XFAIL: mingw32,win32
+
+; Runs several interpreted threads at once.  Each thread counts the set bits of
+; the numbers below 4096 into its own slot, calling an intrinsic that the
+; interpreter lowers the first time any thread reaches it, and main checks
+; every slot after joining the threads.
+@slots = global [4 x i32] zeroinitializer
+
+declare i32 @pthread_create(i64*, i8*, i8* (i8*)*, i8*)
+declare i32 @pthread_join(i64, i8**)
+declare i32 @llvm.ctpop.i32(i32)
+
+define i8* @worker(i8* %arg) {
+entry:
+  %slot = bitcast i8* %arg to i32*
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %bits = call i32 @llvm.ctpop.i32(i32 %i)
+  %sum.next = add i32 %sum, %bits
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, 4096
+  br i1 %done, label %exit, label %loop
+
+exit:
+  store i32 %sum.next, i32* %slot
+  ret i8* %arg
+}
+
+define i32 @main() {
+entry:
+  %threads = alloca [4 x i64]
+  br label %spawn
+
+spawn:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %spawn ]
+  %tid = getelementptr [4 x i64]* %threads, i32 0, i32 %i
+  %slot = getelementptr [4 x i32]* @slots, i32 0, i32 %i
+  %arg = bitcast i32* %slot to i8*
+  %r = call i32 @pthread_create(i64* %tid, i8* null, i8* (i8*)* @worker, i8* %arg)
+  %i.next = add i32 %i, 1
+  %spawned = icmp eq i32 %i.next, 4
+  br i1 %spawned, label %join, label %spawn
+
+join:
+  %j = phi i32 [ 0, %spawn ], [ %j.next, %check ]
+  %failed = phi i32 [ 0, %spawn ], [ %failed.next, %check ]
+  %tid.j = getelementptr [4 x i64]* %threads, i32 0, i32 %j
+  %t = load i64* %tid.j
+  %jr = call i32 @pthread_join(i64 %t, i8** null)
+  br label %check
+
+check:
+  %slot.j = getelementptr [4 x i32]* @slots, i32 0, i32 %j
+  %v = load i32* %slot.j
+  ; 12 bits, each set in half of the 4096 numbers.
+  %bad = icmp ne i32 %v, 24576
+  %bad.i = zext i1 %bad to i32
+  %failed.next = or i32 %failed, %bad.i
+  %j.next = add i32 %j, 1
+  %joined = icmp eq i32 %j.next, 4
+  br i1 %joined, label %exit, label %join
+
+exit:
+  ret i32 %failed.next
+}
@@ -0,0 +1,19 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@shared = weak global i32 2
+
+define i32 @small() {
+  ret i32 42
+}
+
+define i32 @big(i32 %x) {
+  %s = load i32* @shared
+  %a = mul i32 %x, %s
+  %b = add i32 %a, 7
+  ret i32 %b
+}
+
+define i32 @unused_b() {
+  ret i32 1
+}
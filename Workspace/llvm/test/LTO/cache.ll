@@ -0,0 +1,50 @@
+; RUN: rm -rf %t.cache
+; RUN: llvm-as %s -o %t1.bc
+; RUN: llvm-as %p/Inputs/partitions.ll -o %t2.bc
+; RUN: llvm-lto -partitions=2 -cache-dir=%t.cache -exported-symbol=main \
+; RUN:   -o %t.o %t1.bc %t2.bc
+; RUN: ls %t.cache | count 2
+
+; Linking again with the same inputs and options finds both partitions in
+; the cache.
+; RUN: rm -f %t.o.0 %t.o.1
+; RUN: llvm-lto -partitions=2 -cache-dir=%t.cache -exported-symbol=main \
+; RUN:   -o %t.o %t1.bc %t2.bc
+; RUN: ls %t.cache | count 2
+; RUN: llvm-nm %t.o.0 | FileCheck %s -check-prefix=P0
+; RUN: llvm-nm %t.o.1 | FileCheck %s -check-prefix=P1
+
+; Keeping @unused_b only changes the partition that defines it.
+; RUN: llvm-lto -partitions=2 -cache-dir=%t.cache -exported-symbol=main \
+; RUN:   -exported-symbol=unused_b -o %t.o %t1.bc %t2.bc
+; RUN: ls %t.cache | count 3
+; RUN: llvm-nm %t.o.0 | FileCheck %s -check-prefix=P0-KEEP
+
+; Code generation options change every partition.
+; RUN: llvm-lto -partitions=2 -cache-dir=%t.cache -exported-symbol=main \
+; RUN:   -disable-inlining -o %t.o %t1.bc %t2.bc
+; RUN: ls %t.cache | count 5
+
+; P0-DAG: T big
+; P0-DAG: T small
+; P0-NOT: unused_b
+
+; P1-NOT: big
+; P1: T main
+; P1-NOT: small
+
+; P0-KEEP: T unused_b
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@shared = weak global i32 1
+
+define i32 @main() {
+  %a = call i32 @small()
+  %b = call i32 @big(i32 %a)
+  ret i32 %b
+}
+
+declare i32 @small()
+declare i32 @big(i32)
@@ -0,0 +1,10 @@
+; The input has a valid symbol table but an invalid module. Loading it for
+; linking must report the error, and listing its symbols needs only the table.
+; RUN: not llvm-lto -o %t.o %S/Inputs/invalid-symbol-table.bc 2>&1 \
+; RUN:   | FileCheck %s
+; RUN: llvm-lto -list-symbols-only %S/Inputs/invalid-symbol-table.bc \
+; RUN:   | FileCheck %s -check-prefix=SYMS
+
+; CHECK: llvm-lto{{.*}}: error loading file '{{.*}}/Inputs/invalid-symbol-table.bc': Invalid type for value
+
+; SYMS: f
@@ -0,0 +1,29 @@
+; RUN: llvm-as %s -o %t1.bc
+; RUN: llvm-as %p/Inputs/partitions-linkonce.ll -o %t2.bc
+; RUN: llvm-lto -partitions=2 -lto-import-instr-limit=2 -exported-symbol=main \
+; RUN:   -exported-symbol=fa -o %t.o %t1.bc %t2.bc
+; RUN: llvm-nm %t.o.0 | FileCheck %s -check-prefix=P0
+; RUN: llvm-nm %t.o.1 | FileCheck %s -check-prefix=P1
+
+; @inl is too large to be imported, so the second partition calls the copy
+; of the first one. That copy must be emitted even though @fa inlines it.
+; P0-DAG: T fa
+; P0-DAG: W inl
+
+; P1-DAG: T main
+; P1-DAG: U inl
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define linkonce_odr i32 @inl(i32 %x) {
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 3
+  ret i32 %b
+}
+
+define i32 @fa(i32 %x) {
+  %r = call i32 @inl(i32 %x)
+  %s = add i32 %r, 5
+  ret i32 %s
+}
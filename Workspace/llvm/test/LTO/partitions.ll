@@ -0,0 +1,39 @@
+; RUN: llvm-as %s -o %t1.bc
+; RUN: llvm-as %p/Inputs/partitions.ll -o %t2.bc
+; RUN: llvm-lto -partitions=2 -lto-import-instr-limit=2 -exported-symbol=main \
+; RUN:   -o %t.o %t1.bc %t2.bc
+; RUN: llvm-nm %t.o.0 | FileCheck %s -check-prefix=P0
+; RUN: llvm-nm %t.o.1 | FileCheck %s -check-prefix=P1
+
+; The larger input goes to the first partition. Its definitions that the
+; other partition uses stay visible, the rest are internalized and deleted,
+; and its copy of @shared gives way to the one of the first input.
+; P0-DAG: T big
+; P0-DAG: T small
+; P0-DAG: U shared
+; P0-NOT: unused
+
+; @small is imported and inlined, @big is too large to be imported.
+; P1-DAG: T main
+; P1-DAG: U big
+; P1-DAG: V shared
+; P1-NOT: small
+; P1-NOT: unused
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@shared = weak global i32 1
+
+define i32 @main() {
+  %a = call i32 @small()
+  %b = call i32 @big(i32 %a)
+  ret i32 %b
+}
+
+define i32 @unused_a() {
+  ret i32 0
+}
+
+declare i32 @small()
+declare i32 @big(i32)
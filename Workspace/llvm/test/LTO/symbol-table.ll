@@ -0,0 +1,45 @@
+; LTOModule lists the same symbols whether or not it can read them from the
+; bitcode symbol table.
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-as -bitcode-symbol-table=false %s -o %t.notable.bc
+; RUN: llvm-lto -list-symbols-only %t.bc | sed 1d > %t.lto
+; RUN: llvm-lto -list-symbols-only %t.notable.bc | sed 1d > %t.notable.lto
+; RUN: cmp %t.lto %t.notable.lto
+; RUN: FileCheck %s < %t.lto
+
+; CHECK-DAG: ext_fn
+; CHECK-DAG: ext_var
+; CHECK-DAG: tentative
+; CHECK-DAG: linkonce_fn
+; CHECK-DAG: used_fn
+; CHECK-DAG: fn_alias
+; CHECK-DAG: weak_ref
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+$linkonce_fn = comdat any
+
+@ext_var = global i32 1, section "data_sec", align 8
+@const_var = hidden constant i32 2
+@tentative = common global [16 x i32] zeroinitializer, align 16
+@weak_ref = extern_weak global i32
+@llvm.used = appending global [1 x i8*] [i8* bitcast (void ()* @used_fn to i8*)], section "llvm.metadata"
+@fn_alias = alias void ()* @used_fn
+
+declare void @ext_fn()
+
+define internal void @internal_fn() {
+  call void @ext_fn()
+  ret void
+}
+
+define linkonce_odr void @linkonce_fn() unnamed_addr comdat {
+  call void @internal_fn()
+  ret void
+}
+
+define void @used_fn() {
+  call void @linkonce_fn()
+  ret void
+}
@@ -0,0 +1,3 @@
+define available_externally i32 @f() {
+  ret i32 0
+}
@@ -0,0 +1,17 @@
+@llvm.used = appending global [1 x i8*] [i8* getelementptr ([4 x i8]* @used, i32 0, i32 0)], section "llvm.metadata"
+@other = private unnamed_addr constant [4 x i8] c"abc\00", align 1
+@aligned = private unnamed_addr constant [4 x i8] c"def\00", align 2
+@self = private unnamed_addr constant i8* bitcast (i8** @self to i8*)
+@used = private unnamed_addr constant [4 x i8] c"ghi\00"
+
+define i8* @g() {
+  ret i8* getelementptr ([4 x i8]* @other, i32 0, i32 0)
+}
+
+define i8* @g_aligned() {
+  ret i8* getelementptr ([4 x i8]* @aligned, i32 0, i32 0)
+}
+
+define i8** @g_self() {
+  ret i8** @self
+}
@@ -0,0 +1,12 @@
+@arr = appending global [1 x i32] [i32 2]
+
+define linkonce_odr i32 @inl() {
+  ret i32 1
+}
+
+define i32 @b() {
+  %r = call i32 @c()
+  ret i32 %r
+}
+
+declare i32 @c()
@@ -0,0 +1,14 @@
+@arr = appending global [1 x i32] [i32 3]
+
+define linkonce void @unused() {
+  ret void
+}
+
+define i32 @c() {
+  %r = call i32 @inl()
+  ret i32 %r
+}
+
+define linkonce_odr i32 @inl() {
+  ret i32 1
+}
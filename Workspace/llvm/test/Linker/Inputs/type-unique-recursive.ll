@@ -0,0 +1,7 @@
+%node = type { %node*, i32 }
+%x = type { %y*, i64 }
+%y = type { %x*, i8 }
+
+define void @g(%node*, %y*) {
+  ret void
+}
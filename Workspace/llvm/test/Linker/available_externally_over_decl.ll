@@ -0,0 +1,11 @@
+; RUN: llvm-link -S %s %p/Inputs/available_externally_over_decl.ll | FileCheck %s
+
+; An available_externally definition replaces a declaration.
+; CHECK: define available_externally i32 @f()
+
+declare i32 @f()
+
+define i32 @g() {
+  %r = call i32 @f()
+  ret i32 %r
+}
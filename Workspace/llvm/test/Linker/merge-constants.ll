@@ -0,0 +1,42 @@
+; RUN: llvm-link -S %s %p/Inputs/merge-constants.ll | FileCheck %s
+; RUN: llvm-link -parallel -threads=2 -S %s %p/Inputs/merge-constants.ll \
+; RUN:   | FileCheck %s
+; RUN: llvm-link -S %s %p/Inputs/merge-constants.ll \
+; RUN:   | FileCheck %s -check-prefix=MERGED
+
+; Private unnamed_addr constants are merged with identical ones from other
+; modules, unless their alignment differs, they refer to globals or they are
+; used.
+
+; MERGED-NOT: @other
+
+; CHECK-DAG: @str = private unnamed_addr constant [4 x i8] c"abc\00", align 1
+; CHECK-DAG: @aligned = private unnamed_addr constant [4 x i8] c"def\00", align 1
+; CHECK-DAG: @aligned{{[0-9]+}} = private unnamed_addr constant [4 x i8] c"def\00", align 2
+; CHECK-DAG: @self = private unnamed_addr constant i8* bitcast (i8** @self to i8*)
+; CHECK-DAG: @self{{[0-9]+}} = private unnamed_addr constant i8* bitcast
+; CHECK-DAG: @used = private unnamed_addr constant [4 x i8] c"ghi\00"
+; CHECK-DAG: @used{{[0-9]+}} = private unnamed_addr constant [4 x i8] c"ghi\00"
+
+; CHECK: define i8* @f()
+; CHECK-NEXT: ret i8* getelementptr inbounds ([4 x i8]* @str, i32 0, i32 0)
+; CHECK: define i8* @g()
+; CHECK-NEXT: ret i8* getelementptr inbounds ([4 x i8]* @str, i32 0, i32 0)
+
+@llvm.used = appending global [1 x i8*] [i8* getelementptr ([4 x i8]* @used, i32 0, i32 0)], section "llvm.metadata"
+@str = private unnamed_addr constant [4 x i8] c"abc\00", align 1
+@aligned = private unnamed_addr constant [4 x i8] c"def\00", align 1
+@self = private unnamed_addr constant i8* bitcast (i8** @self to i8*)
+@used = private unnamed_addr constant [4 x i8] c"ghi\00"
+
+define i8* @f() {
+  ret i8* getelementptr ([4 x i8]* @str, i32 0, i32 0)
+}
+
+define i8* @f_aligned() {
+  ret i8* getelementptr ([4 x i8]* @aligned, i32 0, i32 0)
+}
+
+define i8** @f_self() {
+  ret i8** @self
+}
@@ -0,0 +1,30 @@
+; RUN: llvm-link -parallel -threads=2 %s %p/Inputs/parallel-b.ll \
+; RUN:   %p/Inputs/parallel-c.ll -S | FileCheck %s
+; RUN: llvm-link -parallel -threads=1 %s %p/Inputs/parallel-b.ll \
+; RUN:   %p/Inputs/parallel-c.ll -S | FileCheck %s -check-prefix=SERIAL
+
+; Inputs linked in separate runs must resolve against each other, and
+; appending globals keep the order of the inputs.
+
+; CHECK-DAG: @arr = appending global [3 x i32] [i32 1, i32 2, i32 3]
+; CHECK-DAG: define i32 @a()
+; CHECK-DAG: define i32 @b()
+; CHECK-DAG: define i32 @c()
+; CHECK-DAG: define linkonce_odr i32 @inl()
+; CHECK-DAG: call i32 @inl()
+
+; Linkonce definitions nothing references are only dropped when linking
+; serially.
+; CHECK-DAG: define linkonce void @unused()
+; SERIAL-NOT: @unused
+
+; CHECK-NOT: declare
+
+@arr = appending global [1 x i32] [i32 1]
+
+define i32 @a() {
+  %r = call i32 @b()
+  ret i32 %r
+}
+
+declare i32 @b()
@@ -0,0 +1,22 @@
+; RUN: llvm-link -S %s %p/Inputs/type-unique-recursive.ll | FileCheck %s
+; RUN: llvm-link -parallel -threads=2 -S %s %p/Inputs/type-unique-recursive.ll \
+; RUN:   | FileCheck %s
+
+; Recursive types are merged with isomorphic ones from other modules whatever
+; their names, like other types are.
+
+; CHECK: %list = type { %list*, i32 }
+; CHECK: %a = type { %b*, i64 }
+; CHECK: %b = type { %a*, i8 }
+; CHECK-NOT: type
+
+; CHECK: define void @f(%list*, %a*)
+; CHECK: define void @g(%list*, %b*)
+
+%list = type { %list*, i32 }
+%a = type { %b*, i64 }
+%b = type { %a*, i8 }
+
+define void @f(%list*, %a*) {
+  ret void
+}
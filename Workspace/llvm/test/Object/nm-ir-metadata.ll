@@ -0,0 +1,39 @@
+; RUN: llvm-as %s -o - | llvm-nm - | FileCheck %s
+
+; The symbol table of bitcode is read without its metadata, which is skipped.
+; The input has the same symbols, no bitcode symbol table, and a named
+; metadata node whose operand is a string, which reading the metadata rejects.
+; RUN: not llvm-dis %S/Inputs/invalid-metadata.bc -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=INVALID
+; RUN: llvm-nm %S/Inputs/invalid-metadata.bc | FileCheck %s
+
+; INVALID: Invalid record
+
+; CHECK: T foo
+; CHECK: D table
+
+@table = global [2 x i32] [i32 1, i32 2], align 4
+
+define i32 @foo() nounwind {
+  %v = load i32* getelementptr ([2 x i32]* @table, i64 0, i64 1), align 4, !tbaa !12
+  ret i32 %v, !dbg !6
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!11}
+
+!0 = !{!"0x11\0012\00clang\001\00\000\00\000", !8, !9, !9, !10, null, null} ; [ DW_TAG_compile_unit ]
+!1 = !{!"0x2e\00foo\00foo\00\002\000\001\000\006\000\000\000", !8, !2, !3, null, i32 ()* @foo, null, null, null} ; [ DW_TAG_subprogram ] [line 2] [def] [scope 0] [foo]
+!2 = !{!"0x29", !8} ; [ DW_TAG_file_type ]
+!3 = !{!"0x15\00\000\000\000\000\000\000", !8, !2, null, !4, null, null, null} ; [ DW_TAG_subroutine_type ]
+!4 = !{!5}
+!5 = !{!"0x24\00int\000\0032\0032\000\000\005", null, !0} ; [ DW_TAG_base_type ]
+!6 = !MDLocation(line: 2, column: 13, scope: !7)
+!7 = !{!"0xb\002\0011\000", !8, !1} ; [ DW_TAG_lexical_block ]
+!8 = !{!"a.c", !"/tmp"}
+!9 = !{i32 0}
+!10 = !{!1}
+!11 = !{i32 2, !"Debug Info Version", i32 2}
+!12 = !{!13, !13, i64 0}
+!13 = !{!"int", !14, i64 0}
+!14 = !{!"tbaa root"}
@@ -0,0 +1,22 @@
+; RUN: opt -argpromotion -pass-profile=%t.trace -pass-profile-format=chrome \
+; RUN:     -disable-output %s
+; RUN: FileCheck %s < %t.trace
+; RUN: opt -inline -argpromotion -pass-profile=%t.json -disable-output %s
+; RUN: FileCheck %s --check-prefix=JSON < %t.json
+
+; -argpromotion replaces @callee with a new function and deletes it. The
+; profile still names it and counts the instructions of its replacement.
+; CHECK: {"name":"Promote 'by reference' arguments to scalars",{{.*}}"args":{"ir":"callee","instructions":-1,
+
+; JSON: {"name": "Function Integration/Inlining", "runs": 3,
+; JSON: {"name": "Promote 'by reference' arguments to scalars", "runs": 3,
+
+define internal i32 @callee(i32* %p) {
+  %v = load i32* %p
+  ret i32 %v
+}
+
+define i32 @caller(i32* %p) {
+  %r = call i32 @callee(i32* %p)
+  ret i32 %r
+}
@@ -0,0 +1,42 @@
+; RUN: opt -instcombine -loop-rotate -pass-profile=%t.json -disable-output %s
+; RUN: FileCheck %s --check-prefix=JSON < %t.json
+; RUN: opt -instcombine -pass-profile=%t.trace -pass-profile-format=chrome \
+; RUN:     -disable-output %s
+; RUN: FileCheck %s --check-prefix=CHROME < %t.trace
+
+; JSON: "peak-malloc":
+; JSON: "passes": [
+; JSON: {"name": "Combine redundant instructions", "runs": 3,
+; JSON-SAME: "instructions": -1,
+; JSON-NEXT: "slowest": {"ir":
+; JSON-NEXT: "most-instructions": {"ir": "f", "instructions": 0},
+; JSON: {"name": "Rotate Loops", "runs": 1,
+; JSON-NEXT: "slowest": {"ir": "h",
+
+; CHROME: [
+; CHROME-DAG: {"name":"Combine redundant instructions","cat":"pass","ph":"X",{{.*}}"args":{"ir":"f","instructions":0,
+; CHROME-DAG: {"name":"Combine redundant instructions","cat":"pass","ph":"X",{{.*}}"args":{"ir":"g","instructions":-1,
+; CHROME: ]
+
+define i32 @f(i32 %x) {
+  ret i32 %x
+}
+
+define i32 @g(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
+
+define void @h(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
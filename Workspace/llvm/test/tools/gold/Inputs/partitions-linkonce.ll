@@ -0,0 +1,10 @@
+define linkonce_odr i32 @inl(i32 %x) {
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 3
+  ret i32 %b
+}
+
+define i32 @main() {
+  %r = call i32 @inl(i32 0)
+  ret i32 %r
+}
@@ -0,0 +1,10 @@
+define i32 @small() {
+  ret i32 42
+}
+
+define i32 @big(i32 %x) {
+  %a = mul i32 %x, %x
+  %b = add i32 %a, 7
+  %c = mul i32 %b, %x
+  ret i32 %c
+}
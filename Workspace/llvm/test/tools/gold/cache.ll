@@ -0,0 +1,42 @@
+; RUN: rm -rf %t.cache
+; RUN: llvm-as %s -o %t.o
+; RUN: llvm-as %p/Inputs/partitions.ll -o %t2.o
+; RUN: ld -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=partitions=2 \
+; RUN:    --plugin-opt=cache-dir=%t.cache \
+; RUN:    -shared %t.o %t2.o -o %t3
+; RUN: ls %t.cache | count 2
+
+; The second link reuses both object files.
+; RUN: ld -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=partitions=2 \
+; RUN:    --plugin-opt=cache-dir=%t.cache \
+; RUN:    -shared %t.o %t2.o -o %t4
+; RUN: ls %t.cache | count 2
+; RUN: llvm-nm %t4 | FileCheck %s
+
+; Changing a plugin option changes every partition.
+; RUN: ld -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=partitions=2 \
+; RUN:    --plugin-opt=cache-dir=%t.cache \
+; RUN:    --plugin-opt=-lto-import-instr-limit=2 \
+; RUN:    -shared %t.o %t2.o -o %t5
+; RUN: ls %t.cache | count 4
+
+; CHECK-DAG: T big
+; CHECK-DAG: T main
+; CHECK-DAG: T small
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@shared = weak global i32 1
+
+define i32 @main() {
+  %a = call i32 @small()
+  %b = call i32 @big(i32 %a)
+  ret i32 %b
+}
+
+declare i32 @small()
+declare i32 @big(i32)
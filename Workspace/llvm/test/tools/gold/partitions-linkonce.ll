@@ -0,0 +1,31 @@
+; RUN: llvm-as %s -o %t.o
+; RUN: llvm-as %p/Inputs/partitions-linkonce.ll -o %t2.o
+; RUN: ld -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=partitions=2 \
+; RUN:    --plugin-opt=-lto-import-instr-limit=2 \
+; RUN:    --plugin-opt=save-temps \
+; RUN:    -shared %t.o %t2.o -o %t3
+; RUN: llvm-dis %t3.0.bc -o - | FileCheck --check-prefix=P0 %s
+; RUN: llvm-dis %t3.1.bc -o - | FileCheck --check-prefix=P1 %s
+; RUN: llvm-nm %t3 | FileCheck --check-prefix=NM %s
+
+; The first partition defines @inl, which is too large to be imported into
+; the second one. It must survive being inlined into @fa.
+; P0: define weak_odr i32 @inl(i32 %x)
+; P1: declare i32 @inl(i32)
+
+; NM: T fa
+; NM: W inl
+; NM: T main
+
+define linkonce_odr i32 @inl(i32 %x) {
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 3
+  ret i32 %b
+}
+
+define i32 @fa(i32 %x) {
+  %r = call i32 @inl(i32 %x)
+  %s = add i32 %r, 5
+  ret i32 %s
+}
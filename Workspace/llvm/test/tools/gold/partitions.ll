@@ -0,0 +1,32 @@
+; RUN: llvm-as %s -o %t.o
+; RUN: llvm-as %p/Inputs/partitions.ll -o %t2.o
+; RUN: ld -plugin %llvmshlibdir/LLVMgold.so \
+; RUN:    --plugin-opt=partitions=2 \
+; RUN:    --plugin-opt=-lto-import-instr-limit=2 \
+; RUN:    --plugin-opt=save-temps \
+; RUN:    -shared %t.o %t2.o -o %t3
+; RUN: llvm-dis %t3.0.bc -o - | FileCheck --check-prefix=P0 %s
+; RUN: llvm-dis %t3.1.bc -o - | FileCheck --check-prefix=P1 %s
+; RUN: llvm-nm %t3 | FileCheck --check-prefix=NM %s
+
+; The larger input is in the first partition.
+; P0: define i32 @small()
+; P0: define i32 @big(i32 %x)
+
+; The second partition gets a copy of @small, but @big is too large.
+; P1: define i32 @main()
+; P1-DAG: define available_externally i32 @small()
+; P1-DAG: declare i32 @big(i32)
+
+; NM: T big
+; NM: T main
+; NM: T small
+
+define i32 @main() {
+  %a = call i32 @small()
+  %b = call i32 @big(i32 %a)
+  ret i32 %b
+}
+
+declare i32 @small()
+declare i32 @big(i32)
@@ -14,6 +14,7 @@
 
 #include "llvm/Config/config.h" // plugin-api.h requires HAVE_STDINT_H
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/Analysis.h"
@@ -24,14 +25,18 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/LTO/LTOCache.h"
+#include "llvm/LTO/LTOPartitioner.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/IRObjectFile.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetLibraryInfo.h"
@@ -93,6 +98,12 @@ namespace options {
   static std::string extra_library_path;
   static std::string triple;
   static std::string mcpu;
+  // Split the program into this many partitions, optimized and compiled into
+  // separate object files on several threads. See LTOPartitioner.
+  static unsigned Partitions = 1;
+  // Directory in which to keep the object files of partitions for reuse by
+  // later links. See LTOCache.
+  static std::string cache_dir;
   // Additional options to pass into the code generator.
   // Note: This array will contain all plugin options which are not claimed
   // as plugin exclusive to pass to the code generator.
@@ -116,6 +127,12 @@ namespace options {
       triple = opt.substr(strlen("mtriple="));
     } else if (opt.startswith("obj-path=")) {
       obj_path = opt.substr(strlen("obj-path="));
+    } else if (opt.startswith("partitions=")) {
+      if (opt.substr(strlen("partitions=")).getAsInteger(10, Partitions) ||
+          Partitions == 0)
+        Partitions = 1;
+    } else if (opt.startswith("cache-dir=")) {
+      cache_dir = opt.substr(strlen("cache-dir="));
     } else if (opt == "emit-llvm") {
       TheOutputType = OT_BC_ONLY;
     } else if (opt == "save-temps") {
@@ -288,6 +305,75 @@ static void diagnosticHandler(const DiagnosticInfo &DI, void *Context) {
           ErrStorage.c_str());
 }
 
+/// Tell gold about the symbols of a claimed file.
+static ld_plugin_status addClaimedSymbols(claimed_file &cf) {
+  if (!cf.syms.empty()) {
+    if (add_symbols(cf.handle, cf.syms.size(), &cf.syms[0]) != LDPS_OK) {
+      message(LDPL_ERROR, "Unable to add symbols!");
+      return LDPS_ERR;
+    }
+  }
+
+  return LDPS_OK;
+}
+
+/// Describe the symbols of a bitcode file to gold from its symbol table, the
+/// way claim_file_hook does from its module.  Returns false if the table
+/// can't do that, because the comdat key of an alias would be the name of its
+/// aliasee's symbol, which the table doesn't have.
+static bool addSymbolsFromTable(claimed_file &cf,
+                                const BitcodeSymbolTable &Table) {
+  for (const BitcodeSymbol &Sym : Table.Symbols)
+    if (Sym.Kind == BitcodeSymbol::Alias && Sym.Comdat.empty())
+      return false;
+
+  for (const BitcodeSymbol &Sym : Table.Symbols) {
+    uint32_t Symflags = object::IRObjectFile::getBitcodeSymbolFlags(Sym);
+    if (shouldSkip(Symflags))
+      continue;
+
+    cf.syms.push_back(ld_plugin_symbol());
+    ld_plugin_symbol &sym = cf.syms.back();
+    sym.version = nullptr;
+    sym.name = strdup(Sym.Name.c_str());
+
+    switch (Sym.Visibility) {
+    case GlobalValue::DefaultVisibility:
+      sym.visibility = LDPV_DEFAULT;
+      break;
+    case GlobalValue::HiddenVisibility:
+      sym.visibility = LDPV_HIDDEN;
+      break;
+    case GlobalValue::ProtectedVisibility:
+      sym.visibility = LDPV_PROTECTED;
+      break;
+    }
+
+    if (Symflags & object::BasicSymbolRef::SF_Undefined) {
+      sym.def = LDPK_UNDEF;
+      if (GlobalValue::isExternalWeakLinkage(Sym.Linkage))
+        sym.def = LDPK_WEAKUNDEF;
+    } else {
+      sym.def = LDPK_DEF;
+      if (GlobalValue::isCommonLinkage(Sym.Linkage))
+        sym.def = LDPK_COMMON;
+      else if (GlobalValue::isWeakForLinker(Sym.Linkage))
+        sym.def = LDPK_WEAKDEF;
+    }
+
+    sym.size = 0;
+    sym.comdat_key = nullptr;
+    if (!Sym.Comdat.empty())
+      sym.comdat_key = strdup(Sym.Comdat.c_str());
+    else if (GlobalValue::isWeakLinkage(Sym.Linkage) ||
+             GlobalValue::isLinkOnceLinkage(Sym.Linkage))
+      sym.comdat_key = strdup(sym.name);
+
+    sym.resolution = LDPR_UNKNOWN;
+  }
+  return true;
+}
+
 /// Called by gold to see whether this file is one that our plugin can handle.
 /// We'll try to open it and register all the symbols with add_symbol if
 /// possible.
@@ -322,6 +408,36 @@ static ld_plugin_status claim_file_hook(const ld_plugin_input_file *file,
   }
 
   Context.setDiagnosticHandler(diagnosticHandler);
+
+  // The symbols of bitcode files that have a symbol table can be read without
+  // going through an IRObjectFile.  The module is still read here, since
+  // every claimed file is linked and an invalid one must be reported now,
+  // not once all symbols are read.
+  if (ErrorOr<MemoryBufferRef> BCOrErr =
+          object::IRObjectFile::findBitcodeInMemBuffer(BufferRef)) {
+    ErrorOr<BitcodeSymbolTable> TableOrErr =
+        readBitcodeSymbolTable(*BCOrErr, Context);
+    if (TableOrErr) {
+      ErrorOr<Module *> MOrErr = parseBitcodeFile(*BCOrErr, Context);
+      if (std::error_code EC = MOrErr.getError()) {
+        *claimed = 1;
+        message(LDPL_ERROR,
+                "LLVM gold plugin has failed to create LTO module: %s",
+                EC.message().c_str());
+        return LDPS_ERR;
+      }
+      delete *MOrErr;
+
+      claimed_file cf;
+      cf.handle = file->handle;
+      if (addSymbolsFromTable(cf, *TableOrErr)) {
+        *claimed = 1;
+        Modules.push_back(std::move(cf));
+        return addClaimedSymbols(Modules.back());
+      }
+    }
+  }
+
   ErrorOr<std::unique_ptr<object::IRObjectFile>> ObjOrErr =
       object::IRObjectFile::create(BufferRef, Context);
   std::error_code EC = ObjOrErr.getError();
@@ -408,14 +524,7 @@ static ld_plugin_status claim_file_hook(const ld_plugin_input_file *file,
     sym.resolution = LDPR_UNKNOWN;
   }
 
-  if (!cf.syms.empty()) {
-    if (add_symbols(cf.handle, cf.syms.size(), &cf.syms[0]) != LDPS_OK) {
-      message(LDPL_ERROR, "Unable to add symbols!");
-      return LDPS_ERR;
-    }
-  }
-
-  return LDPS_OK;
+  return addClaimedSymbols(cf);
 }
 
 static void keepGlobalValue(GlobalValue &GV,
@@ -712,7 +821,23 @@ static void saveBCFile(StringRef Path, Module &M) {
   WriteBitcodeToFile(&M, OS);
 }
 
-static void codegen(Module &M) {
+/// Return the name of the object file to generate. \p Task numbers the
+/// object files of a partitioned link and is -1 otherwise.
+static std::string getObjectFileName(int Task) {
+  if (!options::obj_path.empty())
+    return options::obj_path + (Task < 0 ? "" : "." + utostr(Task));
+
+  SmallString<128> Filename;
+  if (std::error_code EC =
+          sys::fs::createTemporaryFile("lto-llvm", "o", Filename))
+    message(LDPL_FATAL, "Could not create temporary file: %s",
+            EC.message().c_str());
+  return Filename.str();
+}
+
+/// Optimize \p M and compile it into the object file \p Filename. \p Task is
+/// as for getObjectFileName().
+static void codegen(Module &M, int Task, const std::string &Filename) {
   const std::string &TripleStr = M.getTargetTriple();
   Triple TheTriple(TripleStr);
 
@@ -721,8 +846,7 @@ static void codegen(Module &M) {
   if (!TheTarget)
     message(LDPL_FATAL, "Target not found: %s", ErrMsg.c_str());
 
-  if (unsigned NumOpts = options::extra.size())
-    cl::ParseCommandLineOptions(NumOpts, &options::extra[0]);
+  std::string Suffix = Task < 0 ? "" : "." + utostr(Task);
 
   SubtargetFeatures Features;
   Features.getDefaultSubtargetFeatures(TheTriple);
@@ -737,26 +861,16 @@ static void codegen(Module &M) {
   runLTOPasses(M, *TM);
 
   if (options::TheOutputType == options::OT_SAVE_TEMPS)
-    saveBCFile(output_name + ".opt.bc", M);
+    saveBCFile(output_name + Suffix + ".opt.bc", M);
 
   PassManager CodeGenPasses;
   CodeGenPasses.add(new DataLayoutPass());
 
-  SmallString<128> Filename;
   int FD;
-  if (options::obj_path.empty()) {
-    std::error_code EC =
-        sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
-    if (EC)
-      message(LDPL_FATAL, "Could not create temporary file: %s",
-              EC.message().c_str());
-  } else {
-    Filename = options::obj_path;
-    std::error_code EC =
-        sys::fs::openFileForWrite(Filename.c_str(), FD, sys::fs::F_None);
-    if (EC)
-      message(LDPL_FATAL, "Could not open file: %s", EC.message().c_str());
-  }
+  std::error_code EC =
+      sys::fs::openFileForWrite(Filename.c_str(), FD, sys::fs::F_None);
+  if (EC)
+    message(LDPL_FATAL, "Could not open file: %s", EC.message().c_str());
 
   {
     raw_fd_ostream OS(FD, true);
@@ -767,14 +881,117 @@ static void codegen(Module &M) {
       message(LDPL_FATAL, "Failed to setup codegen");
     CodeGenPasses.run(M);
   }
+}
 
+static void addObjectFile(const std::string &Filename) {
   if (add_input_file(Filename.c_str()) != LDPS_OK)
     message(LDPL_FATAL,
             "Unable to add .o file to the link. File left behind in: %s",
             Filename.c_str());
 
   if (options::obj_path.empty())
-    Cleanup.push_back(Filename.c_str());
+    Cleanup.push_back(Filename);
+}
+
+/// Apply the internalization decisions made from the symbol resolutions to
+/// \p M. In a partitioned link, symbols used by other partitions are left
+/// alone.
+static void internalizeModule(Module &M, const StringSet<> &Internalize,
+                              const StringSet<> &Maybe,
+                              const LTOPartitioner *Partitioner) {
+  for (const auto &Name : Internalize) {
+    GlobalValue *GV = M.getNamedValue(Name.first());
+    if (GV && !(Partitioner && Partitioner->isExported(Name.first())))
+      internalize(*GV);
+  }
+
+  for (const auto &Name : Maybe) {
+    GlobalValue *GV = M.getNamedValue(Name.first());
+    if (!GV || GV->isDeclarationForLinker() ||
+        (Partitioner && Partitioner->isExported(Name.first())))
+      continue;
+    GV->setLinkage(GlobalValue::LinkOnceODRLinkage);
+    if (canBeOmittedFromSymbolTable(GV))
+      internalize(*GV);
+  }
+}
+
+/// Return the key of the object file of partition \p I in the cache: a hash
+/// of the partition's inputs, the symbol resolutions that concern it and the
+/// code generation options.
+static std::string getCacheKey(const LTOPartitioner &Partitioner, unsigned I,
+                               const StringSet<> &Internalize,
+                               const StringSet<> &Maybe) {
+  MD5 Hasher;
+  auto AddString = [&](StringRef S) {
+    Hasher.update(utostr(S.size()) + ":");
+    Hasher.update(S);
+  };
+
+  AddString(PACKAGE_VERSION);
+  AddString(options::mcpu);
+  AddString(utostr(RelocationModel));
+  // The remaining options are parsed into the code generator's cl::opts.
+  for (unsigned J = 1, E = options::extra.size(); J < E; ++J)
+    AddString(options::extra[J]);
+
+  Partitioner.hashPartition(I, Hasher, [&](StringRef Name) {
+    return unsigned(Internalize.count(Name)) |
+           unsigned(Maybe.count(Name)) << 1;
+  });
+
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+/// Optimize and compile the partitions on the threads of the global
+/// ThreadPool, each in an LLVMContext of its own, then add the object files
+/// to the link in partition order. Partitions found in the cache are not
+/// compiled again.
+static void codegenPartitions(LTOPartitioner &Partitioner,
+                              const StringSet<> &Internalize,
+                              const StringSet<> &Maybe) {
+  Partitioner.plan(options::Partitions);
+  unsigned N = Partitioner.getNumPartitions();
+
+  std::unique_ptr<LTOCache> Cache;
+  std::vector<std::string> Keys(N);
+  if (!options::cache_dir.empty()) {
+    Cache.reset(new LTOCache(options::cache_dir));
+    for (unsigned I = 0; I != N; ++I)
+      Keys[I] = getCacheKey(Partitioner, I, Internalize, Maybe);
+  }
+
+  std::vector<std::string> Filenames(N);
+  for (unsigned I = 0; I != N; ++I)
+    Filenames[I] = getObjectFileName(I);
+
+  parallel_for_each_n(0u, N, [&](unsigned I) {
+    if (Cache && Cache->lookup(Keys[I], Filenames[I]))
+      return;
+
+    LLVMContext Context;
+    std::string ErrMsg;
+    std::unique_ptr<Module> M =
+        Partitioner.buildPartition(I, Context, ErrMsg);
+    if (!M)
+      message(LDPL_FATAL, "Failed to build partition %u: %s", I,
+              ErrMsg.c_str());
+
+    internalizeModule(*M, Internalize, Maybe, &Partitioner);
+    if (options::TheOutputType == options::OT_SAVE_TEMPS)
+      saveBCFile(output_name + "." + utostr(I) + ".bc", *M);
+
+    codegen(*M, I, Filenames[I]);
+    if (Cache)
+      Cache->insert(Keys[I], Filenames[I]);
+  });
+
+  for (const std::string &Filename : Filenames)
+    addObjectFile(Filename);
 }
 
 /// gold informs us that all symbols have been read. At this point, we use
@@ -788,6 +1005,13 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
   std::unique_ptr<Module> Combined(new Module("ld-temp.o", Context));
   Linker L(Combined.get());
 
+  // Partitions only make sense when generating code.
+  bool Partitioned = (options::Partitions > 1 ||
+                      !options::cache_dir.empty()) &&
+                     (options::TheOutputType == options::OT_NORMAL ||
+                      options::TheOutputType == options::OT_SAVE_TEMPS);
+  LTOPartitioner Partitioner;
+
   std::string DefaultTriple = sys::getDefaultTargetTriple();
 
   StringSet<> Internalize;
@@ -805,43 +1029,42 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
       M->setTargetTriple(DefaultTriple);
     }
 
-    if (L.linkInModule(M.get()))
+    if (Partitioned)
+      Partitioner.addModule(*M);
+    else if (L.linkInModule(M.get()))
       message(LDPL_FATAL, "Failed to link module");
     if (release_input_file(F.handle) != LDPS_OK)
       message(LDPL_FATAL, "Failed to release file information");
   }
 
-  for (const auto &Name : Internalize) {
-    GlobalValue *GV = Combined->getNamedValue(Name.first());
-    if (GV)
-      internalize(*GV);
-  }
+  if (Partitioned) {
+    if (unsigned NumOpts = options::extra.size())
+      cl::ParseCommandLineOptions(NumOpts, &options::extra[0]);
+    codegenPartitions(Partitioner, Internalize, Maybe);
+  } else {
+    internalizeModule(*Combined, Internalize, Maybe, nullptr);
 
-  for (const auto &Name : Maybe) {
-    GlobalValue *GV = Combined->getNamedValue(Name.first());
-    if (!GV)
-      continue;
-    GV->setLinkage(GlobalValue::LinkOnceODRLinkage);
-    if (canBeOmittedFromSymbolTable(GV))
-      internalize(*GV);
-  }
+    if (options::TheOutputType == options::OT_DISABLE)
+      return LDPS_OK;
 
-  if (options::TheOutputType == options::OT_DISABLE)
-    return LDPS_OK;
+    if (options::TheOutputType != options::OT_NORMAL) {
+      std::string path;
+      if (options::TheOutputType == options::OT_BC_ONLY)
+        path = output_name;
+      else
+        path = output_name + ".bc";
+      saveBCFile(path, *L.getModule());
+      if (options::TheOutputType == options::OT_BC_ONLY)
+        return LDPS_OK;
+    }
 
-  if (options::TheOutputType != options::OT_NORMAL) {
-    std::string path;
-    if (options::TheOutputType == options::OT_BC_ONLY)
-      path = output_name;
-    else
-      path = output_name + ".bc";
-    saveBCFile(path, *L.getModule());
-    if (options::TheOutputType == options::OT_BC_ONLY)
-      return LDPS_OK;
+    if (unsigned NumOpts = options::extra.size())
+      cl::ParseCommandLineOptions(NumOpts, &options::extra[0]);
+    std::string Filename = getObjectFileName(-1);
+    codegen(*L.getModule(), -1, Filename);
+    addObjectFile(Filename);
   }
 
-  codegen(*L.getModule());
-
   if (!options::extra_library_path.empty() &&
       set_extra_library_path(options::extra_library_path.c_str()) != LDPS_OK)
     message(LDPL_FATAL, "Unable to set the extra library path.");
@@ -151,8 +151,10 @@ GetOutputStream(const char *TargetName, Triple::OSType OS,
   sys::fs::OpenFlags OpenFlags = sys::fs::F_None;
   if (!Binary)
     OpenFlags |= sys::fs::F_Text;
+  // Object files are written straight into a mapping of the output file.
+  bool AllowMapping = FileType == TargetMachine::CGFT_ObjectFile;
   auto FDOut = llvm::make_unique<tool_output_file>(OutputFilename, EC,
-                                                   OpenFlags);
+                                                   OpenFlags, AllowMapping);
   if (EC) {
     errs() << EC.message() << '\n';
     return nullptr;
@@ -312,7 +314,7 @@ static int compileModule(char **argv, LLVMContext &Context) {
              << ": warning: ignoring -mc-relax-all because filetype != obj";
 
   {
-    formatted_raw_ostream FOS(Out->os());
+    formatted_raw_ostream FOS(Out->stream());
 
     AnalysisID StartAfterID = nullptr;
     AnalysisID StopAfterID = nullptr;
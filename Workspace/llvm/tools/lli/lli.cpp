@@ -74,6 +74,13 @@ namespace {
                                  cl::desc("Force interpretation: disable JIT"),
                                  cl::init(false));
 
+  cl::opt<std::string>
+  GlobalsSnapshot("globals-snapshot",
+    cl::desc("Restore global variables from this file instead of running "
+             "static constructors, or save them to it after running the "
+             "constructors if it can't be restored (interpreter only)"),
+    cl::value_desc("filename"), cl::init(""));
+
   // The MCJIT supports building for a target address space separate from
   // the JIT compilation process. Use a forked process and a copying
   // memory manager with IPC to execute using this functionality.
@@ -546,6 +553,8 @@ int main(int argc, char **argv, char * const *envp) {
                 JITEventListener::createOProfileJITEventListener());
   EE->RegisterJITEventListener(
                 JITEventListener::createIntelJITEventListener());
+  EE->RegisterJITEventListener(
+                JITEventListener::createPerfJITEventListener());
 
   if (!NoLazyCompilation && RemoteMCJIT) {
     errs() << "warning: remote mcjit does not support lazy compilation\n";
@@ -595,7 +604,18 @@ int main(int argc, char **argv, char * const *envp) {
       // Give MCJIT a chance to apply relocations and set page permissions.
       EE->finalizeObject();
     }
-    EE->runStaticConstructorsDestructors(false);
+    if (GlobalsSnapshot.empty() || !ForceInterpreter) {
+      EE->runStaticConstructorsDestructors(false);
+    } else {
+      std::string SnapshotErr;
+      if (EE->restoreGlobalsSnapshot(GlobalsSnapshot, SnapshotErr)) {
+        DEBUG(dbgs() << "lli: not restoring globals: " << SnapshotErr << "\n");
+        EE->runStaticConstructorsDestructors(false);
+        if (EE->saveGlobalsSnapshot(GlobalsSnapshot, SnapshotErr))
+          errs() << argv[0] << ": warning: cannot save globals snapshot: "
+                 << SnapshotErr << "\n";
+      }
+    }
 
     // Trigger compilation separately so code regions that need to be
     // invalidated will be known.
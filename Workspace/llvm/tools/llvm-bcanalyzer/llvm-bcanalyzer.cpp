@@ -110,6 +110,8 @@ static const char *GetBlockName(unsigned BlockID,
   case bitc::METADATA_BLOCK_ID:        return "METADATA_BLOCK";
   case bitc::METADATA_ATTACHMENT_ID:   return "METADATA_ATTACHMENT_BLOCK";
   case bitc::USELIST_BLOCK_ID:         return "USELIST_BLOCK_ID";
+  case bitc::FUNCTION_INDEX_BLOCK_ID:  return "FUNCTION_INDEX_BLOCK";
+  case bitc::SYMTAB_BLOCK_ID:          return "SYMTAB_BLOCK";
   }
 }
 
@@ -158,6 +160,7 @@ static const char *GetCodeName(unsigned CodeID, unsigned BlockID,
     case bitc::MODULE_CODE_ALIAS:       return "ALIAS";
     case bitc::MODULE_CODE_PURGEVALS:   return "PURGEVALS";
     case bitc::MODULE_CODE_GCNAME:      return "GCNAME";
+    case bitc::MODULE_CODE_FNINDEXOFFSET: return "FNINDEXOFFSET";
     }
   case bitc::PARAMATTR_BLOCK_ID:
     switch (CodeID) {
@@ -278,6 +281,19 @@ static const char *GetCodeName(unsigned CodeID, unsigned BlockID,
     case bitc::USELIST_CODE_DEFAULT: return "USELIST_CODE_DEFAULT";
     case bitc::USELIST_CODE_BB:      return "USELIST_CODE_BB";
     }
+  case bitc::FUNCTION_INDEX_BLOCK_ID:
+    switch (CodeID) {
+    default: return nullptr;
+    case bitc::FNINDEX_CODE_ENTRY: return "ENTRY";
+    }
+  case bitc::SYMTAB_BLOCK_ID:
+    switch (CodeID) {
+    default: return nullptr;
+    case bitc::SYMTAB_CODE_TRIPLE:        return "TRIPLE";
+    case bitc::SYMTAB_CODE_DATALAYOUT:    return "DATALAYOUT";
+    case bitc::SYMTAB_CODE_LINKER_OPTION: return "LINKER_OPTION";
+    case bitc::SYMTAB_CODE_ENTRY:         return "ENTRY";
+    }
   }
 }
 
@@ -500,6 +516,18 @@ static bool openBitcodeFile(StringRef Path,
   const unsigned char *BufPtr = (const unsigned char *)MemBuf->getBufferStart();
   const unsigned char *EndBufPtr = BufPtr + MemBuf->getBufferSize();
 
+  // Dump compressed bitcode as the bitcode it holds.
+  if (isCompressedBitcode(BufPtr, EndBufPtr)) {
+    SmallVector<char, 0> Bitcode;
+    if (std::error_code EC =
+            uncompressBitcode(MemBuf->getMemBufferRef(), Bitcode))
+      return Error("Invalid compressed bitcode: " + EC.message());
+    MemBuf = MemoryBuffer::getMemBufferCopy(
+        StringRef(Bitcode.data(), Bitcode.size()), Path);
+    BufPtr = (const unsigned char *)MemBuf->getBufferStart();
+    EndBufPtr = BufPtr + MemBuf->getBufferSize();
+  }
+
   // If we have a wrapper header, parse it and ignore the non-bc file contents.
   // The magic number is 0x0B17C0DE stored in little endian.
   if (isBitcodeWrapper(BufPtr, EndBufPtr))
@@ -174,7 +174,8 @@ int main(int argc, char **argv) {
 
   std::error_code EC;
   std::unique_ptr<tool_output_file> Out(
-      new tool_output_file(OutputFilename, EC, sys::fs::F_None));
+      new tool_output_file(OutputFilename, EC, sys::fs::F_None,
+                           /*AllowMapping=*/true));
   if (EC) {
     errs() << EC.message() << '\n';
     return 1;
@@ -186,7 +187,7 @@ int main(int argc, char **argv) {
 
   // All that llvm-dis does is write the assembly to a file.
   if (!DontPrint)
-    M->print(Out->os(), Annotator.get());
+    M->print(Out->stream(), Annotator.get());
 
   // Declare success.
   Out->keep();
@@ -23,6 +23,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -57,16 +58,28 @@ static cl::opt<bool>
 SuppressWarnings("suppress-warnings", cl::desc("Suppress all linking warnings"),
                  cl::init(false));
 
+static cl::opt<bool>
+Parallel("parallel",
+         cl::desc("Load and link the inputs on several threads"));
+
+// Held while writing messages, which come from several threads with -parallel.
+static ManagedStatic<sys::Mutex> OutputLock;
+
 // Read the specified bitcode file in and return it. This routine searches the
 // link path for the specified file to try to find it...
 //
 static std::unique_ptr<Module>
 loadFile(const char *argv0, const std::string &FN, LLVMContext &Context) {
   SMDiagnostic Err;
-  if (Verbose) errs() << "Loading '" << FN << "'\n";
+  if (Verbose) {
+    sys::ScopedLock Guard(*OutputLock);
+    errs() << "Loading '" << FN << "'\n";
+  }
   std::unique_ptr<Module> Result = getLazyIRFileModule(FN, Err, Context);
-  if (!Result)
+  if (!Result) {
+    sys::ScopedLock Guard(*OutputLock);
     Err.print(argv0, errs());
+  }
 
   return Result;
 }
@@ -104,17 +117,32 @@ int main(int argc, char **argv) {
   auto Composite = make_unique<Module>("llvm-link", Context);
   Linker L(Composite.get(), diagnosticHandler);
 
-  for (unsigned i = 0; i < InputFilenames.size(); ++i) {
-    std::unique_ptr<Module> M = loadFile(argv[0], InputFilenames[i], Context);
-    if (!M.get()) {
-      errs() << argv[0] << ": error loading file '" <<InputFilenames[i]<< "'\n";
+  if (Parallel) {
+    auto Load = [&](unsigned i, LLVMContext &Ctx) -> std::unique_ptr<Module> {
+      std::unique_ptr<Module> M = loadFile(argv[0], InputFilenames[i], Ctx);
+      if (!M.get()) {
+        sys::ScopedLock Guard(*OutputLock);
+        errs() << argv[0] << ": error loading file '" << InputFilenames[i]
+               << "'\n";
+      }
+      return M;
+    };
+    if (L.linkInModules(InputFilenames.size(), Load))
       return 1;
+  } else {
+    for (unsigned i = 0; i < InputFilenames.size(); ++i) {
+      std::unique_ptr<Module> M = loadFile(argv[0], InputFilenames[i], Context);
+      if (!M.get()) {
+        errs() << argv[0] << ": error loading file '" << InputFilenames[i]
+               << "'\n";
+        return 1;
+      }
+
+      if (Verbose) errs() << "Linking in '" << InputFilenames[i] << "'\n";
+
+      if (L.linkInModule(M.get()))
+        return 1;
     }
-
-    if (Verbose) errs() << "Linking in '" << InputFilenames[i] << "'\n";
-
-    if (L.linkInModule(M.get()))
-      return 1;
   }
 
   if (DumpAsm) errs() << "Here's the assembly:\n" << *Composite;
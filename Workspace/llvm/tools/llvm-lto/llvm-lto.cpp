@@ -65,6 +65,17 @@ DSOSymbols("dso-symbol",
   cl::desc("Symbol to put in the symtab in the resulting dso"),
   cl::ZeroOrMore);
 
+static cl::opt<unsigned>
+Partitions("partitions", cl::init(1),
+  cl::desc("Split the program into this many partitions, each compiled into "
+           "an object file of its own (named <o>.0, <o>.1, ... with -o)"));
+
+static cl::opt<std::string>
+CacheDir("cache-dir", cl::init(""),
+  cl::desc("Reuse the object files of partitions that have not changed since "
+           "an earlier run with the same cache directory"),
+  cl::value_desc("directory"));
+
 static cl::opt<bool> ListSymbolsOnly(
     "list-symbols-only", cl::init(false),
     cl::desc("Instead of running LTO, list the symbols in each IR file"));
@@ -177,6 +188,8 @@ int main(int argc, char **argv) {
 
   CodeGen.setDebugInfo(LTO_DEBUG_MODEL_DWARF);
   CodeGen.setTargetOptions(Options);
+  CodeGen.setPartitions(Partitions);
+  CodeGen.setCacheDir(CacheDir);
 
   llvm::StringSet<llvm::MallocAllocator> DSOSymbolsSet;
   for (unsigned i = 0; i < DSOSymbols.size(); ++i)
@@ -227,7 +240,21 @@ int main(int argc, char **argv) {
   if (!attrs.empty())
     CodeGen.setAttr(attrs.c_str());
 
-  if (!OutputFilename.empty()) {
+  if (Partitions > 1 || !CacheDir.empty()) {
+    std::string ErrorInfo;
+    std::vector<std::string> OutputNames;
+    if (!CodeGen.compile_to_files(OutputNames, OutputFilename, DisableOpt,
+                                  DisableInline, DisableGVNLoadPRE,
+                                  DisableLTOVectorization, ErrorInfo)) {
+      errs() << argv[0]
+             << ": error compiling the code: " << ErrorInfo << "\n";
+      return 1;
+    }
+
+    if (OutputFilename.empty())
+      for (const std::string &Name : OutputNames)
+        outs() << "Wrote native object file '" << Name << "'\n";
+  } else if (!OutputFilename.empty()) {
     size_t len = 0;
     std::string ErrorInfo;
     const void *Code =
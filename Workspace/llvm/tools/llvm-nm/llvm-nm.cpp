@@ -16,6 +16,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalAlias.h"
 #include "llvm/IR/GlobalVariable.h"
@@ -538,7 +539,7 @@ static void darwinPrintStab(MachOObjectFile *MachO, SymbolListT::iterator I) {
   outs() << Str;
 }
 
-static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
+static void sortAndPrintSymbolList(SymbolicFile *Obj, bool printName,
                                    std::string ArchiveName,
                                    std::string ArchitectureName) {
   if (!NoSort) {
@@ -563,7 +564,9 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
   }
 
   const char *printBlanks, *printFormat;
-  if (isSymbolList64Bit(Obj)) {
+  // Bitcode symbol tables are listed without an object file.
+  MachOObjectFile *MachO = dyn_cast_or_null<MachOObjectFile>(Obj);
+  if (Obj && isSymbolList64Bit(*Obj)) {
     printBlanks = "                ";
     printFormat = "%016" PRIx64;
   } else {
@@ -586,7 +589,7 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
         outs() << ArchiveName << ":";
       outs() << CurrentFilename << ": ";
     }
-    if (JustSymbolName || (UndefinedOnly && isa<MachOObjectFile>(Obj))) {
+    if (JustSymbolName || (UndefinedOnly && MachO)) {
       outs() << I->Name << "\n";
       continue;
     }
@@ -610,7 +613,6 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
     // nm(1) -m output or hex, else if OutputFormat is darwin or we are
     // printing Mach-O symbols in hex and not a Mach-O object fall back to
     // OutputFormat bsd (see below).
-    MachOObjectFile *MachO = dyn_cast<MachOObjectFile>(&Obj);
     if ((OutputFormat == darwin || FormatMachOasHex) && MachO) {
       darwinPrintSymbol(MachO, I, SymbolAddrStr, printBlanks);
     } else if (OutputFormat == posix) {
@@ -964,7 +966,64 @@ static void dumpSymbolNamesFromObject(SymbolicFile &Obj, bool printName,
   }
 
   CurrentFilename = Obj.getFileName();
-  sortAndPrintSymbolList(Obj, printName, ArchiveName, ArchitectureName);
+  sortAndPrintSymbolList(&Obj, printName, ArchiveName, ArchitectureName);
+}
+
+// readBitcodeSymbols() reads the symbol table of Buffer if it is a bitcode
+// file that has one, so that its symbols can be listed without reading its
+// module.  It returns false if they can't be listed that way.
+static bool readBitcodeSymbols(MemoryBufferRef Buffer, LLVMContext &Context,
+                               BitcodeSymbolTable &Table) {
+  if (NoLLVMBitcode || DynamicSyms ||
+      sys::fs::identify_magic(Buffer.getBuffer()) !=
+          sys::fs::file_magic::bitcode)
+    return false;
+  ErrorOr<BitcodeSymbolTable> TableOrErr =
+      readBitcodeSymbolTable(Buffer, Context);
+  if (!TableOrErr)
+    return false;
+  Table = std::move(TableOrErr.get());
+  return true;
+}
+
+// getNMTypeChar() for the symbol of an IRObjectFile that Sym describes.
+static char getBitcodeSymbolNMTypeChar(const BitcodeSymbol &Sym,
+                                       uint32_t Symflags) {
+  if (Symflags & object::SymbolRef::SF_Weak)
+    return (Symflags & object::SymbolRef::SF_Undefined) ? 'w' : 'W';
+  if (Symflags & object::SymbolRef::SF_Undefined)
+    return 'U';
+  if (Symflags & object::SymbolRef::SF_Common)
+    return 'C';
+  char Ret = Sym.HasFunctionType ? 't' : 'd';
+  if (Symflags & object::SymbolRef::SF_Global)
+    Ret = toupper(Ret);
+  return Ret;
+}
+
+// dumpSymbolNamesFromBitcode() lists the symbols of a bitcode file from its
+// symbol table the way dumpSymbolNamesFromObject() lists the symbols of the
+// IRObjectFile for it.
+static void
+dumpSymbolNamesFromBitcode(const BitcodeSymbolTable &Table, StringRef FileName,
+                           bool printName,
+                           std::string ArchiveName = std::string()) {
+  for (const BitcodeSymbol &Sym : Table.Symbols) {
+    uint32_t SymFlags = IRObjectFile::getBitcodeSymbolFlags(Sym);
+    if (!DebugSyms && (SymFlags & SymbolRef::SF_FormatSpecific))
+      continue;
+    if (WithoutAliases && Sym.Kind == BitcodeSymbol::Alias)
+      continue;
+    NMSymbol S;
+    S.Size = UnknownAddressOrSize;
+    S.Address = UnknownAddressOrSize;
+    S.TypeChar = getBitcodeSymbolNMTypeChar(Sym, SymFlags);
+    S.Name = Sym.Name;
+    SymbolList.push_back(S);
+  }
+
+  CurrentFilename = FileName;
+  sortAndPrintSymbolList(nullptr, printName, ArchiveName, std::string());
 }
 
 // checkMachOAndArchFlags() checks to see if the SymbolicFile is a Mach-O file
@@ -1008,6 +1067,14 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
     return;
 
   LLVMContext &Context = getGlobalContext();
+  BitcodeSymbolTable Table;
+  if (readBitcodeSymbols(BufferOrErr.get()->getMemBufferRef(), Context,
+                         Table)) {
+    dumpSymbolNamesFromBitcode(
+        Table, BufferOrErr.get()->getBufferIdentifier(), true);
+    return;
+  }
+
   ErrorOr<std::unique_ptr<Binary>> BinaryOrErr = createBinary(
       BufferOrErr.get()->getMemBufferRef(), NoLLVMBitcode ? nullptr : &Context);
   if (error(BinaryOrErr.getError(), Filename))
@@ -1036,6 +1103,15 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
 
     for (Archive::child_iterator I = A->child_begin(), E = A->child_end();
          I != E; ++I) {
+      ErrorOr<MemoryBufferRef> MemberOrErr = I->getMemoryBufferRef();
+      if (MemberOrErr && readBitcodeSymbols(*MemberOrErr, Context, Table)) {
+        if (!PrintFileName)
+          outs() << "\n" << MemberOrErr->getBufferIdentifier() << ":\n";
+        dumpSymbolNamesFromBitcode(Table, MemberOrErr->getBufferIdentifier(),
+                                   false, Filename);
+        continue;
+      }
+
       ErrorOr<std::unique_ptr<Binary>> ChildOrErr = I->getAsBinary(&Context);
       if (ChildOrErr.getError())
         continue;
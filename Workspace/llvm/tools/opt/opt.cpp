@@ -361,7 +361,8 @@ int main(int argc, char **argv) {
       OutputFilename = "-";
 
     std::error_code EC;
-    Out.reset(new tool_output_file(OutputFilename, EC, sys::fs::F_None));
+    Out.reset(new tool_output_file(OutputFilename, EC, sys::fs::F_None,
+                                   /*AllowMapping=*/true));
     if (EC) {
       errs() << EC.message() << '\n';
       return 1;
@@ -372,7 +373,7 @@ int main(int argc, char **argv) {
   // console, print out a warning message and refuse to do it.  We don't
   // impress anyone by spewing tons of binary goo to a terminal.
   if (!Force && !NoOutput && !AnalyzeOnly && !OutputAssembly)
-    if (CheckBitcodeOutputToConsole(Out->os(), !Quiet))
+    if (CheckBitcodeOutputToConsole(Out->stream(), !Quiet))
       NoOutput = true;
 
   if (PassPipeline.getNumOccurrences() > 0) {
@@ -452,7 +453,7 @@ int main(int argc, char **argv) {
         return 1;
       }
     }
-    Passes.add(createBreakpointPrinter(Out->os()));
+    Passes.add(createBreakpointPrinter(Out->stream()));
     NoOutput = true;
   }
 
@@ -509,22 +510,22 @@ int main(int argc, char **argv) {
       if (AnalyzeOnly) {
         switch (Kind) {
         case PT_BasicBlock:
-          Passes.add(createBasicBlockPassPrinter(PassInf, Out->os(), Quiet));
+          Passes.add(createBasicBlockPassPrinter(PassInf, Out->stream(), Quiet));
           break;
         case PT_Region:
-          Passes.add(createRegionPassPrinter(PassInf, Out->os(), Quiet));
+          Passes.add(createRegionPassPrinter(PassInf, Out->stream(), Quiet));
           break;
         case PT_Loop:
-          Passes.add(createLoopPassPrinter(PassInf, Out->os(), Quiet));
+          Passes.add(createLoopPassPrinter(PassInf, Out->stream(), Quiet));
           break;
         case PT_Function:
-          Passes.add(createFunctionPassPrinter(PassInf, Out->os(), Quiet));
+          Passes.add(createFunctionPassPrinter(PassInf, Out->stream(), Quiet));
           break;
         case PT_CallGraphSCC:
-          Passes.add(createCallGraphPassPrinter(PassInf, Out->os(), Quiet));
+          Passes.add(createCallGraphPassPrinter(PassInf, Out->stream(), Quiet));
           break;
         default:
-          Passes.add(createModulePassPrinter(PassInf, Out->os(), Quiet));
+          Passes.add(createModulePassPrinter(PassInf, Out->stream(), Quiet));
           break;
         }
       }
@@ -570,9 +571,9 @@ int main(int argc, char **argv) {
   // Write bitcode or assembly to the output as the last step...
   if (!NoOutput && !AnalyzeOnly) {
     if (OutputAssembly)
-      Passes.add(createPrintModulePass(Out->os()));
+      Passes.add(createPrintModulePass(Out->stream()));
     else
-      Passes.add(createBitcodeWriterPass(Out->os()));
+      Passes.add(createBitcodeWriterPass(Out->stream()));
   }
 
   // Before executing passes, print the final values of the LLVM options.
@@ -0,0 +1,75 @@
+//===- llvm/unittest/ADT/StatisticTest.cpp - Statistic unit tests ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#if LLVM_ENABLE_THREADS
+#include <thread>
+#endif
+using namespace llvm;
+
+#define DEBUG_TYPE "unittest"
+STATISTIC(Counter, "Counts things");
+STATISTIC(Counter2, "Counts other things");
+
+namespace {
+
+#if !defined(NDEBUG) || defined(LLVM_ENABLE_STATS)
+TEST(StatisticTest, Count) {
+  EnableStatistics();
+
+  Counter = 0;
+  EXPECT_EQ(0u, Counter);
+  Counter++;
+  ++Counter;
+  EXPECT_EQ(2u, Counter);
+  Counter += 5;
+  Counter -= 1;
+  EXPECT_EQ(6u, Counter);
+  Counter *= 3;
+  EXPECT_EQ(18u, Counter);
+  Counter /= 2;
+  Counter--;
+  EXPECT_EQ(8u, Counter);
+
+  Counter2 = 5;
+  bool Found = false;
+  for (const StatisticSnapshot &S : GetStatistics()) {
+    if (S.Name == StringRef("unittest") && S.VarName == StringRef("Counter2")) {
+      EXPECT_EQ(5u, S.Value);
+      Found = true;
+    }
+  }
+  EXPECT_TRUE(Found);
+
+  std::string JSON;
+  raw_string_ostream OS(JSON);
+  PrintStatisticsJSON(OS);
+  EXPECT_NE(std::string::npos, OS.str().find("\"unittest.Counter\": 8"));
+  EXPECT_NE(std::string::npos, OS.str().find("\"unittest.Counter2\": 5"));
+}
+
+#if LLVM_ENABLE_THREADS
+TEST(StatisticTest, ConcurrentUpdates) {
+  Counter = 0;
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T != 8; ++T)
+    Threads.push_back(std::thread([] {
+      for (unsigned I = 0; I != 100000; ++I)
+        ++Counter;
+    }));
+  for (std::thread &T : Threads)
+    T.join();
+  EXPECT_EQ(800000u, Counter);
+}
+#endif
+#endif
+
+} // end anonymous namespace
@@ -304,6 +304,11 @@ TEST(StringRefTest, Find) {
   EXPECT_EQ(28U, LongStr.find("foo"));
   EXPECT_EQ(12U, LongStr.find("hell", 2));
   EXPECT_EQ(0U, LongStr.find(""));
+  EXPECT_EQ(StringRef::npos, Str.find('l', 10));
+  EXPECT_EQ(5U, Str.find("", 5));
+  EXPECT_EQ(StringRef::npos, Str.find("", 6));
+  EXPECT_EQ(StringRef::npos, StringRef().find('a'));
+  EXPECT_EQ(StringRef::npos, LongStr.find("bar hellox"));
 
   EXPECT_EQ(3U, Str.rfind('l'));
   EXPECT_EQ(StringRef::npos, Str.rfind('z'));
@@ -334,6 +339,9 @@ TEST(StringRefTest, Count) {
   EXPECT_EQ(1U, Str.count("hello"));
   EXPECT_EQ(1U, Str.count("ello"));
   EXPECT_EQ(0U, Str.count("zz"));
+  EXPECT_EQ(3U, StringRef("aaaa").count("aa"));
+  EXPECT_EQ(3U, StringRef("abababab").count("abab"));
+  EXPECT_EQ(0U, StringRef().count("a"));
 }
 
 TEST(StringRefTest, EditDistance) {
@@ -341,6 +349,18 @@ TEST(StringRefTest, EditDistance) {
   EXPECT_EQ(2U, Str.edit_distance("hill"));
 }
 
+TEST(StringRefTest, HashString) {
+  // HashString must keep computing the Bernstein hash, one byte at a time.
+  std::string S;
+  for (unsigned Len = 0; Len != 40; ++Len) {
+    unsigned Expected = 7;
+    for (char C : S)
+      Expected = Expected * 33 + (unsigned char)C;
+    EXPECT_EQ(Expected, HashString(S, 7));
+    S.push_back(char(0x80 + Len * 5));
+  }
+}
+
 TEST(StringRefTest, Misc) {
   std::string Storage;
   raw_string_ostream OS(Storage);
@@ -0,0 +1,127 @@
+//===- llvm/unittest/ADT/SwissDenseMapTest.cpp - SwissDenseMap tests ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SwissDenseMap.h"
+#include "gtest/gtest.h"
+#include <map>
+#include <string>
+using namespace llvm;
+
+namespace {
+
+TEST(SwissDenseMapTest, EmptyMap) {
+  SwissDenseMap<unsigned, unsigned> M;
+  EXPECT_TRUE(M.empty());
+  EXPECT_EQ(0u, M.size());
+  EXPECT_TRUE(M.begin() == M.end());
+  EXPECT_EQ(0u, M.count(1));
+  EXPECT_TRUE(M.find(1) == M.end());
+  EXPECT_EQ(0u, M.lookup(1));
+  EXPECT_FALSE(M.erase(1));
+}
+
+TEST(SwissDenseMapTest, InsertFindErase) {
+  SwissDenseMap<unsigned, unsigned> M;
+  EXPECT_TRUE(M.insert(std::make_pair(1u, 2u)).second);
+  EXPECT_FALSE(M.insert(std::make_pair(1u, 3u)).second);
+  EXPECT_EQ(1u, M.size());
+  EXPECT_EQ(2u, M.lookup(1));
+  EXPECT_EQ(1u, M.find(1)->first);
+  EXPECT_EQ(2u, M.find(1)->second);
+
+  M[5] = 6;
+  EXPECT_EQ(6u, M.lookup(5));
+  EXPECT_EQ(2u, M.size());
+
+  EXPECT_TRUE(M.erase(1));
+  EXPECT_EQ(0u, M.count(1));
+  EXPECT_EQ(1u, M.size());
+  M.erase(M.find(5));
+  EXPECT_TRUE(M.empty());
+}
+
+// The keys DenseMap reserves for empty and erased buckets are ordinary keys.
+TEST(SwissDenseMapTest, ReservedKeys) {
+  SwissDenseMap<unsigned, unsigned> M;
+  M[DenseMapInfo<unsigned>::getEmptyKey()] = 1;
+  M[DenseMapInfo<unsigned>::getTombstoneKey()] = 2;
+  EXPECT_EQ(1u, M.lookup(DenseMapInfo<unsigned>::getEmptyKey()));
+  EXPECT_EQ(2u, M.lookup(DenseMapInfo<unsigned>::getTombstoneKey()));
+}
+
+// Compare against std::map over many inserts and erases, so that groups fill
+// up, erased buckets get reused, and the table grows and rehashes.
+TEST(SwissDenseMapTest, Stress) {
+  SwissDenseMap<int *, unsigned> M;
+  std::map<int *, unsigned> Ref;
+  static int Storage[4096];
+  unsigned Seed = 1;
+  for (unsigned i = 0; i != 100000; ++i) {
+    Seed = Seed * 1103515245 + 12345;
+    int *Key = &Storage[(Seed >> 8) % 4096];
+    if ((Seed >> 4) % 3 == 0) {
+      EXPECT_EQ(Ref.erase(Key) != 0, M.erase(Key));
+    } else {
+      M[Key] = i;
+      Ref[Key] = i;
+    }
+    EXPECT_EQ(Ref.size(), M.size());
+  }
+
+  unsigned Visited = 0;
+  for (const auto &KV : M) {
+    ++Visited;
+    EXPECT_EQ(Ref[KV.first], KV.second);
+  }
+  EXPECT_EQ(Ref.size(), Visited);
+  for (int &I : Storage)
+    EXPECT_EQ(Ref.count(&I), M.count(&I));
+}
+
+TEST(SwissDenseMapTest, NonTrivialTypes) {
+  SwissDenseMap<unsigned, std::string> M(4);
+  for (unsigned i = 0; i != 100; ++i)
+    M[i] = std::string(i, 'x');
+  for (unsigned i = 0; i != 100; i += 2)
+    M.erase(i);
+
+  SwissDenseMap<unsigned, std::string> Copy(M);
+  SwissDenseMap<unsigned, std::string> Moved(std::move(M));
+  EXPECT_TRUE(M.empty());
+  EXPECT_EQ(50u, Copy.size());
+  EXPECT_EQ(50u, Moved.size());
+  for (unsigned i = 1; i < 100; i += 2) {
+    EXPECT_EQ(std::string(i, 'x'), Copy.lookup(i));
+    EXPECT_EQ(std::string(i, 'x'), Moved.lookup(i));
+  }
+
+  Copy.clear();
+  EXPECT_TRUE(Copy.empty());
+  EXPECT_TRUE(Copy.begin() == Copy.end());
+  Copy = Moved;
+  EXPECT_EQ(50u, Copy.size());
+}
+
+TEST(SwissDenseMapTest, ConstIterator) {
+  SwissDenseMap<unsigned, unsigned> M;
+  M.resize(100);
+  for (unsigned i = 0; i != 100; ++i)
+    M[i] = i * 2;
+  const SwissDenseMap<unsigned, unsigned> &CM = M;
+  unsigned Sum = 0;
+  for (SwissDenseMap<unsigned, unsigned>::const_iterator I = CM.begin(),
+                                                         E = CM.end();
+       I != E; ++I)
+    Sum += I->second;
+  EXPECT_EQ(9900u, Sum);
+  EXPECT_TRUE(CM.find(7) == M.find(7));
+  EXPECT_EQ(14u, CM.find(7)->second);
+}
+
+} // end anonymous namespace
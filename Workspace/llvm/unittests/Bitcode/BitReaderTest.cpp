@@ -47,14 +47,15 @@ static void writeModuleToBuffer(std::unique_ptr<Module> Mod,
   WriteBitcodeToFile(Mod.get(), OS);
 }
 
-static std::unique_ptr<Module> getLazyModuleFromAssembly(LLVMContext &Context,
-                                                         SmallString<1024> &Mem,
-                                                         const char *Assembly) {
+static std::unique_ptr<Module>
+getLazyModuleFromAssembly(LLVMContext &Context, SmallString<1024> &Mem,
+                          const char *Assembly,
+                          bool ShouldLazyLoadMetadata = false) {
   writeModuleToBuffer(parseAssembly(Assembly), Mem);
   std::unique_ptr<MemoryBuffer> Buffer =
       MemoryBuffer::getMemBuffer(Mem.str(), "test", false);
-  ErrorOr<Module *> ModuleOrErr =
-      getLazyBitcodeModule(std::move(Buffer), Context);
+  ErrorOr<Module *> ModuleOrErr = getLazyBitcodeModule(
+      std::move(Buffer), Context, nullptr, ShouldLazyLoadMetadata);
   return std::unique_ptr<Module>(ModuleOrErr.get());
 }
 
@@ -164,4 +165,68 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddrInFunctionAfter) {
   EXPECT_FALSE(verifyModule(*M, &dbgs()));
 }
 
+static const char *const MetadataAssembly =
+    "declare void @llvm.foo(metadata)\n"
+    "define void @func(i32 %x) {\n"
+    "  call void @llvm.foo(metadata i32 %x), !attached !0\n"
+    "  ret void\n"
+    "}\n"
+    "!named = !{!0}\n"
+    "!0 = !{!1}\n"
+    "!1 = !{!\"node\"}\n";
+
+TEST(BitReaderTest, MaterializeMetadataAfterFunction) {
+  SmallString<1024> Mem;
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M =
+      getLazyModuleFromAssembly(Context, Mem, MetadataAssembly, true);
+  EXPECT_FALSE(M->getNamedMetadata("named"));
+
+  // The function reads without the module's metadata, and its own
+  // function-local metadata still refers to the right value.
+  Function *F = M->getFunction("func");
+  EXPECT_FALSE(F->materialize());
+  CallInst *Call = cast<CallInst>(F->front().begin());
+  auto *Arg = cast<MetadataAsValue>(Call->getArgOperand(0));
+  EXPECT_EQ(F->arg_begin(), cast<LocalAsMetadata>(Arg->getMetadata())
+                                ->getValue());
+  EXPECT_FALSE(M->getNamedMetadata("named"));
+
+  // Reading the metadata fills in the attachment.
+  EXPECT_FALSE(M->materializeMetadata());
+  NamedMDNode *Named = M->getNamedMetadata("named");
+  ASSERT_TRUE(Named);
+  ASSERT_EQ(1U, Named->getNumOperands());
+  EXPECT_EQ(Named->getOperand(0), Call->getMetadata("attached"));
+  EXPECT_EQ(1U, Named->getOperand(0)->getNumOperands());
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+}
+
+TEST(BitReaderTest, DestroyWithoutMaterializingMetadata) {
+  SmallString<1024> Mem;
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M =
+      getLazyModuleFromAssembly(Context, Mem, MetadataAssembly, true);
+  EXPECT_FALSE(M->getFunction("func")->materialize());
+  EXPECT_TRUE(M->getFunction("func")->front().front().getMetadata("attached"));
+
+  // The placeholder for the attachment is freed with the module.
+  M.reset();
+}
+
+TEST(BitReaderTest, MaterializeModuleReadsMetadata) {
+  SmallString<1024> Mem;
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M =
+      getLazyModuleFromAssembly(Context, Mem, MetadataAssembly, true);
+  EXPECT_FALSE(M->materializeAll());
+  ASSERT_TRUE(M->getNamedMetadata("named"));
+  EXPECT_EQ(M->getNamedMetadata("named")->getOperand(0),
+            M->getFunction("func")->front().front().getMetadata("attached"));
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+}
+
 } // end namespace
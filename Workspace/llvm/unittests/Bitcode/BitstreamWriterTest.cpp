@@ -0,0 +1,119 @@
+//===- BitstreamWriterTest.cpp - Tests for BitstreamWriter ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Bitcode/BitstreamWriter.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitstreamReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Emit a few nested blocks with records, so that there are block sizes to
+/// backpatch after the start of the block has been flushed.
+void writeBlocks(BitstreamWriter &Stream) {
+  SmallVector<unsigned, 8> Vals;
+  Stream.EnterSubblock(8, 3);
+  for (unsigned i = 0; i != 4; ++i) {
+    Stream.EnterSubblock(9, 4);
+    for (unsigned j = 0; j != 10; ++j) {
+      Vals.assign(j, i * 1000 + j);
+      Stream.EmitRecord(1, Vals);
+    }
+    Stream.ExitBlock();
+  }
+  Stream.ExitBlock();
+}
+
+TEST(BitstreamWriterTest, StreamToFile) {
+  SmallVector<char, 0> Expected;
+  {
+    BitstreamWriter Stream(Expected);
+    writeBlocks(Stream);
+  }
+
+  int FD;
+  SmallString<64> Path;
+  ASSERT_FALSE(sys::fs::createTemporaryFile("BitstreamWriterTest", "bc", FD,
+                                            Path));
+  {
+    raw_fd_ostream OS(FD, true);
+    ASSERT_TRUE(OS.supportsPwrite());
+    SmallVector<char, 0> Buffer;
+    {
+      BitstreamWriter Stream(Buffer, &OS, 4);
+      writeBlocks(Stream);
+    }
+    // Only the end of the stream is left for the caller to write.
+    EXPECT_LT(Buffer.size(), Expected.size());
+    OS.write(Buffer.data(), Buffer.size());
+  }
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> File =
+      MemoryBuffer::getFile(Path.str());
+  ASSERT_TRUE(bool(File));
+  EXPECT_EQ(StringRef(Expected.data(), Expected.size()),
+            (*File)->getBuffer());
+  sys::fs::remove(Path.str());
+}
+
+TEST(BitstreamWriterTest, DefaultAbbrev) {
+  SmallVector<char, 0> Buffer;
+  {
+    BitstreamWriter Stream(Buffer);
+    Stream.EnterBlockInfoBlock(2);
+    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(1));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 4));
+    unsigned AbbrevID = Stream.EmitBlockInfoAbbrev(9, Abbv);
+    Stream.SetDefaultAbbrev(9, 1, AbbrevID);
+    Stream.ExitBlock();
+
+    SmallVector<unsigned, 1> Vals;
+    Stream.EnterSubblock(9, 3);
+    Vals.push_back(5);
+    Stream.EmitRecord(1, Vals); // Fits the abbreviation.
+    Vals[0] = 500;
+    Stream.EmitRecord(1, Vals); // Doesn't.
+    Stream.ExitBlock();
+  }
+
+  BitstreamReader Reader((const unsigned char *)Buffer.begin(),
+                         (const unsigned char *)Buffer.end());
+  BitstreamCursor Cursor(Reader);
+  BitstreamEntry Entry = Cursor.advance();
+  ASSERT_EQ(BitstreamEntry::SubBlock, Entry.Kind);
+  ASSERT_EQ(unsigned(bitc::BLOCKINFO_BLOCK_ID), Entry.ID);
+  ASSERT_FALSE(Cursor.ReadBlockInfoBlock());
+  Entry = Cursor.advance();
+  ASSERT_EQ(BitstreamEntry::SubBlock, Entry.Kind);
+  ASSERT_EQ(9U, Entry.ID);
+  ASSERT_FALSE(Cursor.EnterSubBlock(9));
+
+  SmallVector<uint64_t, 1> Record;
+  Entry = Cursor.advance();
+  ASSERT_EQ(BitstreamEntry::Record, Entry.Kind);
+  EXPECT_EQ(unsigned(bitc::FIRST_APPLICATION_ABBREV), Entry.ID);
+  EXPECT_EQ(1U, Cursor.readRecord(Entry.ID, Record));
+  ASSERT_EQ(1U, Record.size());
+  EXPECT_EQ(5U, Record[0]);
+
+  Record.clear();
+  Entry = Cursor.advance();
+  ASSERT_EQ(BitstreamEntry::Record, Entry.Kind);
+  EXPECT_EQ(unsigned(bitc::UNABBREV_RECORD), Entry.ID);
+  EXPECT_EQ(1U, Cursor.readRecord(Entry.ID, Record));
+  ASSERT_EQ(1U, Record.size());
+  EXPECT_EQ(500U, Record[0]);
+}
+
+} // end anonymous namespace
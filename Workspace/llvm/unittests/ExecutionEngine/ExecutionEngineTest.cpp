@@ -7,15 +7,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ExecutionEngine/Interpreter.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
+#include <cstring>
 
 using namespace llvm;
 
@@ -165,4 +171,64 @@ TEST_F(ExecutionEngineTest, LookupwithDemangledName) {
             RTDyldMemoryManager::getSymbolAddressInProcess("_x"));
 }
 
+TEST_F(ExecutionEngineTest, GlobalsSnapshotRejectsCorruptFiles) {
+  Type *Int32Ty = Type::getInt32Ty(getGlobalContext());
+  GlobalVariable *G = new GlobalVariable(
+      *M, Int32Ty, false, GlobalValue::ExternalLinkage,
+      ConstantInt::get(Int32Ty, 7), "g");
+  GlobalVariable *P = new GlobalVariable(
+      *M, G->getType(), false, GlobalValue::ExternalLinkage, G, "p");
+  int32_t *GMem = (int32_t *)Engine->getPointerToGlobal(G);
+  int32_t **PMem = (int32_t **)Engine->getPointerToGlobal(P);
+  ASSERT_EQ(GMem, *PMem);
+
+  SmallString<128> Path;
+  ASSERT_FALSE(sys::fs::createTemporaryFile("snapshot", "bin", Path));
+  std::string ErrMsg;
+  ASSERT_FALSE(Engine->saveGlobalsSnapshot(Path, ErrMsg)) << ErrMsg;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf =
+      MemoryBuffer::getFile(Path.str());
+  ASSERT_FALSE(Buf.getError());
+  const std::string Good = Buf.get()->getBuffer();
+
+  // The header, then @g with no relocation, then @p with one relocation.
+  const size_t NumSavedOffset = 8 + 4 + 16;
+  const size_t RelocOffset = NumSavedOffset + 4 + (4 + 8 + 4 + 8) +
+                             (4 + 8 + sizeof(void *) + 8);
+  const size_t AddendOffset = RelocOffset + 8 + 4 + 4;
+  ASSERT_EQ(AddendOffset + 8, Good.size());
+
+  auto Restore = [&](const std::string &Data) {
+    {
+      std::error_code EC;
+      raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+      OS << Data;
+    }
+    *GMem = 0;
+    *PMem = nullptr;
+    return Engine->restoreGlobalsSnapshot(Path, ErrMsg);
+  };
+
+  EXPECT_FALSE(Restore(Good)) << ErrMsg;
+  EXPECT_EQ(7, *GMem);
+  EXPECT_EQ(GMem, *PMem);
+
+  // A huge count of globals must not be trusted.
+  std::string Bad = Good;
+  uint32_t NumSaved = ~0U;
+  memcpy(&Bad[NumSavedOffset], &NumSaved, sizeof(NumSaved));
+  EXPECT_TRUE(Restore(Bad));
+  EXPECT_EQ(0, *GMem);
+
+  // Neither must a pointer far past the end of @g.
+  Bad = Good;
+  uint64_t Addend = 1 << 20;
+  memcpy(&Bad[AddendOffset], &Addend, sizeof(Addend));
+  EXPECT_TRUE(Restore(Bad));
+  EXPECT_EQ(0, *GMem);
+  EXPECT_EQ(nullptr, *PMem);
+
+  sys::fs::remove(Path.str());
+}
+
 }
@@ -166,5 +166,74 @@ TEST(MCJITMemoryManagerTest, ManyVariedAllocations) {
   }
 }
 
+TEST(MCJITMemoryManagerTest, ReuseAfterFinalize) {
+  std::unique_ptr<SectionMemoryManager> MemMgr(
+      new SectionMemoryManager(SectionMemoryManager::DefaultSlabSize));
+
+  // Load a first "object" and finalize it.
+  uint8_t *code1 = MemMgr->allocateCodeSection(256, 0, 1, "");
+  uint8_t *data1 = MemMgr->allocateDataSection(256, 0, 2, "", true);
+  EXPECT_NE((uint8_t*)nullptr, code1);
+  EXPECT_NE((uint8_t*)nullptr, data1);
+  for (unsigned i = 0; i < 256; ++i) {
+    code1[i] = 1;
+    data1[i] = 2;
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+
+  // Sections of a second object must be writable, and come from the unused
+  // part of the first slab rather than from a new mapping.
+  uint8_t *code2 = MemMgr->allocateCodeSection(256, 0, 3, "");
+  uint8_t *data2 = MemMgr->allocateDataSection(256, 0, 4, "", true);
+  EXPECT_NE((uint8_t*)nullptr, code2);
+  EXPECT_NE((uint8_t*)nullptr, data2);
+  for (unsigned i = 0; i < 256; ++i) {
+    code2[i] = 3;
+    data2[i] = 4;
+  }
+
+  EXPECT_LT((uintptr_t)code1, (uintptr_t)code2);
+  EXPECT_GT((uintptr_t)code1 + SectionMemoryManager::DefaultSlabSize,
+            (uintptr_t)code2);
+  EXPECT_LT((uintptr_t)data1, (uintptr_t)data2);
+  EXPECT_GT((uintptr_t)data1 + SectionMemoryManager::DefaultSlabSize,
+            (uintptr_t)data2);
+
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+
+  for (unsigned i = 0; i < 256; ++i) {
+    EXPECT_EQ(1, code1[i]);
+    EXPECT_EQ(2, data1[i]);
+    EXPECT_EQ(3, code2[i]);
+    EXPECT_EQ(4, data2[i]);
+  }
+}
+
+TEST(MCJITMemoryManagerTest, HugePageAllocations) {
+  std::unique_ptr<SectionMemoryManager> MemMgr(
+      new SectionMemoryManager(SectionMemoryManager::DefaultSlabSize,
+                               /*UseHugePages=*/true));
+
+  uint8_t *code1 = MemMgr->allocateCodeSection(256, 0, 1, "");
+  uint8_t *data1 = MemMgr->allocateDataSection(256, 0, 2, "", false);
+  uint8_t *code2 = MemMgr->allocateCodeSection(0x300000, 0, 3, "");
+
+  EXPECT_NE((uint8_t*)nullptr, code1);
+  EXPECT_NE((uint8_t*)nullptr, data1);
+  EXPECT_NE((uint8_t*)nullptr, code2);
+
+  for (unsigned i = 0; i < 256; ++i) {
+    code1[i] = 1;
+    data1[i] = 2;
+  }
+  for (unsigned i = 0; i < 0x300000; ++i)
+    code2[i] = 3;
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+}
+
 } // Namespace
 
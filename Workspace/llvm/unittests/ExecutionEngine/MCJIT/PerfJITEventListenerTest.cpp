@@ -0,0 +1,118 @@
+//===- PerfJITEventListenerTest.cpp - Unit tests for the perf listener ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This test JITs a small module with a PerfJITEventListener registered and
+// checks the jitdump file it writes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/llvm-config.h"
+
+#if LLVM_USE_PERF
+
+#include "MCJITTestBase.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace llvm;
+
+namespace {
+
+class PerfJITEventListenerTest : public testing::Test, public MCJITTestBase {
+protected:
+  virtual void SetUp() { M.reset(createEmptyModule("<main>")); }
+};
+
+template <typename T> T readAt(StringRef Data, size_t Offset) {
+  T Val;
+  memcpy(&Val, Data.data() + Offset, sizeof(T));
+  return Val;
+}
+
+TEST_F(PerfJITEventListenerTest, JitDumpHasCode) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  SmallString<128> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("jitdump", Dir));
+  setenv("JITDUMPDIR", Dir.c_str(), 1);
+  std::unique_ptr<JITEventListener> Listener(
+      JITEventListener::createPerfJITEventListener());
+  unsetenv("JITDUMPDIR");
+
+  Function *F = insertAddFunction(M.get());
+  std::string Name = F->getName();
+  createJIT(std::move(M));
+  TheJIT->RegisterJITEventListener(Listener.get());
+  uint64_t Addr = TheJIT->getFunctionAddress(Name);
+  ASSERT_NE(0u, Addr);
+  TheJIT->UnregisterJITEventListener(Listener.get());
+  // Write the close record.
+  Listener.reset();
+
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, "jit-" + Twine(::getpid()) + ".dump");
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf =
+      MemoryBuffer::getFile(Path.str());
+  ASSERT_FALSE(Buf.getError());
+  StringRef Data = Buf.get()->getBuffer();
+
+  // The header starts with the magic and version, and gives its own size.
+  ASSERT_LE(40u, Data.size());
+  EXPECT_EQ(0x4A695444u, readAt<uint32_t>(Data, 0));
+  EXPECT_EQ(1u, readAt<uint32_t>(Data, 4));
+
+  // Every record starts with its kind, total size and a timestamp. The code
+  // load record follows with pid, tid, vma, code address, code size and code
+  // index, then the name and the code.
+  bool FoundCode = false, FoundClose = false;
+  for (size_t Off = readAt<uint32_t>(Data, 8); Off + 16 <= Data.size();) {
+    uint32_t Kind = readAt<uint32_t>(Data, Off);
+    uint32_t Size = readAt<uint32_t>(Data, Off + 4);
+    ASSERT_LE(16u, Size);
+    ASSERT_LE(Off + Size, Data.size());
+    StringRef Rec = Data.substr(Off, Size);
+    Off += Size;
+
+    if (Kind == 3)
+      FoundClose = true;
+    if (Kind != 0)
+      continue;
+    ASSERT_LE(56u, Rec.size());
+    StringRef RecName(Rec.data() + 56);
+    if (RecName != Name)
+      continue;
+    uint64_t CodeAddr = readAt<uint64_t>(Rec, 32);
+    uint64_t CodeSize = readAt<uint64_t>(Rec, 40);
+    EXPECT_EQ(Addr, CodeAddr);
+    ASSERT_EQ(56 + RecName.size() + 1 + CodeSize, Rec.size());
+    // The function has no relocations, so its code in the object is the code
+    // that was loaded.
+    StringRef Code = Rec.substr(56 + RecName.size() + 1);
+    EXPECT_EQ(0, memcmp(Code.data(), (const void *)Addr, CodeSize));
+    FoundCode = true;
+  }
+  EXPECT_TRUE(FoundCode);
+  EXPECT_TRUE(FoundClose);
+
+  sys::fs::remove(Path.str());
+  sys::fs::remove(Dir.str());
+  sys::fs::remove("/tmp/perf-" + Twine(::getpid()) + ".map");
+}
+
+}
+
+#endif // LLVM_USE_PERF
@@ -13,7 +13,11 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Config/llvm-config.h"
 #include "gtest/gtest.h"
+#if LLVM_ENABLE_THREADS
+#include <thread>
+#endif
 
 namespace llvm {
 namespace {
@@ -347,5 +351,42 @@ TEST(ConstantsTest, GEPReplaceWithConstant) {
   ASSERT_EQ(GEP->getOperand(0), Alias);
 }
 
+#if LLVM_ENABLE_THREADS
+// Create the same constants and types from several threads at once, and check
+// that every thread got the same uniqued objects.
+static void createUniquedValues(LLVMContext &Context,
+                                std::vector<Constant *> &Values) {
+  Type *Int32Ty = Type::getInt32Ty(Context);
+  for (unsigned I = 0; I != 1000; ++I) {
+    Values.push_back(ConstantInt::get(Int32Ty, I));
+    Values.push_back(ConstantInt::get(Type::getInt64Ty(Context), I * 977));
+    Values.push_back(ConstantFP::get(Type::getDoubleTy(Context), I + 0.5));
+    ArrayType *ArrTy = ArrayType::get(Int32Ty, I % 64 + 1);
+    Values.push_back(UndefValue::get(ArrTy));
+    Values.push_back(ConstantPointerNull::get(ArrTy->getPointerTo()));
+    uint32_t Data[] = { I, I + 1 };
+    Values.push_back(ConstantDataArray::get(Context, Data));
+  }
+}
+
+TEST(ConstantsTest, ConcurrentUniquing) {
+  LLVMContext Context;
+  Context.enableConcurrentUniquing();
+  EXPECT_TRUE(Context.isConcurrentUniquingEnabled());
+
+  const unsigned NumThreads = 4;
+  std::vector<Constant *> Values[NumThreads];
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I != NumThreads; ++I)
+    Threads.push_back(std::thread(createUniquedValues, std::ref(Context),
+                                  std::ref(Values[I])));
+  for (std::thread &T : Threads)
+    T.join();
+
+  for (unsigned I = 1; I != NumThreads; ++I)
+    EXPECT_EQ(Values[0], Values[I]);
+}
+#endif
+
 }  // end anonymous namespace
 }  // end namespace llvm
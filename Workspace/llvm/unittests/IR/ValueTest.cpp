@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -43,6 +44,53 @@ TEST(ValueTest, UsedInBasicBlock) {
   EXPECT_TRUE(F->arg_begin()->isUsedInBasicBlock(F->begin()));
 }
 
+TEST(ValueTest, BatchReplaceAllUsesWith) {
+  LLVMContext C;
+
+  const char *ModuleString =
+      "@g1 = global i32 0\n"
+      "@g2 = global i32 0\n"
+      "@g3 = global i32 0\n"
+      "@pair = global [2 x i32*] [i32* @g1, i32* @g2]\n"
+      "define i32 @f(i32 %x, i32 %y) {\n"
+      "  %a = add i32 %x, %y\n"
+      "  %b = mul i32 %a, %x\n"
+      "  %c = sub i32 %b, %y\n"
+      "  ret i32 %c\n"
+      "}\n";
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(ModuleString, Err, C);
+
+  Function *F = M->getFunction("f");
+  Argument *X = F->arg_begin();
+  Argument *Y = ++F->arg_begin();
+  Instruction *A = F->begin()->begin();
+  Instruction *B = A->getNextNode();
+  Instruction *Sub = B->getNextNode();
+
+  // A chain: uses of both %x and %a end up on %y.
+  std::pair<Value *, Value *> Chain[] = {{X, A}, {A, Y}};
+  Value::batchReplaceAllUsesWith(Chain);
+  EXPECT_TRUE(X->use_empty());
+  EXPECT_TRUE(A->use_empty());
+  EXPECT_EQ(Y, B->getOperand(0));
+  EXPECT_EQ(Y, B->getOperand(1));
+  EXPECT_EQ(Y, Sub->getOperand(1));
+
+  // Both operands of a constant user are replaced at once.
+  GlobalVariable *G1 = M->getGlobalVariable("g1");
+  GlobalVariable *G2 = M->getGlobalVariable("g2");
+  GlobalVariable *G3 = M->getGlobalVariable("g3");
+  GlobalVariable *Pair = M->getGlobalVariable("pair");
+  std::pair<Value *, Value *> Globals[] = {{G1, G3}, {G2, G3}};
+  Value::batchReplaceAllUsesWith(Globals);
+  EXPECT_TRUE(G1->use_empty());
+  EXPECT_TRUE(G2->use_empty());
+  auto *Init = cast<ConstantArray>(Pair->getInitializer());
+  EXPECT_EQ(G3, Init->getOperand(0));
+  EXPECT_EQ(G3, Init->getOperand(1));
+}
+
 TEST(GlobalTest, CreateAddressSpace) {
   LLVMContext &Ctx = getGlobalContext();
   std::unique_ptr<Module> M(new Module("TestModule", Ctx));
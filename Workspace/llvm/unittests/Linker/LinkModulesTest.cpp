@@ -177,4 +177,38 @@ TEST_F(LinkModuleTest, TypeMerge) {
             M1->getNamedGlobal("t2")->getType());
 }
 
+/// Parse a module with a private string \p Name and a function \p F that
+/// returns it.
+static std::unique_ptr<Module> parseStringUser(LLVMContext &C, StringRef Name,
+                                               StringRef F) {
+  SMDiagnostic Err;
+  std::string Str =
+      ("@" + Name + " = private unnamed_addr constant [2 x i8] c\"x\\00\"\n"
+       "define i8* @" + F + "() {\n"
+       "  ret i8* getelementptr ([2 x i8]* @" + Name + ", i32 0, i32 0)\n"
+       "}\n").str();
+  return parseAssemblyString(Str, Err, C);
+}
+
+TEST_F(LinkModuleTest, ConstantMerge) {
+  LLVMContext C;
+  std::unique_ptr<Module> Dst = parseStringUser(C, "a", "f");
+  Linker L(Dst.get(), [](const llvm::DiagnosticInfo &) {});
+
+  std::unique_ptr<Module> Src1 = parseStringUser(C, "b", "g");
+  EXPECT_FALSE(L.linkInModule(Src1.get()));
+  EXPECT_EQ(1U, Dst->getGlobalList().size());
+
+  // Constants the client deletes from the composite module aren't merged
+  // into.
+  GlobalVariable *A = Dst->getNamedGlobal("a");
+  A->replaceAllUsesWith(Constant::getNullValue(A->getType()));
+  A->eraseFromParent();
+
+  std::unique_ptr<Module> Src2 = parseStringUser(C, "c", "h");
+  EXPECT_FALSE(L.linkInModule(Src2.get()));
+  ASSERT_EQ(1U, Dst->getGlobalList().size());
+  EXPECT_TRUE(Dst->getNamedGlobal("c") != nullptr);
+}
+
 } // end anonymous namespace
@@ -67,4 +67,44 @@ TEST(CompressionTest, ZlibCRC32) {
 
 #endif
 
+void TestLZ77Compression(StringRef Input) {
+  SmallString<32> Compressed;
+  SmallString<32> Uncompressed;
+  lz77::compress(Input, Compressed);
+  EXPECT_TRUE(lz77::uncompress(Compressed, Uncompressed, Input.size()));
+  EXPECT_EQ(Input, Uncompressed);
+  if (Input.size() > 0) {
+    // Uncompression fails if the expected length is wrong, or if the data is
+    // cut short.
+    EXPECT_FALSE(lz77::uncompress(Compressed, Uncompressed, Input.size() - 1));
+    EXPECT_FALSE(lz77::uncompress(Compressed, Uncompressed, Input.size() + 1));
+    EXPECT_FALSE(lz77::uncompress(Compressed.str().drop_back(), Uncompressed,
+                                  Input.size()));
+  }
+}
+
+TEST(CompressionTest, LZ77) {
+  TestLZ77Compression("");
+  TestLZ77Compression("hello, world!");
+  TestLZ77Compression("abababababababababababababababababababab");
+
+  const size_t kSize = 100000;
+  std::string Repetitive;
+  for (size_t i = 0; Repetitive.size() < kSize; ++i)
+    Repetitive += "block " + std::to_string(i % 300) + ";";
+  TestLZ77Compression(Repetitive);
+
+  std::string Random;
+  uint32_t Seed = 1;
+  for (size_t i = 0; i != kSize; ++i) {
+    Seed = Seed * 1103515245 + 12345;
+    Random += char(Seed >> 16);
+  }
+  TestLZ77Compression(Random);
+
+  SmallString<32> Compressed;
+  lz77::compress(Repetitive, Compressed);
+  EXPECT_LT(Compressed.size(), Repetitive.size() / 4);
+}
+
 }
@@ -11,7 +11,9 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileOutputBuffer.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_mmap_ostream.h"
 #include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
@@ -108,7 +110,74 @@ TEST(FileOutputBuffer, Test) {
   EXPECT_TRUE(IsExecutable);
   ASSERT_NO_ERROR(fs::remove(File4.str()));
 
+  // TEST 5: Verify growing the buffer and shrinking it on commit.
+  SmallString<128> File5(TestDirectory);
+  File5.append("/file5");
+  {
+    std::unique_ptr<FileOutputBuffer> Buffer;
+    ASSERT_NO_ERROR(FileOutputBuffer::create(File5, 8192, Buffer));
+    memcpy(Buffer->getBufferStart(), "AABBCCDDEEFFGGHHIIJJ", 20);
+    ASSERT_NO_ERROR(Buffer->resize(819200));
+    ASSERT_EQ(Buffer->getBufferSize(), 819200U);
+    EXPECT_EQ(0, memcmp(Buffer->getBufferStart(), "AABBCCDDEEFFGGHHIIJJ", 20));
+    memcpy(Buffer->getBufferEnd() - 20, "AABBCCDDEEFFGGHHIIJJ", 20);
+    ASSERT_NO_ERROR(Buffer->commit(5000));
+  }
+  uint64_t File5Size;
+  ASSERT_NO_ERROR(fs::file_size(Twine(File5), File5Size));
+  ASSERT_EQ(File5Size, 5000ULL);
+  ASSERT_NO_ERROR(fs::remove(File5.str()));
+
   // Clean up.
   ASSERT_NO_ERROR(fs::remove(TestDirectory.str()));
 }
+
+TEST(FileOutputBuffer, RawMMapOStream) {
+  SmallString<128> TestDirectory;
+  ASSERT_NO_ERROR(
+      fs::createUniqueDirectory("raw_mmap_ostream-test", TestDirectory));
+
+  // Write more than the initial mapping through both the buffered and the
+  // direct write paths, then commit.
+  SmallString<128> File1(TestDirectory);
+  File1.append("/file1");
+  std::string Expected;
+  {
+    raw_string_ostream ES(Expected);
+    std::error_code EC;
+    raw_mmap_ostream OS(File1, EC, 0, 4096);
+    ASSERT_NO_ERROR(EC);
+    std::string Big(10000, 'x');
+    for (unsigned i = 0; i != 2000; ++i) {
+      OS << "line " << i << '\n';
+      ES << "line " << i << '\n';
+      if (i % 500 == 0) {
+        OS << Big;
+        ES << Big;
+      }
+    }
+    EXPECT_EQ(ES.str().size(), OS.tell());
+    ASSERT_NO_ERROR(OS.commit());
+  }
+  {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Contents =
+        MemoryBuffer::getFile(File1.str());
+    ASSERT_TRUE(bool(Contents));
+    EXPECT_EQ(Expected, (*Contents)->getBuffer().str());
+  }
+  ASSERT_NO_ERROR(fs::remove(File1.str()));
+
+  // Without a commit, nothing is left behind.
+  SmallString<128> File2(TestDirectory);
+  File2.append("/file2");
+  {
+    std::error_code EC;
+    raw_mmap_ostream OS(File2, EC);
+    ASSERT_NO_ERROR(EC);
+    OS << "discarded";
+  }
+  EXPECT_FALSE(fs::exists(Twine(File2)));
+
+  ASSERT_NO_ERROR(fs::remove(TestDirectory.str()));
+}
 } // anonymous namespace
@@ -0,0 +1,73 @@
+//===- llvm/unittest/Support/ParallelTest.cpp - Parallel algorithm tests --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/Parallel.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <random>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+TEST(ParallelTest, ForEachN) {
+  ThreadPool Pool(4);
+  std::vector<unsigned> Out(10000);
+  parallel_for_each_n(0U, 10000U, [&](unsigned I) { Out[I] = I * 2; }, Pool);
+  for (unsigned I = 0; I != 10000; ++I)
+    ASSERT_EQ(I * 2, Out[I]);
+
+  // Ranges shorter than the number of chunks.
+  std::atomic<unsigned> Count(0);
+  parallel_for_each_n(5, 8, [&](int) { ++Count; }, Pool);
+  parallel_for_each_n(5, 5, [&](int) { ++Count; }, Pool);
+  EXPECT_EQ(3U, Count);
+}
+
+TEST(ParallelTest, ForEach) {
+  ThreadPool Pool(3);
+  std::vector<int> V(777, 1);
+  parallel_for_each(V.begin(), V.end(), [](int &X) { X += 41; }, Pool);
+  for (int X : V)
+    ASSERT_EQ(42, X);
+}
+
+TEST(ParallelTest, Sort) {
+  ThreadPool Pool(4);
+  std::mt19937 Gen(42);
+  for (unsigned Size : {0U, 1U, 100U, 5000U, 100000U}) {
+    std::vector<unsigned> V(Size);
+    for (unsigned &X : V)
+      X = Gen() % 1000;
+    std::vector<unsigned> Expected = V;
+    std::sort(Expected.begin(), Expected.end());
+    parallel_sort(V.begin(), V.end(), std::less<unsigned>(), Pool);
+    ASSERT_EQ(Expected, V);
+  }
+
+  // Already sorted input and a custom comparator.
+  std::vector<unsigned> V(50000);
+  for (unsigned I = 0; I != V.size(); ++I)
+    V[I] = I;
+  parallel_sort(V.begin(), V.end(), std::greater<unsigned>(), Pool);
+  for (unsigned I = 0; I != V.size(); ++I)
+    ASSERT_EQ(V.size() - 1 - I, V[I]);
+}
+
+TEST(ParallelTest, GlobalPool) {
+  std::vector<int> V(20000);
+  for (unsigned I = 0; I != V.size(); ++I)
+    V[I] = (I * 7919) % 20000;
+  parallel_sort(V.begin(), V.end());
+  for (unsigned I = 0; I != V.size(); ++I)
+    ASSERT_EQ(int(I), V[I]);
+}
+
+} // end anonymous namespace
@@ -0,0 +1,81 @@
+//===- llvm/unittest/Support/ThreadPoolTest.cpp - ThreadPool tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Parallel.h"
+#include "gtest/gtest.h"
+#include <atomic>
+
+using namespace llvm;
+
+namespace {
+
+TEST(ThreadPoolTest, AsyncAndWait) {
+  ThreadPool Pool(4);
+  std::atomic<unsigned> Count(0);
+  for (unsigned I = 0; I != 1000; ++I)
+    Pool.async([&Count] { ++Count; });
+  Pool.wait();
+  EXPECT_EQ(1000U, Count);
+
+  // The pool can be reused after waiting.
+  for (unsigned I = 0; I != 10; ++I)
+    Pool.async([&Count] { ++Count; });
+  Pool.wait();
+  EXPECT_EQ(1010U, Count);
+}
+
+TEST(ThreadPoolTest, TasksSpawningTasks) {
+  ThreadPool Pool(3);
+  std::atomic<unsigned> Count(0);
+  for (unsigned I = 0; I != 10; ++I)
+    Pool.async([&Pool, &Count] {
+      for (unsigned J = 0; J != 10; ++J)
+        Pool.async([&Count] { ++Count; });
+    });
+  // wait() also covers tasks queued by tasks.
+  Pool.wait();
+  EXPECT_EQ(100U, Count);
+}
+
+TEST(ThreadPoolTest, DestructorFinishesTasks) {
+  std::atomic<unsigned> Count(0);
+  {
+    ThreadPool Pool(2);
+    for (unsigned I = 0; I != 100; ++I)
+      Pool.async([&Count] { ++Count; });
+  }
+  EXPECT_EQ(100U, Count);
+}
+
+// Recursive fork-join with more waiting tasks than threads must not
+// deadlock, since waiting threads run queued tasks.
+static unsigned fib(ThreadPool &Pool, unsigned N) {
+  if (N < 2)
+    return N;
+  unsigned A, B;
+  TaskGroup TG(Pool);
+  TG.spawn([&] { A = fib(Pool, N - 1); });
+  B = fib(Pool, N - 2);
+  TG.wait();
+  return A + B;
+}
+
+TEST(ThreadPoolTest, NestedTaskGroups) {
+  ThreadPool Pool(2);
+  EXPECT_EQ(610U, fib(Pool, 15));
+}
+
+TEST(ThreadPoolTest, SingleThread) {
+  ThreadPool Pool(1);
+  EXPECT_EQ(1U, Pool.getThreadCount());
+  EXPECT_EQ(55U, fib(Pool, 10));
+}
+
+} // end anonymous namespace